@@ -11,11 +11,16 @@
 
 #include "dxc/Support/WinIncludes.h"
 #include "llvm/ADT/ArrayRef.h"
+#include <functional>
 
 struct IDxcBlob;
 struct IStream;
 struct IMalloc;
 
+namespace hlsl {
+class AbstractMemoryStream;
+}
+
 namespace hlsl {
 namespace pdb {
 
@@ -23,5 +28,14 @@ namespace pdb {
   HRESULT LoadDataFromStream(IMalloc *pMalloc, IStream *pIStream, IDxcBlob **pOutContainer);
   HRESULT WriteDxilPDB(IMalloc *pMalloc, IDxcBlob *pContainer, llvm::ArrayRef<BYTE> HashData, IDxcBlob **ppOutBlob);
   HRESULT WriteDxilPDB(IMalloc *pMalloc, llvm::ArrayRef<BYTE> ContainerData, llvm::ArrayRef<BYTE> HashData, IDxcBlob **ppOutBlob);
+
+  // Streaming form of WriteDxilPDB. The PDB is written at the current
+  // position of pStream, and WriteContainer is called once to write exactly
+  // ContainerSize bytes of container straight into its blocks. The caller can
+  // reserve GetDxilPDBSize(ContainerSize) bytes up front.
+  uint32_t GetDxilPDBSize(uint32_t ContainerSize);
+  HRESULT WriteDxilPDB(AbstractMemoryStream *pStream, uint32_t ContainerSize,
+                       const std::function<HRESULT(IStream *)> &WriteContainer,
+                       llvm::ArrayRef<BYTE> HashData);
 }
 }
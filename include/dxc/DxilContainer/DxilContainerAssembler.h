@@ -13,8 +13,11 @@
 
 #include <functional>
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/Support/WinIncludes.h"
 #include "llvm/ADT/StringRef.h"
 
+struct IDxcBlob;
+struct IMalloc;
 struct IStream;
 
 namespace llvm {
@@ -74,4 +77,13 @@ void SerializeDxilContainerForModule(hlsl::DxilModule *pModule,
 void SerializeDxilContainerForRootSignature(hlsl::RootSignatureHandle *pRootSigHandle,
                                      AbstractMemoryStream *pStream);
 
+// Writes a copy of pContainer with one more part at the end, whose content is
+// written by WritePart straight into the new container. Like
+// IDxcContainerBuilder, the new header carries no hash, and a part that is
+// already present fails with DXC_E_DUPLICATE_PART.
+HRESULT AppendPartToContainer(IMalloc *pMalloc, IDxcBlob *pContainer,
+                              uint32_t uFourCC, uint32_t uPartSize,
+                              const std::function<HRESULT(AbstractMemoryStream *)> &WritePart,
+                              IDxcBlob **ppNewContainer, uint32_t *pPartOffset);
+
 } // namespace hlsl
\ No newline at end of file
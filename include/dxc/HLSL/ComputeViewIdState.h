@@ -107,6 +107,8 @@ private:
 namespace llvm {
 
 void initializeComputeViewIdStatePass(llvm::PassRegistry &);
-llvm::ModulePass *createComputeViewIdStatePass();
+// bPerOutputWalk selects the reference implementation that walks the
+// contributions of each output separately; it is only used for testing.
+llvm::ModulePass *createComputeViewIdStatePass(bool bPerOutputWalk = false);
 
 } // end of llvm namespace
@@ -284,8 +284,11 @@ enum class ValidationRule : unsigned {
 
 const char *GetValidationRuleText(ValidationRule value);
 void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor);
+// Functions of library targets are validated on up to NumThreads threads;
+// 0 or 1 validates serially. Diagnostics are the same either way.
 HRESULT ValidateDxilModule(_In_ llvm::Module *pModule,
-                           _In_opt_ llvm::Module *pDebugModule);
+                           _In_opt_ llvm::Module *pDebugModule,
+                           _In_ unsigned NumThreads = 0);
 
 // DXIL Container Verification Functions (return false on failure)
 
@@ -341,19 +344,22 @@ HRESULT ValidateLoadModuleFromContainerLazy(
 // Load and validate Dxil module from bitcode.
 HRESULT ValidateDxilBitcode(_In_reads_bytes_(ILLength) const char *pIL,
                             _In_ uint32_t ILLength,
-                            _In_ llvm::raw_ostream &DiagStream);
+                            _In_ llvm::raw_ostream &DiagStream,
+                            _In_ unsigned NumThreads = 0);
 
 // Full container validation, including ValidateDxilModule
 HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
                               _In_ uint32_t ContainerSize,
-                              _In_ llvm::raw_ostream &DiagStream);
+                              _In_ llvm::raw_ostream &DiagStream,
+                              _In_ unsigned NumThreads = 0);
 
 // Full container validation, including ValidateDxilModule, with debug module
 HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
                               _In_ uint32_t ContainerSize,
                               const void *pOptDebugBitcode,
                               uint32_t OptDebugBitcodeSize,
-                              _In_ llvm::raw_ostream &DiagStream);
+                              _In_ llvm::raw_ostream &DiagStream,
+                              _In_ unsigned NumThreads = 0);
 
 class PrintDiagnosticContext {
 private:
@@ -71,6 +71,16 @@ public:
   const std::string &GetSemanticDefineMetadataName() { return m_semanticDefineMetaDataName; }
   const std::string &GetTargetTriple() { return m_targetTriple; }
 
+  // Whether anything was registered or changed from its default. Intrinsic
+  // tables and validators are opaque, so such compiles can't be cached.
+  bool HasRegisteredExtensions() const {
+    return !m_semanticDefines.empty() || !m_semanticDefineExclusions.empty() ||
+           !m_nonOptSemanticDefines.empty() || !m_defines.empty() ||
+           !m_intrinsicTables.empty() || m_semanticDefineValidator != nullptr ||
+           m_semanticDefineMetaDataName != "hlsl.semdefs" ||
+           m_targetTriple != "dxil-ms-dx";
+  }
+
   HRESULT STDMETHODCALLTYPE RegisterSemanticDefine(LPCWSTR name)
   {
     return RegisterIntoVector(name, m_semanticDefines);
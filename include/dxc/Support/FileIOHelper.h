@@ -234,6 +234,11 @@ public:
   virtual LPBYTE Detach() throw() = 0;
   virtual UINT64 GetPosition() throw() = 0;
   virtual HRESULT Reserve(ULONG targetSize) throw() = 0;
+  // Extends the stream by cb zeroed bytes at the current position and returns
+  // a pointer to them, so the caller can fill them in place instead of
+  // staging them elsewhere and calling Write. The pointer is valid until the
+  // next call that may grow the stream. Returns nullptr on failure.
+  virtual LPBYTE WriteInPlace(ULONG cb) throw() = 0;
 };
 HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, _COM_Outptr_ AbstractMemoryStream** ppResult) throw();
 HRESULT CreateReadOnlyBlobStream(_In_ IDxcBlob *pSource, _COM_Outptr_ IStream** ppResult) throw();
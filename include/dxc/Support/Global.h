@@ -25,6 +25,7 @@ typedef _Return_type_success_(return >= 0) long HRESULT;
 #endif // _WIN32
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <system_error>
 #include "dxc/Support/exception.h"
 #include "dxc/Support/WinAdapter.h"
@@ -74,6 +75,45 @@ private:
   IMalloc *pPrior;
 };
 
+// Used by API entry points to serve everything operator new allocates on this
+// thread from large chunks, so that the memory of a whole invocation is
+// released in bulk rather than object by object. A chunk is released once the
+// arena is gone and the last allocation in it has been deleted. Memory freed
+// on the arena's thread is reused for later allocations of the same size
+// class, but chunks are not returned while the arena is installed.
+//
+// Only available where operator new and delete are dxcompiler's own for the
+// whole process: on non-Windows platforms, when dxcompiler is linked in rather
+// than loaded with dlopen. Otherwise the arena is simply not installed.
+struct DxcArenaStats {
+  uint64_t TotalBytes = 0; // Bytes requested while the arena was installed.
+  uint64_t ChunkBytes = 0; // Size of all the chunks the arena took.
+};
+
+class DxcThreadArena {
+public:
+  explicit DxcThreadArena(bool bEnable) throw();
+  ~DxcThreadArena();
+
+  bool IsInstalled() const { return pArena != nullptr; }
+  DxcArenaStats GetStats() const;
+
+  struct Arena;
+
+private:
+  DxcThreadArena(const DxcThreadArena &) = delete;
+  DxcThreadArena &operator =(const DxcThreadArena &) = delete;
+
+  Arena *pArena;
+  Arena *pPrior;
+};
+
+// Used by operator new and delete. DxcArenaAlloc returns null when no arena is
+// installed on the thread or the size is better served by the heap;
+// DxcArenaFree returns false for pointers that did not come from an arena.
+void *DxcArenaAlloc(size_t size) throw();
+bool DxcArenaFree(void *ptr) throw();
+
 ///////////////////////////////////////////////////////////////////////////////
 // Error handling support.
 void CheckLLVMErrorCode(const std::error_code &ec);
@@ -120,7 +120,10 @@ public:
   llvm::StringRef OutputReflectionFile; // OPT_Fre
   llvm::StringRef OutputRootSigFile; // OPT_Frs
   llvm::StringRef OutputShaderHashFile; // OPT_Fsh
+  llvm::StringRef CacheDir; // OPT_cache_dir
+  llvm::StringRef BatchFile; // OPT_batch
   llvm::StringRef Preprocess; // OPT_P
+  llvm::StringRef IncludePCH; // OPT_include_pch
   llvm::StringRef TargetProfile; // OPT_target_profile
   llvm::StringRef VariableName; // OPT_Vn
   llvm::StringRef PrivateSource; // OPT_setprivate
@@ -197,6 +200,12 @@ public:
   bool ResMayAlias = false; // OPT_res_may_alias
   unsigned long ValVerMajor = UINT_MAX, ValVerMinor = UINT_MAX; // OPT_validator_version
   unsigned ScanLimit = 0; // OPT_memdep_block_scan_limit
+  unsigned CacheSizeLimit = 1024; // OPT_cache_size_limit, in megabytes
+  unsigned BatchThreads = 0; // OPT_batch_threads, 0 for one per hardware thread
+  bool TimeReport = false; // OPT_ftime_report
+  std::string TimeTrace = ""; // OPT_ftime_trace[EQ], "-" for stdout
+  bool CompileArena = false; // OPT_fcompile_arena
+  bool EmitPCH = false; // OPT_emit_pch
   bool ForceZeroStoreLifetimes = false; // OPT_force_zero_store_lifetimes
   bool EnableLifetimeMarkers = false; // OPT_enable_lifetime_markers
 
@@ -96,13 +96,15 @@ inline DxcOutputType DxcGetOutputType(DXC_OUT_KIND kind) {
   case DXC_OUT_DISASSEMBLY:
   case DXC_OUT_HLSL:
   case DXC_OUT_TEXT:
+  case DXC_OUT_TIME_REPORT:
+  case DXC_OUT_TIME_TRACE:
     return DxcOutputType_Text;
   }
   return DxcOutputType_None;
 }
 
 // Update when new results are allowed
-static const unsigned kNumDxcOutputTypes = DXC_OUT_EXTRA_OUTPUTS;
+static const unsigned kNumDxcOutputTypes = DXC_OUT_TIME_TRACE;
 static const SIZE_T kAutoSize = (SIZE_T)-1;
 static const LPCWSTR DxcOutNoName = nullptr;
 
@@ -462,10 +464,11 @@ public:
     UINT32 numOutputs = 0;
     unsigned i = 0;
     for (; i < kNumDxcOutputTypes; ++i) {
+      if (m_outputs[i].kind == DXC_OUT_NONE)
+        continue;
       if (Index == numOutputs)
         return m_outputs[i].kind;
-      if (m_outputs[i].kind != DXC_OUT_NONE)
-        numOutputs++;
+      numOutputs++;
     }
     return DXC_OUT_NONE;
   }
@@ -14,6 +14,7 @@
 #include "dxc/dxcapi.h"
 #include "llvm/Support/MSFileSystem.h"
 #include <string>
+#include <vector>
 
 namespace clang {
 class CompilerInstance;
@@ -32,6 +33,13 @@ class MSFileSystem;
 
 namespace dxcutil {
 
+// A name the include handler was asked to load during a compile. Blob is
+// owned by the file system and is null if the handler could not provide it.
+struct DxcIncludeRecord {
+  std::wstring Name;
+  IDxcBlobUtf8 *Blob;
+};
+
 class DxcArgsFileSystem : public ::llvm::sys::fs::MSFileSystem {
 public:
   virtual ~DxcArgsFileSystem(){};
@@ -41,6 +49,7 @@ public:
   virtual void EnableDisplayIncludeProcess() = 0;
   virtual HRESULT CreateStdStreams(_In_ IMalloc *pMalloc) = 0;
   virtual HRESULT RegisterOutputStream(LPCWSTR pName, IStream *pStream) = 0;
+  virtual void GetIncludeRecords(std::vector<DxcIncludeRecord> &records) = 0;
 };
 
 DxcArgsFileSystem *
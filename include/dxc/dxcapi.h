@@ -183,6 +183,22 @@ struct IDxcIncludeHandler : public IUnknown {
     ) = 0;
 };
 
+// Include handler that keeps the decoded UTF-8 contents of every file it
+// loads. Pass one instance to many Compile calls (for example, when building
+// shader permutations) so each include is loaded and transcoded only once.
+// Identical contents reached through different names share a single blob.
+// Files are assumed not to change while the cache is in use. The cache may be
+// shared between threads; calls into the wrapped handler are serialized.
+CROSS_PLATFORM_UUIDOF(IDxcIncludeCache, "2649a834-5b44-4856-82fc-13541af872e9")
+struct IDxcIncludeCache : public IDxcIncludeHandler {
+  // Handler used to load files missing from the cache; nullptr (the default)
+  // loads from the file system.
+  virtual HRESULT STDMETHODCALLTYPE SetIncludeHandler(
+    _In_opt_ IDxcIncludeHandler *pHandler) = 0;
+  // Drop all cached contents and failed lookups.
+  virtual HRESULT STDMETHODCALLTYPE Clear() = 0;
+};
+
 // Structure for supplying bytes or text input to Dxc APIs.
 // Use Encoding = 0 for non-text bytes, ANSI text, or unknown with BOM.
 typedef struct DxcBuffer {
@@ -349,6 +365,43 @@ public:
   ) = 0;
 };
 
+// A shader to produce with IDxcLinkerBatch::LinkBatch.
+struct DxcLinkTarget {
+  LPCWSTR pEntryName;                   // Entry point name
+  LPCWSTR pTargetProfile;               // Shader profile to link
+  const LPCWSTR *pArguments;            // Arguments for this target only, placed after the shared ones
+  UINT32 argCount;                      // Number of arguments
+};
+
+CROSS_PLATFORM_UUIDOF(IDxcLinkerBatchCallback, "8ae88ac5-b8f2-4e0a-9809-2e7c9b5acf8f")
+struct IDxcLinkerBatchCallback : public IUnknown {
+  // Receives the result of target uIndex as soon as it completes. Results
+  // arrive in completion order and may be delivered concurrently from
+  // multiple threads. Returning a failure stops the batch from starting
+  // further targets.
+  virtual HRESULT STDMETHODCALLTYPE OnResult(
+    _In_ UINT32 uIndex, _In_ IDxcOperationResult *pResult) = 0;
+};
+
+// Available from the same object as IDxcLinker.
+CROSS_PLATFORM_UUIDOF(IDxcLinkerBatch, "c6a71421-e026-4ab7-9d0a-437d7f4da2b6")
+struct IDxcLinkerBatch : public IUnknown {
+  // Link one shader per target from the same registered libraries, on up to
+  // numThreads threads. Each thread loads the libraries once, lazily, and
+  // links all of its targets from them. The container event handler is
+  // called from the linking threads.
+  virtual HRESULT STDMETHODCALLTYPE LinkBatch(
+    _In_count_(targetCount) const DxcLinkTarget *pTargets, // Shaders to link
+    _In_ UINT32 targetCount,                               // Number of targets
+    _In_count_(libCount) const LPCWSTR *pLibNames,         // Array of library names to link
+    _In_ UINT32 libCount,                                  // Number of libraries to link
+    _In_opt_count_(sharedArgCount) const LPCWSTR *pSharedArguments, // Arguments common to every target
+    _In_ UINT32 sharedArgCount,                            // Number of shared arguments
+    _In_ UINT32 numThreads,                                // Worker threads; 0 uses one per hardware thread
+    _In_ IDxcLinkerBatchCallback *pCallback                // Receives each target's result
+  ) = 0;
+};
+
 /////////////////////////
 // Latest interfaces. Please use these
 ////////////////////////
@@ -444,6 +497,8 @@ typedef enum DXC_OUT_KIND {
   DXC_OUT_REFLECTION = 8,     // IDxcBlob - RDAT part with reflection data
   DXC_OUT_ROOT_SIGNATURE = 9, // IDxcBlob - Serialized root signature output
   DXC_OUT_EXTRA_OUTPUTS  = 10,// IDxcExtraResults - Extra outputs
+  DXC_OUT_TIME_REPORT = 11,   // IDxcBlobUtf8 or IDxcBlobUtf16 - Per-phase time report (-ftime-report)
+  DXC_OUT_TIME_TRACE = 12,    // IDxcBlobUtf8 or IDxcBlobUtf16 - Chrome trace JSON (-ftime-trace)
 
   DXC_OUT_FORCE_DWORD = 0xFFFFFFFF
 } DXC_OUT_KIND;
@@ -495,11 +550,45 @@ struct IDxcCompiler3 : public IUnknown {
     ) = 0;
 };
 
+CROSS_PLATFORM_UUIDOF(IDxcCompilerBatchCallback, "99b7a8cf-22fd-4d74-9433-7729be5e9c61")
+struct IDxcCompilerBatchCallback : public IUnknown {
+  // Receives the result of variant uIndex as soon as it completes. Results
+  // arrive in completion order and may be delivered concurrently from
+  // multiple threads. Returning a failure stops the batch from starting
+  // further variants.
+  virtual HRESULT STDMETHODCALLTYPE OnResult(
+    _In_ UINT32 uIndex, _In_ IDxcResult *pResult) = 0;
+};
+
+// Available from the same object as IDxcCompiler3.
+CROSS_PLATFORM_UUIDOF(IDxcCompilerBatch, "e734df94-40d6-4450-a388-3f1b5e4508fa")
+struct IDxcCompilerBatch : public IUnknown {
+  // Compile one source once per argument set (for example, each combination
+  // of -D defines of a shader permutation), on up to numThreads threads.
+  // The source is decoded once and included files are loaded once for the
+  // whole batch. When the variants add only -D defines that the leading
+  // #include lines of the source do not use, those lines are compiled once
+  // into a precompiled header that every variant loads; -include-pch in the
+  // shared arguments supplies one instead. Language extensions and container
+  // event handlers must not be changed while a batch is running.
+  virtual HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_ const DxcBuffer *pSource,                      // Source text to compile
+    _In_opt_count_(sharedArgCount) LPCWSTR *pSharedArguments, // Arguments common to every variant, placed first
+    _In_ UINT32 sharedArgCount,                         // Number of shared arguments
+    _In_count_(variantCount) IDxcCompilerArgs **ppVariantArguments, // Arguments specific to each variant
+    _In_ UINT32 variantCount,                           // Number of variants
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,       // user-provided interface to handle #include directives (optional)
+    _In_ UINT32 numThreads,                             // Worker threads; 0 uses one per hardware thread
+    _In_ IDxcCompilerBatchCallback *pCallback           // Receives each variant's IDxcResult
+  ) = 0;
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit = 1;  // Validator is allowed to update shader blob in-place.
 static const UINT32 DxcValidatorFlags_RootSignatureOnly = 2;
 static const UINT32 DxcValidatorFlags_ModuleOnly = 4;
-static const UINT32 DxcValidatorFlags_ValidMask = 0x7;
+static const UINT32 DxcValidatorFlags_ParallelFunctions = 8; // Validate library functions on multiple threads.
+static const UINT32 DxcValidatorFlags_ValidMask = 0xf;
 
 CROSS_PLATFORM_UUIDOF(IDxcValidator, "A6E82BD2-1FD7-4826-9811-2857E797F49A")
 struct IDxcValidator : public IUnknown {
@@ -722,4 +811,11 @@ CLSID_SCOPE const GUID CLSID_DxcPdbUtils = {
     0x457e,
     {0xae, 0x8c, 0xec, 0x35, 0x5f, 0xae, 0xec, 0x7c}};
 
+// {ef581253-40ae-4478-8287-3df19db7981b}
+CLSID_SCOPE const GUID CLSID_DxcIncludeCache = {
+    0xef581253,
+    0x40ae,
+    0x4478,
+    {0x82, 0x87, 0x3d, 0xf1, 0x9d, 0xb7, 0x98, 0x1b}};
+
 #endif
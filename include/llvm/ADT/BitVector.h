@@ -534,7 +534,7 @@ private:
     // HLSL Change Starts: Use overridable operator new
     // Bits = (BitWord *)std::realloc(Bits, Capacity * sizeof(BitWord));
     BitWord  *newBits = new BitWord[Capacity];
-    std::memcpy(newBits, Bits, NumBitWords(Size));
+    std::memcpy(newBits, Bits, NumBitWords(Size) * sizeof(BitWord));
     delete[] Bits;
     Bits = newBits;
     // HLSL Change Ends
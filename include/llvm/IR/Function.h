@@ -83,7 +83,8 @@ private:
   enum {
     /// Whether this function is materializable.
     IsMaterializableBit = 1 << 0,
-    HasMetadataHashEntryBit = 1 << 1
+    HasMetadataHashEntryBit = 1 << 1,
+    HasDxilOpNameBit = 1 << 2 // HLSL Change
   };
   void setGlobalObjectBit(unsigned Mask, bool Value) {
     setGlobalObjectSubClassData((~Mask & getGlobalObjectSubClassData()) |
@@ -159,11 +160,21 @@ public:
   Intrinsic::ID getIntrinsicID() const LLVM_READONLY { return IntID; }
   bool isIntrinsic() const { return getName().startswith("llvm."); }
 
+  // HLSL Change Begin
+  /// hasDxilOpName - Return true if the name of this function starts with
+  /// "dx.op.". Like the intrinsic ID, this is updated whenever the name
+  /// changes, so it can be tested without looking up the name.
+  bool hasDxilOpName() const {
+    return getGlobalObjectSubClassData() & HasDxilOpNameBit;
+  }
+  // HLSL Change End
+
   /// \brief Recalculate the ID for this function if it is an Intrinsic defined
   /// in llvm/Intrinsics.h.  Sets the intrinsic ID to Intrinsic::not_intrinsic
   /// if the name of this function does not match an intrinsic in that header.
   /// Note, this method does not need to be called directly, as it is called
   /// from Value::setName() whenever the name of this function changes.
+  /// HLSL Change - also recalculates hasDxilOpName().
   void recalculateIntrinsicID();
 
   /// getCallingConv()/setCallingConv(CC) - These method get and set the
@@ -233,6 +233,7 @@ public:
 private:
   void destroyValueName();
   void setNameImpl(const Twine &Name);
+  void takeNameImpl(Value *V); // HLSL Change
 
 public:
   /// \brief Return a constant reference to the value's name.
@@ -0,0 +1,89 @@
+//===- llvm/Support/TimeProfiler.h - Hierarchical Time Profiler -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - Records nested, named time regions for the current thread and
+// writes them either as a Chrome trace (chrome://tracing, Perfetto) or as a
+// flat report of the total time spent in each region.
+//
+// The profiler is per thread, so concurrent compiles in one process each get
+// their own trace. All entry points are no-ops on threads where the profiler
+// has not been initialized.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_TIME_PROFILER_H
+#define LLVM_SUPPORT_TIME_PROFILER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+#include <chrono>
+#include <string>
+
+namespace llvm {
+
+class raw_ostream;
+
+struct TimeTraceProfiler;
+extern LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance;
+
+typedef std::chrono::steady_clock TimeTraceClock;
+
+/// Initialize the time trace profiler for the current thread. Times are
+/// reported relative to \p StartTime.
+void timeTraceProfilerInitialize(
+    TimeTraceClock::time_point StartTime = TimeTraceClock::now());
+
+/// Release the current thread's profiler and everything it recorded.
+void timeTraceProfilerCleanup();
+
+/// Is the time trace profiler enabled on the current thread?
+inline bool timeTraceProfilerEnabled() {
+  return TimeTraceProfilerInstance != nullptr;
+}
+
+/// Write the recorded regions in Chrome trace event JSON format.
+void timeTraceProfilerWrite(raw_ostream &OS);
+
+/// Write the total time and count of each region, largest first. Regions
+/// with a detail are reported per detail, such as one line per pass.
+void timeTraceProfilerWriteReport(raw_ostream &OS);
+
+/// Manually begin a region. Every call must be paired with
+/// timeTraceProfilerEnd; prefer TimeTraceScope.
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail);
+
+/// Manually end the most recently begun region.
+void timeTraceProfilerEnd();
+
+/// Record a region that began at \p Start and ends now, for work that ran
+/// before the profiler could be initialized.
+void timeTraceProfilerAddRegion(StringRef Name, StringRef Detail,
+                                TimeTraceClock::time_point Start);
+
+/// The TimeTraceScope is a helper class to call the begin and end functions
+/// of the time trace profiler. When the object is constructed, it begins the
+/// region; when it is destroyed, it ends it.
+struct TimeTraceScope {
+  TimeTraceScope(StringRef Name, StringRef Detail = StringRef()) {
+    if (TimeTraceProfilerInstance != nullptr)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  ~TimeTraceScope() {
+    if (TimeTraceProfilerInstance != nullptr)
+      timeTraceProfilerEnd();
+  }
+
+private:
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  void operator=(const TimeTraceScope &) = delete;
+};
+
+} // end namespace llvm
+
+#endif
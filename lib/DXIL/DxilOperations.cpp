@@ -538,9 +538,13 @@ bool OP::IsDxilOpFuncName(StringRef name) {
 
 bool OP::IsDxilOpFunc(const llvm::Function *F) {
   // Test for null to allow IsDxilOpFunc(Call.getCalledFunc()) to be resilient to indirect calls
-  if (F == nullptr || !F->hasName())
+  if (F == nullptr)
     return false;
-  return IsDxilOpFuncName(F->getName());
+  // The function caches whether its name has the dx.op. prefix, which avoids
+  // looking up the name of every callee.
+  DXASSERT_NOMSG(F->hasDxilOpName() ==
+                 (F->hasName() && IsDxilOpFuncName(F->getName())));
+  return F->hasDxilOpName();
 }
 
 bool OP::IsDxilOpTypeName(StringRef name) {
@@ -1492,6 +1496,10 @@ void OP::RemoveFunction(Function *F) {
 }
 
 bool OP::GetOpCodeClass(const Function *F, OP::OpCodeClass &opClass) {
+  if (!IsDxilOpFunc(F)) {
+    opClass = OP::OpCodeClass::NumOpClasses;
+    return false;
+  }
   auto iter = m_FunctionToOpClass.find(F);
   if (iter == m_FunctionToOpClass.end()) {
     // When no user, cannot get opcode.
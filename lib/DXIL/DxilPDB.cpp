@@ -86,8 +86,13 @@ static HRESULT ReadAllBytes(IStream *pStream, void *pDst, size_t uSize) {
 
 struct MSFWriter {
 
+  typedef std::function<HRESULT(IStream *)> WriteFn;
+
   struct Stream {
     ArrayRef<char> Data;
+    uint32_t Size = 0;
+    // When set, writes the Size bytes of the stream instead of Data.
+    const WriteFn *Write = nullptr;
     unsigned NumBlocks = 0;
   };
   struct StreamLayout {
@@ -102,10 +107,17 @@ struct MSFWriter {
   }
 
   uint32_t AddStream(ArrayRef<char> Data) {
+    uint32_t ID = AddStream(Data.size(), nullptr);
+    m_Streams[ID].Data = Data;
+    return ID;
+  }
+
+  uint32_t AddStream(uint32_t Size, const WriteFn *Write) {
     uint32_t ID = m_Streams.size();
     Stream S;
-    S.Data = Data;
-    S.NumBlocks = GetNumBlocks(Data.size());
+    S.Size = Size;
+    S.Write = Write;
+    S.NumBlocks = GetNumBlocks(Size);
     m_NumBlocks += S.NumBlocks;
     m_Streams.push_back(S);
     return ID;
@@ -143,8 +155,12 @@ struct MSFWriter {
     BlockWriter(raw_ostream &OS) : OS(OS) {}
 
     void WriteZeroPads(uint32_t Count) {
-      for (unsigned i = 0; i < Count; i++)
-        OS.write(0);
+      static const char Zeros[kMsfBlockSize] = {};
+      while (Count) {
+        uint32_t Size = std::min(Count, kMsfBlockSize);
+        OS.write(Zeros, Size);
+        Count -= Size;
+      }
     }
 
     void WriteEmptyBlock() {
@@ -184,7 +200,18 @@ struct MSFWriter {
     return ValueLE;
   }
 
-  void WriteToStream(raw_ostream &OS) {
+  // Number of bytes WriteToStream will write. The superblock's NumBlocks does
+  // not count the block address blocks, so this is derived from the layout.
+  uint32_t GetSize() {
+    const uint32_t NumDirectoryBlocks = GetNumBlocks(CalculateDirectorySize());
+    const uint32_t NumBlockAddrBlocks =
+        GetNumBlocks(NumDirectoryBlocks * sizeof(support::ulittle32_t));
+    return (3 + NumBlockAddrBlocks + NumDirectoryBlocks + m_NumBlocks) *
+           kMsfBlockSize;
+  }
+
+  HRESULT WriteToStream(hlsl::AbstractMemoryStream *pStream) {
+    raw_stream_ostream OS(pStream);
     MSF_SuperBlock SB = CalculateSuperblock();
     const uint32_t NumDirectoryBlocks = GetNumBlocks(SB.NumDirectoryBytes);
     const uint32_t StreamDirectoryAddr = SB.BlockMapAddr;
@@ -220,7 +247,7 @@ struct MSFWriter {
       SmallVector<support::ulittle32_t, 32> StreamDirectoryData;
       StreamDirectoryData.push_back(MakeUint32LE(m_Streams.size()));
       for (unsigned i = 0; i < m_Streams.size(); i++) {
-        StreamDirectoryData.push_back(MakeUint32LE(m_Streams[i].Data.size()));
+        StreamDirectoryData.push_back(MakeUint32LE(m_Streams[i].Size));
       }
       uint32_t Start = StreamStart;
       for (unsigned i = 0; i < m_Streams.size(); i++) {
@@ -236,10 +263,23 @@ struct MSFWriter {
     {
       for (unsigned i = 0; i < m_Streams.size(); i++) {
         auto &Stream = m_Streams[i];
-        Writer.WriteBlocks(Stream.NumBlocks, Stream.Data.data(), Stream.Data.size());
+        if (!Stream.Write) {
+          Writer.WriteBlocks(Stream.NumBlocks, Stream.Data.data(), Stream.Data.size());
+          continue;
+        }
+        // Let the stream write itself into place, then pad out its blocks.
+        OS.flush();
+        UINT64 uStart = pStream->GetPosition();
+        IFR((*Stream.Write)(pStream));
+        if (pStream->GetPosition() - uStart != Stream.Size)
+          return E_FAIL;
+        Writer.WriteZeroPads(Stream.NumBlocks * kMsfBlockSize - Stream.Size);
+        Writer.BlocksWritten += Stream.NumBlocks;
       }
     }
 
+    OS.flush();
+    return S_OK;
   }
 };
 
@@ -302,13 +342,9 @@ HRESULT hlsl::pdb::WriteDxilPDB(IMalloc *pMalloc, IDxcBlob *pContainer, ArrayRef
     HashData, ppOutBlob);
 }
 
-HRESULT hlsl::pdb::WriteDxilPDB(IMalloc *pMalloc, llvm::ArrayRef<BYTE> ContainerData, llvm::ArrayRef<BYTE> HashData, IDxcBlob **ppOutBlob) {
-  if (!hlsl::IsValidDxilContainer((const hlsl::DxilContainerHeader *)ContainerData.data(), ContainerData.size()))
-    return E_FAIL;
-
-  SmallVector<char, 0> PdbStream = WritePdbStream(HashData);
-
-  MSFWriter Writer;
+static void AddDxilPDBStreams(MSFWriter &Writer, ArrayRef<char> PdbStream,
+                              uint32_t ContainerSize,
+                              const MSFWriter::WriteFn *WriteContainer) {
   Writer.AddEmptyStream();     // Old Directory
   Writer.AddStream(PdbStream); // PDB Header
 
@@ -316,15 +352,44 @@ HRESULT hlsl::pdb::WriteDxilPDB(IMalloc *pMalloc, llvm::ArrayRef<BYTE> Container
   Writer.AddEmptyStream(); // TPI
   Writer.AddEmptyStream(); // DBI
   Writer.AddEmptyStream(); // IPI
-  
-  Writer.AddStream(llvm::ArrayRef<char>((const char *)ContainerData.data(), ContainerData.size() )); // Actual data block
-  
+
+  Writer.AddStream(ContainerSize, WriteContainer); // Actual data block
+}
+
+uint32_t hlsl::pdb::GetDxilPDBSize(uint32_t ContainerSize) {
+  // Only the size of the PDB header stream matters here.
+  BYTE Hash[sizeof(PdbStreamHeader::UniqueId)] = {};
+  SmallVector<char, 0> PdbStream = WritePdbStream(Hash);
+
+  MSFWriter Writer;
+  AddDxilPDBStreams(Writer, PdbStream, ContainerSize, nullptr);
+  return Writer.GetSize();
+}
+
+HRESULT hlsl::pdb::WriteDxilPDB(AbstractMemoryStream *pStream, uint32_t ContainerSize,
+                                const std::function<HRESULT(IStream *)> &WriteContainer,
+                                ArrayRef<BYTE> HashData) {
+  SmallVector<char, 0> PdbStream = WritePdbStream(HashData);
+
+  MSFWriter Writer;
+  AddDxilPDBStreams(Writer, PdbStream, ContainerSize, &WriteContainer);
+  return Writer.WriteToStream(pStream);
+}
+
+HRESULT hlsl::pdb::WriteDxilPDB(IMalloc *pMalloc, llvm::ArrayRef<BYTE> ContainerData, llvm::ArrayRef<BYTE> HashData, IDxcBlob **ppOutBlob) {
+  if (!hlsl::IsValidDxilContainer((const hlsl::DxilContainerHeader *)ContainerData.data(), ContainerData.size()))
+    return E_FAIL;
+
   CComPtr<hlsl::AbstractMemoryStream> pStream;
   IFR(hlsl::CreateMemoryStream(pMalloc, &pStream));
-
-  raw_stream_ostream OS(pStream);
-  Writer.WriteToStream(OS);
-  OS.flush();
+  IFR(pStream->Reserve(GetDxilPDBSize(ContainerData.size())));
+
+  IFR(WriteDxilPDB(pStream, ContainerData.size(),
+    [ContainerData](IStream *pContainerStream) {
+      ULONG uBytesWritten = 0;
+      return pContainerStream->Write(ContainerData.data(), ContainerData.size(), &uBytesWritten);
+    },
+    HashData));
 
   IFR(pStream.QueryInterface(ppOutBlob));
 
@@ -1198,6 +1198,20 @@ public:
     return S_OK;
   }
 
+  LPBYTE WriteInPlace(ULONG cb) throw() override {
+    if (cb + m_offset > m_allocSize) {
+      if (FAILED(Grow(cb + m_offset)))
+        return nullptr;
+    }
+    // Zero any gap left by seeking past the end, as well as the new bytes.
+    ULONG start = std::min(m_offset, m_size);
+    memset(m_pMemory + start, 0, m_offset + cb - start);
+    LPBYTE result = m_pMemory + m_offset;
+    m_offset += cb;
+    m_size = std::max(m_size, m_offset);
+    return result;
+  }
+
   // IDxcBlob implementation. Requires no further writes.
   LPVOID STDMETHODCALLTYPE GetBufferPointer(void) override {
     return m_pMemory;
@@ -1551,6 +1565,15 @@ public:
   HRESULT Reserve(ULONG targetSize) throw() override {
     return targetSize <= m_size ? S_OK : E_BOUNDS;
   }
+
+  LPBYTE WriteInPlace(ULONG cb) throw() override {
+    if (cb > m_size - m_offset)
+      return nullptr;
+    LPBYTE result = m_pBuffer + m_offset;
+    memset(result, 0, cb);
+    m_offset += cb;
+    return result;
+  }
 };
 
 HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, _COM_Outptr_ AbstractMemoryStream** ppResult) throw() {
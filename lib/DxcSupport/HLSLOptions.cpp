@@ -488,6 +488,20 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.OutputReflectionFile = Args.getLastArgValue(OPT_Fre);
   opts.OutputRootSigFile = Args.getLastArgValue(OPT_Frs);
   opts.OutputShaderHashFile = Args.getLastArgValue(OPT_Fsh);
+  opts.TimeReport = Args.hasFlag(OPT_ftime_report, OPT_INVALID, false);
+  opts.TimeTrace = Args.hasFlag(OPT_ftime_trace, OPT_INVALID, false) ? "-" : "";
+  if (Args.hasArg(OPT_ftime_trace_EQ))
+    opts.TimeTrace = Args.getLastArgValue(OPT_ftime_trace_EQ);
+  opts.CompileArena = Args.hasFlag(OPT_fcompile_arena, OPT_INVALID, false);
+  opts.EmitPCH = Args.hasFlag(OPT_emit_pch, OPT_INVALID, false);
+  opts.IncludePCH = Args.getLastArgValue(OPT_include_pch);
+  opts.CacheDir = Args.getLastArgValue(OPT_cache_dir);
+  llvm::StringRef cacheSizeLimit = Args.getLastArgValue(OPT_cache_size_limit);
+  if (!cacheSizeLimit.empty() &&
+      cacheSizeLimit.getAsInteger(10, opts.CacheSizeLimit)) {
+    errors << "Unsupported value '" << cacheSizeLimit << "' for cache-size-limit option.";
+    return 1;
+  }
   opts.ShowOptionNames = Args.hasFlag(OPT_fdiagnostics_show_option, OPT_fno_diagnostics_show_option, true);
   opts.UseColor = Args.hasFlag(OPT_Cc, OPT_INVALID, false);
   opts.UseInstructionNumbers = Args.hasFlag(OPT_Ni, OPT_INVALID, false);
@@ -656,6 +670,13 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.DefaultColMajor = Args.hasFlag(OPT_Zpc, OPT_INVALID, false);
   opts.DumpBin = Args.hasFlag(OPT_dumpbin, OPT_INVALID, false);
   opts.Link = Args.hasFlag(OPT_link, OPT_INVALID, false);
+  opts.BatchFile = Args.getLastArgValue(OPT_batch);
+  llvm::StringRef batchThreads = Args.getLastArgValue(OPT_batch_threads);
+  if (!batchThreads.empty() &&
+      batchThreads.getAsInteger(10, opts.BatchThreads)) {
+    errors << "Unsupported value '" << batchThreads << "' for batch-threads option.";
+    return 1;
+  }
   opts.NotUseLegacyCBufLoad = Args.hasFlag(OPT_no_legacy_cbuf_layout, OPT_INVALID, false);
   opts.NotUseLegacyCBufLoad = Args.hasFlag(OPT_not_use_legacy_cbuf_load_, OPT_INVALID, opts.NotUseLegacyCBufLoad);
   opts.PackPrefixStable = Args.hasFlag(OPT_pack_prefix_stable, OPT_INVALID, false);
@@ -727,7 +748,8 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // ERR_TEMPLATE_VAR_CONFLICT
   // ERR_ATTRIBUTE_PARAM_SIDE_EFFECT
 
-  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty()) {
+  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty() &&
+      opts.BatchFile.empty()) {
     // Input file is required in arguments only for drivers; APIs take this through an argument.
     errors << "Required input file argument is missing. use -help to get more information.";
     return 1;
@@ -772,7 +794,8 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // XXX TODO: Sort this out, since it's required for new API, but a separate argument for old APIs.
   if ((flagsToInclude & hlsl::options::DriverOption) &&
       !(flagsToInclude & hlsl::options::RewriteOption) &&
-      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary
+      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary &&
+      opts.BatchFile.empty()
       ) {
     // Target profile is required in arguments only for drivers when compiling;
     // APIs take this through an argument.
@@ -16,8 +16,17 @@
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/WinFunctions.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/ThreadLocal.h"
+#include <atomic>
+#include <cstring>
 #include <memory>
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <mutex>
+#include <sys/mman.h>
+#endif
 
 static llvm::sys::ThreadLocal<IMalloc> *g_ThreadMallocTls;
 static IMalloc *g_pDefaultMalloc;
@@ -98,3 +107,266 @@ DxcThreadMalloc::DxcThreadMalloc(IMalloc *pMallocOrNull) throw() {
 DxcThreadMalloc::~DxcThreadMalloc() {
     DxcSwapThreadMalloc(pPrior, nullptr);
 }
+
+//===------------------------ Per-invocation arena ------------------------===//
+//
+// Arena chunks are aligned to their size, so the chunk of an allocation is
+// found by masking its address. A bitmap with one bit per chunk-aligned
+// address tells operator delete whether a pointer belongs to a chunk without
+// reading the memory around it. Each chunk counts its live allocations plus
+// one reference held by the arena that fills it; whoever drops the count to
+// zero releases the chunk. Allocations that outlive the arena, like the
+// contents of results handed back to the caller, keep only their own chunk.
+//
+// Chunks are carved into page-aligned runs, each serving a single size class
+// recorded per page in the chunk header. Blocks deleted on the arena's own
+// thread go on a free list for their class and are handed out again.
+
+static const size_t kArenaChunkSize = 1 << 20;
+static const size_t kArenaPageSize = 4096;
+static const size_t kArenaRunSize = 4 * kArenaPageSize;
+static const size_t kArenaMaxAllocSize = kArenaChunkSize / 16;
+static const size_t kArenaAlignment = 16;
+static const unsigned kArenaAddressBits = 47;
+static const unsigned kArenaMaxCachedChunks = 16;
+static const size_t kArenaChunkMapWords =
+    ((size_t)1 << kArenaAddressBits) / kArenaChunkSize / 64;
+// Sixteen byte steps up to 128 bytes, then four classes per power of two up
+// to kArenaMaxAllocSize.
+static const unsigned kArenaSizeClassCount = 8 + 9 * 4;
+
+static unsigned GetArenaSizeClass(size_t size) {
+  if (size <= 128)
+    return size == 0 ? 0 : (unsigned)((size - 1) / 16);
+  unsigned Log = llvm::Log2_64(size - 1);
+  return 8 + (Log - 7) * 4 + (unsigned)((size - 1) >> (Log - 2)) - 4;
+}
+
+static size_t GetArenaSizeClassSize(unsigned Class) {
+  if (Class < 8)
+    return (Class + 1) * 16;
+  unsigned Log = 7 + (Class - 8) / 4;
+  return (size_t)(5 + (Class - 8) % 4) << (Log - 2);
+}
+
+namespace {
+struct ArenaChunk {
+  std::atomic<size_t> Refs;
+  ArenaChunk *Next;
+  // Arena that fills the chunk; cleared when that arena goes away.
+  std::atomic<DxcThreadArena::Arena *> Owner;
+  uint8_t PageClass[kArenaChunkSize / kArenaPageSize];
+};
+}
+// The first page only holds the header; runs start on the next one.
+static_assert(sizeof(ArenaChunk) <= kArenaPageSize,
+              "arena chunk header must fit in the first page");
+
+struct DxcThreadArena::Arena {
+  char *Cur = nullptr;
+  char *End = nullptr;
+  ArenaChunk *Chunks = nullptr;
+  char *RunCur[kArenaSizeClassCount] = {};
+  char *RunEnd[kArenaSizeClassCount] = {};
+  void *FreeList[kArenaSizeClassCount] = {};
+  DxcArenaStats Stats;
+};
+
+static std::atomic<std::atomic<uint64_t> *> g_ArenaChunkMap;
+static LLVM_THREAD_LOCAL DxcThreadArena::Arena *g_pThreadArena;
+
+#ifndef _WIN32
+// Arena pointers must never reach a delete that does not know about them.
+// That only holds if the operator new and delete bound for the whole process
+// are the ones defined in this module, which calls back into the arena.
+static bool IsArenaSupported() {
+  static const bool bSupported = []() {
+    void *(*pNew)(std::size_t) = &::operator new;
+    void (*pDelete)(void *) throw() = &::operator delete;
+    Dl_info Self, New, Delete;
+    return dladdr((void *)&IsArenaSupported, &Self) &&
+           dladdr((void *)pNew, &New) && dladdr((void *)pDelete, &Delete) &&
+           New.dli_fbase == Self.dli_fbase &&
+           Delete.dli_fbase == Self.dli_fbase;
+  }();
+  return bSupported;
+}
+
+// The map is reserved once for the whole address space; only the pages that
+// cover chunks in use are ever committed.
+static std::atomic<uint64_t> *GetArenaChunkMap() {
+  std::atomic<uint64_t> *pMap = g_ArenaChunkMap.load(std::memory_order_acquire);
+  if (pMap)
+    return pMap;
+  const size_t MapSize = kArenaChunkMapWords * sizeof(uint64_t);
+  void *pMem = mmap(nullptr, MapSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (pMem == MAP_FAILED)
+    return nullptr;
+  if (!g_ArenaChunkMap.compare_exchange_strong(
+          pMap, (std::atomic<uint64_t> *)pMem, std::memory_order_acq_rel)) {
+    munmap(pMem, MapSize);
+    return pMap;
+  }
+  return (std::atomic<uint64_t> *)pMem;
+}
+
+// Released chunks are kept for the next arena up to a limit, so back to back
+// compiles do not map and fault in fresh memory every time.
+static std::mutex g_ArenaChunkCacheLock;
+static void *g_ArenaChunkCache[kArenaMaxCachedChunks];
+static unsigned g_ArenaChunkCacheCount;
+
+static ArenaChunk *AllocArenaChunk() {
+  std::atomic<uint64_t> *pMap = GetArenaChunkMap();
+  if (!pMap)
+    return nullptr;
+  void *pMem = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(g_ArenaChunkCacheLock);
+    if (g_ArenaChunkCacheCount)
+      pMem = g_ArenaChunkCache[--g_ArenaChunkCacheCount];
+  }
+  if (!pMem && posix_memalign(&pMem, kArenaChunkSize, kArenaChunkSize) != 0)
+    return nullptr;
+  uintptr_t Index = (uintptr_t)pMem / kArenaChunkSize;
+  if (Index / 64 >= kArenaChunkMapWords) {
+    free(pMem);
+    return nullptr;
+  }
+  ArenaChunk *pChunk = new (pMem) ArenaChunk;
+  pChunk->Refs.store(1, std::memory_order_relaxed);
+  pChunk->Next = nullptr;
+  pChunk->Owner.store(nullptr, std::memory_order_relaxed);
+  pMap[Index / 64].fetch_or((uint64_t)1 << (Index % 64),
+                            std::memory_order_release);
+  return pChunk;
+}
+
+static void ReleaseArenaChunk(ArenaChunk *pChunk) {
+  if (pChunk->Refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  uintptr_t Index = (uintptr_t)pChunk / kArenaChunkSize;
+  g_ArenaChunkMap.load(std::memory_order_relaxed)[Index / 64].fetch_and(
+      ~((uint64_t)1 << (Index % 64)), std::memory_order_release);
+  pChunk->~ArenaChunk();
+  {
+    std::lock_guard<std::mutex> lock(g_ArenaChunkCacheLock);
+    if (g_ArenaChunkCacheCount < kArenaMaxCachedChunks) {
+      g_ArenaChunkCache[g_ArenaChunkCacheCount++] = pChunk;
+      return;
+    }
+  }
+  free(pChunk);
+}
+#else
+// operator new on Windows routes through the thread IMalloc instead.
+static bool IsArenaSupported() { return false; }
+static ArenaChunk *AllocArenaChunk() { return nullptr; }
+static void ReleaseArenaChunk(ArenaChunk *) {}
+#endif
+
+DxcThreadArena::DxcThreadArena(bool bEnable) throw()
+    : pArena(nullptr), pPrior(g_pThreadArena) {
+  if (!bEnable || !IsArenaSupported())
+    return;
+  // Allocated before the arena is installed, so it comes from the heap.
+  pArena = new (std::nothrow) Arena;
+  if (pArena)
+    g_pThreadArena = pArena;
+}
+
+DxcThreadArena::~DxcThreadArena() {
+  if (!pArena)
+    return;
+  g_pThreadArena = pPrior;
+  for (ArenaChunk *pChunk = pArena->Chunks; pChunk;) {
+    ArenaChunk *pNext = pChunk->Next;
+    pChunk->Owner.store(nullptr, std::memory_order_relaxed);
+    ReleaseArenaChunk(pChunk);
+    pChunk = pNext;
+  }
+  delete pArena;
+}
+
+DxcArenaStats DxcThreadArena::GetStats() const {
+  return pArena ? pArena->Stats : DxcArenaStats();
+}
+
+static ArenaChunk *GetArenaChunk(void *ptr) {
+  return (ArenaChunk *)((uintptr_t)ptr & ~(uintptr_t)(kArenaChunkSize - 1));
+}
+
+// Starts a new run of blocks of the given class, taking a new chunk if the
+// current one has no room left.
+static bool AllocArenaRun(DxcThreadArena::Arena *pArena, unsigned Class) {
+  size_t ClassSize = GetArenaSizeClassSize(Class);
+  size_t RunSize = ClassSize > kArenaRunSize
+                       ? (ClassSize + kArenaPageSize - 1) & ~(kArenaPageSize - 1)
+                       : kArenaRunSize;
+  if ((size_t)(pArena->End - pArena->Cur) < RunSize) {
+    ArenaChunk *pChunk = AllocArenaChunk();
+    if (pChunk == nullptr)
+      return false;
+    pChunk->Owner.store(pArena, std::memory_order_relaxed);
+    pChunk->Next = pArena->Chunks;
+    pArena->Chunks = pChunk;
+    pArena->Cur = (char *)pChunk + kArenaPageSize;
+    pArena->End = (char *)pChunk + kArenaChunkSize;
+    pArena->Stats.ChunkBytes += kArenaChunkSize;
+  }
+  ArenaChunk *pChunk = pArena->Chunks;
+  size_t FirstPage = (pArena->Cur - (char *)pChunk) / kArenaPageSize;
+  memset(&pChunk->PageClass[FirstPage], Class, RunSize / kArenaPageSize);
+  pArena->RunCur[Class] = pArena->Cur;
+  pArena->RunEnd[Class] = pArena->Cur + RunSize;
+  pArena->Cur += RunSize;
+  return true;
+}
+
+void *DxcArenaAlloc(size_t size) throw() {
+  DxcThreadArena::Arena *pArena = g_pThreadArena;
+  if (pArena == nullptr)
+    return nullptr;
+  pArena->Stats.TotalBytes += size;
+  if (size > kArenaMaxAllocSize)
+    return nullptr;
+  unsigned Class = GetArenaSizeClass(size);
+  void *ptr = pArena->FreeList[Class];
+  if (ptr) {
+    pArena->FreeList[Class] = *(void **)ptr;
+  } else {
+    size_t ClassSize = GetArenaSizeClassSize(Class);
+    if ((size_t)(pArena->RunEnd[Class] - pArena->RunCur[Class]) < ClassSize &&
+        !AllocArenaRun(pArena, Class))
+      return nullptr;
+    ptr = pArena->RunCur[Class];
+    pArena->RunCur[Class] += ClassSize;
+  }
+  GetArenaChunk(ptr)->Refs.fetch_add(1, std::memory_order_relaxed);
+  return ptr;
+}
+
+bool DxcArenaFree(void *ptr) throw() {
+  std::atomic<uint64_t> *pMap = g_ArenaChunkMap.load(std::memory_order_acquire);
+  if (pMap == nullptr)
+    return false;
+  uintptr_t Index = (uintptr_t)ptr / kArenaChunkSize;
+  if (Index / 64 >= kArenaChunkMapWords ||
+      !(pMap[Index / 64].load(std::memory_order_relaxed) &
+        ((uint64_t)1 << (Index % 64))))
+    return false;
+  ArenaChunk *pChunk = GetArenaChunk(ptr);
+  // The arena's own reference keeps the chunk alive while the block waits on
+  // the free list.
+  DxcThreadArena::Arena *pArena = g_pThreadArena;
+  if (pArena != nullptr &&
+      pChunk->Owner.load(std::memory_order_relaxed) == pArena) {
+    unsigned Class =
+        pChunk->PageClass[((char *)ptr - (char *)pChunk) / kArenaPageSize];
+    *(void **)ptr = pArena->FreeList[Class];
+    pArena->FreeList[Class] = ptr;
+  }
+  ReleaseArenaChunk(pChunk);
+  return true;
+}
@@ -408,7 +408,6 @@ private:
   PSVInitInfo m_PSVInitInfo;
   DxilPipelineStateValidation m_PSV;
   uint32_t m_PSVBufferSize;
-  SmallVector<char, 512> m_PSVBuffer;
   SmallVector<char, 256> m_StringBuffer;
   SmallVector<uint32_t, 8> m_SemanticIndexBuffer;
   std::vector<PSVSignatureElement0> m_SigInputElements;
@@ -552,11 +551,14 @@ public:
   }
 
   void write(AbstractMemoryStream *pStream) override {
-    m_PSVBuffer.resize(m_PSVBufferSize);
-    if (!m_PSV.InitNew(m_PSVInitInfo, m_PSVBuffer.data(), &m_PSVBufferSize)) {
+    // Build the part directly in its slot in the output stream.
+    const uint32_t PSVBufferSize = m_PSVBufferSize;
+    void *pPSVBuffer = pStream->WriteInPlace(PSVBufferSize);
+    IFTBOOL(pPSVBuffer != nullptr, E_OUTOFMEMORY);
+    if (!m_PSV.InitNew(m_PSVInitInfo, pPSVBuffer, &m_PSVBufferSize)) {
       DXASSERT(false, "PSV InitNew failed!");
     }
-    DXASSERT_NOMSG(m_PSVBuffer.size() == m_PSVBufferSize);
+    DXASSERT_NOMSG(PSVBufferSize == m_PSVBufferSize);
 
     // Set DxilRuntimeInfo
     PSVRuntimeInfo0* pInfo = m_PSV.GetPSVRuntimeInfo0();
@@ -818,10 +820,6 @@ public:
         DXASSERT_NOMSG(viewState.data() + viewState.size() == pSrc);
       }
     }
-
-    ULONG cbWritten;
-    IFT(pStream->Write(m_PSVBuffer.data(), m_PSVBufferSize, &cbWritten));
-    DXASSERT_NOMSG(cbWritten == m_PSVBufferSize);
   }
 };
 
@@ -1072,8 +1070,6 @@ using namespace DXIL;
 
 class DxilRDATWriter : public DxilPartWriter {
 private:
-  SmallVector<char, 1024> m_RDATBuffer;
-
   std::vector<std::unique_ptr<RDATPart>> m_Parts;
   typedef llvm::SmallSetVector<uint32_t, 8> Indices;
   typedef std::unordered_map<const llvm::Function *, Indices> FunctionIndexMap;
@@ -1409,7 +1405,7 @@ private:
 
 public:
   DxilRDATWriter(const DxilModule &mod)
-      : m_RDATBuffer(), m_Parts(), m_FuncToResNameOffset() {
+      : m_Parts(), m_FuncToResNameOffset() {
     // Keep track of validator version so we can make a compatible RDAT
     mod.GetValidatorVersion(m_ValMajor, m_ValMinor);
 
@@ -1439,9 +1435,12 @@ public:
   }
 
   void write(AbstractMemoryStream *pStream) override {
+    // Build the part directly in its slot in the output stream.
+    const uint32_t RDATSize = size();
+    void *pRDATBuffer = pStream->WriteInPlace(RDATSize);
+    IFTBOOL(pRDATBuffer != nullptr, E_OUTOFMEMORY);
     try {
-      m_RDATBuffer.resize(size(), 0);
-      CheckedWriter W(m_RDATBuffer.data(), m_RDATBuffer.size());
+      CheckedWriter W(pRDATBuffer, RDATSize);
       // write RDAT header
       RuntimeDataHeader &header = W.Map<RuntimeDataHeader>();
       header.Version = RDAT_Version_10;
@@ -1463,10 +1462,6 @@ public:
     catch (CheckedWriter::exception e) {
       throw hlsl::Exception(DXC_E_GENERAL_INTERNAL_ERROR, e.what());
     }
-
-    ULONG cbWritten;
-    IFT(pStream->Write(m_RDATBuffer.data(), m_RDATBuffer.size(), &cbWritten));
-    DXASSERT_NOMSG(cbWritten == m_RDATBuffer.size());
   }
 };
 
@@ -1928,3 +1923,56 @@ void hlsl::SerializeDxilContainerForRootSignature(hlsl::RootSignatureHandle *pRo
   }
   writer.write(pFinalStream);
 }
+
+HRESULT hlsl::AppendPartToContainer(IMalloc *pMalloc, IDxcBlob *pContainer,
+                                    uint32_t uFourCC, uint32_t uPartSize,
+                                    const std::function<HRESULT(AbstractMemoryStream *)> &WritePart,
+                                    IDxcBlob **ppNewContainer, uint32_t *pPartOffset) {
+  const DxilContainerHeader *pHeader = IsDxilContainerLike(
+    pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+  if (!pHeader || !IsValidDxilContainer(pHeader, pContainer->GetBufferSize()))
+    return E_FAIL;
+
+  const UINT32 uPartCount = pHeader->PartCount + 1;
+  UINT32 uPartsSize = uPartSize;
+  for (auto it = hlsl::begin(pHeader), itEnd = hlsl::end(pHeader); it != itEnd; ++it) {
+    if ((*it)->PartFourCC == uFourCC)
+      return DXC_E_DUPLICATE_PART;
+    uPartsSize += (*it)->PartSize;
+  }
+  const UINT32 uContainerSize =
+    GetDxilContainerSizeFromParts(uPartCount, uPartsSize);
+
+  CComPtr<AbstractMemoryStream> pStream;
+  IFR(CreateMemoryStream(pMalloc, &pStream));
+  IFR(pStream->Reserve(uContainerSize));
+
+  DxilContainerHeader NewHeader;
+  InitDxilContainer(&NewHeader, uPartCount, uContainerSize);
+  IFR(WriteStreamValue(pStream, NewHeader));
+
+  UINT32 uOffset = sizeof(NewHeader) + GetOffsetTableSize(uPartCount);
+  for (auto it = hlsl::begin(pHeader), itEnd = hlsl::end(pHeader); it != itEnd; ++it) {
+    IFR(WriteStreamValue(pStream, uOffset));
+    uOffset += sizeof(DxilPartHeader) + (*it)->PartSize;
+  }
+  const UINT32 uNewPartOffset = uOffset;
+  IFR(WriteStreamValue(pStream, uNewPartOffset));
+
+  ULONG uSizeWritten = 0;
+  for (auto it = hlsl::begin(pHeader), itEnd = hlsl::end(pHeader); it != itEnd; ++it)
+    IFR(pStream->Write(*it, sizeof(DxilPartHeader) + (*it)->PartSize, &uSizeWritten));
+
+  DxilPartHeader NewPartHeader = {};
+  NewPartHeader.PartFourCC = uFourCC;
+  NewPartHeader.PartSize = uPartSize;
+  IFR(WriteStreamValue(pStream, NewPartHeader));
+  IFR(WritePart(pStream));
+  if (pStream->GetPosition() != uContainerSize)
+    return E_FAIL;
+
+  IFR(pStream.QueryInterface(ppNewContainer));
+  *pPartOffset = uNewPartOffset;
+  return S_OK;
+}
+
@@ -11,9 +11,12 @@
 
 #include "DxilDiaSession.h"
 
+#include <algorithm>
+
 #include "dxc/DxilPIXPasses/DxilPIXPasses.h"
 #include "dxc/DxilPIXPasses/DxilPIXVirtualRegisters.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
@@ -71,6 +74,12 @@ void dxil_dia::Session::Init(
     m_module->getNamedMetadata(hlsl::DxilMDHelper::kDxilSourceArgsMDName);
   if (!m_arguments)
     m_arguments = m_module->getNamedMetadata("llvm.dbg.args");
+}
+
+void dxil_dia::Session::BuildInstructionTables() {
+  if (m_instructionTablesBuilt)
+    return;
+  m_instructionTablesBuilt = true;
 
   // Build up a linear list of instructions. The index will be used as the
   // RVA.
@@ -82,7 +91,7 @@ void dxil_dia::Session::Init(
         continue;
       }
       m_rvaMap.insert({ &i, rva });
-      m_instructions.insert({ rva, &i});
+      m_instructions.emplace_back(rva, &i);
       if (llvm::DebugLoc DL = i.getDebugLoc()) {
         auto result = m_lineToInfoMap.emplace(DL.getLine(), LineInfo(DL.getCol(), rva, rva + 1));
         if (!result.second) {
@@ -94,34 +103,104 @@ void dxil_dia::Session::Init(
     }
   }
 
+  // Instruction numbers are assigned in module order, so the table is
+  // usually sorted already. Keep the first instruction seen for an RVA.
+  std::stable_sort(m_instructions.begin(), m_instructions.end(),
+                   [](const RVATable::value_type &a, const RVATable::value_type &b) {
+                     return a.first < b.first;
+                   });
+  m_instructions.erase(
+      std::unique(m_instructions.begin(), m_instructions.end(),
+                  [](const RVATable::value_type &a, const RVATable::value_type &b) {
+                    return a.first == b.first;
+                  }),
+      m_instructions.end());
+
   // Sanity check to make sure rva map is same as instruction index.
   for (auto It = m_instructions.begin(); It != m_instructions.end(); ++It) {
     DXASSERT(m_rvaMap.find(It->second) != m_rvaMap.end(), "instruction not mapped to rva");
     DXASSERT(m_rvaMap[It->second] == It->first, "instruction mapped to wrong rva");
   }
+}
 
-  // Initialize symbols
-  try {
-      m_symsMgr.Init(this);
-  } catch (const hlsl::Exception &) {
-      m_symsMgr = std::move(dxil_dia::SymbolManager());
+void dxil_dia::Session::BuildFileLineIndex() {
+  if (m_fileLineIndexBuilt)
+    return;
+  m_fileLineIndexBuilt = true;
+
+  for (const llvm::Instruction *inst : InstructionLinesRef()) {
+    const llvm::DebugLoc &DL = inst->getDebugLoc();
+    DWORD fileId;
+    if (getSourceFileIdByScope(DL.getScope(), &fileId) != S_OK)
+      continue;
+    m_fileLineIndex.push_back({ fileId, DL.getLine(), inst });
   }
+
+  std::stable_sort(m_fileLineIndex.begin(), m_fileLineIndex.end(),
+                   [](const FileLineEntry &a, const FileLineEntry &b) {
+                     return std::make_pair(a.FileId, a.Line) <
+                            std::make_pair(b.FileId, b.Line);
+                   });
+}
+
+const llvm::Instruction *dxil_dia::Session::FindInstruction(RVA rva) {
+  const RVATable &instructions = InstructionsRef();
+  auto It = std::lower_bound(
+      instructions.begin(), instructions.end(), rva,
+      [](const RVATable::value_type &entry, RVA rva) { return entry.first < rva; });
+  if (It == instructions.end() || It->first != rva)
+    return nullptr;
+  return It->second;
+}
+
+const dxil_dia::SymbolManager &dxil_dia::Session::SymMgr() {
+  if (!m_symsMgrInitialized) {
+    m_symsMgrInitialized = true;
+    // Initialize symbols
+    try {
+        m_symsMgr.Init(this);
+    } catch (const hlsl::Exception &) {
+        m_symsMgr = std::move(dxil_dia::SymbolManager());
+    }
+  }
+  return m_symsMgr;
 }
 
 HRESULT dxil_dia::Session::getSourceFileIdByName(
     llvm::StringRef fileName,
     DWORD *pRetVal) {
-  if (Contents() != nullptr) {
-    for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
-      llvm::StringRef fn =
-        llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(i)->getOperand(0))
-        ->getString();
-      if (fn.equals(fileName)) {
-        *pRetVal = i;
-        return S_OK;
+  if (!m_sourceFileIdsBuilt) {
+    m_sourceFileIdsBuilt = true;
+    if (Contents() != nullptr) {
+      for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
+        llvm::StringRef fn =
+          llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(i)->getOperand(0))
+          ->getString();
+        // The first file with a given name owns the id.
+        m_sourceFileIds.insert(std::make_pair(fn, i));
       }
     }
   }
+  auto It = m_sourceFileIds.find(fileName);
+  if (It != m_sourceFileIds.end()) {
+    *pRetVal = It->second;
+    return S_OK;
+  }
+  *pRetVal = 0;
+  return S_FALSE;
+}
+
+HRESULT dxil_dia::Session::getSourceFileIdByScope(
+    llvm::MDNode *pScope,
+    DWORD *pRetVal) {
+  auto *pBlock = llvm::dyn_cast_or_null<llvm::DILexicalBlock>(pScope);
+  if (pBlock != nullptr) {
+    return getSourceFileIdByName(pBlock->getFile()->getFilename(), pRetVal);
+  }
+  auto *pSubProgram = llvm::dyn_cast_or_null<llvm::DISubprogram>(pScope);
+  if (pSubProgram != nullptr) {
+    return getSourceFileIdByName(pSubProgram->getFile()->getFilename(), pRetVal);
+  }
   *pRetVal = 0;
   return S_FALSE;
 }
@@ -142,7 +221,7 @@ STDMETHODIMP dxil_dia::Session::get_globalScope(
   *pRetVal = nullptr;
 
   Symbol *ret;
-  IFR(m_symsMgr.GetGlobalScope(&ret));
+  IFR(SymMgr().GetGlobalScope(&ret));
   *pRetVal = ret;
   return S_OK;
 }
@@ -238,10 +317,15 @@ static HRESULT DxcDiaFindLineNumbersByRVA(
   std::vector<const llvm::Instruction*> instructions;
   auto &allInstructions = pSession->InstructionsRef();
 
-  // Gather the list of insructions that map to the given rva range.
-  for (DWORD i = rva; i < rva + length; ++i) {
-    auto It = allInstructions.find(i);
-    if (It == allInstructions.end())
+  // Gather the list of insructions that map to the given rva range. The range
+  // must be a contiguous interval of the RVA table.
+  auto It = std::lower_bound(
+      allInstructions.begin(), allInstructions.end(), rva,
+      [](const Session::RVATable::value_type &entry, DWORD rva) {
+        return entry.first < rva;
+      });
+  for (DWORD i = rva; i < rva + length; ++i, ++It) {
+    if (It == allInstructions.end() || It->first != i)
       return E_INVALIDARG;
 
     // Only include the instruction if it has debug info for line mappings.
@@ -299,17 +383,6 @@ STDMETHODIMP dxil_dia::Session::findLinesByLinenum(
     *ppResult = nullptr;
 
     DxcThreadMalloc TM(m_pMalloc);
-    CComPtr<IDiaTable> pTable;
-    VARIANT vtIndex;
-    vtIndex.vt = VT_UI4;
-    vtIndex.uintVal = (int)Table::Kind::LineNumbers;
-    IFR(m_pEnumTables->Item(vtIndex, &pTable));
-
-    CComPtr<IDiaEnumLineNumbers> pLineTable;
-    IFR(pTable->QueryInterface(&pLineTable));
-    HRESULT hr;
-    CComPtr<IDiaLineNumber> line;
-    ULONG cnt;
     std::vector<const llvm::Instruction *> lines;
 
     std::function<bool(DWORD, DWORD)>column_matches = [column](DWORD colStart, DWORD colEnd) -> bool {
@@ -322,20 +395,25 @@ STDMETHODIMP dxil_dia::Session::findLinesByLinenum(
         };
     }
 
-    pLineTable->Reset();
-    while (SUCCEEDED(hr = pLineTable->Next(1, &line, &cnt)) && hr == S_OK && cnt == 1) {
-        CComPtr<IDiaSourceFile> f;
-        DWORD ln, lnEnd, cn, cnEnd;
-        IFR(line->get_lineNumber(&ln));
-        IFR(line->get_lineNumberEnd(&lnEnd));
-        IFR(line->get_columnNumber(&cn));
-        IFR(line->get_columnNumberEnd(&cnEnd));
-        IFR(line->get_sourceFile(&f));
-        
-        if (file == f && (ln <= linenum && linenum <= lnEnd) && column_matches(cn, cnEnd)) {
-            lines.emplace_back(reinterpret_cast<LineNumber*>(line.p)->Inst());
+    // Only source files handed out by this session can match.
+    DWORD fileId;
+    CComPtr<IDiaSourceFile> pSessionFile;
+    if (file != nullptr && SUCCEEDED(file->get_uniqueId(&fileId)) &&
+        Contents() != nullptr && fileId < Contents()->getNumOperands() &&
+        SUCCEEDED(findFileById(fileId, &pSessionFile)) && pSessionFile == file) {
+        const FileLineIndex &index = FileLineIndexRef();
+        const FileLineEntry key = { fileId, linenum, nullptr };
+        auto range = std::equal_range(
+            index.begin(), index.end(), key,
+            [](const FileLineEntry &a, const FileLineEntry &b) {
+                return std::make_pair(a.FileId, a.Line) < std::make_pair(b.FileId, b.Line);
+            });
+        for (auto It = range.first; It != range.second; ++It) {
+            const llvm::DebugLoc &DL = It->Inst->getDebugLoc();
+            if (column_matches(DL.getCol(), DL.getCol())) {
+                lines.emplace_back(It->Inst);
+            }
         }
-        line.Release();
     }
 
     HRESULT result = lines.empty() ? S_FALSE : S_OK;
@@ -380,15 +458,14 @@ STDMETHODIMP dxil_dia::Session::findInlineFramesByAddr(
   *ppResult = nullptr;
 
   DxcThreadMalloc TM(m_pMalloc);
-  auto &allInstructions = InstructionsRef();
-  auto It = allInstructions.find(offset);
-  if (It == allInstructions.end()) {
+  const llvm::Instruction *inst = FindInstruction(offset);
+  if (inst == nullptr) {
     return E_INVALIDARG;
   }
 
   HRESULT hr;
   SymbolChildrenEnumerator *ChildrenEnum;
-  IFR(hr = m_symsMgr.DbgScopeOf(It->second, &ChildrenEnum));
+  IFR(hr = SymMgr().DbgScopeOf(inst, &ChildrenEnum));
 
   *ppResult = ChildrenEnum;
   return hr;
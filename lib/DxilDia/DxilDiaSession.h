@@ -13,15 +13,16 @@
 
 #include "dxc/Support/WinIncludes.h"
 
-#include <map>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "dia2.h"
 
 #include "dxc/dxcpix.h"
 #include "dxc/DXIL/DxilModule.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "dxc/Support/Global.h"
 #include "dxc/Support/microcom.h"
@@ -33,7 +34,9 @@ namespace dxil_dia {
 class Session : public IDiaSession, public IDxcPixDxilDebugInfoFactory {
 public:
   using RVA = unsigned;
-  using RVAMap = std::map<RVA, const llvm::Instruction *>;
+  // Instructions that carry an RVA, sorted by RVA. A run of consecutive RVAs
+  // is a contiguous interval of the table.
+  using RVATable = std::vector<std::pair<RVA, const llvm::Instruction *>>;
 
   struct LineInfo {
     LineInfo(std::uint32_t start_col, RVA first, RVA last)
@@ -47,6 +50,15 @@ public:
   };
   using LineToInfoMap = std::unordered_map<std::uint32_t, LineInfo>;
 
+  struct FileLineEntry {
+    DWORD FileId;
+    std::uint32_t Line;
+    const llvm::Instruction *Inst;
+  };
+  // Instructions with line info, sorted by (file, line) and then by module
+  // order.
+  using FileLineIndex = std::vector<FileLineEntry>;
+
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(Session)
 
@@ -63,13 +75,18 @@ public:
   hlsl::DxilModule &DxilModuleRef() { return *m_dxilModule.get(); }
   llvm::Module &ModuleRef() { return *m_module.get(); }
   llvm::DebugInfoFinder &InfoRef() { return *m_finder.get(); }
-  const SymbolManager &SymMgr() const { return m_symsMgr; }
-  const RVAMap &InstructionsRef() const { return m_instructions; }
-  const std::vector<const llvm::Instruction *> &InstructionLinesRef() const { return m_instructionLines; }
-  const std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() const { return m_rvaMap; }
-  const LineToInfoMap &LineToColumnStartMapRef() const { return m_lineToInfoMap; }
+  const SymbolManager &SymMgr();
+  const RVATable &InstructionsRef() { BuildInstructionTables(); return m_instructions; }
+  const std::vector<const llvm::Instruction *> &InstructionLinesRef() { BuildInstructionTables(); return m_instructionLines; }
+  const std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() { BuildInstructionTables(); return m_rvaMap; }
+  const LineToInfoMap &LineToColumnStartMapRef() { BuildInstructionTables(); return m_lineToInfoMap; }
+  const FileLineIndex &FileLineIndexRef() { BuildFileLineIndex(); return m_fileLineIndex; }
+
+  // Returns the instruction at the given RVA, or nullptr if there is none.
+  const llvm::Instruction *FindInstruction(RVA rva);
 
   HRESULT getSourceFileIdByName(llvm::StringRef fileName, DWORD *pRetVal);
+  HRESULT getSourceFileIdByScope(llvm::MDNode *pScope, DWORD *pRetVal);
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
     return DoBasicQueryInterface<IDiaSession, IDxcPixDxilDebugInfoFactory>(this, iid, ppvObject);
@@ -383,6 +400,11 @@ public:
       _COM_Outptr_ IDxcPixCompilationInfo **ppCompilationInfo) override;
 
 private:
+  // The tables below are built on first use rather than in Init, so opening
+  // a session over a large module only pays for the lookups it makes.
+  void BuildInstructionTables();
+  void BuildFileLineIndex();
+
   DXC_MICROCOM_TM_REF_FIELDS()
   std::shared_ptr<llvm::LLVMContext> m_context;
   std::shared_ptr<llvm::Module> m_module;
@@ -392,10 +414,16 @@ private:
   llvm::NamedMDNode *m_defines;
   llvm::NamedMDNode *m_mainFileName;
   llvm::NamedMDNode *m_arguments;
-  RVAMap m_instructions;
+  bool m_instructionTablesBuilt = false;
+  RVATable m_instructions;
   std::vector<const llvm::Instruction *> m_instructionLines; // Instructions with line info.
   std::unordered_map<const llvm::Instruction *, RVA> m_rvaMap; // Map instruction to its RVA.
   LineToInfoMap m_lineToInfoMap;
+  bool m_fileLineIndexBuilt = false;
+  FileLineIndex m_fileLineIndex;
+  bool m_sourceFileIdsBuilt = false;
+  llvm::StringMap<DWORD> m_sourceFileIds; // Map file name to its source file id.
+  bool m_symsMgrInitialized = false;
   SymbolManager m_symsMgr;
 
 private:
@@ -15,6 +15,9 @@
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
@@ -26,6 +29,7 @@
 #include "llvm/Analysis/CallGraph.h"
 
 #include <algorithm>
+#include <map>
 
 using namespace llvm;
 using namespace llvm::legacy;
@@ -49,8 +53,9 @@ public:
   using OutputsDependentOnViewIdType = DxilViewIdStateData::OutputsDependentOnViewIdType;
   using InputsContributingToOutputType = DxilViewIdStateData::InputsContributingToOutputType;
 
-  DxilViewIdStateBuilder(DxilViewIdStateData &state, DxilModule *pDxilModule)
-      : m_pModule(pDxilModule),
+  DxilViewIdStateBuilder(DxilViewIdStateData &state, DxilModule *pDxilModule,
+                         bool bPerOutputWalk = false)
+      : m_pModule(pDxilModule), m_bPerOutputWalk(bPerOutputWalk),
         m_NumInputSigScalars(state.m_NumInputSigScalars),
         m_NumOutputSigScalars(state.m_NumOutputSigScalars,
                               DxilViewIdStateData::kNumStreams),
@@ -70,6 +75,9 @@ private:
   static const unsigned kNumStreams = 4;
 
   DxilModule *m_pModule;
+  // Walk the backward slice of each output separately, as the builder did
+  // before the dataflow. Slow; only kept to check the dataflow against.
+  bool m_bPerOutputWalk;
 
   unsigned &m_NumInputSigScalars;
   MutableArrayRef<unsigned> m_NumOutputSigScalars;
@@ -103,9 +111,13 @@ private:
     FunctionSetType Functions;
     // Outputs to analyze.
     InstructionSetType Outputs;
-    // Contributing instructions per output.
-    std::unordered_map<unsigned, InstructionSetType>
-        ContributingInstructions[kNumStreams];
+    // Instructions that make outputs depend on ViewID or inputs, in the order
+    // they were found.
+    std::vector<llvm::Instruction *> Sources;
+    // Index of each instruction in Sources, for the per-output walk.
+    llvm::DenseMap<llvm::Instruction *, unsigned> SourceIndex;
+    // Contributing sources per output, as bits indexed like Sources.
+    std::map<unsigned, llvm::BitVector> ContributingSources[kNumStreams];
 
     void Clear();
   };
@@ -125,10 +137,33 @@ private:
   std::unordered_map<llvm::Function *, std::unique_ptr<FuncInfo>> m_FuncInfo;
 
   // Cache of decls (global/alloca) reaching a pointer value.
-  using ValueSetType = std::unordered_set<llvm::Value *>;
-  std::unordered_map<llvm::Value *, ValueSetType> m_ReachingDeclsCache;
+  using ValueSetType = llvm::SmallPtrSet<llvm::Value *, 4>;
+  llvm::DenseMap<llvm::Value *, ValueSetType> m_ReachingDeclsCache;
   // Cache of stores for each decl.
-  std::unordered_map<llvm::Value *, ValueSetType> m_StoresPerDeclCache;
+  llvm::DenseMap<llvm::Value *, ValueSetType> m_StoresPerDeclCache;
+
+  // Dataflow over the instructions contributing to the outputs of an entry.
+  // Every instruction is numbered once, and each strongly connected component
+  // of the contribution graph gets the set of sources reachable from it.
+  static const unsigned kNoSCC = ~0u;
+  struct ContributionNode {
+    unsigned LowLink;
+    unsigned SCC = kNoSCC;
+    // Sources reachable from this node, until its component is complete.
+    llvm::BitVector Sources;
+  };
+  llvm::DenseMap<llvm::Instruction *, unsigned> m_ContributionNodeIndex;
+  std::vector<ContributionNode> m_ContributionNodes;
+  std::vector<unsigned> m_ContributionNodeStack;
+  std::vector<llvm::BitVector> m_SCCSources;
+  // A node being visited and the contributing values still to follow. The
+  // visit keeps these on an explicit stack, since contribution chains can be
+  // far deeper than the native stack allows.
+  struct ContributionFrame {
+    unsigned NodeIdx;
+    llvm::SmallVector<llvm::Value *, 8> Values;
+    unsigned NextValue = 0;
+  };
 
 
   void Clear();
@@ -139,12 +174,24 @@ private:
                                     FunctionSetType &FuncSet);
   void AnalyzeFunctions(EntryInfo &Entry);
   void CollectValuesContributingToOutputs(EntryInfo &Entry);
-  void CollectValuesContributingToOutputRec(
-      EntryInfo &Entry, llvm::Value *pContributingValue,
-      InstructionSetType &ContributingInstructions);
-  void CollectPhiCFValuesContributingToOutputRec(
-      llvm::PHINode *pPhi, EntryInfo &Entry,
-      InstructionSetType &ContributingInstructions);
+  void CollectSourcesByWalk(EntryInfo &Entry,
+                            llvm::SmallVectorImpl<llvm::Value *> &Worklist,
+                            llvm::BitVector &Sources);
+  void CollectSourcesContributingToValue(EntryInfo &Entry,
+                                         llvm::Value *pContributingValue,
+                                         llvm::BitVector &Sources);
+  llvm::Instruction *GetContributingInstruction(EntryInfo &Entry,
+                                                llvm::Value *pValue);
+  unsigned VisitContributingInstruction(EntryInfo &Entry,
+                                        llvm::Instruction *pInst);
+  unsigned PushContributionFrame(EntryInfo &Entry, llvm::Instruction *pInst,
+                                 std::vector<ContributionFrame> &Frames);
+  void MergeContributionNode(unsigned NodeIdx, unsigned SuccIdx);
+  void CollectValuesContributingToInstruction(
+      EntryInfo &Entry, llvm::Instruction *pInst,
+      llvm::SmallVectorImpl<llvm::Value *> &Values);
+  void CollectPhiCFValuesContributingToOutput(
+      llvm::PHINode *pPhi, llvm::SmallVectorImpl<llvm::Value *> &Values);
   const ValueSetType &CollectReachingDecls(llvm::Value *pValue);
   void CollectReachingDeclsRec(llvm::Value *pValue, ValueSetType &ReachingDecls,
                                ValueSetType &Visited);
@@ -153,8 +200,7 @@ private:
                         ValueSetType &Visited);
   void UpdateDynamicIndexUsageState() const;
   void
-  CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType>
-                       &ContributingInstructions,
+  CreateViewIdSets(const EntryInfo &Entry, unsigned StreamId,
                    OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                    InputsContributingToOutputType &InputsContributingToOutputs,
                    bool bPC);
@@ -203,17 +249,17 @@ void DxilViewIdStateBuilder::Compute() {
 
   // 5. Construct dependency sets.
   for (unsigned StreamId = 0; StreamId < (pSM->IsGS() ? kNumStreams : 1u); StreamId++) {
-    CreateViewIdSets(m_Entry.ContributingInstructions[StreamId],
+    CreateViewIdSets(m_Entry, StreamId,
                      m_OutputsDependentOnViewId[StreamId],
                      m_InputsContributingToOutputs[StreamId], false);
   }
   if (pSM->IsHS() || pSM->IsMS()) {
-    CreateViewIdSets(m_PCEntry.ContributingInstructions[0],
+    CreateViewIdSets(m_PCEntry, 0,
                      m_PCOrPrimOutputsDependentOnViewId,
                      m_InputsContributingToPCOrPrimOutputs, true);
   } else if (pSM->IsDS()) {
     OutputsDependentOnViewIdType OutputsDependentOnViewId;
-    CreateViewIdSets(m_Entry.ContributingInstructions[0],
+    CreateViewIdSets(m_Entry, 0,
                      OutputsDependentOnViewId,
                      m_PCInputsContributingToOutputs, true);
     DXASSERT_NOMSG(OutputsDependentOnViewId == m_OutputsDependentOnViewId[0]);
@@ -246,14 +292,17 @@ void DxilViewIdStateBuilder::Clear() {
   m_PCEntry.Clear();
   m_FuncInfo.clear();
   m_ReachingDeclsCache.clear();
+  m_StoresPerDeclCache.clear();
 }
 
 void DxilViewIdStateBuilder::EntryInfo::Clear() {
   pEntryFunc = nullptr;
   Functions.clear();
   Outputs.clear();
+  Sources.clear();
+  SourceIndex.clear();
   for (unsigned i = 0; i < kNumStreams; i++)
-    ContributingInstructions[i].clear();
+    ContributingSources[i].clear();
 }
 
 void DxilViewIdStateBuilder::FuncInfo::Clear() {
@@ -414,6 +463,12 @@ void DxilViewIdStateBuilder::AnalyzeFunctions(EntryInfo &Entry) {
 }
 
 void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry) {
+  // Calls to user functions are followed only within this entry.
+  m_ContributionNodeIndex.clear();
+  m_ContributionNodes.clear();
+  m_ContributionNodeStack.clear();
+  m_SCCSources.clear();
+
   for (auto *CI : Entry.Outputs) {  // CI = call instruction
     DxilSignature *pDxilSig = nullptr;
     Value *pContributingValue = nullptr;
@@ -463,15 +518,8 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry
       endRow = SigElem.GetRows() - 1;
     }
 
-    InstructionSetType ContributingInstructionsAllRows;
-    InstructionSetType *pContributingInstructions = &ContributingInstructionsAllRows;
-    if (startRow == endRow) {
-      // Scalar or indexable with known index.
-      unsigned index = GetLinearIndex(SigElem, startRow, col);
-      pContributingInstructions = &Entry.ContributingInstructions[StreamId][index];
-    }
-
-    CollectValuesContributingToOutputRec(Entry, pContributingValue, *pContributingInstructions);
+    SmallVector<Value *, 8> Roots;
+    Roots.push_back(pContributingValue);
 
     // Handle control dependence of this instruction BB.
     BasicBlock *pBB = CI->getParent();
@@ -479,51 +527,194 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry
     FuncInfo *pFuncInfo = m_FuncInfo[F].get();
     const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), *pContributingInstructions);
+      Roots.push_back(B->getTerminator());
     }
 
-    if (pContributingInstructions == &ContributingInstructionsAllRows) {
-      // Write dynamically indexed output contributions to all rows.
-      for (int row = startRow; row <= endRow; row++) {
-        unsigned index = GetLinearIndex(SigElem, row, col);
-        Entry.ContributingInstructions[StreamId][index].insert(ContributingInstructionsAllRows.begin(), ContributingInstructionsAllRows.end());
-      }
+    BitVector ContributingSources;
+    if (m_bPerOutputWalk) {
+      CollectSourcesByWalk(Entry, Roots, ContributingSources);
+    } else {
+      for (Value *V : Roots)
+        CollectSourcesContributingToValue(Entry, V, ContributingSources);
+    }
+
+    // Scalar or indexable with known index has a single row; write dynamically
+    // indexed output contributions to all rows.
+    for (int row = startRow; row <= endRow; row++) {
+      unsigned index = GetLinearIndex(SigElem, row, col);
+      Entry.ContributingSources[StreamId][index] |= ContributingSources;
+    }
+  }
+}
+
+// Visits every instruction reachable from the worklist once and collects the
+// sources among them.
+void DxilViewIdStateBuilder::CollectSourcesByWalk(EntryInfo &Entry,
+                                                  SmallVectorImpl<Value *> &Worklist,
+                                                  BitVector &Sources) {
+  InstructionSetType Visited;
+  while (!Worklist.empty()) {
+    Instruction *pInst = GetContributingInstruction(Entry, Worklist.pop_back_val());
+    if (pInst == nullptr || !Visited.insert(pInst).second)
+      continue;
+
+    if (DxilInst_ViewID(pInst) || DxilInst_LoadInput(pInst) ||
+        DxilInst_LoadOutputControlPoint(pInst) ||
+        DxilInst_LoadPatchConstant(pInst)) {
+      auto itSource = Entry.SourceIndex.insert(
+          std::make_pair(pInst, (unsigned)Entry.Sources.size()));
+      if (itSource.second)
+        Entry.Sources.push_back(pInst);
+      unsigned Bit = itSource.first->second;
+      if (Sources.size() <= Bit)
+        Sources.resize(Bit + 1);
+      Sources.set(Bit);
     }
+
+    CollectValuesContributingToInstruction(Entry, pInst, Worklist);
   }
 }
 
-void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Entry,
-                                                           Value *pContributingValue,
-                                                           InstructionSetType &ContributingInstructions) {
-  if (dyn_cast<Argument>(pContributingValue)) {
+void DxilViewIdStateBuilder::CollectSourcesContributingToValue(EntryInfo &Entry,
+                                                               Value *pContributingValue,
+                                                               BitVector &Sources) {
+  Instruction *pContributingInst = GetContributingInstruction(Entry, pContributingValue);
+  if (pContributingInst == nullptr)
+    return;
+
+  unsigned NodeIdx;
+  auto itNode = m_ContributionNodeIndex.find(pContributingInst);
+  if (itNode != m_ContributionNodeIndex.end()) {
+    NodeIdx = itNode->second;
+  } else {
+    NodeIdx = VisitContributingInstruction(Entry, pContributingInst);
+  }
+  // Outside of a visit, every node belongs to a complete component.
+  DXASSERT_NOMSG(m_ContributionNodes[NodeIdx].SCC != kNoSCC);
+  Sources |= m_SCCSources[m_ContributionNodes[NodeIdx].SCC];
+}
+
+// Returns the instruction for a value that may contribute to an output, or
+// null for values that do not: arguments, constants and branch targets.
+Instruction *DxilViewIdStateBuilder::GetContributingInstruction(EntryInfo &Entry,
+                                                                Value *pValue) {
+  if (dyn_cast<Argument>(pValue)) {
     // This must be a leftover signature argument of an entry function.
     DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
                    Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
-    return;
+    return nullptr;
   }
 
-  Instruction *pContributingInst = dyn_cast<Instruction>(pContributingValue);
-  if (pContributingInst == nullptr) {
+  Instruction *pInst = dyn_cast<Instruction>(pValue);
+  if (pInst == nullptr) {
     // Can be literal constant, global decl, branch target.
-    DXASSERT_NOMSG(isa<Constant>(pContributingValue) || isa<BasicBlock>(pContributingValue));
-    return;
+    DXASSERT_NOMSG(isa<Constant>(pValue) || isa<BasicBlock>(pValue));
+    return nullptr;
   }
 
-  BasicBlock *pBB = pContributingInst->getParent();
-  Function *F = pBB->getParent();
-  auto FuncInfoIt = m_FuncInfo.find(F);
-  DXASSERT_NOMSG(FuncInfoIt != m_FuncInfo.end());
-  if (FuncInfoIt == m_FuncInfo.end()) {
-    return;
+  Function *F = pInst->getParent()->getParent();
+  DXASSERT_NOMSG(m_FuncInfo.find(F) != m_FuncInfo.end());
+  if (m_FuncInfo.find(F) == m_FuncInfo.end()) {
+    return nullptr;
   }
+  return pInst;
+}
 
-  auto itInst = ContributingInstructions.emplace(pContributingInst);
-  // Already visited instruction.
-  if (!itInst.second) return;
+// Numbers the instruction and everything contributing to it, and returns its
+// node index. Uses Tarjan's algorithm, so that each strongly connected
+// component is complete, with its reachable sources, when its root is done.
+unsigned DxilViewIdStateBuilder::VisitContributingInstruction(EntryInfo &Entry,
+                                                              Instruction *pInst) {
+  std::vector<ContributionFrame> Frames;
+  unsigned RootIdx = PushContributionFrame(Entry, pInst, Frames);
+  while (!Frames.empty()) {
+    ContributionFrame &Frame = Frames.back();
+    if (Frame.NextValue < Frame.Values.size()) {
+      Instruction *pSuccInst =
+          GetContributingInstruction(Entry, Frame.Values[Frame.NextValue++]);
+      if (pSuccInst == nullptr)
+        continue;
+      auto itSucc = m_ContributionNodeIndex.find(pSuccInst);
+      if (itSucc != m_ContributionNodeIndex.end())
+        MergeContributionNode(Frame.NodeIdx, itSucc->second);
+      else
+        PushContributionFrame(Entry, pSuccInst, Frames);
+      continue;
+    }
+
+    unsigned NodeIdx = Frame.NodeIdx;
+    Frames.pop_back();
+    ContributionNode &Node = m_ContributionNodes[NodeIdx];
+    if (Node.LowLink == NodeIdx) {
+      // Root of a component: pop its members and merge their sources.
+      unsigned SCC = m_SCCSources.size();
+      m_SCCSources.emplace_back();
+      BitVector &SCCSources = m_SCCSources.back();
+      unsigned MemberIdx;
+      do {
+        MemberIdx = m_ContributionNodeStack.back();
+        m_ContributionNodeStack.pop_back();
+        ContributionNode &Member = m_ContributionNodes[MemberIdx];
+        Member.SCC = SCC;
+        SCCSources |= Member.Sources;
+        Member.Sources.clear();
+      } while (MemberIdx != NodeIdx);
+    }
+    if (!Frames.empty())
+      MergeContributionNode(Frames.back().NodeIdx, NodeIdx);
+  }
+  return RootIdx;
+}
+
+// Numbers an instruction seen for the first time and starts visiting the
+// values that contribute to it.
+unsigned DxilViewIdStateBuilder::PushContributionFrame(
+    EntryInfo &Entry, Instruction *pInst,
+    std::vector<ContributionFrame> &Frames) {
+  unsigned NodeIdx = m_ContributionNodes.size();
+  m_ContributionNodeIndex[pInst] = NodeIdx;
+  m_ContributionNodes.emplace_back();
+  ContributionNode &Node = m_ContributionNodes.back();
+  Node.LowLink = NodeIdx;
+  m_ContributionNodeStack.push_back(NodeIdx);
+
+  if (DxilInst_ViewID(pInst) || DxilInst_LoadInput(pInst) ||
+      DxilInst_LoadOutputControlPoint(pInst) ||
+      DxilInst_LoadPatchConstant(pInst)) {
+    Node.Sources.resize(Entry.Sources.size() + 1);
+    Node.Sources.set(Entry.Sources.size());
+    Entry.Sources.push_back(pInst);
+  }
+
+  Frames.emplace_back();
+  Frames.back().NodeIdx = NodeIdx;
+  CollectValuesContributingToInstruction(Entry, pInst, Frames.back().Values);
+  return NodeIdx;
+}
+
+// Accounts for a contribution of node SuccIdx to node NodeIdx, once SuccIdx
+// has been visited.
+void DxilViewIdStateBuilder::MergeContributionNode(unsigned NodeIdx,
+                                                   unsigned SuccIdx) {
+  const ContributionNode &Succ = m_ContributionNodes[SuccIdx];
+  ContributionNode &Node = m_ContributionNodes[NodeIdx];
+  if (Succ.SCC != kNoSCC) {
+    Node.Sources |= m_SCCSources[Succ.SCC];
+  } else {
+    // Still on the stack, so part of the same component.
+    Node.LowLink = std::min(Node.LowLink, Succ.LowLink);
+  }
+}
+
+void DxilViewIdStateBuilder::CollectValuesContributingToInstruction(EntryInfo &Entry,
+                                                                    Instruction *pContributingInst,
+                                                                    SmallVectorImpl<Value *> &Values) {
+  BasicBlock *pBB = pContributingInst->getParent();
+  Function *F = pBB->getParent();
 
   // Handle special cases.
   if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
-    CollectPhiCFValuesContributingToOutputRec(phi, Entry, ContributingInstructions);
+    CollectPhiCFValuesContributingToOutput(phi, Values);
   } else if (isa<LoadInst>(pContributingInst) || 
              isa<AtomicCmpXchgInst>(pContributingInst) ||
              isa<AtomicRMWInst>(pContributingInst)) {
@@ -533,9 +724,7 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
     DXASSERT_NOMSG(ReachingDecls.size() > 0);
     for (Value *pDeclValue : ReachingDecls) {
       const ValueSetType &Stores = CollectStores(pDeclValue);
-      for (Value *V : Stores) {
-        CollectValuesContributingToOutputRec(Entry, V, ContributingInstructions);
-      }
+      Values.append(Stores.begin(), Stores.end());
     }
   } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
     if (!hlsl::OP::IsDxilOpFuncCallInst(CI)) {
@@ -544,26 +733,20 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
         // Return value of a user function.
         if (Entry.Functions.find(F) != Entry.Functions.end()) {
           const FuncInfo &FI = *m_FuncInfo[F];
-          for (ReturnInst *pRetInst : FI.Returns) {
-            CollectValuesContributingToOutputRec(Entry, pRetInst, ContributingInstructions);
-          }
+          Values.append(FI.Returns.begin(), FI.Returns.end());
         }
       }
     }
   }
 
   // Handle instruction inputs.
-  unsigned NumOps = pContributingInst->getNumOperands();
-  for (unsigned i = 0; i < NumOps; i++) {
-    Value *O = pContributingInst->getOperand(i);
-    CollectValuesContributingToOutputRec(Entry, O, ContributingInstructions);
-  }
+  Values.append(pContributingInst->op_begin(), pContributingInst->op_end());
 
   // Handle control dependence of this instruction BB.
-  FuncInfo *pFuncInfo = FuncInfoIt->second.get();
+  FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
   for (BasicBlock *B : CtrlDepSet) {
-    CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+    Values.push_back(B->getTerminator());
   }
 }
 
@@ -572,9 +755,8 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
 // However, this may be too conservative and, as such, pick up extra control dependent BBs.
 // A better "definition" point is the highest dominator where it is still legal to "insert" constant assignment.
 // In this context, "legal" means that only one value "leaves" the dominator and reaches Phi.
-void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *pPhi,
-                                                                EntryInfo &Entry,
-                                                                InstructionSetType &ContributingInstructions) {
+void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutput(PHINode *pPhi,
+                                                                    SmallVectorImpl<Value *> &Values) {
   Function *F = pPhi->getParent()->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   unordered_map<DomTreeNodeBase<BasicBlock> *, Value *> DomTreeMarkers;
@@ -649,13 +831,13 @@ void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *
     pBB = pDefDomNode->getBlock();
     const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+      Values.push_back(B->getTerminator());
     }
   }
 }
 
 const DxilViewIdStateBuilder::ValueSetType &DxilViewIdStateBuilder::CollectReachingDecls(Value *pValue) {
-  auto it = m_ReachingDeclsCache.emplace(pValue, ValueSetType());
+  auto it = m_ReachingDeclsCache.insert(std::make_pair(pValue, ValueSetType()));
   if (it.second) {
     // We have not seen this value before.
     ValueSetType Visited;
@@ -665,11 +847,11 @@ const DxilViewIdStateBuilder::ValueSetType &DxilViewIdStateBuilder::CollectReach
 }
 
 void DxilViewIdStateBuilder::CollectReachingDeclsRec(Value *pValue, ValueSetType &ReachingDecls, ValueSetType &Visited) {
-  if (Visited.find(pValue) != Visited.end())
+  if (Visited.count(pValue))
     return;
 
-  bool bInitialValue = Visited.size() == 0;
-  Visited.emplace(pValue);
+  bool bInitialValue = Visited.empty();
+  Visited.insert(pValue);
 
   if (!bInitialValue) {
     auto it = m_ReachingDeclsCache.find(pValue);
@@ -680,7 +862,7 @@ void DxilViewIdStateBuilder::CollectReachingDeclsRec(Value *pValue, ValueSetType
   }
 
   if (dyn_cast<GlobalVariable>(pValue)) {
-    ReachingDecls.emplace(pValue);
+    ReachingDecls.insert(pValue);
     return;
   }
 
@@ -697,7 +879,7 @@ void DxilViewIdStateBuilder::CollectReachingDeclsRec(Value *pValue, ValueSetType
   } else if (BitCastInst *pCI = dyn_cast<BitCastInst>(pValue)) {
     CollectReachingDeclsRec(pCI->getOperand(0), ReachingDecls, Visited);
   } else if (dyn_cast<AllocaInst>(pValue)) {
-    ReachingDecls.emplace(pValue);
+    ReachingDecls.insert(pValue);
   } else if (PHINode *phi = dyn_cast<PHINode>(pValue)) {
     for (Value *pPtrValue : phi->operands()) {
       CollectReachingDeclsRec(pPtrValue, ReachingDecls, Visited);
@@ -706,18 +888,18 @@ void DxilViewIdStateBuilder::CollectReachingDeclsRec(Value *pValue, ValueSetType
     CollectReachingDeclsRec(SelI->getTrueValue(), ReachingDecls, Visited);
     CollectReachingDeclsRec(SelI->getFalseValue(), ReachingDecls, Visited);
   } else if (dyn_cast<Argument>(pValue)) {
-    ReachingDecls.emplace(pValue);
+    ReachingDecls.insert(pValue);
   } else if (CallInst *call = dyn_cast<CallInst>(pValue)) {
     DXASSERT(OP::GetDxilOpFuncCallInst(call) == DXIL::OpCode::GetMeshPayload,
              "the function must be @dx.op.getMeshPayload here.");
-    ReachingDecls.emplace(pValue);
+    ReachingDecls.insert(pValue);
   } else {
     IFT(DXC_E_GENERAL_INTERNAL_ERROR);
   }
 }
 
 const DxilViewIdStateBuilder::ValueSetType &DxilViewIdStateBuilder::CollectStores(llvm::Value *pValue) {
-  auto it = m_StoresPerDeclCache.emplace(pValue, ValueSetType());
+  auto it = m_StoresPerDeclCache.insert(std::make_pair(pValue, ValueSetType()));
   if (it.second) {
     // We have not seen this value before.
     ValueSetType Visited;
@@ -727,11 +909,11 @@ const DxilViewIdStateBuilder::ValueSetType &DxilViewIdStateBuilder::CollectStore
 }
 
 void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue, ValueSetType &Stores, ValueSetType &Visited) {
-  if (Visited.find(pValue) != Visited.end())
+  if (Visited.count(pValue))
     return;
 
-  bool bInitialValue = Visited.size() == 0;
-  Visited.emplace(pValue);
+  bool bInitialValue = Visited.empty();
+  Visited.insert(pValue);
 
   if (!bInitialValue) {
     auto it = m_StoresPerDeclCache.find(pValue);
@@ -746,7 +928,7 @@ void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue, ValueSetType
   } else if (isa<StoreInst>(pValue) ||
              isa<AtomicCmpXchgInst>(pValue) ||
              isa<AtomicRMWInst>(pValue)) {
-    Stores.emplace(pValue);
+    Stores.insert(pValue);
     return;
   }
 
@@ -755,15 +937,18 @@ void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue, ValueSetType
   }
 }
 
-void DxilViewIdStateBuilder::CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType> &ContributingInstructions, 
+void DxilViewIdStateBuilder::CreateViewIdSets(const EntryInfo &Entry, unsigned StreamId,
                                        OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                                        InputsContributingToOutputType &InputsContributingToOutputs,
                                        bool bPC) {
   const ShaderModel *pSM = m_pModule->GetShaderModel();
 
-  for (auto &itOut : ContributingInstructions) {
+  for (auto &itOut : Entry.ContributingSources[StreamId]) {
     unsigned outIdx = itOut.first;
-    for (Instruction *pInst : itOut.second) {
+    const BitVector &ContributingSources = itOut.second;
+    for (int i = ContributingSources.find_first(); i != -1;
+         i = ContributingSources.find_next(i)) {
+      Instruction *pInst = Entry.Sources[i];
       // Set output dependence on ViewId.
       if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
         DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
@@ -872,10 +1057,12 @@ void DxilViewIdStateBuilder::UpdateDynamicIndexUsageStateForSig(DxilSignature &S
 
 namespace {
 class ComputeViewIdState : public ModulePass {
+  bool m_bPerOutputWalk;
+
 public:
   static char ID; // Pass ID, replacement for typeid
 
-  ComputeViewIdState();
+  ComputeViewIdState(bool bPerOutputWalk = false);
 
   bool runOnModule(Module &M) override;
 
@@ -890,7 +1077,8 @@ INITIALIZE_PASS_BEGIN(ComputeViewIdState, "viewid-state",
 INITIALIZE_PASS_END(ComputeViewIdState, "viewid-state",
                 "Compute information related to ViewID", true, true)
 
-ComputeViewIdState::ComputeViewIdState() : ModulePass(ID) {
+ComputeViewIdState::ComputeViewIdState(bool bPerOutputWalk)
+    : ModulePass(ID), m_bPerOutputWalk(bPerOutputWalk) {
 }
 
 bool ComputeViewIdState::runOnModule(Module &M) {
@@ -898,7 +1086,7 @@ bool ComputeViewIdState::runOnModule(Module &M) {
   const ShaderModel *pSM = DxilModule.GetShaderModel();
   if (!pSM->IsCS() && !pSM->IsLib()) {
     DxilViewIdState ViewIdState(&DxilModule);
-    DxilViewIdStateBuilder Builder(ViewIdState, &DxilModule);
+    DxilViewIdStateBuilder Builder(ViewIdState, &DxilModule, m_bPerOutputWalk);
     Builder.Compute();
     // Serialize viewidstate.
     ViewIdState.Serialize();
@@ -920,8 +1108,8 @@ void ComputeViewIdState::getAnalysisUsage(AnalysisUsage &AU) const {
 
 namespace llvm {
 
-ModulePass *createComputeViewIdStatePass() {
-  return new ComputeViewIdState();
+ModulePass *createComputeViewIdStatePass(bool bPerOutputWalk) {
+  return new ComputeViewIdState(bPerOutputWalk);
 }
 
 } // end of namespace llvm
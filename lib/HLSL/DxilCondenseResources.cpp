@@ -1822,7 +1822,7 @@ bool UpdateStructTypeForLegacyLayout(DxilResourceBase &Res,
           if (!ldInst->user_empty()) {
             IRBuilder<> Builder = IRBuilder<>(ldInst);
             LoadInst *newLoad = Builder.CreateLoad(NewGV);
-            ArrayRef<Value *> args = {hlslOP->GetI32Const((unsigned)hlsl::OP::OpCode::CreateHandleForLib), newLoad};
+            Value *args[] = {hlslOP->GetI32Const((unsigned)hlsl::OP::OpCode::CreateHandleForLib), newLoad};
 
             for (auto user = ldInst->user_begin(); user != ldInst->user_end();) {
               CallInst *CI = cast<CallInst>(*(user++));
@@ -2097,13 +2097,10 @@ HRESULT DxilModuleReflection::LoadProgramHeader(const DxilProgramHeader *pProgra
     auto errorHandler = [&bBitcodeLoadError](const DiagnosticInfo &diagInfo) {
         bBitcodeLoadError |= diagInfo.getSeverity() == DS_Error;
       };
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look for usage information.
+    // Function bodies are only read if usage information has to be recovered
+    // by walking instructions; everything else comes from metadata.
     ErrorOr<std::unique_ptr<Module>> mod =
         getLazyBitcodeModule(std::move(pMemBuffer), Context, errorHandler);
-#else
-    ErrorOr<std::unique_ptr<Module>> mod =
-      parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, errorHandler);
-#endif
     if (!mod || bBitcodeLoadError) {
       return E_INVALIDARG;
     }
@@ -2113,6 +2110,10 @@ HRESULT DxilModuleReflection::LoadProgramHeader(const DxilProgramHeader *pProgra
     unsigned ValMajor, ValMinor;
     m_pDxilModule->GetValidatorVersion(ValMajor, ValMinor);
     m_bUsageInMetadata = hlsl::DXIL::CompareVersions(ValMajor, ValMinor, 1, 5) >= 0;
+    if (!m_bUsageInMetadata) {
+      if (m_pModule->materializeAll() || bBitcodeLoadError)
+        return E_INVALIDARG;
+    }
 
     CreateReflectionObjects();
     return S_OK;
@@ -63,6 +63,19 @@ void CollectUsedFunctions(Constant *C,
   }
 }
 
+void CollectUsedGlobals(Constant *C,
+                        SmallPtrSetImpl<GlobalVariable *> &usedGVs) {
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(C)) {
+    if (!usedGVs.insert(GV).second)
+      return;
+  } else if (isa<GlobalValue>(C)) {
+    return;
+  }
+  // Globals used by the initializer of a used global are used too.
+  for (Use &U : C->operands())
+    CollectUsedGlobals(cast<Constant>(U), usedGVs);
+}
+
 template <class T>
 void AddResourceMap(
     const std::vector<std::unique_ptr<T>> &resTab, DXIL::ResourceClass resClass,
@@ -103,6 +116,9 @@ namespace {
 struct DxilFunctionLinkInfo {
   DxilFunctionLinkInfo(llvm::Function *F);
   llvm::Function *func;
+  // Function whose body is cloned for func; a prepared copy of func in its
+  // library when linking to a shader profile.
+  llvm::Function *body;
   // SetVectors for deterministic iteration
   llvm::SetVector<llvm::Function *> usedFunctions;
   llvm::SetVector<llvm::GlobalVariable *> usedGVs;
@@ -125,6 +141,7 @@ public:
 
   DxilModule &GetDxilModule() { return m_DM; }
   void LazyLoadFunction(Function *F);
+  DxilFunctionLinkInfo *GetPreparedLinkInfo(Function *F);
   void BuildGlobalUsage();
   void CollectUsedInitFunctions(SetVector<StringRef> &addedFunctionSet,
                                 SmallVector<StringRef, 4> &workList);
@@ -132,6 +149,9 @@ public:
   void FixIntrinsicOverloads();
 
 private:
+  void BuildFunctionUsage(DxilFunctionLinkInfo *linkInfo);
+  Function *GetLinkFunction(Function *F);
+  Function *PrepareFunction(Function *F);
   std::unique_ptr<llvm::Module> m_pModule;
   DxilModule &m_DM;
   // Map from name to Link info for extern functions.
@@ -141,6 +161,12 @@ private:
   llvm::MapVector<const llvm::Constant *, DxilResourceBase *> m_resourceMap;
   // Set of initialize functions for global variable. SetVector for deterministic iteration.
   llvm::SetVector<llvm::Function *> m_initFuncSet;
+  // Link info for functions with prepared bodies, built on first use and
+  // shared by every shader linked from this library.
+  llvm::DenseMap<llvm::Function *, std::unique_ptr<DxilFunctionLinkInfo>>
+      m_preparedLinkInfos;
+  // Map from prepared body to the function it was prepared from.
+  llvm::DenseMap<llvm::Function *, llvm::Function *> m_preparedBodies;
 };
 
 struct DxilLinkJob;
@@ -165,7 +191,7 @@ private:
   bool AddFunctions(SmallVector<StringRef, 4> &workList,
                     SetVector<DxilLib *> &libSet, SetVector<StringRef> &addedFunctionSet,
                     DxilLinkJob &linkJob, bool bLazyLoadDone,
-                    bool bAllowFuncionDecls);
+                    bool bAllowFuncionDecls, bool bUsePreparedBodies);
   // Attached libs to link.
   std::unordered_set<DxilLib *> m_attachedLibs;
   // Owner of all DxilLib.
@@ -180,7 +206,7 @@ private:
 //
 // DxilFunctionLinkInfo methods.
 //
-DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
+DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F), body(F) {
   DXASSERT_NOMSG(F);
 }
 
@@ -232,8 +258,13 @@ void DxilLib::LazyLoadFunction(Function *F) {
   std::error_code EC = F->materialize();
   DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
 
-  // Build used functions for F.
-  for (auto &BB : F->getBasicBlockList()) {
+  BuildFunctionUsage(linkInfo);
+  // Used globals will be build before link.
+}
+
+void DxilLib::BuildFunctionUsage(DxilFunctionLinkInfo *linkInfo) {
+  // Build used functions for body.
+  for (auto &BB : linkInfo->body->getBasicBlockList()) {
     for (auto &I : BB.getInstList()) {
       if (CallInst *CI = dyn_cast<CallInst>(&I)) {
         linkInfo->usedFunctions.insert(CI->getCalledFunction());
@@ -241,6 +272,7 @@ void DxilLib::LazyLoadFunction(Function *F) {
     }
   }
 
+  Function *F = linkInfo->func;
   if (m_DM.HasDxilFunctionProps(F)) {
     DxilFunctionProps &props = m_DM.GetDxilFunctionProps(F);
     if (props.IsHS()) {
@@ -249,7 +281,104 @@ void DxilLib::LazyLoadFunction(Function *F) {
       linkInfo->usedFunctions.insert(patchConstantFunc);
     }
   }
-  // Used globals will be build before link.
+}
+
+// Returns link info whose body is a copy of F that has been through the
+// profile-independent start of the prepare passes: callees defined in this
+// library are inlined and aggregates are split. Shaders linked from this
+// library clone that body instead of redoing the work for every link.
+// Returns nullptr while F itself is being prepared.
+DxilFunctionLinkInfo *DxilLib::GetPreparedLinkInfo(Function *F) {
+  auto it = m_preparedLinkInfos.find(F);
+  if (it != m_preparedLinkInfos.end())
+    return it->second.get();
+
+  LazyLoadFunction(F);
+
+  m_preparedLinkInfos[F] = nullptr;
+  Function *body = PrepareFunction(F);
+  m_preparedBodies[body] = F;
+
+  std::unique_ptr<DxilFunctionLinkInfo> linkInfo =
+      llvm::make_unique<DxilFunctionLinkInfo>(F);
+  linkInfo->body = body;
+  // Callees stay in the link even once inlined, so their debug info is mapped
+  // as before; dead function elimination drops them from the result.
+  linkInfo->usedFunctions = m_functionNameMap[F->getName()]->usedFunctions;
+  BuildFunctionUsage(linkInfo.get());
+
+  // Build used globals, in module order like BuildGlobalUsage.
+  SmallPtrSet<GlobalVariable *, 8> usedGVs;
+  for (auto &BB : body->getBasicBlockList()) {
+    for (auto &I : BB.getInstList()) {
+      for (Value *Op : I.operands()) {
+        if (Constant *C = dyn_cast<Constant>(Op))
+          CollectUsedGlobals(C, usedGVs);
+      }
+    }
+  }
+  if (!usedGVs.empty()) {
+    for (GlobalVariable &GV : m_pModule->globals()) {
+      if (usedGVs.count(&GV))
+        linkInfo->usedGVs.insert(&GV);
+    }
+  }
+
+  DxilFunctionLinkInfo *pLinkInfo = linkInfo.get();
+  m_preparedLinkInfos[F] = std::move(linkInfo);
+  return pLinkInfo;
+}
+
+Function *DxilLib::PrepareFunction(Function *F) {
+  Function *body =
+      Function::Create(F->getFunctionType(), GlobalValue::InternalLinkage,
+                       F->getName() + ".prepared", m_pModule.get());
+  ValueToValueMapTy vmap;
+  auto paramIt = body->arg_begin();
+  for (Argument &param : F->args()) {
+    vmap[&param] = (paramIt++);
+  }
+  SmallVector<ReturnInst *, 2> Returns;
+  llvm::CloneFunctionInto(body, F, vmap, /*ModuleLevelChanges*/ false,
+                          Returns);
+
+  // Inline what the link would inline, from the callees' prepared bodies so
+  // each call is inlined one level only.
+  SmallVector<CallInst *, 8> calls;
+  for (auto &BB : body->getBasicBlockList()) {
+    for (auto &I : BB.getInstList()) {
+      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+        Function *callee = CI->getCalledFunction();
+        if (callee && !CI->isNoInline() &&
+            m_functionNameMap.count(callee->getName()))
+          calls.emplace_back(CI);
+      }
+    }
+  }
+  for (CallInst *CI : calls) {
+    Function *callee = CI->getCalledFunction();
+    // Recursion is reported by validation; leave the call for it.
+    DxilFunctionLinkInfo *calleeInfo = GetPreparedLinkInfo(callee);
+    if (!calleeInfo)
+      continue;
+    CI->setCalledFunction(calleeInfo->body);
+    InlineFunctionInfo IFI;
+    if (!InlineFunction(CI, IFI, /*InsertLifetime*/ false))
+      CI->setCalledFunction(callee);
+  }
+
+  legacy::FunctionPassManager FPM(m_pModule.get());
+  FPM.add(createSROAPass(/*RequiresDomTree*/ false, /*SkipHLSLMat*/ false));
+  FPM.doInitialization();
+  FPM.run(*body);
+  FPM.doFinalization();
+  return body;
+}
+
+// Maps a prepared body back to the function it was prepared from.
+Function *DxilLib::GetLinkFunction(Function *F) {
+  auto it = m_preparedBodies.find(F);
+  return it != m_preparedBodies.end() ? it->second : F;
 }
 
 void DxilLib::BuildGlobalUsage() {
@@ -284,6 +413,9 @@ void DxilLib::BuildGlobalUsage() {
     llvm::SetVector<Function *> funcSet;
     CollectUsedFunctions(&GV, funcSet);
     for (Function *F : funcSet) {
+      // Prepared bodies collect their own used globals.
+      if (m_preparedBodies.count(F))
+        continue;
       DXASSERT(m_functionNameMap.count(F->getName()), "must exist in table");
       DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
       linkInfo->usedGVs.insert(&GV);
@@ -312,7 +444,8 @@ void DxilLib::CollectUsedInitFunctions(SetVector<StringRef> &addedFunctionSet,
       llvm::SetVector<Function *> funcSet;
       CollectUsedFunctions(GV, funcSet);
       bool bAdded = false;
-      for (Function *F : funcSet) {
+      for (Function *UserF : funcSet) {
+        Function *F = GetLinkFunction(UserF);
         if (F == Ctor)
           continue;
         // If F is added for link, add init func to workList.
@@ -689,7 +822,7 @@ void DxilLinkJob::CloneFunctions(ValueToValueMapTy &vmap) {
       }
     }
 
-    CloneFunction(F, NewF, vmap);
+    CloneFunction(linkInfo->body, NewF, vmap);
   }
 }
 
@@ -1396,7 +1529,8 @@ bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
                                   SetVector<DxilLib *> &libSet,
                                   SetVector<StringRef> &addedFunctionSet,
                                   DxilLinkJob &linkJob, bool bLazyLoadDone,
-                                  bool bAllowFuncionDecls) {
+                                  bool bAllowFuncionDecls,
+                                  bool bUsePreparedBodies) {
   while (!workList.empty()) {
     StringRef name = workList.pop_back_val();
     // Ignore added function.
@@ -1408,16 +1542,17 @@ bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
       return false;
     }
 
-    std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair =
+    std::pair<DxilFunctionLinkInfo *, DxilLib *> linkPair =
         m_functionNameMap[name];
-    linkJob.AddFunction(linkPair);
-
     DxilLib *pLib = linkPair.second;
     libSet.insert(pLib);
-    if (!bLazyLoadDone) {
+    if (bUsePreparedBodies) {
+      linkPair.first = pLib->GetPreparedLinkInfo(linkPair.first->func);
+    } else if (!bLazyLoadDone) {
       Function *F = linkPair.first->func;
       pLib->LazyLoadFunction(F);
     }
+    linkJob.AddFunction(linkPair);
     for (Function *F : linkPair.first->usedFunctions) {
       if (hlsl::OP::IsDxilOpFunc(F) || F->isIntrinsic()) {
         // Add dxil operations directly.
@@ -1476,7 +1611,8 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
 
     if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
                       /*bLazyLoadDone*/ false,
-                      /*bAllowFuncionDecls*/ false))
+                      /*bAllowFuncionDecls*/ false,
+                      /*bUsePreparedBodies*/ true))
       return nullptr;
 
   } else {
@@ -1530,7 +1666,8 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
 
       if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
                         /*bLazyLoadDone*/ false,
-                        /*bAllowFuncionDecls*/ false))
+                        /*bAllowFuncionDecls*/ false,
+                        /*bUsePreparedBodies*/ false))
         return nullptr;
     } else {
       SmallVector<StringRef, 4> workList;
@@ -1545,7 +1682,8 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
 
       if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
                         /*bLazyLoadDone*/ false,
-                        /*bAllowFuncionDecls*/ true))
+                        /*bAllowFuncionDecls*/ true,
+                        /*bUsePreparedBodies*/ false))
         return nullptr;
     }
   }
@@ -1572,7 +1710,8 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
   // so set bAllowFuncionDecls is false here.
   if (!AddFunctions(workList, libSet, addedFunctionSet, linkJob,
                     /*bLazyLoadDone*/ true,
-                    /*bAllowFuncionDecls*/ false))
+                    /*bAllowFuncionDecls*/ false,
+                    /*bUsePreparedBodies*/ !bIsLib))
     return nullptr;
 
   if (!bIsLib) {
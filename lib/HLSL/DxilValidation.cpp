@@ -42,6 +42,7 @@
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -56,7 +57,13 @@
 #include "dxc/HLSL/DxilPackSignatureElement.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include <algorithm>
+#include <atomic>
 #include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 using namespace llvm;
 using namespace std;
@@ -331,6 +338,21 @@ static void emitDxilDiag(LLVMContext &Ctx, const char *str) {
   hlsl::dxilutil::EmitErrorOnContext(Ctx, str);
 }
 
+// Diagnostics raised while validating functions in parallel are queued per
+// function and replayed on the calling thread in module order, so the output
+// is identical to serial validation.
+typedef std::vector<std::function<void()>> DeferredDiagList;
+static thread_local DeferredDiagList *CurrentDeferredDiags = nullptr;
+
+// Utility class for queuing diagnostics of the current thread to a list.
+struct DeferredDiagScope {
+  DeferredDiagScope(DeferredDiagList &Diags) {
+    DXASSERT_NOMSG(CurrentDeferredDiags == nullptr);
+    CurrentDeferredDiags = &Diags;
+  }
+  ~DeferredDiagScope() { CurrentDeferredDiags = nullptr; }
+};
+
 } // anon namespace
 
 namespace hlsl {
@@ -411,6 +433,10 @@ struct ValidationContext {
   const unsigned kLLVMLoopMDKind;
   unsigned m_DxilMajor, m_DxilMinor;
   ModuleSlotTracker slotTracker;
+  // Builtin struct types collected up front when functions are validated in
+  // parallel, since hlsl::OP creates missing types on lookup.
+  bool bParallelFunctions = false;
+  std::unordered_set<StructType *> DxilBuiltinStructTypes;
 
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule)
@@ -632,8 +658,35 @@ struct ValidationContext {
 
   DxilResourceProperties GetResourceFromVal(Value *resVal);
 
+  // Queues Emit when diagnostics of this thread are deferred; returns false
+  // if the caller should emit the diagnostic immediately.
+  bool DeferDiag(std::function<void()> Emit) {
+    if (!CurrentDeferredDiags)
+      return false;
+    CurrentDeferredDiags->emplace_back(std::move(Emit));
+    return true;
+  }
+
+  // Same as above, but copies the format arguments, which usually refer to
+  // temporaries of the caller.
+  bool DeferDiag(ArrayRef<StringRef> args,
+                 std::function<void(ArrayRef<StringRef>)> Emit) {
+    if (!CurrentDeferredDiags)
+      return false;
+    std::vector<std::string> argStrs(args.begin(), args.end());
+    CurrentDeferredDiags->emplace_back([argStrs, Emit]() {
+      SmallVector<StringRef, 4> argRefs(argStrs.begin(), argStrs.end());
+      Emit(argRefs);
+    });
+    return true;
+  }
+
   void EmitGlobalVariableFormatError(GlobalVariable *GV, ValidationRule rule,
                                      ArrayRef<StringRef> args) {
+    if (DeferDiag(args, [=](ArrayRef<StringRef> args) {
+          EmitGlobalVariableFormatError(GV, rule, args);
+        }))
+      return;
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
     if (pDebugModule)
@@ -644,6 +697,8 @@ struct ValidationContext {
 
   // This is the least desirable mechanism, as it has no context.
   void EmitError(ValidationRule rule) {
+    if (DeferDiag([=]() { EmitError(rule); }))
+      return;
     dxilutil::EmitErrorOnContext(M.getContext(), GetValidationRuleText(rule));
     Failed = true;
   }
@@ -674,6 +729,10 @@ struct ValidationContext {
   }
 
   void EmitFormatError(ValidationRule rule, ArrayRef<StringRef> args) {
+    if (DeferDiag(args, [=](ArrayRef<StringRef> args) {
+          EmitFormatError(rule, args);
+        }))
+      return;
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
     dxilutil::EmitErrorOnContext(M.getContext(), ruleText);
@@ -681,6 +740,8 @@ struct ValidationContext {
   }
 
   void EmitMetaError(Metadata *Meta, ValidationRule rule) {
+    if (DeferDiag([=]() { EmitMetaError(Meta, rule); }))
+      return;
     std::string O;
     raw_string_ostream OSS(O);
     Meta->print(OSS, &M);
@@ -730,6 +791,8 @@ struct ValidationContext {
   }
 
   void EmitResourceError(const hlsl::DxilResourceBase *Res, ValidationRule rule) {
+    if (DeferDiag([=]() { EmitResourceError(Res, rule); }))
+      return;
     std::string QuotedRes = " '" + GetResourceName(Res) + "'";
     dxilutil::EmitErrorOnContext(M.getContext(), GetValidationRuleText(rule) + QuotedRes);
     Failed = true;
@@ -738,6 +801,10 @@ struct ValidationContext {
   void EmitResourceFormatError(const hlsl::DxilResourceBase *Res,
                                ValidationRule rule,
                                ArrayRef<StringRef> args) {
+    if (DeferDiag(args, [=](ArrayRef<StringRef> args) {
+          EmitResourceFormatError(Res, rule, args);
+        }))
+      return;
     std::string QuotedRes = " '" + GetResourceName(Res) + "'";
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
@@ -773,6 +840,8 @@ struct ValidationContext {
   }
 
   void EmitInstrErrorMsg(Instruction *I, ValidationRule Rule, std::string Msg) {
+    if (DeferDiag([=]() { EmitInstrErrorMsg(I, Rule, Msg); }))
+      return;
     Instruction *DbgI = GetDebugInstr(I);
     const DebugLoc L = DbgI->getDebugLoc();
     if (L) {
@@ -840,6 +909,8 @@ struct ValidationContext {
   }
 
   void EmitTypeError(Type *Ty, ValidationRule rule) {
+    if (DeferDiag([=]() { EmitTypeError(Ty, rule); }))
+      return;
     std::string O;
     raw_string_ostream OSS(O);
     Ty->print(OSS);
@@ -847,6 +918,8 @@ struct ValidationContext {
   }
 
   void EmitFnError(Function *F, ValidationRule rule) {
+    if (DeferDiag([=]() { EmitFnError(F, rule); }))
+      return;
     if (pDebugModule)
       if (Function *dbgF = pDebugModule->getFunction(F->getName()))
         F = dbgF;
@@ -855,6 +928,10 @@ struct ValidationContext {
   }
 
   void EmitFnFormatError(Function *F, ValidationRule rule, ArrayRef<StringRef> args) {
+    if (DeferDiag(args, [=](ArrayRef<StringRef> args) {
+          EmitFnFormatError(F, rule, args);
+        }))
+      return;
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
     if (pDebugModule)
@@ -2754,6 +2831,12 @@ static bool IsDxilBuiltinStructType(StructType *ST, hlsl::OP *hlslOP) {
   }
 }
 
+static bool IsDxilBuiltinStructType(StructType *ST, ValidationContext &ValCtx) {
+  if (ValCtx.bParallelFunctions)
+    return ValCtx.DxilBuiltinStructTypes.count(ST) != 0;
+  return IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP());
+}
+
 // outer type may be: [ptr to][1 dim array of]( UDT struct | scalar )
 // inner type (UDT struct member) may be: [N dim array of]( UDT struct | scalar )
 // scalar type may be: ( float(16|32|64) | int(16|32|64) )
@@ -2788,8 +2871,7 @@ static bool ValidateType(Type *Ty, ValidationContext &ValCtx, bool bInner = fals
       // Allow handle type.
       if (ValCtx.HandleTy == Ty)
         return true;
-      hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
-      if (IsDxilBuiltinStructType(ST, hlslOP)) {
+      if (IsDxilBuiltinStructType(ST, ValCtx)) {
         ValCtx.EmitTypeError(Ty, ValidationRule::InstrDxilStructUser);
         result = false;
       }
@@ -2848,7 +2930,7 @@ static bool GetNodeOperandAsInt(ValidationContext &ValCtx, MDNode *pMD, unsigned
 }
 
 static bool IsPrecise(Instruction &I, ValidationContext &ValCtx) {
-  MDNode *pMD = I.getMetadata(DxilMDHelper::kDxilPreciseAttributeMDName);
+  MDNode *pMD = I.getMetadata(ValCtx.kDxilPreciseMDKind);
   if (pMD == nullptr) {
     return false;
   }
@@ -3024,7 +3106,7 @@ static void ValidateControlFlowHint(BasicBlock &bb, ValidationContext &ValCtx) {
   if (!TI)
     return;
 
-  MDNode *pNode = TI->getMetadata(DxilMDHelper::kDxilControlFlowHintMDName);
+  MDNode *pNode = TI->getMetadata(ValCtx.kDxilControlFlowHintMDKind);
   if (!pNode)
     return;
 
@@ -3438,7 +3520,7 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
         if (StructType *ST = dyn_cast<StructType>(Ty)) {
           Value *Agg = EV->getAggregateOperand();
           if (!isa<AtomicCmpXchgInst>(Agg) &&
-              !IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP())) {
+              !IsDxilBuiltinStructType(ST, ValCtx)) {
             ValCtx.EmitInstrError(EV, ValidationRule::InstrExtractValue);
           }
         } else {
@@ -3703,6 +3785,106 @@ static void ValidateFunction(Function &F, ValidationContext &ValCtx) {
   }
 }
 
+// Shared state that function validation would otherwise create or cache
+// lazily is built here, so worker threads only read the module.
+static void PrepareParallelFunctionValidation(ValidationContext &ValCtx) {
+  hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
+  TypeFinder StructTypes;
+  StructTypes.run(ValCtx.M, /*onlyNamed*/ false);
+  for (StructType *ST : StructTypes) {
+    if (!ST->isOpaque() && ST->isSized())
+      ValCtx.DL.getStructLayout(ST);
+    // Only query shapes OP could have produced for a scalar overload.
+    if (ST->getNumElements() == 0)
+      continue;
+    Type *EltTy = ST->getElementType(0);
+    if (!EltTy->isHalfTy() && !EltTy->isFloatTy() && !EltTy->isDoubleTy() &&
+        !EltTy->isIntegerTy(1) && !EltTy->isIntegerTy(8) &&
+        !EltTy->isIntegerTy(16) && !EltTy->isIntegerTy(32) &&
+        !EltTy->isIntegerTy(64))
+      continue;
+    if (IsDxilBuiltinStructType(ST, hlslOP))
+      ValCtx.DxilBuiltinStructTypes.insert(ST);
+  }
+  Type::getInt8PtrTy(ValCtx.M.getContext());
+  ValCtx.bParallelFunctions = true;
+}
+
+// Bodies of defined functions are validated on up to NumThreads threads for
+// library targets. Declarations validate their call sites in every function
+// and update shared entry status, so they stay on the calling thread.
+static void ValidateFunctions(ValidationContext &ValCtx, unsigned NumThreads) {
+  std::vector<Function *> Functions;
+  unsigned NumDefinitions = 0;
+  for (Function &F : ValCtx.M.functions()) {
+    Functions.emplace_back(&F);
+    if (!F.isDeclaration())
+      NumDefinitions++;
+  }
+
+  NumThreads = std::min(NumThreads, NumDefinitions);
+  if (!ValCtx.isLibProfile || NumThreads <= 1) {
+    for (Function *F : Functions)
+      ValidateFunction(*F, ValCtx);
+    return;
+  }
+
+  PrepareParallelFunctionValidation(ValCtx);
+
+  std::vector<DeferredDiagList> FunctionDiags(Functions.size());
+  std::atomic<unsigned> NextFunction(0);
+  std::exception_ptr WorkerException;
+  std::mutex WorkerExceptionMutex;
+  auto ValidateDefinitions = [&]() {
+    for (unsigned i = NextFunction++; i < Functions.size();
+         i = NextFunction++) {
+      Function *F = Functions[i];
+      if (F->isDeclaration())
+        continue;
+      try {
+        DeferredDiagScope Scope(FunctionDiags[i]);
+        ValidateFunction(*F, ValCtx);
+      } catch (...) {
+        std::lock_guard<std::mutex> Lock(WorkerExceptionMutex);
+        if (!WorkerException)
+          WorkerException = std::current_exception();
+      }
+    }
+  };
+
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  std::vector<std::thread> Workers;
+  for (unsigned i = 1; i < NumThreads; i++) {
+    try {
+      Workers.emplace_back([&]() {
+        DxcThreadMalloc TM(pMalloc);
+        ValidateDefinitions();
+      });
+    } catch (const std::system_error &) {
+      // Continue with the workers started so far.
+      break;
+    }
+  }
+  ValidateDefinitions();
+  for (std::thread &Worker : Workers)
+    Worker.join();
+  ValCtx.bParallelFunctions = false;
+  if (WorkerException)
+    std::rethrow_exception(WorkerException);
+
+  for (unsigned i = 0; i < Functions.size(); i++) {
+    if (!Functions[i]->isDeclaration())
+      continue;
+    DeferredDiagScope Scope(FunctionDiags[i]);
+    ValidateFunction(*Functions[i], ValCtx);
+  }
+
+  for (DeferredDiagList &Diags : FunctionDiags) {
+    for (std::function<void()> &Emit : Diags)
+      Emit();
+  }
+}
+
 static void ValidateGlobalVariable(GlobalVariable &GV,
                                    ValidationContext &ValCtx) {
   bool isInternalGV =
@@ -5755,7 +5937,8 @@ void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor) {
 
 _Use_decl_annotations_ HRESULT ValidateDxilModule(
     llvm::Module *pModule,
-    llvm::Module *pDebugModule) {
+    llvm::Module *pDebugModule,
+    unsigned NumThreads) {
   DxilModule *pDxilModule = DxilModule::TryGetDxilModule(pModule);
   if (!pDxilModule) {
     return DXC_E_IR_VERIFICATION_FAILED;
@@ -5782,9 +5965,7 @@ _Use_decl_annotations_ HRESULT ValidateDxilModule(
   ValidateFlowControl(ValCtx);
 
   // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
-  }
+  ValidateFunctions(ValCtx, NumThreads);
 
   ValidateShaderFlags(ValCtx);
 
@@ -5821,9 +6002,11 @@ static void VerifyBlobPartMatches(_In_ ValidationContext &ValCtx,
     return;
   }
 
+  // Part writers build their output in place, so reserving the exact size
+  // makes this the only buffer the expected part is rendered into.
   CComPtr<AbstractMemoryStream> pOutputStream;
   IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pOutputStream));
-  pOutputStream->Reserve(Size);
+  IFT(pOutputStream->Reserve(Size));
 
   pWriter->write(pOutputStream);
   DXASSERT(pOutputStream->GetPtrSize() == Size, "otherwise, DxilPartWriter misreported size");
@@ -6185,7 +6368,8 @@ HRESULT ValidateLoadModule(const char *pIL,
 HRESULT ValidateDxilBitcode(
   _In_reads_bytes_(ILLength) const char *pIL,
   _In_ uint32_t ILLength,
-  _In_ llvm::raw_ostream &DiagStream) {
+  _In_ llvm::raw_ostream &DiagStream,
+  _In_ unsigned NumThreads) {
 
   LLVMContext Ctx;
   std::unique_ptr<llvm::Module> pModule;
@@ -6200,7 +6384,7 @@ HRESULT ValidateDxilBitcode(
                                      /*bLazyLoad*/ false)))
     return hr;
 
-  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr)))
+  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr, NumThreads)))
     return hr;
 
   DxilModule &dxilModule = pModule->GetDxilModule();
@@ -6304,7 +6488,8 @@ HRESULT ValidateDxilContainer(const void *pContainer,
                               uint32_t ContainerSize,
                               const void *pOptDebugBitcode,
                               uint32_t OptDebugBitcodeSize,
-                              llvm::raw_ostream &DiagStream) {
+                              llvm::raw_ostream &DiagStream,
+                              unsigned NumThreads) {
   LLVMContext Ctx, DbgCtx;
   std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -6325,7 +6510,7 @@ HRESULT ValidateDxilContainer(const void *pContainer,
   }
 
   // Validate DXIL Module
-  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get()));
+  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get(), NumThreads));
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
     return DXC_E_IR_VERIFICATION_FAILED;
@@ -6338,7 +6523,9 @@ HRESULT ValidateDxilContainer(const void *pContainer,
 _Use_decl_annotations_
 HRESULT ValidateDxilContainer(const void *pContainer,
                               uint32_t ContainerSize,
-                              llvm::raw_ostream &DiagStream) {
-  return ValidateDxilContainer(pContainer, ContainerSize, nullptr, 0, DiagStream);
+                              llvm::raw_ostream &DiagStream,
+                              unsigned NumThreads) {
+  return ValidateDxilContainer(pContainer, ContainerSize, nullptr, 0,
+                               DiagStream, NumThreads);
 }
 } // namespace hlsl
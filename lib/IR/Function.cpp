@@ -256,6 +256,9 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage, const Twine &name,
   assert(FunctionType::isValidReturnType(getReturnType()) &&
          "invalid return type");
   setGlobalObjectSubClassData(0);
+  // HLSL Change - the name was set before the subclass data was cleared.
+  setGlobalObjectBit(HasDxilOpNameBit,
+                     hasName() && getName().startswith("dx.op."));
   SymTab.reset(new ValueSymbolTable()); // HLSL Change: use unique_ptr
 
   // If the function has arguments, mark them as lazily built.
@@ -470,6 +473,10 @@ static Intrinsic::ID lookupIntrinsicID(const ValueName *ValName) {
 
 void Function::recalculateIntrinsicID() {
   const ValueName *ValName = this->getValueName();
+  // HLSL Change Begin
+  setGlobalObjectBit(HasDxilOpNameBit,
+                     ValName && ValName->getKey().startswith("dx.op."));
+  // HLSL Change End
   if (!ValName || !isIntrinsic()) {
     IntID = Intrinsic::not_intrinsic;
     return;
@@ -261,7 +261,18 @@ void Value::setName(const Twine &NewName) {
     F->recalculateIntrinsicID();
 }
 
+// HLSL Change Begin - recalculate properties that functions derive from
+// their names, as setName does.
 void Value::takeName(Value *V) {
+  takeNameImpl(V);
+  if (Function *F = dyn_cast<Function>(this))
+    F->recalculateIntrinsicID();
+  if (Function *F = dyn_cast<Function>(V))
+    F->recalculateIntrinsicID();
+}
+// HLSL Change End
+
+void Value::takeNameImpl(Value *V) { // HLSL Change - renamed from takeName
   ValueSymbolTable *ST = nullptr;
   // If this value has a name, drop it.
   if (hasName()) {
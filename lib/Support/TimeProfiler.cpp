@@ -0,0 +1,205 @@
+//===-- TimeProfiler.cpp - Hierarchical Time Profiler ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - This file implements the hierarchical time profiler.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance = nullptr;
+
+namespace {
+
+typedef std::chrono::microseconds TimeTraceUnit;
+
+struct Entry {
+  TimeTraceClock::time_point Start;
+  TimeTraceClock::duration Duration;
+  std::string Name;
+  std::string Detail;
+
+  Entry(TimeTraceClock::time_point S, std::string &&N, std::string &&D)
+      : Start(S), Duration(), Name(std::move(N)), Detail(std::move(D)) {}
+
+  // Regions with a detail are reported separately per detail.
+  std::string getReportKey() const {
+    return Detail.empty() ? Name : Name + ": " + Detail;
+  }
+};
+
+struct RegionTotal {
+  TimeTraceClock::duration Duration = TimeTraceClock::duration();
+  unsigned Count = 0;
+};
+
+void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    switch (C) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\b': OS << "\\b"; break;
+    case '\f': OS << "\\f"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if (C < 0x20)
+        OS << format("\\u%04x", C);
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+} // namespace
+
+struct TimeTraceProfiler {
+  TimeTraceClock::time_point StartTime;
+  std::vector<Entry> Stack;
+  std::vector<Entry> Entries;
+  StringMap<RegionTotal> Totals;
+
+  TimeTraceProfiler(TimeTraceClock::time_point S) : StartTime(S) {}
+
+  void begin(std::string Name, std::string Detail) {
+    Stack.emplace_back(TimeTraceClock::now(), std::move(Name),
+                       std::move(Detail));
+  }
+
+  void end() {
+    // A region begun before the profiler was initialized has nothing to end.
+    if (Stack.empty())
+      return;
+    Entry E = std::move(Stack.back());
+    Stack.pop_back();
+    E.Duration = TimeTraceClock::now() - E.Start;
+    addEntry(std::move(E));
+  }
+
+  void addEntry(Entry &&E) {
+    // Only count the outermost of nested regions with the same key, so that
+    // recursion does not count the same time twice.
+    std::string Key = E.getReportKey();
+    bool Nested = std::any_of(Stack.begin(), Stack.end(),
+                              [&Key](const Entry &Open) {
+                                return Open.getReportKey() == Key;
+                              });
+    if (!Nested) {
+      RegionTotal &Total = Totals[Key];
+      Total.Duration += E.Duration;
+      ++Total.Count;
+    }
+    Entries.emplace_back(std::move(E));
+  }
+
+  void write(raw_ostream &OS) {
+    OS << "{\"traceEvents\":[";
+    bool First = true;
+    for (const Entry &E : Entries) {
+      int64_t StartUs =
+          std::chrono::duration_cast<TimeTraceUnit>(E.Start - StartTime)
+              .count();
+      int64_t DurUs =
+          std::chrono::duration_cast<TimeTraceUnit>(E.Duration).count();
+      OS << (First ? "\n" : ",\n");
+      First = false;
+      OS << "{\"pid\":1,\"tid\":0,\"ph\":\"X\",\"ts\":" << StartUs
+         << ",\"dur\":" << DurUs << ",\"name\":";
+      writeJSONString(OS, E.Name);
+      if (!E.Detail.empty()) {
+        OS << ",\"args\":{\"detail\":";
+        writeJSONString(OS, E.Detail);
+        OS << "}";
+      }
+      OS << "}";
+    }
+    OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+  void writeReport(raw_ostream &OS) {
+    typedef std::pair<StringRef, RegionTotal> Row;
+    std::vector<Row> Rows;
+    for (const auto &Total : Totals)
+      Rows.push_back(Row(Total.getKey(), Total.getValue()));
+    std::sort(Rows.begin(), Rows.end(), [](const Row &A, const Row &B) {
+      return A.second.Duration > B.second.Duration;
+    });
+
+    typedef std::chrono::duration<double> Seconds;
+    double TotalSeconds =
+        std::chrono::duration_cast<Seconds>(TimeTraceClock::now() - StartTime)
+            .count();
+    OS << "===" << std::string(73, '-') << "===\n"
+       << "                          Compile Time Report\n"
+       << "===" << std::string(73, '-') << "===\n"
+       << format("  Total Execution Time: %.4f seconds\n\n", TotalSeconds)
+       << "   ---Wall Time---  --Count--  --- Name ---\n";
+    for (const Row &R : Rows) {
+      double Secs =
+          std::chrono::duration_cast<Seconds>(R.second.Duration).count();
+      double Percent = TotalSeconds > 0 ? Secs * 100.0 / TotalSeconds : 0;
+      OS << format("   %7.4f (%5.1f%%)  %9u  ", Secs, Percent, R.second.Count)
+         << R.first << "\n";
+    }
+  }
+};
+
+void timeTraceProfilerInitialize(TimeTraceClock::time_point StartTime) {
+  assert(TimeTraceProfilerInstance == nullptr &&
+         "Profiler should not be initialized");
+  TimeTraceProfilerInstance = new TimeTraceProfiler(StartTime);
+}
+
+void timeTraceProfilerCleanup() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
+}
+
+void timeTraceProfilerWrite(raw_ostream &OS) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+  TimeTraceProfilerInstance->write(OS);
+}
+
+void timeTraceProfilerWriteReport(raw_ostream &OS) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+  TimeTraceProfilerInstance->writeReport(OS);
+}
+
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name.str(), Detail.str());
+}
+
+void timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->end();
+}
+
+void timeTraceProfilerAddRegion(StringRef Name, StringRef Detail,
+                                TimeTraceClock::time_point Start) {
+  if (TimeTraceProfilerInstance == nullptr)
+    return;
+  Entry E(Start, Name.str(), Detail.str());
+  E.Duration = TimeTraceClock::now() - Start;
+  TimeTraceProfilerInstance->addEntry(std::move(E));
+}
+
+} // namespace llvm
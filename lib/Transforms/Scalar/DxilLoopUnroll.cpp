@@ -46,9 +46,16 @@
 //
 // 3. Unroll the loop until we succeed.
 //
-//    Unlike LLVM, we do not try to find a loop count before unrolling.
-//    Instead, we unroll to find a constant terminal condition. Give up when we
-//    fail to do so.
+//    If the trip count is known, either from SCEV or by evaluating the exit
+//    condition from the starting values of the loop (with DxilValueCache
+//    resolving what comes from outside of the loop), all iterations are cloned
+//    in one go. The exit branches of all but the last iteration are folded as
+//    they are cloned, and the induction variables are folded to constants in a
+//    single pass over the unrolled body afterwards.
+//
+//    Otherwise, unlike LLVM, we do not try to find a loop count before
+//    unrolling. Instead, we unroll to find a constant terminal condition. Give
+//    up when we fail to do so.
 //
 //
 //===----------------------------------------------------------------------===//
@@ -60,6 +67,7 @@
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -746,6 +754,134 @@ static void RemapDebugInsts(BasicBlock *ClonedBB, ValueToValueMapTy &VarMap, Set
   }
 }
 
+// Collect the instructions the exit condition in the latch is computed from,
+// in an order where operands come before their users, along with the header
+// PHIs they go through. Fails if the condition depends on anything in the loop
+// other than simple arithmetic.
+static bool CollectExitConditionSlice(Loop *L, BasicBlock *Latch, Value *Cond,
+    SmallVectorImpl<Instruction *> &Slice, SmallVectorImpl<PHINode *> &SlicePHIs) {
+  SmallPtrSet<Value *, 16> Seen;
+  SmallVector<std::pair<Value *, bool>, 16> WorkList;
+  WorkList.push_back(std::make_pair(Cond, false));
+  while (WorkList.size()) {
+    std::pair<Value *, bool> Item = WorkList.pop_back_val();
+    Instruction *I = dyn_cast<Instruction>(Item.first);
+    if (!I || !L->contains(I))
+      continue;
+
+    // All operands have been visited.
+    if (Item.second) {
+      Slice.push_back(I);
+      continue;
+    }
+    if (!Seen.insert(I).second)
+      continue;
+
+    if (PHINode *PN = dyn_cast<PHINode>(I)) {
+      if (PN->getParent() != L->getHeader())
+        return false;
+      SlicePHIs.push_back(PN);
+      WorkList.push_back(std::make_pair(PN->getIncomingValueForBlock(Latch), false));
+      continue;
+    }
+
+    if (!isa<BinaryOperator>(I) && !isa<CmpInst>(I) &&
+        !isa<CastInst>(I) && !isa<SelectInst>(I))
+      return false;
+
+    WorkList.push_back(std::make_pair(I, true));
+    for (Value *Op : I->operands())
+      WorkList.push_back(std::make_pair(Op, false));
+  }
+  return true;
+}
+
+// Get the constant a value of the exit condition slice has in the current
+// iteration. Values from outside of the loop are the same in every iteration.
+static Constant *GetSliceValue(Value *V, DenseMap<Value *, Constant *> &Vals,
+    Loop *L, DxilValueCache *DVC) {
+  if (Constant *C = dyn_cast<Constant>(V))
+    return C;
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (I && L->contains(I))
+    return Vals.lookup(V);
+  return DVC->GetConstValue(V);
+}
+
+// Constant fold an instruction of the exit condition slice, given the
+// constants its operands have in the current iteration.
+static Constant *EvaluateSliceInstruction(Instruction *I, DenseMap<Value *, Constant *> &Vals,
+    Loop *L, DxilValueCache *DVC, const DataLayout &DL) {
+  SmallVector<Constant *, 4> Ops;
+  for (Value *Op : I->operands()) {
+    Constant *C = GetSliceValue(Op, Vals, L, DVC);
+    if (!C)
+      return nullptr;
+    Ops.push_back(C);
+  }
+
+  Constant *Result = nullptr;
+  if (CmpInst *CI = dyn_cast<CmpInst>(I))
+    Result = ConstantFoldCompareInstOperands(CI->getPredicate(), Ops[0], Ops[1], DL);
+  else
+    Result = ConstantFoldInstOperands(I->getOpcode(), I->getType(), Ops, DL);
+
+  // A constant expression that could not be folded any further says nothing
+  // about when the loop exits.
+  if (Result && !isa<ConstantInt>(Result) && !isa<ConstantFP>(Result))
+    return nullptr;
+  return Result;
+}
+
+// Find the trip count by evaluating the exit condition in the latch one
+// iteration at a time, starting from the values the header PHIs have on entry.
+// This catches loops SCEV can't count, such as ones with floating point or
+// non-affine induction variables, or with more iterations than SCEV is willing
+// to evaluate. Returns 0 if the count could not be found within MaxIterations.
+static unsigned EvaluateTripCount(Loop *L, BasicBlock *Latch, BasicBlock *Predecessor,
+    ArrayRef<Instruction *> Slice, ArrayRef<PHINode *> SlicePHIs,
+    DxilValueCache *DVC, const DataLayout &DL, unsigned MaxIterations) {
+  BranchInst *BI = cast<BranchInst>(Latch->getTerminator());
+  bool ContinueOnTrue = BI->getSuccessor(0) == L->getHeader();
+
+  DenseMap<Value *, Constant *> Vals;
+  SmallVector<Constant *, 8> PHIVals;
+  for (PHINode *PN : SlicePHIs) {
+    Constant *C = DVC->GetConstValue(PN->getIncomingValueForBlock(Predecessor));
+    if (!C)
+      return 0;
+    PHIVals.push_back(C);
+  }
+
+  for (unsigned Iteration = 1; Iteration <= MaxIterations; Iteration++) {
+    Vals.clear();
+    for (unsigned i = 0; i < SlicePHIs.size(); i++)
+      Vals[SlicePHIs[i]] = PHIVals[i];
+
+    for (Instruction *I : Slice) {
+      Constant *C = EvaluateSliceInstruction(I, Vals, L, DVC, DL);
+      if (!C)
+        return 0;
+      Vals[I] = C;
+    }
+
+    bool Cond = false;
+    Constant *CondVal = GetSliceValue(BI->getCondition(), Vals, L, DVC);
+    if (!CondVal || !GetConstantI1(CondVal, &Cond))
+      return 0;
+    if (Cond != ContinueOnTrue)
+      return Iteration;
+
+    for (unsigned i = 0; i < SlicePHIs.size(); i++) {
+      Value *Next = SlicePHIs[i]->getIncomingValueForBlock(Latch);
+      PHIVals[i] = GetSliceValue(Next, Vals, L, DVC);
+      if (!PHIVals[i])
+        return 0;
+    }
+  }
+  return 0;
+}
+
 bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
   DebugLoc LoopLoc = L->getStartLoc(); // Debug location for the start of the loop.
@@ -823,8 +959,10 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   std::unordered_set<BasicBlock *> ProblemBlocks;
   FindProblemBlocks(L->getHeader(), BlocksInLoop, ProblemBlocks, ProblemAllocas);
 
+  bool Structurized = false;
   if (StructurizeLoopExits && hlsl::RemoveUnstructuredLoopExits(L, LI, DT, /* exclude */&ProblemBlocks)) {
     // Recompute the loop if we managed to simplify the exit blocks
+    Structurized = true;
 
     Latch = L->getLoopLatch();
     ExitBlocks.clear();
@@ -859,6 +997,29 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     }
   }
 
+  // If we know how many times the latch is going to be run before it exits the
+  // loop, all iterations can be cloned in one go. SCEV's count no longer
+  // applies if the exits were restructured after it was computed.
+  unsigned BulkCount = 0;
+  SmallVector<Instruction *, 16> ExitCondSlice;
+  SmallVector<PHINode *, 8> ExitCondPHIs;
+  if (L->isLoopExiting(Latch)) {
+    Value *Cond = cast<BranchInst>(Latch->getTerminator())->getCondition();
+    bool HasSlice = CollectExitConditionSlice(L, Latch, Cond, ExitCondSlice, ExitCondPHIs);
+    if (!HasSlice) {
+      ExitCondSlice.clear();
+      ExitCondPHIs.clear();
+    }
+
+    if (TripCount != 0 && ExitingBlock == Latch && !Structurized)
+      BulkCount = TripCount;
+    else if (HasSlice)
+      BulkCount = EvaluateTripCount(L, Latch, Predecessor, ExitCondSlice,
+                                    ExitCondPHIs, DVC, DL, MaxIterationAttempt);
+    if (BulkCount && HasExplicitLoopCount)
+      BulkCount = std::min(BulkCount, ExplicitUnrollCount);
+  }
+
   SetVector<BasicBlock *> ToBeCloned; // List of blocks that will be cloned.
   for (BasicBlock *BB : L->getBlocks()) // Include the body right away
     ToBeCloned.insert(BB);
@@ -920,10 +1081,22 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   SmallVector<std::unique_ptr<ClonedIteration>, 16> Iterations; // List of cloned iterations
   bool Succeeded = false;
 
+  // When unrolling in bulk, the latches of all but the last iteration branch
+  // straight to the next iteration, unless leaving through the latch takes us
+  // to a block that is cloned as well.
+  BasicBlock *LatchExit = nullptr;
+  for (BasicBlock *Succ : successors(Latch))
+    if (Succ != Header)
+      LatchExit = Succ;
+  const bool FoldLatchExits = BulkCount != 0 && !ToBeCloned.count(LatchExit);
+
   unsigned MaxAttempt = this->MaxIterationAttempt;
   // If we were able to figure out the definitive trip count,
   // just unroll that many times.
-  if (TripCount != 0) {
+  if (BulkCount != 0) {
+    MaxAttempt = BulkCount;
+  }
+  else if (TripCount != 0) {
     MaxAttempt = TripCount;
   }
   else if (HasExplicitLoopCount) {
@@ -967,6 +1140,10 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     }
 
     for (BasicBlock *BB : ToBeCloned) {
+      // The latch only leaves the loop in the last iteration.
+      if (FoldLatchExits && BB == Latch && IterationI+1 < BulkCount)
+        continue;
+
       BasicBlock *ClonedBB = cast<BasicBlock>(CurIteration.VarMap[BB]);
       // If branching to outside of the loop, need to update the
       // phi nodes there to include new values.
@@ -1025,7 +1202,18 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
       // Make the latch of the previous iteration branch to the header
       // of this new iteration.
-      if (BranchInst *BI = dyn_cast<BranchInst>(PrevIteration->Latch->getTerminator())) {
+      if (FoldLatchExits) {
+        BranchInst *BI = cast<BranchInst>(PrevIteration->Latch->getTerminator());
+        Value *Cond = BI->getCondition();
+        BranchInst *NewBI = IRBuilder<>(BI).CreateBr(CurIteration.Header);
+        SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+        BI->getAllMetadataOtherThanDebugLoc(MDs);
+        for (std::pair<unsigned, MDNode *> &MD : MDs)
+          NewBI->setMetadata(MD.first, MD.second);
+        BI->eraseFromParent();
+        RecursivelyDeleteTriviallyDeadInstructions(Cond);
+      }
+      else if (BranchInst *BI = dyn_cast<BranchInst>(PrevIteration->Latch->getTerminator())) {
         for (unsigned i = 0; i < BI->getNumSuccessors(); i++) {
           if (BI->getSuccessor(i) == PrevIteration->Header) {
             BI->setSuccessor(i, CurIteration.Header);
@@ -1035,8 +1223,9 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
       }
     }
 
-    // Check exit condition to see if we fully unrolled the loop
-    if (BranchInst *BI = dyn_cast<BranchInst>(CurIteration.Latch->getTerminator())) {
+    // Check exit condition to see if we fully unrolled the loop. There is
+    // nothing to check if we already know how many iterations there are.
+    if (BranchInst *BI = BulkCount ? nullptr : dyn_cast<BranchInst>(CurIteration.Latch->getTerminator())) {
       bool Cond = false;
 
       Value *ConstantCond = BI->getCondition();
@@ -1053,7 +1242,8 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
     // We've reached the N defined in [unroll(N)]
     if ((HasExplicitLoopCount && IterationI+1 >= ExplicitUnrollCount) ||
-      (TripCount != 0 && IterationI+1 >= TripCount))
+      (BulkCount == 0 && TripCount != 0 && IterationI+1 >= TripCount) ||
+      (BulkCount != 0 && IterationI+1 >= BulkCount))
     {
       Succeeded = true;
       BranchInst *BI = cast<BranchInst>(CurIteration.Latch->getTerminator());
@@ -1076,6 +1266,24 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   }
 
   if (Succeeded) {
+    // Fold what the exit condition is computed from in every iteration, in
+    // order, so that the induction variables of each iteration become
+    // constants from those of the previous one.
+    if (BulkCount) {
+      for (std::unique_ptr<ClonedIteration> &IterPtr : Iterations) {
+        for (Instruction *I : ExitCondSlice) {
+          Value *ClonedV = IterPtr->VarMap.lookup(I);
+          Instruction *ClonedI = dyn_cast_or_null<Instruction>(ClonedV);
+          if (!ClonedI)
+            continue;
+          if (Constant *C = ConstantFoldInstruction(ClonedI, DL)) {
+            ClonedI->replaceAllUsesWith(C);
+            ClonedI->eraseFromParent();
+          }
+        }
+      }
+    }
+
     // Now that we successfully unrolled the loop L, if there were any sub loops in L,
     // we have to recreate all the sub-loops for each iteration of L that we cloned.
     for (std::unique_ptr<ClonedIteration> &IterPtr : Iterations) {
@@ -3853,6 +3853,7 @@ public:
     IdentifierInfo *Id, SourceLocation IdLoc, 
     std::vector<hlsl::UnusualAnnotation *>& BufferAttributes,
     SourceLocation LBrace);
+  static HLSLBufferDecl *CreateDeserialized(ASTContext &C, unsigned ID);
 
   virtual SourceRange getSourceRange() const LLVM_READONLY{
     return SourceRange(getLocStart(), RBraceLoc);
@@ -4646,6 +4646,7 @@ public:
 
   /// getEncodedElementAccess - Encode the elements accessed
   hlsl::MatrixMemberAccessPositions getEncodedElementAccess() const { return Positions; }
+  void setEncodedElementAccess(hlsl::MatrixMemberAccessPositions P) { Positions = P; }
   /// getEncodedElementAccess - Encode the elements accessed
   void getEncodedElementAccess(SmallVectorImpl<unsigned> &Elts) const {
     for (uint32_t i = 0; i < Positions.Count; i++) {
@@ -4716,6 +4717,7 @@ public:
 
   /// getEncodedElementAccess - Encode the elements accessed
   hlsl::VectorMemberAccessPositions getEncodedElementAccess() const { return Positions; }
+  void setEncodedElementAccess(hlsl::VectorMemberAccessPositions P) { Positions = P; }
 
   /// getEncodedElementAccess - Encode the elements accessed
   void getEncodedElementAccess(SmallVectorImpl<unsigned> &Elts) const {
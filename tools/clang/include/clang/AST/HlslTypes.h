@@ -32,6 +32,7 @@ namespace clang {
   class CXXMethodDecl;
   class CXXRecordDecl;
   class ClassTemplateDecl;
+  class ExternalSemaSource;
   class ExtVectorType;
   class FunctionDecl;
   class FunctionTemplateDecl;
@@ -47,6 +48,11 @@ namespace hlsl {
 /// <summary>Initializes the specified context to support HLSL compilation.</summary>
 void InitializeASTContextForHLSL(clang::ASTContext& context);
 
+/// <summary>Loads declarations from the AST file read by the specified reader
+/// into a context initialized for HLSL.</summary>
+void AttachASTReaderForHLSL(clang::ASTContext& context,
+                            clang::ExternalSemaSource* reader);
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Type system enumerations.
 
@@ -291,6 +291,10 @@ private:
   /// precompiled preamble.
   std::unique_ptr<llvm::MemoryBuffer> PreambleBuffer;
 
+  /// \brief The precompiled preamble, which is kept in memory rather than
+  /// written to a temporary file. // HLSL Change
+  std::unique_ptr<llvm::MemoryBuffer> PreamblePCH;
+
   /// \brief The number of warnings that occurred while parsing the preamble.
   ///
   /// This value will be used to restore the state of the \c DiagnosticsEngine
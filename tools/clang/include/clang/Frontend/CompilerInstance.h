@@ -124,14 +124,14 @@ class CompilerInstance : public ModuleLoader {
   /// \brief The frontend timer.
   std::unique_ptr<llvm::Timer> FrontendTimer;
 
-#if 0 // HLSL Change Starts - no support for modules or PCH
   /// \brief The ASTReader, if one exists.
   IntrusiveRefCntPtr<ASTReader> ModuleManager;
 
+#if 0 // HLSL Change Starts - no support for modules
   /// \brief The module dependency collector for crashdumps
   std::shared_ptr<ModuleDependencyCollector> ModuleDepCollector;
 
-#endif // HLSL Change Ends - no support for modules or PCH
+#endif // HLSL Change Ends - no support for modules
 
   /// \brief The module provider.
   std::shared_ptr<PCHContainerOperations> ThePCHContainerOperations;
@@ -525,7 +525,6 @@ public:
   std::unique_ptr<Sema> takeSema();
   void resetAndLeakSema();
 
-#if 0 // HLSL Change Starts - no support for modules or PCH
   /// }
   /// @name Module Management
   /// {
@@ -533,9 +532,11 @@ public:
   IntrusiveRefCntPtr<ASTReader> getModuleManager() const;
   void setModuleManager(IntrusiveRefCntPtr<ASTReader> Reader);
 
+#if 0 // HLSL Change Starts - no support for modules
   std::shared_ptr<ModuleDependencyCollector> getModuleDepCollector() const;
   void setModuleDepCollector(
       std::shared_ptr<ModuleDependencyCollector> Collector);
+#endif // HLSL Change Ends - no support for modules
 
   std::shared_ptr<PCHContainerOperations> getPCHContainerOperations() const {
     return ThePCHContainerOperations;
@@ -555,7 +556,6 @@ public:
     return *Writer;
   }
 
-#endif // HLSL Change Ends - no support for modules or PCH
   
   /// Return the appropriate PCHContainerReader depending on the
   /// current CodeGenOptions.
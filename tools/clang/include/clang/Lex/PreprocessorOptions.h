@@ -65,6 +65,12 @@ public:
   /// The implicit PCH included at the start of the translation unit, or empty.
   std::string ImplicitPCHInclude;
 
+  // HLSL Change Begin - in-memory precompiled headers.
+  /// \brief When non-null, the contents of ImplicitPCHInclude, which then need
+  /// not exist on disk. Not owned.
+  const llvm::MemoryBuffer *ImplicitPCHBuffer;
+  // HLSL Change End
+
   /// \brief Headers that will be converted to chained PCHs in memory.
   std::vector<std::string> ChainedIncludes;
 
@@ -149,6 +155,7 @@ public:
 public:
   PreprocessorOptions() : UsePredefines(true), DetailedRecord(false),
                           IgnoreLineDirectives(false), // HLSL Change - ignore line directives.
+                          ImplicitPCHBuffer(nullptr), // HLSL Change
                           DisablePCHValidation(false),
                           AllowPCHWithCompilerErrors(false),
                           DumpDeserializedPCHDecls(false),
@@ -180,6 +187,7 @@ public:
     ChainedIncludes.clear();
     DumpDeserializedPCHDecls = false;
     ImplicitPCHInclude.clear();
+    ImplicitPCHBuffer = nullptr; // HLSL Change
     ImplicitPTHInclude.clear();
     TokenCache.clear();
     RetainRemappedFileBuffers = true;
@@ -51,6 +51,10 @@ public:
   ///
   MultiplexExternalSemaSource(ExternalSemaSource& s1, ExternalSemaSource& s2);
 
+  // HLSL Change Begin - allow sources that only multiplex on demand.
+  MultiplexExternalSemaSource() {}
+  // HLSL Change End
+
   ~MultiplexExternalSemaSource() override;
 
   ///\brief Appends new source to the source list.
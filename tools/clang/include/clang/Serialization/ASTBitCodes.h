@@ -777,7 +777,20 @@ namespace clang {
       /// \brief OpenCL event type.
       PREDEF_TYPE_EVENT_ID      = 44,
       /// \brief OpenCL sampler type.
-      PREDEF_TYPE_SAMPLER_ID    = 45
+      PREDEF_TYPE_SAMPLER_ID    = 45,
+      // HLSL Change Begin
+      /// \brief HLSL minimum-precision, literal and packed types.
+      PREDEF_TYPE_MIN12INT_ID   = 46,
+      PREDEF_TYPE_MIN10FLOAT_ID = 47,
+      PREDEF_TYPE_LITINT_ID     = 48,
+      PREDEF_TYPE_LITFLOAT_ID   = 49,
+      PREDEF_TYPE_HALFFLOAT_ID  = 50,
+      PREDEF_TYPE_MIN16FLOAT_ID = 51,
+      PREDEF_TYPE_MIN16INT_ID   = 52,
+      PREDEF_TYPE_MIN16UINT_ID  = 53,
+      PREDEF_TYPE_INT8_4PACKED_ID = 54,
+      PREDEF_TYPE_UINT8_4PACKED_ID = 55
+      // HLSL Change End
     };
 
     /// \brief The number of predefined type IDs that are reserved for
@@ -875,7 +888,9 @@ namespace clang {
       /// \brief A DecayedType record.
       TYPE_DECAYED               = 41,
       /// \brief An AdjustedType record.
-      TYPE_ADJUSTED              = 42
+      TYPE_ADJUSTED              = 42,
+      /// \brief A DependentSizedExtVectorType record.
+      TYPE_DEPENDENT_SIZED_EXT_VECTOR = 43 // HLSL Change
     };
 
     /// \brief The type IDs for special types constructed by semantic
@@ -1108,6 +1123,10 @@ namespace clang {
       DECL_EMPTY,
       /// \brief An ObjCTypeParamDecl record.
       DECL_OBJC_TYPE_PARAM,
+      // HLSL Change Begin
+      /// \brief An HLSLBufferDecl record for a cbuffer, tbuffer or buffer view.
+      DECL_HLSL_BUFFER,
+      // HLSL Change End
     };
 
     /// \brief Record codes for each kind of statement or expression.
@@ -1410,7 +1429,9 @@ namespace clang {
 
       // HLSL Change: Add support for hlsl types.
       // HLSL
-      STMT_DISCARD                // DiscardStmt
+      STMT_DISCARD,               // DiscardStmt
+      EXPR_EXT_MATRIX_ELEMENT,    // ExtMatrixElementExpr
+      EXPR_HLSL_VECTOR_ELEMENT    // HLSLVectorElementExpr
     };
 
     /// \brief The kinds of designators that can occur in a
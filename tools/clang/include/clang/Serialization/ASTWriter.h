@@ -356,6 +356,10 @@ private:
   /// record.
   SmallVector<uint64_t, 16> EagerlyDeserializedDecls;
 
+  /// \brief The declarations behind EagerlyDeserializedDecls, used to hand
+  /// them to the consumer in source order. // HLSL Change
+  SmallVector<const Decl *, 16> EagerlyDeserializedDeclPtrs;
+
   /// \brief DeclContexts that have received extensions since their serialized
   /// form.
   ///
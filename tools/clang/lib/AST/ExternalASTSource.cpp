@@ -110,9 +110,13 @@ uint32_t ExternalASTSource::incrementGeneration(ASTContext &C) {
   // Make sure the generation of the topmost external source for the context is
   // incremented. That might not be us.
   auto *P = C.getExternalSource();
-  if (P && P != this)
-    CurrentGeneration = P->incrementGeneration(C);
-  else {
+  if (P && P != this) {
+    // HLSL Change - take the new generation rather than the one returned,
+    // which is the old one, so that a source the topmost one multiplexes
+    // does not skip what it loads.
+    P->incrementGeneration(C);
+    CurrentGeneration = P->getGeneration();
+  } else {
     // FIXME: Only bump the generation counter if the current generation number
     // has been observed?
     if (!++CurrentGeneration)
@@ -25,7 +25,8 @@ using namespace clang;
 #endif // LLVM_ON_UNIX
 
 LangOptions::LangOptions() 
-    : HLSLVersion(2018) {
+    : HLSLVersion(2018), UseMinPrecision(true), EnableDX9CompatMode(false),
+      EnableFXCCompatMode(false), EnablePayloadAccessQualifiers(false) {
 #ifdef MS_SUPPORT_VARIABLE_LANGOPTS
 #define LANGOPT(Name, Bits, Default, Description) Name = Default;
 #define ENUM_LANGOPT(Name, Type, Bits, Default, Description) set##Name(Default);
@@ -36,6 +36,7 @@
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/Support/TimeProfiler.h"
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -3540,6 +3541,7 @@ HLCBuffer &CGMSHLSLRuntime::GetOrCreateCBuffer(HLSLBufferDecl *D) {
 }
 
 void CGMSHLSLRuntime::FinishCodeGen() {
+  llvm::TimeTraceScope FinishScope("FinishCodeGen");
   HLModule &HLM = *m_pHLModule;
   llvm::Module &M = TheModule;
   // Do this before CloneShaderEntry and TranslateRayQueryConstructor to avoid
@@ -34,6 +34,7 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TimeProfiler.h" // HLSL Change
 #include "llvm/Support/Timer.h"
 #include <memory>
 using namespace clang;
@@ -144,6 +145,7 @@ namespace clang {
         if (llvm::TimePassesIsEnabled)
           LLVMIRGeneration.startTimer();
 
+        llvm::TimeTraceScope CodeGenScope("CodeGen"); // HLSL Change
         Gen->HandleTranslationUnit(C);
 
         if (llvm::TimePassesIsEnabled)
@@ -188,9 +190,12 @@ namespace clang {
       void *OldDiagnosticContext = Ctx.getDiagnosticContext();
       Ctx.setDiagnosticHandler(DiagnosticHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        C.getTargetInfo().getTargetDescription(),
-                        TheModule.get(), Action, AsmOutStream);
+      {
+        llvm::TimeTraceScope BackendScope("Backend"); // HLSL Change
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          C.getTargetInfo().getTargetDescription(),
+                          TheModule.get(), Action, AsmOutStream);
+      }
 
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
 
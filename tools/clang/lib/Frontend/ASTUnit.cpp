@@ -34,6 +34,7 @@
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/ASTWriter.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CrashRecoveryContext.h"
@@ -124,27 +125,24 @@ static OnDiskData &getOnDiskData(const ASTUnit *AU) {
   return *D;
 }
 
-#if 0 // HLSL Change Starts - no support for PCH
+// HLSL Change Starts - the precompiled preamble is kept in memory by the
+// ASTUnit; only the name it is loaded under is recorded here, and there is
+// nothing on disk to clean up.
 static void erasePreambleFile(const ASTUnit *AU) {
-  getOnDiskData(AU).CleanPreambleFile();
+  getOnDiskData(AU).PreambleFile.clear();
 }
 
 static void removeOnDiskEntry(const ASTUnit *AU) {
   // We require the mutex since we are modifying the structure of the
   // DenseMap.
   llvm::MutexGuard Guard(getOnDiskMutex());
-  OnDiskDataMap &M = getOnDiskDataMap();
-  OnDiskDataMap::iterator I = M.find(AU);
-  if (I != M.end()) {
-    I->second->Cleanup();
-    M.erase(I);
-  }
+  getOnDiskDataMap().erase(AU);
 }
 
 static void setPreambleFile(const ASTUnit *AU, StringRef preambleFile) {
   getOnDiskData(AU).PreambleFile = preambleFile;
 }
-#endif // HLSL Change Ends - no support for PCH
+// HLSL Change Ends
 
 static const std::string &getPreambleFile(const ASTUnit *AU) {
   return getOnDiskData(AU).PreambleFile;  
@@ -195,7 +193,7 @@ void ASTUnit::addTemporaryFile(StringRef TempFile) {
 /// errors in the source that occurs in the preamble), the number of
 /// reparses during which we'll skip even trying to precompile the
 /// preamble.
-//const unsigned DefaultPreambleRebuildInterval = 5; // HLSL Change Starts - no support for PCH
+const unsigned DefaultPreambleRebuildInterval = 5;
 
 
 /// \brief Tracks the number of ASTUnit objects that are currently active.
@@ -232,7 +230,7 @@ ASTUnit::~ASTUnit() {
   clearFileLevelDecls();
 
   // Clean up the temporary files and the preamble file.
-  // removeOnDiskEntry(this); // HLSL Change - no temporary/preamble files generated.
+  removeOnDiskEntry(this);
 
   // Free the buffers associated with remapped files. We are required to
   // perform this operation here because we explicitly request that the
@@ -790,6 +788,31 @@ public:
   }
 };
 
+// HLSL Change Starts
+/// \brief Records the files entered while precompiling the preamble. Entries
+/// are kept rather than names, since unsaved files are often named "./x.h"
+/// and dependency names drop that prefix.
+class PreambleFileTrackerPPCallbacks : public PPCallbacks {
+  SourceManager &SM;
+  llvm::SmallPtrSetImpl<const FileEntry *> &Files;
+
+public:
+  PreambleFileTrackerPPCallbacks(SourceManager &SM,
+                                 llvm::SmallPtrSetImpl<const FileEntry *> &Files)
+      : SM(SM), Files(Files) {}
+
+  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                   SrcMgr::CharacteristicKind FileType,
+                   FileID PrevFID) override {
+    if (Reason != PPCallbacks::EnterFile)
+      return;
+    if (const FileEntry *FE =
+            SM.getFileEntryForID(SM.getFileID(SM.getExpansionLoc(Loc))))
+      Files.insert(FE);
+  }
+};
+// HLSL Change Ends
+
 /// \brief Add the given declaration to the hash of all top-level entities.
 void AddTopLevelDeclarationToHash(Decl *D, unsigned &Hash) {
   if (!D)
@@ -912,11 +935,11 @@ public:
   }
 };
 
-#if 0 // HLSL Change Starts - no support for PCH
-
 class PrecompilePreambleAction : public ASTFrontendAction {
   ASTUnit &Unit;
   bool HasEmittedPreamblePCH;
+  SmallVector<char, 0> PreamblePCH; // HLSL Change
+  llvm::SmallPtrSet<const FileEntry *, 16> PreambleFiles; // HLSL Change
 
 public:
   explicit PrecompilePreambleAction(ASTUnit &Unit)
@@ -926,6 +949,12 @@ public:
                                                  StringRef InFile) override;
   bool hasEmittedPreamblePCH() const { return HasEmittedPreamblePCH; }
   void setHasEmittedPreamblePCH() { HasEmittedPreamblePCH = true; }
+  StringRef getPreamblePCH() const { // HLSL Change
+    return StringRef(PreamblePCH.data(), PreamblePCH.size());
+  }
+  const llvm::SmallPtrSetImpl<const FileEntry *> &getPreambleFiles() const {
+    return PreambleFiles; // HLSL Change
+  }
   bool shouldEraseOutputFiles() override { return !hasEmittedPreamblePCH(); }
 
   bool hasCodeCompletionSupport() const override { return false; }
@@ -938,12 +967,12 @@ class PrecompilePreambleConsumer : public PCHGenerator {
   unsigned &Hash;
   std::vector<Decl *> TopLevelDecls;
   PrecompilePreambleAction *Action;
-  raw_ostream *Out;
+  SmallVectorImpl<char> &Out; // HLSL Change - written to memory
 
 public:
   PrecompilePreambleConsumer(ASTUnit &Unit, PrecompilePreambleAction *Action,
                              const Preprocessor &PP, StringRef isysroot,
-                             raw_ostream *Out)
+                             SmallVectorImpl<char> &Out)
       : PCHGenerator(PP, "", nullptr, isysroot, std::make_shared<PCHBuffer>(),
                      /*AllowASTWithErrors=*/true),
         Unit(Unit), Hash(Unit.getCurrentTopLevelHashValue()), Action(Action),
@@ -968,13 +997,8 @@ public:
   void HandleTranslationUnit(ASTContext &Ctx) override {
     PCHGenerator::HandleTranslationUnit(Ctx);
     if (hasEmittedPCH()) {
-      // Write the generated bitstream to "Out".
-      *Out << getPCH();
-      // Make sure it hits disk now.
-      Out->flush();
-      // Free the buffer.
-      llvm::SmallVector<char, 0> Empty;
-      getPCH() = std::move(Empty);
+      // Hand the generated bitstream to "Out", which frees the buffer.
+      Out = std::move(getPCH()); // HLSL Change
 
       // Translate the top-level declarations we captured during
       // parsing into declaration IDs in the precompiled
@@ -992,33 +1016,26 @@ public:
   }
 };
 
-#endif // HLSL Change Ends - no support for PCH
-
 }
 
-#if 0 // HLSL Change Starts - no support for PCH
 std::unique_ptr<ASTConsumer>
 PrecompilePreambleAction::CreateASTConsumer(CompilerInstance &CI,
                                             StringRef InFile) {
+  // HLSL Change - the preamble is written to memory, not to an output file.
   std::string Sysroot;
-  std::string OutputFile;
-  raw_ostream *OS = GeneratePCHAction::ComputeASTConsumerArguments(
-      CI, InFile, Sysroot, OutputFile);
-  if (!OS)
-    return nullptr;
-
-  if (!CI.getFrontendOpts().RelocatablePCH)
-    Sysroot.clear();
+  if (CI.getFrontendOpts().RelocatablePCH)
+    Sysroot = CI.getHeaderSearchOpts().Sysroot;
 
   CI.getPreprocessor().addPPCallbacks(
       llvm::make_unique<MacroDefinitionTrackerPPCallbacks>(
                                            Unit.getCurrentTopLevelHashValue()));
+  CI.getPreprocessor().addPPCallbacks(
+      llvm::make_unique<PreambleFileTrackerPPCallbacks>(CI.getSourceManager(),
+                                                        PreambleFiles));
   return llvm::make_unique<PrecompilePreambleConsumer>(
-      Unit, this, CI.getPreprocessor(), Sysroot, OS);
+      Unit, this, CI.getPreprocessor(), Sysroot, PreamblePCH);
 }
 
-#endif // HLSL Change Ends - no support for PCH
-
 static bool isNonDriverDiag(const StoredDiagnostic &StoredDiag) {
   return StoredDiag.getLocation().isValid();
 }
@@ -1140,6 +1157,7 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
     PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.ImplicitPCHBuffer = PreamblePCH.get(); // HLSL Change
     PreprocessorOpts.DisablePCHValidation = true;
     
     // The stored diagnostic has the old source manager in it; update
@@ -1172,6 +1190,20 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
   if (!Act->Execute())
     goto error;
 
+  // HLSL Change Starts - callers only provide file access while parsing, so
+  // load the files behind the precompiled preamble now rather than when a
+  // location in them is first resolved.
+  if (SavedMainFileBuffer) {
+    SourceManager &SM = getSourceManager();
+    for (unsigned I = 0, N = SM.loaded_sloc_entry_size(); I != N; ++I) {
+      bool Invalid = false;
+      const SrcMgr::SLocEntry &Entry = SM.getLoadedSLocEntry(I, &Invalid);
+      if (!Invalid && Entry.isFile())
+        Entry.getFile().getContentCache()->getBuffer(getDiagnostics(), SM);
+    }
+  }
+  // HLSL Change Ends
+
   transferASTDataFromCompilerInstance(*Clang);
   
   Act->EndSourceFile();
@@ -1193,22 +1225,23 @@ error:
   return true;
 }
 
-#if 0 // HLSL Change Ends - no support for PCH
 /// \brief Simple function to retrieve a path for a preamble precompiled header.
-static std::string GetPreamblePCHPath() {
-  // FIXME: This is a hack so that we can override the preamble file during
-  // crash-recovery testing, which is the only case where the preamble files
-  // are not necessarily cleaned up.
-  const char *TmpFile = ::getenv("CINDEXTEST_PREAMBLE_FILE");
-  if (TmpFile)
-    return TmpFile;
-
-  SmallString<128> Path;
-  llvm::sys::fs::createTemporaryFile("preamble", "pch", Path);
+/// HLSL Change - the preamble is never written out, so this only names the
+/// in-memory buffer for the reader.
+static std::string GetPreamblePCHPath(StringRef MainFilename) {
+  return (MainFilename + ".preamble.pch").str();
+}
 
-  return Path.str();
+// HLSL Change Starts - editors hand over files that exist only as unsaved
+// buffers, which have no unique ID on disk; those are matched by name.
+static bool isSameFile(StringRef LHS, StringRef RHS) {
+  llvm::sys::fs::UniqueID LHSID, RHSID;
+  if (!llvm::sys::fs::getUniqueID(LHS, LHSID) &&
+      !llvm::sys::fs::getUniqueID(RHS, RHSID))
+    return LHSID == RHSID;
+  return LHS == RHS;
 }
-#endif // HLSL Change Ends - no support for PCH
+// HLSL Change Ends
 
 /// \brief Compute the preamble for the main file, providing the source buffer
 /// that corresponds to the main file along with a pair (bytes, start-of-line)
@@ -1224,33 +1257,25 @@ ASTUnit::ComputePreamble(CompilerInvocation &Invocation, unsigned MaxLines) {
   llvm::MemoryBuffer *Buffer = nullptr;
   std::unique_ptr<llvm::MemoryBuffer> BufferOwner;
   std::string MainFilePath(FrontendOpts.Inputs[0].getFile());
-  llvm::sys::fs::UniqueID MainFileID;
-  if (!llvm::sys::fs::getUniqueID(MainFilePath, MainFileID)) {
+  // HLSL Change - the main file may exist only as an unsaved buffer.
+  {
     // Check whether there is a file-file remapping of the main file
     for (const auto &RF : PreprocessorOpts.RemappedFiles) {
-      std::string MPath(RF.first);
-      llvm::sys::fs::UniqueID MID;
-      if (!llvm::sys::fs::getUniqueID(MPath, MID)) {
-        if (MainFileID == MID) {
-          // We found a remapping. Try to load the resulting, remapped source.
-          BufferOwner = getBufferForFile(RF.second);
-          if (!BufferOwner)
-            return ComputedPreamble(nullptr, nullptr, 0, true);
-        }
+      if (isSameFile(MainFilePath, RF.first)) {
+        // We found a remapping. Try to load the resulting, remapped source.
+        BufferOwner = getBufferForFile(RF.second);
+        if (!BufferOwner)
+          return ComputedPreamble(nullptr, nullptr, 0, true);
       }
     }
     
     // Check whether there is a file-buffer remapping. It supercedes the
     // file-file remapping.
     for (const auto &RB : PreprocessorOpts.RemappedFileBuffers) {
-      std::string MPath(RB.first);
-      llvm::sys::fs::UniqueID MID;
-      if (!llvm::sys::fs::getUniqueID(MPath, MID)) {
-        if (MainFileID == MID) {
-          // We found a remapping.
-          BufferOwner.reset();
-          Buffer = const_cast<llvm::MemoryBuffer *>(RB.second);
-        }
+      if (isSameFile(MainFilePath, RB.first)) {
+        // We found a remapping.
+        BufferOwner.reset();
+        Buffer = const_cast<llvm::MemoryBuffer *>(RB.second);
       }
     }
   }
@@ -1300,7 +1325,6 @@ bool operator==(const ASTUnit::PreambleFileHash &LHS,
 }
 } // namespace clang
 
-#if 0 // HLSL Change Starts - no support for PCH
 static std::pair<unsigned, unsigned>
 makeStandaloneRange(CharSourceRange Range, const SourceManager &SM,
                     const LangOptions &LangOpts) {
@@ -1345,7 +1369,6 @@ makeStandaloneDiagnostic(const LangOptions &LangOpts,
 
   return OutDiag;
 }
-#endif // HLSL Change Ends - no support for PCH
 
 /// \brief Attempt to build or re-use a precompiled preamble when (re-)parsing
 /// the source file.
@@ -1372,9 +1395,6 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     const CompilerInvocation &PreambleInvocationIn, bool AllowRebuild,
     unsigned MaxLines) {
-#if 1 // HLSL Change Starts - no support for PCH
-  return std::unique_ptr<llvm::MemoryBuffer>();
-#else
   IntrusiveRefCntPtr<CompilerInvocation>
     PreambleInvocation(new CompilerInvocation(PreambleInvocationIn));
   FrontendOptions &FrontendOpts = PreambleInvocation->getFrontendOpts();
@@ -1388,6 +1408,7 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     // preamble, if we have one. It's obviously no good any more.
     Preamble.clear();
     erasePreambleFile(this);
+    PreamblePCH.reset(); // HLSL Change
 
     // The next time we actually see a preamble, precompile it.
     PreambleRebuildCounter = 1;
@@ -1485,6 +1506,7 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     Preamble.clear();
     PreambleDiagnostics.clear();
     erasePreambleFile(this);
+    PreamblePCH.reset(); // HLSL Change
     PreambleRebuildCounter = 1;
   } else if (!AllowRebuild) {
     // We aren't allowed to rebuild the precompiled preamble; just
@@ -1500,14 +1522,9 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     return nullptr;
   }
 
-  // Create a temporary file for the precompiled preamble. In rare 
-  // circumstances, this can fail.
-  std::string PreamblePCHPath = GetPreamblePCHPath();
-  if (PreamblePCHPath.empty()) {
-    // Try again next time.
-    PreambleRebuildCounter = 1;
-    return nullptr;
-  }
+  // HLSL Change - name the precompiled preamble; it is built in memory.
+  std::string PreamblePCHPath =
+      GetPreamblePCHPath(FrontendOpts.Inputs[0].getFile());
   
   // We did not previously compute a preamble, or it can't be reused anyway.
   SimpleTimer PreambleTimer(WantTiming);
@@ -1528,10 +1545,9 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   StringRef MainFilePath = FrontendOpts.Inputs[0].getFile();
   PreprocessorOpts.addRemappedFile(MainFilePath, PreambleBuffer.get());
 
-  // Tell the compiler invocation to generate a temporary precompiled header.
+  // Tell the compiler invocation to generate a precompiled header.
   FrontendOpts.ProgramAction = frontend::GeneratePCH;
-  // FIXME: Generate the precompiled header into memory?
-  FrontendOpts.OutputFile = PreamblePCHPath;
+  FrontendOpts.OutputFile.clear(); // HLSL Change - generated into memory
   PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
   PreprocessorOpts.PrecompiledPreambleBytes.second = false;
   
@@ -1543,6 +1559,7 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   llvm::CrashRecoveryContextCleanupRegistrar<CompilerInstance>
     CICleanup(Clang.get());
 
+  Clang->HlslLangExtensions = HlslLangExtensions; // HLSL Change
   Clang->setInvocation(&*PreambleInvocation);
   OriginalSourceFile = Clang->getFrontendOpts().Inputs[0].getFile();
   
@@ -1553,7 +1570,6 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   Clang->setTarget(TargetInfo::CreateTargetInfo(
       Clang->getDiagnostics(), Clang->getInvocation().TargetOpts));
   if (!Clang->hasTarget()) {
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
     Preamble.clear();
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
     PreprocessorOpts.RemappedFileBuffers.pop_back();
@@ -1593,13 +1609,9 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   Clang->setSourceManager(new SourceManager(getDiagnostics(),
                                             Clang->getFileManager()));
 
-  auto PreambleDepCollector = std::make_shared<DependencyCollector>();
-  Clang->addDependencyCollector(PreambleDepCollector);
-
   std::unique_ptr<PrecompilePreambleAction> Act;
   Act.reset(new PrecompilePreambleAction(*this));
   if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0])) {
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
     Preamble.clear();
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
     PreprocessorOpts.RemappedFileBuffers.pop_back();
@@ -1624,7 +1636,6 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     // The preamble PCH failed (e.g. there was a module loading fatal error),
     // so no precompiled header was generated. Forget that we even tried.
     // FIXME: Should we leave a note for ourselves to try again?
-    llvm::sys::fs::remove(FrontendOpts.OutputFile);
     Preamble.clear();
     TopLevelDeclsInPreamble.clear();
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
@@ -1633,15 +1644,17 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   }
   
   // Keep track of the preamble we precompiled.
-  setPreambleFile(this, FrontendOpts.OutputFile);
+  // HLSL Change - keep the precompiled preamble in memory.
+  PreamblePCH = llvm::MemoryBuffer::getMemBufferCopy(Act->getPreamblePCH(),
+                                                     PreamblePCHPath);
+  setPreambleFile(this, PreamblePCHPath);
   NumWarningsInPreamble = getDiagnostics().getNumWarnings();
   
   // Keep track of all of the files that the source manager knows about,
   // so we can verify whether they have changed or not.
   FilesInPreamble.clear();
   SourceManager &SourceMgr = Clang->getSourceManager();
-  for (auto &Filename : PreambleDepCollector->getDependencies()) {
-    const FileEntry *File = Clang->getFileManager().getFile(Filename);
+  for (const FileEntry *File : Act->getPreambleFiles()) { // HLSL Change
     if (!File || File == SourceMgr.getFileEntryForID(SourceMgr.getMainFileID()))
       continue;
     if (time_t ModTime = File->getModificationTime()) {
@@ -1667,7 +1680,6 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
 
   return llvm::MemoryBuffer::getMemBufferCopy(NewPreamble.Buffer->getBuffer(),
                                               MainFilename);
-#endif // HLSL Change Ends - no support for PCH
 }
 
 void ASTUnit::RealizeTopLevelDeclsFromPreamble() {
@@ -2481,18 +2493,10 @@ void ASTUnit::CodeComplete(
   // preamble.
   std::unique_ptr<llvm::MemoryBuffer> OverrideMainBuffer;
   if (!getPreambleFile(this).empty()) {
-    std::string CompleteFilePath(File);
-    llvm::sys::fs::UniqueID CompleteFileID;
-
-    if (!llvm::sys::fs::getUniqueID(CompleteFilePath, CompleteFileID)) {
-      std::string MainPath(OriginalSourceFile);
-      llvm::sys::fs::UniqueID MainID;
-      if (!llvm::sys::fs::getUniqueID(MainPath, MainID)) {
-        if (CompleteFileID == MainID && Line > 1)
-          OverrideMainBuffer = getMainBufferWithPrecompiledPreamble(
-              PCHContainerOps, *CCInvocation, false, Line - 1);
-      }
-    }
+    // HLSL Change - the main file may exist only as an unsaved buffer.
+    if (isSameFile(File, OriginalSourceFile) && Line > 1)
+      OverrideMainBuffer = getMainBufferWithPrecompiledPreamble(
+          PCHContainerOps, *CCInvocation, false, Line - 1);
   }
 
   // If the main file has been overridden due to the use of a preamble,
@@ -2504,6 +2508,7 @@ void ASTUnit::CodeComplete(
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
     PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.ImplicitPCHBuffer = PreamblePCH.get(); // HLSL Change
     PreprocessorOpts.DisablePCHValidation = true;
 
     OwnedBuffers.push_back(OverrideMainBuffer.release());
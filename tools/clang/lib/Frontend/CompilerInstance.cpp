@@ -11,6 +11,7 @@
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
+#include "clang/AST/HlslTypes.h" // HLSL Change
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
@@ -124,8 +125,6 @@ std::unique_ptr<Sema> CompilerInstance::takeSema() {
   return std::move(TheSema);
 }
 
-#if 0 // HLSL Change Ends - no support for modules
-
 IntrusiveRefCntPtr<ASTReader> CompilerInstance::getModuleManager() const {
   return ModuleManager;
 }
@@ -133,6 +132,8 @@ void CompilerInstance::setModuleManager(IntrusiveRefCntPtr<ASTReader> Reader) {
   ModuleManager = Reader;
 }
 
+#if 0 // HLSL Change Starts - no support for modules
+
 std::shared_ptr<ModuleDependencyCollector>
 CompilerInstance::getModuleDepCollector() const {
   return ModuleDepCollector;
@@ -421,7 +422,6 @@ void CompilerInstance::createASTContext() {
 void CompilerInstance::createPCHExternalASTSource(
     StringRef Path, bool DisablePCHValidation, bool AllowPCHWithCompilerErrors,
     void *DeserializationListener, bool OwnDeserializationListener) {
-#if 0 // HLSL Change Starts - no support for PCH
   bool Preamble = getPreprocessorOpts().PrecompiledPreambleBytes.first != 0;
   ModuleManager = createPCHExternalASTSource(
       Path, getHeaderSearchOpts().Sysroot, DisablePCHValidation,
@@ -429,7 +429,6 @@ void CompilerInstance::createPCHExternalASTSource(
       getPCHContainerReader(), DeserializationListener,
       OwnDeserializationListener, Preamble,
       getFrontendOpts().UseGlobalModuleIndex);
-#endif // HLSL Change Ends - no support for PCH
 }
 
 IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
@@ -438,7 +437,6 @@ IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
     const PCHContainerReader &PCHContainerRdr,
     void *DeserializationListener, bool OwnDeserializationListener,
     bool Preamble, bool UseGlobalModuleIndex) {
-#if 0 // HLSL Change Starts - no support for PCH
   HeaderSearchOptions &HSOpts = PP.getHeaderSearchInfo().getHeaderSearchOpts();
 
   IntrusiveRefCntPtr<ASTReader> Reader(new ASTReader(
@@ -447,9 +445,23 @@ IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
       /*AllowConfigurationMismatch*/ false, HSOpts.ModulesValidateSystemHeaders,
       UseGlobalModuleIndex));
 
+  // HLSL Change Begin - serve a precompiled header held in memory.
+  const PreprocessorOptions &PPOpts = PP.getPreprocessorOpts();
+  if (PPOpts.ImplicitPCHBuffer && Path == PPOpts.ImplicitPCHInclude)
+    Reader->getModuleManager().addInMemoryBuffer(
+        Path, llvm::MemoryBuffer::getMemBuffer(
+                  PPOpts.ImplicitPCHBuffer->getMemBufferRef(),
+                  /*RequiresNullTerminator*/ false));
+  // HLSL Change End
+
   // We need the external source to be set up before we read the AST, because
   // eagerly-deserialized declarations may use it.
-  Context.setExternalSource(Reader.get());
+  // HLSL Change Begin - keep the HLSL source, which multiplexes the reader.
+  if (Context.getLangOpts().HLSL)
+    hlsl::AttachASTReaderForHLSL(Context, Reader.get());
+  else
+    Context.setExternalSource(Reader.get());
+  // HLSL Change End
 
   Reader->setDeserializationListener(
       static_cast<ASTDeserializationListener *>(DeserializationListener),
@@ -478,8 +490,10 @@ IntrusiveRefCntPtr<ASTReader> CompilerInstance::createPCHExternalASTSource(
     break;
   }
 
-  Context.setExternalSource(nullptr);
-#endif // HLSL Change Starts - no support for PCH
+  // HLSL Change - the failure is reported and the compilation abandoned; the
+  // HLSL source keeps the reader it multiplexes.
+  if (!Context.getLangOpts().HLSL)
+    Context.setExternalSource(nullptr);
   return nullptr;
 }
 
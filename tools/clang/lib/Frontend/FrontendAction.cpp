@@ -334,6 +334,20 @@ bool FrontendAction::BeginSourceFile(CompilerInstance &CI,
     if (!isModelParsingAction())
       CI.getASTContext().setASTMutationListener(Consumer->GetASTMutationListener());
 
+    // HLSL Change Begin - precompiled headers are supported, chained includes
+    // and the deserialized declaration dumpers are not.
+    if (!CI.getPreprocessorOpts().ImplicitPCHInclude.empty()) {
+      assert(hasPCHSupport() && "This action does not have PCH support!");
+      CI.createPCHExternalASTSource(
+          CI.getPreprocessorOpts().ImplicitPCHInclude,
+          CI.getPreprocessorOpts().DisablePCHValidation,
+          CI.getPreprocessorOpts().AllowPCHWithCompilerErrors,
+          Consumer->GetASTDeserializationListener(),
+          /*OwnDeserializationListener*/ false);
+      if (!CI.getModuleManager())
+        goto failure;
+    }
+    // HLSL Change End
 #if 0 // HLSL Change Starts - no support for AST serialization
     if (!CI.getPreprocessorOpts().ChainedIncludes.empty()) {
       // Convert headers to PCH and chain them.
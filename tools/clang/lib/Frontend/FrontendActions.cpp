@@ -81,8 +81,6 @@ DeclContextPrintAction::CreateASTConsumer(CompilerInstance &CI,
   return CreateDeclContextPrinter();
 }
 
-#if 0 // HLSL Change Starts - no support for modules or PCH
-
 std::unique_ptr<ASTConsumer>
 GeneratePCHAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
   std::string Sysroot;
@@ -123,7 +121,8 @@ raw_pwrite_stream *GeneratePCHAction::ComputeASTConsumerArguments(
   raw_pwrite_stream *OS =
       CI.createOutputFile(CI.getFrontendOpts().OutputFile, /*Binary=*/true,
                           /*RemoveFileOnSignal=*/false, InFile,
-                          /*Extension=*/"", /*useTemporary=*/true);
+                          /*Extension=*/"",
+                          /*useTemporary=*/!CI.WriteDefaultOutputDirectly); // HLSL Change
   if (!OS)
     return nullptr;
 
@@ -131,6 +130,8 @@ raw_pwrite_stream *GeneratePCHAction::ComputeASTConsumerArguments(
   return OS;
 }
 
+#if 0 // HLSL Change Starts - no support for modules
+
 std::unique_ptr<ASTConsumer>
 GenerateModuleAction::CreateASTConsumer(CompilerInstance &CI,
                                         StringRef InFile) {
@@ -24,6 +24,7 @@
 #include "clang/Sema/SemaConsumer.h"
 #include "clang/Sema/SemaHLSL.h" // HLSL Change
 #include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/TimeProfiler.h" // HLSL Change
 #include <cstdio>
 #include <memory>
 
@@ -133,6 +134,7 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
     External->StartTranslationUnit(Consumer);
 
   if (!S.getDiagnostics().hasUnrecoverableErrorOccurred()) {  // HLSL Change: Skip if fatal error already occurred
+    llvm::TimeTraceScope ParseScope("Parse"); // HLSL Change
     if (P.ParseTopLevelDecl(ADecl)) {
       if (!External && !S.getLangOpts().CPlusPlus)
         P.Diag(diag::ext_empty_translation_unit);
@@ -155,7 +157,10 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   // Provide the opportunity to generate translation-unit level validation
   // errors in the front-end, without relying on code generation being
   // available.
-  hlsl::DiagnoseTranslationUnit(&S);
+  {
+    llvm::TimeTraceScope SemaScope("SemaHLSL");
+    hlsl::DiagnoseTranslationUnit(&S);
+  }
   // HLSL Change Ends
   Consumer->HandleTranslationUnit(S.getASTContext());
 
@@ -749,32 +749,33 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
   if (spirvOptions.codeGenHighLevel) {
     beforeHlslLegalization = needsLegalization;
   } else {
-    // Run legalization passes
-    if (needsLegalization) {
+    // Run legalization and optimization passes back to back in one optimizer,
+    // so the module is only parsed and serialized once.
+    const bool needsOptimization =
+        theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0;
+    if (needsLegalization || needsOptimization) {
       std::string messages;
-      if (!spirvToolsLegalize(&m, &messages,
-                              &dsetbindingsToCombineImageSampler)) {
-        emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
-        emitNote("please file a bug report on "
-                 "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-                 "with source code if possible",
-                 {});
-        return;
-      } else if (!messages.empty()) {
-        emitWarning("SPIR-V legalization: %0", {}) << messages;
-      }
-    }
-
-    // Run optimization passes
-    if (theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0) {
-      std::string messages;
-      if (!spirvToolsOptimize(&m, &messages)) {
-        emitFatalError("failed to optimize SPIR-V: %0", {}) << messages;
+      bool invalidFlags = false;
+      if (!spirvToolsLegalizeAndOptimize(
+              &m, &messages, needsLegalization, needsOptimization,
+              &dsetbindingsToCombineImageSampler, &invalidFlags)) {
+        if (needsLegalization && !invalidFlags)
+          emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
+        else
+          emitFatalError("failed to optimize SPIR-V: %0", {}) << messages;
         emitNote("please file a bug report on "
                  "https://github.com/Microsoft/DirectXShaderCompiler/issues "
                  "with source code if possible",
                  {});
         return;
+      } else if (needsLegalization && !messages.empty()) {
+        // Messages from both pass lists come back together, so only say
+        // legalization when nothing else ran.
+        if (needsOptimization)
+          emitWarning("SPIR-V legalization and optimization: %0", {})
+              << messages;
+        else
+          emitWarning("SPIR-V legalization: %0", {}) << messages;
       }
     }
   }
@@ -12458,76 +12459,81 @@ bool SpirvEmitter::spirvToolsValidate(std::vector<uint32_t> *mod,
   return tools.Validate(mod->data(), mod->size(), options);
 }
 
-bool SpirvEmitter::spirvToolsOptimize(std::vector<uint32_t> *mod,
-                                      std::string *messages) {
-  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
-
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
-
-  spvtools::OptimizerOptions options;
-  options.set_run_validator(false);
-
+bool SpirvEmitter::spirvToolsRegisterOptimizationPasses(
+    spvtools::Optimizer *optimizer) {
   if (spirvOptions.optConfig.empty()) {
     // Add performance passes.
-    optimizer.RegisterPerformancePasses();
+    optimizer->RegisterPerformancePasses();
 
     // Add compact ID pass.
-    optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
-  } else {
-    // Command line options use llvm::SmallVector and llvm::StringRef, whereas
-    // SPIR-V optimizer uses std::vector and std::string.
-    std::vector<std::string> stdFlags;
-    for (const auto &f : spirvOptions.optConfig)
-      stdFlags.push_back(f.str());
-    if (!optimizer.RegisterPassesFromFlags(stdFlags))
-      return false;
+    optimizer->RegisterPass(spvtools::CreateCompactIdsPass());
+    return true;
   }
 
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
+  // Command line options use llvm::SmallVector and llvm::StringRef, whereas
+  // SPIR-V optimizer uses std::vector and std::string.
+  std::vector<std::string> stdFlags;
+  for (const auto &f : spirvOptions.optConfig)
+    stdFlags.push_back(f.str());
+  return optimizer->RegisterPassesFromFlags(stdFlags);
 }
 
-bool SpirvEmitter::spirvToolsLegalize(std::vector<uint32_t> *mod,
-                                      std::string *messages,
-                                      const std::vector<DescriptorSetAndBinding>
-                                          *dsetbindingsToCombineImageSampler) {
-  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
-
-  spvtools::OptimizerOptions options;
-  options.set_run_validator(false);
-  optimizer.RegisterLegalizationPasses();
+void SpirvEmitter::spirvToolsRegisterLegalizationPasses(
+    spvtools::Optimizer *optimizer,
+    const std::vector<DescriptorSetAndBinding>
+        *dsetbindingsToCombineImageSampler) {
+  optimizer->RegisterLegalizationPasses();
   // Add flattening of resources if needed.
   if (spirvOptions.flattenResourceArrays ||
       declIdMapper.requiresFlatteningCompositeResources()) {
-    optimizer.RegisterPass(spvtools::CreateDescriptorScalarReplacementPass());
+    optimizer->RegisterPass(spvtools::CreateDescriptorScalarReplacementPass());
     // ADCE should be run after desc_sroa in order to remove potentially
     // illegal types such as structures containing opaque types.
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer->RegisterPass(spvtools::CreateAggressiveDCEPass());
   }
   if (dsetbindingsToCombineImageSampler &&
       !dsetbindingsToCombineImageSampler->empty()) {
-    optimizer.RegisterPass(spvtools::CreateConvertToSampledImagePass(
+    optimizer->RegisterPass(spvtools::CreateConvertToSampledImagePass(
         *dsetbindingsToCombineImageSampler));
     // ADCE should be run after combining images and samplers in order to
     // remove potentially illegal types such as structures containing opaque
     // types.
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer->RegisterPass(spvtools::CreateAggressiveDCEPass());
   }
   if (spirvOptions.reduceLoadSize) {
     // The threshold must be bigger than 1.0 to reduce all possible loads.
-    optimizer.RegisterPass(spvtools::CreateReduceLoadSizePass(1.1));
+    optimizer->RegisterPass(spvtools::CreateReduceLoadSizePass(1.1));
     // ADCE should be run after reduce-load-size pass in order to remove
     // dead instructions.
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+    optimizer->RegisterPass(spvtools::CreateAggressiveDCEPass());
+  }
+  optimizer->RegisterPass(spvtools::CreateReplaceInvalidOpcodePass());
+  optimizer->RegisterPass(spvtools::CreateCompactIdsPass());
+}
+
+bool SpirvEmitter::spirvToolsLegalizeAndOptimize(
+    std::vector<uint32_t> *mod, std::string *messages, bool legalize,
+    bool optimize,
+    const std::vector<DescriptorSetAndBinding>
+        *dsetbindingsToCombineImageSampler,
+    bool *invalidFlags) {
+  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
+  optimizer.SetMessageConsumer(
+      [messages](spv_message_level_t /*level*/, const char * /*source*/,
+                 const spv_position_t & /*position*/,
+                 const char *message) { *messages += message; });
+
+  spvtools::OptimizerOptions options;
+  options.set_run_validator(false);
+
+  // Legalization passes must run before any optimization pass.
+  if (legalize)
+    spirvToolsRegisterLegalizationPasses(&optimizer,
+                                         dsetbindingsToCombineImageSampler);
+  if (optimize && !spirvToolsRegisterOptimizationPasses(&optimizer)) {
+    *invalidFlags = true;
+    return false;
   }
-  optimizer.RegisterPass(spvtools::CreateReplaceInvalidOpcodePass());
-  optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
 
   return optimizer.Run(mod->data(), mod->size(), mod, options);
 }
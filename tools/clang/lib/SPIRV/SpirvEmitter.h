@@ -36,6 +36,8 @@
 #include "DeclResultIdMapper.h"
 
 namespace spvtools {
+class Optimizer;
+
 namespace opt {
 
 // A struct for a pair of descriptor set and binding.
@@ -1039,22 +1041,32 @@ private:
                               const clang::FunctionDecl *,
                               bool isEntryFunction);
 
-  /// \brief Helper function to run SPIRV-Tools optimizer's performance passes.
-  /// Runs the SPIRV-Tools optimizer on the given SPIR-V module |mod|, and
-  /// gets the info/warning/error messages via |messages|.
+  /// \brief Helper function to add SPIRV-Tools optimizer's performance
+  /// passes, or the passes given by -Oconfig, to |optimizer|.
+  /// Returns false if the -Oconfig flags are invalid.
+  bool spirvToolsRegisterOptimizationPasses(spvtools::Optimizer *optimizer);
+
+  /// \brief Helper function to add SPIRV-Tools optimizer's legalization
+  /// passes to |optimizer|. If |dsetbindingsToCombineImageSampler| is not
+  /// empty, adds --convert-to-sampled-image pass.
+  void spirvToolsRegisterLegalizationPasses(
+      spvtools::Optimizer *optimizer,
+      const std::vector<spvtools::opt::DescriptorSetAndBinding>
+          *dsetbindingsToCombineImageSampler);
+
+  /// \brief Helper function to run SPIRV-Tools optimizer's legalization
+  /// passes if |legalize| is true, followed by its performance passes if
+  /// |optimize| is true. All passes run in a single optimizer, so the given
+  /// SPIR-V module |mod| is parsed and serialized only once. Gets the
+  /// info/warning/error messages via |messages|, and sets |invalidFlags| if
+  /// the -Oconfig flags could not be parsed.
   /// Returns true on success and false otherwise.
-  bool spirvToolsOptimize(std::vector<uint32_t> *mod, std::string *messages);
-
-  /// \brief Helper function to run SPIRV-Tools optimizer's legalization passes.
-  /// Runs the SPIRV-Tools legalization on the given SPIR-V module |mod|, and
-  /// gets the info/warning/error messages via |messages|. If
-  /// |dsetbindingsToCombineImageSampler| is not empty, runs
-  /// --convert-to-sampled-image pass.
-  /// Returns true on success and false otherwise.
-  bool
-  spirvToolsLegalize(std::vector<uint32_t> *mod, std::string *messages,
-                     const std::vector<spvtools::opt::DescriptorSetAndBinding>
-                         *dsetbindingsToCombineImageSampler);
+  bool spirvToolsLegalizeAndOptimize(
+      std::vector<uint32_t> *mod, std::string *messages, bool legalize,
+      bool optimize,
+      const std::vector<spvtools::opt::DescriptorSetAndBinding>
+          *dsetbindingsToCombineImageSampler,
+      bool *invalidFlags);
 
   /// \brief Helper function to run the SPIRV-Tools validator.
   /// Runs the SPIRV-Tools validator on the given SPIR-V module |mod|, and
@@ -12,6 +12,9 @@
 
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/SaveAndRestore.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/DeclCXX.h"
@@ -27,6 +30,7 @@
 #include "clang/Sema/Initialization.h"
 #include "clang/Sema/ExternalSemaSource.h"
 #include "clang/Sema/Lookup.h"
+#include "clang/Sema/MultiplexExternalSemaSource.h"
 #include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
 #include "clang/Sema/SemaHLSL.h"
@@ -42,6 +46,7 @@
 #include <array>
 #include <algorithm>
 #include <float.h>
+#include <unordered_map>
 
 enum ArBasicKind {
   AR_BASIC_BOOL,
@@ -2241,6 +2246,43 @@ class UsedIntrinsicStore : public std::set<UsedIntrinsic>
 {
 };
 
+/// <summary>
+/// Identifies a call to a global intrinsic by its name and the types of its
+/// arguments; calls with the same key resolve to the same declaration.
+/// </summary>
+class IntrinsicCallKey
+{
+public:
+  IntrinsicCallKey(const IdentifierInfo* name, bool isVkNamespace, ArrayRef<Expr *> args)
+    : m_name(name), m_isVkNamespace(isVkNamespace)
+  {
+    for (const Expr* arg : args) {
+      m_args.push_back(arg->getType().getAsOpaquePtr());
+    }
+  }
+
+  bool operator==(const IntrinsicCallKey& other) const
+  {
+    return m_name == other.m_name && m_isVkNamespace == other.m_isVkNamespace &&
+           m_args == other.m_args;
+  }
+
+  struct Hash
+  {
+    size_t operator()(const IntrinsicCallKey& key) const
+    {
+      return llvm::hash_combine(
+          key.m_name, key.m_isVkNamespace,
+          llvm::hash_combine_range(key.m_args.begin(), key.m_args.end()));
+    }
+  };
+
+private:
+  const IdentifierInfo* m_name;
+  bool m_isVkNamespace;
+  llvm::SmallVector<void*, 8> m_args;
+};
+
 static
 void GetIntrinsicMethods(ArBasicKind kind, _Outptr_result_buffer_(*intrinsicCount) const HLSL_INTRINSIC** intrinsics, _Out_ size_t* intrinsicCount)
 {
@@ -2450,79 +2492,68 @@ bool TemplateHasDefaultType(ArBasicKind kind)
   }
 }
 
+/// <summary>
+/// Intrinsics returned by each external intrinsic table for one object type and
+/// function name, in table order and in the order the table returns them.
+/// </summary>
+typedef std::vector<llvm::SmallVector<const HLSL_INTRINSIC*, 2> > ExtensionIntrinsicLookup;
+
 /// <summary>
 /// Use this class to iterate over intrinsic definitions that come from an external source.
 /// </summary>
 class IntrinsicTableDefIter
 {
 private:
-  StringRef _typeName;
-  StringRef _functionName;
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& _tables;
+  const ExtensionIntrinsicLookup* _lookup;
   const HLSL_INTRINSIC* _tableIntrinsic;
-  UINT64 _tableLookupCookie;
   unsigned _tableIndex;
+  unsigned _lookupIndex;
   unsigned _argCount;
   bool _firstChecked;
 
   IntrinsicTableDefIter(
     llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
-    StringRef typeName,
-    StringRef functionName,
+    const ExtensionIntrinsicLookup* lookup,
     unsigned argCount) :
-    _typeName(typeName), _functionName(functionName), _tables(tables),
-    _tableIntrinsic(nullptr), _tableLookupCookie(0), _tableIndex(0),
+    _tables(tables), _lookup(lookup),
+    _tableIntrinsic(nullptr), _tableIndex(0), _lookupIndex(0),
     _argCount(argCount), _firstChecked(false)
   {
   }
 
-  void CheckForIntrinsic() {
-    if (_tableIndex >= _tables.size()) {
-      return;
-    }
-
-    _firstChecked = true;
-
-    // TODO: review this - this will allocate at least once per string
-    CA2WEX<> typeName(_typeName.str().c_str(), CP_UTF8);
-    CA2WEX<> functionName(_functionName.str().c_str(), CP_UTF8);
-
-    if (FAILED(_tables[_tableIndex]->LookupIntrinsic(
-            typeName, functionName, &_tableIntrinsic, &_tableLookupCookie))) {
-      _tableLookupCookie = 0;
-      _tableIntrinsic = nullptr;
-    }
-  }
-
   void MoveToNext() {
-    for (;;) {
-      // If we don't have an intrinsic, try the following table.
-      if (_firstChecked && _tableIntrinsic == nullptr) {
-        _tableIndex++;
+    _firstChecked = true;
+    _tableIntrinsic = nullptr;
+    while (_tableIndex < _tables.size()) {
+      const auto &found = (*_lookup)[_tableIndex];
+      while (_lookupIndex < found.size()) {
+        const HLSL_INTRINSIC *pIntrinsic = found[_lookupIndex++];
+        if (pIntrinsic->uNumArgs == (_argCount + 1)) { // uNumArgs includes return
+          _tableIntrinsic = pIntrinsic;
+          return;
+        }
       }
-
-      CheckForIntrinsic();
-      if (_tableIndex == _tables.size() ||
-          (_tableIntrinsic != nullptr &&
-           _tableIntrinsic->uNumArgs ==
-               (_argCount + 1))) // uNumArgs includes return
-        break;
+      // No more intrinsics in this table; try the following one.
+      _tableIndex++;
+      _lookupIndex = 0;
     }
   }
 
 public:
   static IntrinsicTableDefIter CreateStart(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
-    StringRef typeName,
-    StringRef functionName,
+    const ExtensionIntrinsicLookup* lookup,
     unsigned argCount)
   {
-    IntrinsicTableDefIter result(tables, typeName, functionName, argCount);
+    DXASSERT(tables.empty() || (lookup != nullptr && lookup->size() == tables.size()),
+             "otherwise lookup was not made against every table");
+    IntrinsicTableDefIter result(tables, lookup, argCount);
     return result;
   }
 
   static IntrinsicTableDefIter CreateEnd(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables)
   {
-    IntrinsicTableDefIter result(tables, StringRef(), StringRef(), 0);
+    IntrinsicTableDefIter result(tables, nullptr, 0);
     result._tableIndex = tables.size();
     return result;
   }
@@ -2991,7 +3022,7 @@ TypedefDecl *CreateGlobalTypedef(ASTContext* context, const char* ident, QualTyp
   return decl;
 }
 
-class HLSLExternalSource : public ExternalSemaSource {
+class HLSLExternalSource : public MultiplexExternalSemaSource {
 private:
   // Inner types.
   struct FindStructBasicTypeResult {
@@ -3020,6 +3051,12 @@ private:
   // Semantic analyzer being processed.
   Sema* m_sema;
 
+  // Whether an AST file is loaded into the context. Its built-in declarations
+  // are used rather than declaring them again.
+  bool m_hasASTFile;
+  // Reader of the AST file, which this source multiplexes.
+  IntrusiveRefCntPtr<ExternalSemaSource> m_astFileReader;
+
   // Intrinsic tables available externally.
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
 
@@ -3047,15 +3084,28 @@ private:
   TypedefDecl* m_hlslStringTypedef;
 
   // Built-in object types declarations, indexed by basic kind constant.
+  // Declarations are created on first use, see GetObjectTypeDecl.
   CXXRecordDecl* m_objectTypeDecls[_countof(g_ArBasicKindsAsTypes)];
   // Map from object decl to the object index.
-  using ObjectTypeDeclMapType = std::array<std::pair<CXXRecordDecl*,unsigned>, _countof(g_ArBasicKindsAsTypes)+_countof(g_DeprecatedEffectObjectNames)>;
-  ObjectTypeDeclMapType m_objectTypeDeclsMap;
+  llvm::DenseMap<const CXXRecordDecl*, unsigned> m_objectTypeDeclsMap;
   // Mask for object which not has methods created.
   uint64_t m_objectTypeLazyInitMask;
+  // Alias for SamplerState, created on first use.
+  TypedefDecl* m_samplerTypedef;
+  // Whether a built-in declaration is being made. Adding it to the
+  // translation unit looks its name up, which must not declare it again.
+  bool m_declaringBuiltin;
 
   UsedIntrinsicStore m_usedIntrinsics;
 
+  // Positions of the entries in each built-in intrinsic table, by name.
+  typedef llvm::StringMap<llvm::SmallVector<unsigned, 4> > IntrinsicNameIndex;
+  llvm::DenseMap<const HLSL_INTRINSIC*, std::unique_ptr<IntrinsicNameIndex> > m_intrinsicNameIndices;
+  // Intrinsics found in the external tables, by type and function name.
+  llvm::StringMap<ExtensionIntrinsicLookup> m_extensionIntrinsicLookups;
+  // Global intrinsic calls already resolved to a declaration.
+  std::unordered_map<IntrinsicCallKey, FunctionDecl*, IntrinsicCallKey::Hash> m_resolvedIntrinsicCalls;
+
   /// <summary>Add all base QualTypes for each hlsl scalar types.</summary>
   void AddBaseTypes();
 
@@ -3420,22 +3470,109 @@ private:
     }
   }
 
-  static bool ObjectTypeDeclMapTypeCmp(const std::pair<CXXRecordDecl*,unsigned> &a,
-                           const std::pair<CXXRecordDecl*,unsigned> &b) {
-    return a.first < b.first;
-  };
-
   int FindObjectBasicKindIndex(const CXXRecordDecl* recordDecl) {
-    auto begin = m_objectTypeDeclsMap.begin();
-    auto end = m_objectTypeDeclsMap.end();
-    auto val = std::make_pair(const_cast<CXXRecordDecl*>(recordDecl), 0);
-    auto low = std::lower_bound(begin, end, val, ObjectTypeDeclMapTypeCmp);
-    if (low == end)
-      return -1;
-    if (recordDecl == low->first)
-      return low->second;
-    else
+    auto it = m_objectTypeDeclsMap.find(recordDecl);
+    if (it == m_objectTypeDeclsMap.end()) {
+      // An object type from an AST file is known once it is first declared.
+      if (m_hasASTFile && recordDecl->isFromASTFile() &&
+          recordDecl->isImplicit() && recordDecl->getIdentifier()) {
+        int index = FindObjectTypeIndexByName(recordDecl->getName());
+        if (index >= 0 && m_objectTypeDecls[index] == nullptr &&
+            GetObjectTypeDecl(index) == recordDecl)
+          return index;
+      }
       return -1;
+    }
+    return it->second;
+  }
+
+  // Returns the implicit declaration of the given kind that the loaded AST
+  // file made at translation unit scope with the given name, if any.
+  NamedDecl* FindBuiltinDeclFromASTFile(DeclarationName name, Decl::Kind kind)
+  {
+    if (!m_hasASTFile)
+      return nullptr;
+    for (NamedDecl *decl : m_context->getTranslationUnitDecl()->lookup(name)) {
+      if (decl->isFromASTFile() && decl->isImplicit() && decl->getKind() == kind)
+        return decl;
+    }
+    return nullptr;
+  }
+
+  NamedDecl* FindBuiltinDeclFromASTFile(StringRef name, Decl::Kind kind)
+  {
+    return FindBuiltinDeclFromASTFile(
+        DeclarationName(&m_context->Idents.get(name)), kind);
+  }
+
+  // Drops the built-in declarations made up front for this context in favor
+  // of the ones the AST file made for the context it was written from, which
+  // the declarations in the file refer to.
+  void AdoptDeclsFromASTFile()
+  {
+    TranslationUnitDecl *tu = m_context->getTranslationUnitDecl();
+    SmallVector<NamedDecl *, 64> builtins;
+    for (Decl *decl : tu->noload_decls()) {
+      NamedDecl *namedDecl = dyn_cast<NamedDecl>(decl);
+      if (namedDecl != nullptr && namedDecl->isImplicit() &&
+          namedDecl->getDeclName())
+        builtins.push_back(namedDecl);
+    }
+
+    for (NamedDecl *decl : builtins) {
+      DeclContext::lookup_result lookup = tu->lookup(decl->getDeclName());
+      if (std::find(lookup.begin(), lookup.end(), decl) == lookup.end())
+        continue;
+      NamedDecl *fromFile =
+          FindBuiltinDeclFromASTFile(decl->getDeclName(), decl->getKind());
+      if (fromFile == nullptr)
+        continue;
+      tu->removeDecl(decl);
+      if (decl == m_vectorTemplateDecl) {
+        m_vectorTemplateDecl = cast<ClassTemplateDecl>(fromFile);
+      } else if (decl == m_matrixTemplateDecl) {
+        m_matrixTemplateDecl = cast<ClassTemplateDecl>(fromFile);
+      } else if (CXXRecordDecl *recordDecl = dyn_cast<CXXRecordDecl>(decl)) {
+        auto it = m_objectTypeDeclsMap.find(recordDecl);
+        if (it != m_objectTypeDeclsMap.end()) {
+          unsigned index = it->second;
+          m_objectTypeDeclsMap.erase(it);
+          m_objectTypeDeclsMap[cast<CXXRecordDecl>(fromFile)] = index;
+        }
+      }
+    }
+
+    // Vectors and matrices looked up so far specialize the dropped templates.
+    for (unsigned i = 0; i < HLSLScalarTypeCount; i++) {
+      for (unsigned row = 0; row < 4; row++) {
+        m_vectorTypes[i][row] = QualType();
+        m_vectorTypedefs[i][row] = nullptr;
+        for (unsigned col = 0; col < 4; col++) {
+          m_matrixTypes[i][row][col] = QualType();
+          m_matrixShorthandTypes[i][row][col] = nullptr;
+        }
+      }
+    }
+  }
+
+  // Returns the declaration of the built-in object type at index i that the
+  // loaded AST file made, or null if it has none.
+  CXXRecordDecl* FindObjectTypeDeclFromASTFile(unsigned i)
+  {
+    const char* typeName = g_ArBasicTypeNames[g_ArBasicKindsAsTypes[i]];
+    if (NamedDecl *decl = FindBuiltinDeclFromASTFile(typeName, Decl::ClassTemplate))
+      return cast<ClassTemplateDecl>(decl)->getTemplatedDecl();
+    return cast_or_null<CXXRecordDecl>(
+        FindBuiltinDeclFromASTFile(typeName, Decl::CXXRecord));
+  }
+
+  // Returns the typedef the loaded AST file made with the given name, or
+  // declares it.
+  TypedefDecl* GetOrCreateGlobalTypedef(const char* ident, QualType baseType)
+  {
+    if (NamedDecl *decl = FindBuiltinDeclFromASTFile(ident, Decl::Typedef))
+      return cast<TypedefDecl>(decl);
+    return CreateGlobalTypedef(m_context, ident, baseType);
   }
 
 
@@ -3496,128 +3633,190 @@ private:
   }
 #endif // ENABLE_SPIRV_CODEGEN
 
-  // Adds all built-in HLSL object types.
+  // Adds the built-in HLSL object types that are not declared on demand.
   void AddObjectTypes()
   {
     DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
 
-    QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
-    TypeSourceInfo *float4TypeSourceInfo = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
     m_objectTypeLazyInitMask = 0;
-    unsigned effectKindIndex = 0;
-    for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++)
-    {
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
-        continue;
-      }
-      if (kind == AR_OBJECT_LEGACY_EFFECT)
-        effectKindIndex = i;
-
-      DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
-      _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
-      const char* typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      CXXRecordDecl* recordDecl = nullptr;
-      if (kind == AR_OBJECT_RAY_DESC) {
-        QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
-        recordDecl = CreateRayDescStruct(*m_context, float3Ty);
-      } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
-        QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
-        recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
-      } else if (IsSubobjectBasicKind(kind)) {
-        switch (kind) {
-        case AR_OBJECT_STATE_OBJECT_CONFIG:
-          recordDecl = CreateSubobjectStateObjectConfig(*m_context);
-          break;
-        case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, true);
-          break;
-        case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, false);
-          break;
-        case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
-          recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
-          recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
-          recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
-          break;
-        case AR_OBJECT_TRIANGLE_HIT_GROUP:
-          recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
-          break;
-        case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
-          recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG1:
-          recordDecl = CreateSubobjectRaytracingPipelineConfig1(*m_context);
+    unsigned effectKindIndex = std::find(g_ArBasicKindsAsTypes,
+        &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)],
+        AR_OBJECT_LEGACY_EFFECT) - g_ArBasicKindsAsTypes;
+
+    // Create decls for each deprecated effect object type:
+    DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
+    for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
+      IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
+      CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
+      currentDeclContext->addDecl(effectObjDecl);
+      effectObjDecl->setImplicit(true);
+      m_objectTypeDeclsMap[effectObjDecl] = effectKindIndex;
+    }
+  }
+
+  // Returns the declaration for the built-in object type at index i of
+  // g_ArBasicKindsAsTypes, declaring it on first use. Most shaders only
+  // reference a handful of the object types, so they are not all declared
+  // up front.
+  CXXRecordDecl* GetObjectTypeDecl(unsigned i)
+  {
+    DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
+    DXASSERT_NOMSG(i < _countof(g_ArBasicKindsAsTypes));
+    if (m_objectTypeDecls[i] != nullptr)
+      return m_objectTypeDecls[i];
+
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
+      return nullptr;
+    }
+
+    DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
+    _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
+
+    llvm::SaveAndRestore<bool> declaringBuiltin(m_declaringBuiltin, true);
+
+    // Reuse the declaration from an AST file, along with its methods if the
+    // file was written after they were added.
+    if (CXXRecordDecl *fromFile = FindObjectTypeDeclFromASTFile(i)) {
+      m_objectTypeDecls[i] = fromFile;
+      m_objectTypeDeclsMap[fromFile] = i;
+      bool hasMethods = false;
+      for (Decl *member : fromFile->decls()) {
+        if (isa<CXXMethodDecl>(member) || isa<FunctionTemplateDecl>(member)) {
+          hasMethods = true;
           break;
         }
-      } else if (kind == AR_OBJECT_CONSTANT_BUFFER) {
-        recordDecl = DeclareConstantBufferViewType(*m_context, /*bTBuf*/false);
-      } else if (kind == AR_OBJECT_TEXTURE_BUFFER) {
-        recordDecl = DeclareConstantBufferViewType(*m_context, /*bTBuf*/true);
-      } else if (kind == AR_OBJECT_RAY_QUERY) {
-        recordDecl = DeclareRayQueryType(*m_context);
-      } else if (kind == AR_OBJECT_HEAP_RESOURCE) {
-        recordDecl = DeclareResourceType(*m_context, /*bSampler*/false);
-        // create Resource ResourceDescriptorHeap;
-        DeclareBuiltinGlobal("ResourceDescriptorHeap",
-                             m_context->getRecordType(recordDecl), *m_context);
-      } else if (kind == AR_OBJECT_HEAP_SAMPLER) {
-        recordDecl = DeclareResourceType(*m_context, /*bSampler*/true);
-        // create Resource SamplerDescriptorHeap;
-        DeclareBuiltinGlobal("SamplerDescriptorHeap",
-                             m_context->getRecordType(recordDecl), *m_context);
-
-      }
-      else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D) {
-        recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2D", "kind");
-      }
-      else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D_ARRAY) {
-        recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2DArray", "kind");
-      }
-      else if (templateArgCount == 0) {
-        recordDecl = DeclareRecordTypeWithHandle(*m_context, typeName);
       }
-      else
-      {
-        DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+      if (!hasMethods) {
+        m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+        for (auto && intrinsic : m_intrinsicTables) {
+          AddIntrinsicTableMethods(intrinsic, i);
+        }
+      }
+      return fromFile;
+    }
+
+    const char* typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    CXXRecordDecl* recordDecl = nullptr;
+    if (kind == AR_OBJECT_RAY_DESC) {
+      QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
+      recordDecl = CreateRayDescStruct(*m_context, float3Ty);
+    } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
+      QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
+      recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
+    } else if (IsSubobjectBasicKind(kind)) {
+      switch (kind) {
+      case AR_OBJECT_STATE_OBJECT_CONFIG:
+        recordDecl = CreateSubobjectStateObjectConfig(*m_context);
+        break;
+      case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, true);
+        break;
+      case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, false);
+        break;
+      case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
+        recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
+        recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
+        recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
+        break;
+      case AR_OBJECT_TRIANGLE_HIT_GROUP:
+        recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
+        break;
+      case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
+        recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG1:
+        recordDecl = CreateSubobjectRaytracingPipelineConfig1(*m_context);
+        break;
+      }
+    } else if (kind == AR_OBJECT_CONSTANT_BUFFER) {
+      recordDecl = DeclareConstantBufferViewType(*m_context, /*bTBuf*/false);
+    } else if (kind == AR_OBJECT_TEXTURE_BUFFER) {
+      recordDecl = DeclareConstantBufferViewType(*m_context, /*bTBuf*/true);
+    } else if (kind == AR_OBJECT_RAY_QUERY) {
+      recordDecl = DeclareRayQueryType(*m_context);
+    } else if (kind == AR_OBJECT_HEAP_RESOURCE) {
+      recordDecl = DeclareResourceType(*m_context, /*bSampler*/false);
+      // create Resource ResourceDescriptorHeap;
+      DeclareBuiltinGlobal("ResourceDescriptorHeap",
+                           m_context->getRecordType(recordDecl), *m_context);
+    } else if (kind == AR_OBJECT_HEAP_SAMPLER) {
+      recordDecl = DeclareResourceType(*m_context, /*bSampler*/true);
+      // create Resource SamplerDescriptorHeap;
+      DeclareBuiltinGlobal("SamplerDescriptorHeap",
+                           m_context->getRecordType(recordDecl), *m_context);
+
+    }
+    else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D) {
+      recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2D", "kind");
+    }
+    else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D_ARRAY) {
+      recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2DArray", "kind");
+    }
+    else if (templateArgCount == 0) {
+      recordDecl = DeclareRecordTypeWithHandle(*m_context, typeName);
+    }
+    else
+    {
+      DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
 
-        TypeSourceInfo* typeDefault = TemplateHasDefaultType(kind) ? float4TypeSourceInfo : nullptr;
-        recordDecl = DeclareTemplateTypeWithHandle(*m_context, typeName, templateArgCount, typeDefault);
+      TypeSourceInfo* typeDefault = nullptr;
+      if (TemplateHasDefaultType(kind)) {
+        QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
+        typeDefault = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
       }
-      m_objectTypeDecls[i] = recordDecl;
-      m_objectTypeDeclsMap[i] = std::make_pair(recordDecl, i);
-      m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+      recordDecl = DeclareTemplateTypeWithHandle(*m_context, typeName, templateArgCount, typeDefault);
     }
+    m_objectTypeDecls[i] = recordDecl;
+    m_objectTypeDeclsMap[recordDecl] = i;
+    m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
 
-    // Create an alias for SamplerState. 'sampler' is very commonly used.
-    {
+    for (auto && intrinsic : m_intrinsicTables) {
+      AddIntrinsicTableMethods(intrinsic, i);
+    }
+    return recordDecl;
+  }
+
+  // Returns the index in g_ArBasicKindsAsTypes of the object type declared
+  // with the given name, or -1 if there is none.
+  static int FindObjectTypeIndexByName(StringRef name)
+  {
+    for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+      if (kind == AR_OBJECT_WAVE)
+        continue;
+      if (name == g_ArBasicTypeNames[kind])
+        return i;
+    }
+    // Built-in globals declared with their object type.
+    if (name == "ResourceDescriptorHeap")
+      return FindObjectTypeIndexByName(g_ArBasicTypeNames[AR_OBJECT_HEAP_RESOURCE]);
+    if (name == "SamplerDescriptorHeap")
+      return FindObjectTypeIndexByName(g_ArBasicTypeNames[AR_OBJECT_HEAP_SAMPLER]);
+    return -1;
+  }
+
+  // Create an alias for SamplerState. 'sampler' is very commonly used.
+  TypedefDecl* GetSamplerTypedef()
+  {
+    if (m_samplerTypedef == nullptr) {
+      llvm::SaveAndRestore<bool> declaringBuiltin(m_declaringBuiltin, true);
+      if (NamedDecl *fromFile = FindBuiltinDeclFromASTFile("sampler", Decl::Typedef))
+        return m_samplerTypedef = cast<TypedefDecl>(fromFile);
       DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
       IdentifierInfo& samplerId = m_context->Idents.get(StringRef("sampler"), tok::TokenKind::identifier);
       TypeSourceInfo* samplerTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_SAMPLER));
-      TypedefDecl* samplerDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
-      currentDeclContext->addDecl(samplerDecl);
-      samplerDecl->setImplicit(true);
-
-      // Create decls for each deprecated effect object type:
-      unsigned effectObjBase = _countof(g_ArBasicKindsAsTypes);
-      // TypeSourceInfo* effectObjTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_LEGACY_EFFECT));
-      for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
-        IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
-        //TypedefDecl* effectObjDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &idInfo, effectObjTypeSource);
-        CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
-        currentDeclContext->addDecl(effectObjDecl);
-        effectObjDecl->setImplicit(true);
-        m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
-      }
+      m_samplerTypedef = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
+      currentDeclContext->addDecl(m_samplerTypedef);
+      m_samplerTypedef->setImplicit(true);
     }
-
-    // Make sure it's in order.
-    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
+    return m_samplerTypedef;
   }
 
   FunctionDecl* AddSubscriptSpecialization(
@@ -3643,6 +3842,14 @@ private:
                    rowCount <= 4 && colCount <= 4);
     TypedefDecl *qts =
         m_matrixShorthandTypes[scalarType][rowCount - 1][colCount - 1];
+    if (qts == nullptr && m_hasASTFile) {
+      char typeName[64];
+      sprintf_s(typeName, _countof(typeName), "%s%ux%u",
+                HLSLScalarTypeNames[scalarType], rowCount, colCount);
+      qts = cast_or_null<TypedefDecl>(
+          FindBuiltinDeclFromASTFile(typeName, Decl::Typedef));
+      m_matrixShorthandTypes[scalarType][rowCount - 1][colCount - 1] = qts;
+    }
     if (qts == nullptr) {
       QualType type = LookupMatrixType(scalarType, rowCount, colCount);
       qts = CreateMatrixSpecializationShorthand(*m_context, type, scalarType,
@@ -3656,6 +3863,14 @@ private:
     DXASSERT_NOMSG(scalarType != HLSLScalarType::HLSLScalarType_unknown &&
                    colCount <= 4);
     TypedefDecl *qts = m_vectorTypedefs[scalarType][colCount - 1];
+    if (qts == nullptr && m_hasASTFile) {
+      char typeName[64];
+      sprintf_s(typeName, _countof(typeName), "%s%u",
+                HLSLScalarTypeNames[scalarType], colCount);
+      qts = cast_or_null<TypedefDecl>(
+          FindBuiltinDeclFromASTFile(typeName, Decl::Typedef));
+      m_vectorTypedefs[scalarType][colCount - 1] = qts;
+    }
     if (qts == nullptr) {
       QualType type = LookupVectorType(scalarType, colCount);
       qts = CreateVectorSpecializationShorthand(*m_context, type, scalarType,
@@ -3673,8 +3888,12 @@ public:
     m_vkNSDecl(nullptr),
     m_context(nullptr),
     m_sema(nullptr),
-    m_hlslStringTypedef(nullptr)
+    m_hasASTFile(false),
+    m_hlslStringTypedef(nullptr),
+    m_samplerTypedef(nullptr),
+    m_declaringBuiltin(false)
   {
+    memset(m_objectTypeDecls, 0, sizeof(m_objectTypeDecls));
     memset(m_matrixTypes, 0, sizeof(m_matrixTypes));
     memset(m_matrixShorthandTypes, 0, sizeof(m_matrixShorthandTypes));
     memset(m_vectorTypes, 0, sizeof(m_vectorTypes));
@@ -3702,12 +3921,14 @@ public:
     auto &context = S.getASTContext();
     m_sema = &S;
     S.addExternalSource(this);
+    MultiplexExternalSemaSource::InitializeSema(S);
+
+    // Lookups into the translation unit ask this source for built-in object
+    // types that haven't been declared yet.
+    context.getTranslationUnitDecl()->setHasExternalVisibleStorage(true);
 
     AddObjectTypes();
     AddStdIsEqualImplementation(context, S);
-    for (auto && intrinsic : m_intrinsicTables) {
-      AddIntrinsicTableMethods(intrinsic);
-    }
 
 #ifdef ENABLE_SPIRV_CODEGEN
     if (m_sema->getLangOpts().SPIRV) {
@@ -3724,13 +3945,25 @@ public:
       AddVkIntrinsicConstants();
     }
 #endif // ENABLE_SPIRV_CODEGEN
+
+    if (m_hasASTFile)
+      AdoptDeclsFromASTFile();
   }
 
   void ForgetSema() override
   {
+    MultiplexExternalSemaSource::ForgetSema();
     m_sema = nullptr;
   }
 
+  void AttachASTFileReader(ExternalSemaSource *reader)
+  {
+    DXASSERT(m_sema == nullptr, "otherwise the AST file is attached too late");
+    m_astFileReader = reader;
+    m_hasASTFile = true;
+    addSource(*reader);
+  }
+
   Sema* getSema() {
     return m_sema;
   }
@@ -3740,7 +3973,7 @@ public:
     // For built in scalar types, this funciton may be called for
     // TypoCorrection. In that case, we return a nullptr.
     if (m_scalarTypes[scalarType].isNull()) {
-      m_scalarTypeDefs[scalarType] = CreateGlobalTypedef(m_context, HLSLScalarTypeNames[scalarType], m_baseTypes[scalarType]);
+      m_scalarTypeDefs[scalarType] = GetOrCreateGlobalTypedef(HLSLScalarTypeNames[scalarType], m_baseTypes[scalarType]);
       m_scalarTypes[scalarType] = m_context->getTypeDeclType(m_scalarTypeDefs[scalarType]);
     }
     return m_scalarTypeDefs[scalarType];
@@ -3775,7 +4008,7 @@ public:
 
   TypedefDecl* GetStringTypedef() {
     if (m_hlslStringTypedef == nullptr) {
-      m_hlslStringTypedef = CreateGlobalTypedef(m_context, "string", m_hlslStringType);
+      m_hlslStringTypedef = GetOrCreateGlobalTypedef("string", m_hlslStringType);
       m_hlslStringType = m_context->getTypeDeclType(m_hlslStringTypedef);
     }
     DXASSERT_NOMSG(m_hlslStringTypedef != nullptr);
@@ -3908,6 +4141,55 @@ public:
     return false;
   }
 
+  // Declares the built-in object type, global or typedef with the given name
+  // if it hasn't been declared yet. Returns true if a declaration was made.
+  bool DeclareBuiltinByName(StringRef name)
+  {
+    int index = FindObjectTypeIndexByName(name);
+    if (index >= 0) {
+      if (m_objectTypeDecls[index] != nullptr)
+        return false;
+      return GetObjectTypeDecl(index) != nullptr;
+    }
+    if (name == "sampler" && m_samplerTypedef == nullptr)
+      return GetSamplerTypedef() != nullptr;
+    return false;
+  }
+
+  // Built-in object types are declared the first time their name is looked up
+  // in the translation unit, by qualified or unqualified lookup.
+  bool FindExternalVisibleDeclsByName(const DeclContext *DC,
+                                      DeclarationName Name) override
+  {
+    bool found = MultiplexExternalSemaSource::FindExternalVisibleDeclsByName(DC, Name);
+    // Currently template instantiation is blocked when a fatal error is
+    // detected. So no faulting-in types at this point.
+    if (m_declaringBuiltin || m_sema == nullptr ||
+        m_sema->Diags.hasFatalErrorOccurred() ||
+        !DC->isTranslationUnit() || !Name.isIdentifier()) {
+      return found;
+    }
+    if (DeclareBuiltinByName(Name.getAsIdentifierInfo()->getName()))
+      found = true;
+    return found;
+  }
+
+  // Code completion and typo correction enumerate every visible declaration
+  // in the translation unit, so all the built-in object types are declared.
+  void completeVisibleDeclsMap(const DeclContext *DC) override
+  {
+    MultiplexExternalSemaSource::completeVisibleDeclsMap(DC);
+    if (m_declaringBuiltin || m_sema == nullptr ||
+        m_sema->Diags.hasFatalErrorOccurred() || !DC->isTranslationUnit()) {
+      return;
+    }
+    for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+      if (g_ArBasicKindsAsTypes[i] != AR_OBJECT_WAVE)
+        GetObjectTypeDecl(i);
+    }
+    GetSamplerTypedef();
+  }
+
   /// <summary>
   /// Determines whether the specify record type is a matrix, another HLSL object, or a user-defined structure.
   /// </sumary>
@@ -4141,40 +4423,46 @@ public:
     DXASSERT_NOMSG(table != nullptr);
 
     // Function intrinsics are added on-demand, objects get template methods.
+    // Objects declared later get them from GetObjectTypeDecl.
     for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
-      // Grab information already processed by AddObjectTypes.
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      const char *typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
-      int startDepth = (templateArgCount == 0) ? 0 : 1;
-      CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
-      if (recordDecl == nullptr) {
-        DXASSERT(kind == AR_OBJECT_WAVE, "else objects other than reserved not initialized");
-        continue;
-      }
+      if (m_objectTypeDecls[i] != nullptr)
+        AddIntrinsicTableMethods(table, i);
+    }
+  }
 
-      // This is a variation of AddObjectMethods using the new table.
-      const HLSL_INTRINSIC *pIntrinsic = nullptr;
-      const HLSL_INTRINSIC *pPrior = nullptr;
-      UINT64 lookupCookie = 0;
-      CA2W wideTypeName(typeName, CP_UTF8);
-      HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      while (pIntrinsic != nullptr && SUCCEEDED(found)) {
-        if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
-          AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
-          // NOTE: this only works with the current implementation because
-          // intrinsics are alive as long as the table is alive.
-          pPrior = pIntrinsic;
-        }
-        found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table, unsigned i) {
+    // Grab information already processed by GetObjectTypeDecl.
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    const char *typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
+    int startDepth = (templateArgCount == 0) ? 0 : 1;
+    CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
+    DXASSERT_NOMSG(recordDecl != nullptr);
+
+    // This is a variation of AddObjectMethods using the new table.
+    const HLSL_INTRINSIC *pIntrinsic = nullptr;
+    const HLSL_INTRINSIC *pPrior = nullptr;
+    UINT64 lookupCookie = 0;
+    CA2W wideTypeName(typeName, CP_UTF8);
+    HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    while (pIntrinsic != nullptr && SUCCEEDED(found)) {
+      if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
+        AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
+        // NOTE: this only works with the current implementation because
+        // intrinsics are alive as long as the table is alive.
+        pPrior = pIntrinsic;
       }
+      found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
     }
   }
 
   void RegisterIntrinsicTable(_In_ IDxcIntrinsicTable *table) {
     DXASSERT_NOMSG(table != nullptr);
     m_intrinsicTables.push_back(table);
+    // Earlier lookups did not see this table.
+    m_extensionIntrinsicLookups.clear();
+    m_resolvedIntrinsicCalls.clear();
     // If already initialized, add methods immediately.
     if (m_sema != nullptr) {
       AddIntrinsicTableMethods(table);
@@ -4300,7 +4588,7 @@ public:
         const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
         DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
         size_t index = match - g_ArBasicKindsAsTypes;
-        return m_context->getTagDeclType(this->m_objectTypeDecls[index]);
+        return m_context->getTagDeclType(GetObjectTypeDecl(index));
     }
 
     case AR_OBJECT_SAMPLER1D:
@@ -4417,6 +4705,61 @@ public:
     _In_ const HLSL_INTRINSIC *pIntrinsic,
     _In_ QualType objectElement);
 
+  /// <summary>Returns the positions of the entries in a built-in intrinsic table that have the given name.</summary>
+  /// <remarks>The index for a table is built the first time the table is searched.</remarks>
+  ArrayRef<unsigned> FindIntrinsicsByName(
+    _In_count_(tableSize) const HLSL_INTRINSIC* table,
+    size_t tableSize,
+    StringRef nameIdentifier)
+  {
+    std::unique_ptr<IntrinsicNameIndex> &index = m_intrinsicNameIndices[table];
+    if (!index) {
+      index.reset(new IntrinsicNameIndex());
+      for (unsigned i = 0; i < tableSize; i++) {
+        (*index)[table[i].pArgs[0].pName].push_back(i);
+      }
+    }
+
+    IntrinsicNameIndex::const_iterator found = index->find(nameIdentifier);
+    if (found == index->end()) {
+      return ArrayRef<unsigned>();
+    }
+    return found->getValue();
+  }
+
+  /// <summary>Returns the intrinsics with the given name found in each external intrinsic table.</summary>
+  /// <remarks>Tables are asked once per type and function name; the results are kept for the translation unit.</remarks>
+  const ExtensionIntrinsicLookup* LookupExtensionIntrinsics(
+    StringRef typeName,
+    StringRef nameIdentifier)
+  {
+    if (m_intrinsicTables.empty()) {
+      return nullptr;
+    }
+
+    SmallString<64> key(typeName);
+    key += "::";
+    key += nameIdentifier;
+    ExtensionIntrinsicLookup &lookup = m_extensionIntrinsicLookups[key];
+    if (!lookup.empty()) {
+      return &lookup;
+    }
+
+    lookup.resize(m_intrinsicTables.size());
+    CA2WEX<> wideTypeName(typeName.str().c_str(), CP_UTF8);
+    CA2WEX<> wideFunctionName(nameIdentifier.str().c_str(), CP_UTF8);
+    for (size_t i = 0; i < m_intrinsicTables.size(); i++) {
+      const HLSL_INTRINSIC* pIntrinsic = nullptr;
+      UINT64 lookupCookie = 0;
+      while (SUCCEEDED(m_intrinsicTables[i]->LookupIntrinsic(
+                 wideTypeName, wideFunctionName, &pIntrinsic, &lookupCookie)) &&
+             pIntrinsic != nullptr) {
+        lookup[i].push_back(pIntrinsic);
+      }
+    }
+    return &lookup;
+  }
+
   // Returns the iterator with the first entry that matches the requirement
   IntrinsicDefIter FindIntrinsicByNameAndArgCount(
     _In_count_(tableSize) const HLSL_INTRINSIC* table,
@@ -4425,33 +4768,22 @@ public:
     StringRef nameIdentifier,
     size_t argumentCount)
   {
-    // This is implemented by a linear scan for now.
-    // We tested binary search on tables, and there was no performance gain on
-    // samples probably for the following reasons.
-    // 1. The tables are not big enough to make noticable difference
-    // 2. The user of this function assumes that it returns the first entry in
-    // the table that matches name and argument count. So even in the binary
-    // search, we have to scan backwards until the entry does not match the name
-    // or arg count. For linear search this is not a problem
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+    IntrinsicTableDefIter tableIter = IntrinsicTableDefIter::CreateStart(
+      m_intrinsicTables, LookupExtensionIntrinsics(typeName, nameIdentifier),
+      argumentCount);
 
-      const bool isVariadicFn = IsVariadicIntrinsicFunction(pIntrinsic);
-
-      // Do some quick checks to verify size and name.
-      if (!isVariadicFn && pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
-      }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
+    // Only the entries with a matching name are checked; they are visited in
+    // table order, so the first one with a matching argument count is the
+    // first entry in the table that matches both.
+    for (unsigned i : FindIntrinsicsByName(table, tableSize, nameIdentifier)) {
+      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+      if (IsVariadicIntrinsicFunction(pIntrinsic) ||
+          pIntrinsic->uNumArgs == 1 + argumentCount) {
+        return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic, tableIter);
       }
-
-      return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
     }
 
-    return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize,
-      IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
+    return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize, tableIter);
   }
 
   bool AddOverloadedCallCandidates(
@@ -4497,6 +4829,26 @@ public:
     }
 #endif // ENABLE_SPIRV_CODEGEN
 
+    // Calls with the same argument types resolve to the same overload, unless
+    // a literal argument is involved, whose concrete type depends on its value.
+    IntrinsicCallKey callKey(idInfo, isVkNamespace, Args);
+    bool cacheable = std::none_of(Args.begin(), Args.end(), [this](Expr *arg) {
+      ArBasicKind kind = GetTypeElementKind(arg->getType());
+      return kind == AR_BASIC_LITERAL_INT || kind == AR_BASIC_LITERAL_FLOAT;
+    });
+    if (cacheable) {
+      auto resolved = m_resolvedIntrinsicCalls.find(callKey);
+      if (resolved != m_resolvedIntrinsicCalls.end()) {
+        FunctionDecl *intrinsicFuncDecl = resolved->second;
+        OverloadCandidate& candidate = CandidateSet.addCandidate(Args.size());
+        candidate.Function = intrinsicFuncDecl;
+        candidate.FoundDecl.setDecl(intrinsicFuncDecl);
+        candidate.Viable = true;
+        CandidateSet.isNewCandidate(intrinsicFuncDecl); // used to insert into set
+        return true;
+      }
+    }
+
     IntrinsicDefIter cursor = FindIntrinsicByNameAndArgCount(
         table, tableCount, StringRef(), nameIdentifier, Args.size());
     IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(
@@ -4542,8 +4894,11 @@ public:
       candidate.FoundDecl.setDecl(intrinsicFuncDecl);
       candidate.Viable = argsMatch;
       CandidateSet.isNewCandidate(intrinsicFuncDecl); // used to insert into set
-      if (argsMatch)
+      if (argsMatch) {
+        if (cacheable)
+          m_resolvedIntrinsicCalls[callKey] = intrinsicFuncDecl;
         return true;
+      }
       if (badArgIdx) {
         candidate.FailureKind = ovl_fail_bad_conversion;
         QualType ParamType = functionArgTypes[badArgIdx];
@@ -10234,6 +10589,11 @@ static NameLookup GetSingleFunctionDeclByName(clang::Sema *self, StringRef Name,
 void hlsl::DiagnoseTranslationUnit(clang::Sema *self) {
   DXASSERT_NOMSG(self != nullptr);
 
+  // A precompiled header has no entry points of its own to validate.
+  if (self->TUKind == TU_Prefix) {
+    return;
+  }
+
   // Don't bother with global validation if compilation has already failed.
   if (self->getDiagnostics().hasErrorOccurred()) {
     return;
@@ -10778,6 +11138,17 @@ void hlsl::InitializeASTContextForHLSL(ASTContext& context)
   }
 }
 
+/// <summary>Loads declarations from the AST file read by the specified reader
+/// into a context initialized for HLSL.</summary>
+void hlsl::AttachASTReaderForHLSL(ASTContext& context, ExternalSemaSource* reader)
+{
+  DXASSERT_NOMSG(reader != nullptr);
+  HLSLExternalSource* hlslSource =
+      static_cast<HLSLExternalSource*>(context.getExternalSource());
+  DXASSERT(hlslSource != nullptr, "otherwise context isn't initialized for HLSL");
+  hlslSource->AttachASTFileReader(reader);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // FlattenedTypeIterator implementation                                       //
 
@@ -12206,6 +12577,14 @@ HLSLBufferDecl::Create(ASTContext &C, DeclContext *lexicalParent, bool cbuffer,
   return result;
 }
 
+HLSLBufferDecl *HLSLBufferDecl::CreateDeserialized(ASTContext &C,
+                                                   unsigned ID) {
+  std::vector<hlsl::UnusualAnnotation *> BufferAttributes;
+  return ::new (C, ID)
+      HLSLBufferDecl(nullptr, false, false, SourceLocation(), nullptr,
+                     SourceLocation(), BufferAttributes, SourceLocation());
+}
+
 const char *HLSLBufferDecl::getDeclKindName() const {
   static const char *HLSLBufferNames[] = {"tbuffer", "cbuffer", "TextureBuffer",
                                           "ConstantBuffer"};
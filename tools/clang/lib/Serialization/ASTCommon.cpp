@@ -72,6 +72,20 @@ serialization::TypeIdxFromBuiltin(const BuiltinType *BT) {
   case BuiltinType::OCLEvent:         ID = PREDEF_TYPE_EVENT_ID;        break;
   case BuiltinType::BuiltinFn:
                                 ID = PREDEF_TYPE_BUILTIN_FN; break;
+  // HLSL Change Begin
+  case BuiltinType::Min12Int:   ID = PREDEF_TYPE_MIN12INT_ID;   break;
+  case BuiltinType::Min10Float: ID = PREDEF_TYPE_MIN10FLOAT_ID; break;
+  case BuiltinType::LitInt:     ID = PREDEF_TYPE_LITINT_ID;     break;
+  case BuiltinType::LitFloat:   ID = PREDEF_TYPE_LITFLOAT_ID;   break;
+  case BuiltinType::HalfFloat:  ID = PREDEF_TYPE_HALFFLOAT_ID;  break;
+  case BuiltinType::Min16Float: ID = PREDEF_TYPE_MIN16FLOAT_ID; break;
+  case BuiltinType::Min16Int:   ID = PREDEF_TYPE_MIN16INT_ID;   break;
+  case BuiltinType::Min16UInt:  ID = PREDEF_TYPE_MIN16UINT_ID;  break;
+  case BuiltinType::Int8_4Packed:
+                                ID = PREDEF_TYPE_INT8_4PACKED_ID; break;
+  case BuiltinType::UInt8_4Packed:
+                                ID = PREDEF_TYPE_UINT8_4PACKED_ID; break;
+  // HLSL Change End
 
   }
 
@@ -230,6 +230,23 @@ static bool checkLanguageOptions(const LangOptions &LangOpts,
     return true;
   }
 
+  // HLSL Change Begin
+#define CHECK_HLSL_LANGOPT(Name, Description)             \
+  if (ExistingLangOpts.Name != LangOpts.Name) {           \
+    if (Diags)                                            \
+      Diags->Report(diag::err_pch_langopt_value_mismatch) \
+        << Description;                                   \
+    return true;                                          \
+  }
+  CHECK_HLSL_LANGOPT(HLSLVersion, "HLSL version")
+  CHECK_HLSL_LANGOPT(UseMinPrecision, "minimum precision")
+  CHECK_HLSL_LANGOPT(EnableDX9CompatMode, "DX9 compatibility mode")
+  CHECK_HLSL_LANGOPT(EnableFXCCompatMode, "FXC compatibility mode")
+  CHECK_HLSL_LANGOPT(EnablePayloadAccessQualifiers,
+                     "payload access qualifiers")
+#undef CHECK_HLSL_LANGOPT
+  // HLSL Change End
+
   return false;
 }
 
@@ -4475,6 +4492,14 @@ bool ASTReader::ParseLanguageOptions(const RecordData &Record,
   }
   LangOpts.CommentOpts.ParseAllComments = Record[Idx++];
 
+  // HLSL Change Begin
+  LangOpts.HLSLVersion = Record[Idx++];
+  LangOpts.UseMinPrecision = Record[Idx++];
+  LangOpts.EnableDX9CompatMode = Record[Idx++];
+  LangOpts.EnableFXCCompatMode = Record[Idx++];
+  LangOpts.EnablePayloadAccessQualifiers = Record[Idx++];
+  // HLSL Change End
+
   return Listener.ReadLanguageOptions(LangOpts, Complain,
                                       AllowCompatibleDifferences);
 }
@@ -5143,10 +5168,14 @@ QualType ASTReader::readTypeRecord(unsigned Index) {
 
     unsigned NumParams = Record[Idx++];
     SmallVector<QualType, 16> ParamTypes;
-    for (unsigned I = 0; I != NumParams; ++I)
+    SmallVector<hlsl::ParameterModifier, 16> ParamMods; // HLSL Change
+    for (unsigned I = 0; I != NumParams; ++I) {
       ParamTypes.push_back(readType(*Loc.F, Record, Idx));
+      ParamMods.push_back(hlsl::ParameterModifier( // HLSL Change
+          (hlsl::ParameterModifier::Kind)Record[Idx++]));
+    }
 
-    return Context.getFunctionType(ResultType, ParamTypes, EPI, None); // HLSL Change
+    return Context.getFunctionType(ResultType, ParamTypes, EPI, ParamMods); // HLSL Change
   }
 
   case TYPE_UNRESOLVED_USING: {
@@ -5386,6 +5415,17 @@ QualType ASTReader::readTypeRecord(unsigned Index) {
                                                IndexTypeQuals, Brackets);
   }
 
+  // HLSL Change Begin
+  case TYPE_DEPENDENT_SIZED_EXT_VECTOR: {
+    unsigned Idx = 0;
+    QualType ElementType = readType(*Loc.F, Record, Idx);
+    Expr *SizeExpr = ReadExpr(*Loc.F);
+    SourceLocation AttrLoc = ReadSourceLocation(*Loc.F, Record, Idx);
+    return Context.getDependentSizedExtVectorType(ElementType, SizeExpr,
+                                                  AttrLoc);
+  }
+  // HLSL Change End
+
   case TYPE_TEMPLATE_SPECIALIZATION: {
     unsigned Idx = 0;
     bool IsDependent = Record[Idx++];
@@ -5751,6 +5791,18 @@ QualType ASTReader::GetType(TypeID ID) {
     case PREDEF_TYPE_IMAGE3D_ID:    T = Context.OCLImage3dTy;       break;
     case PREDEF_TYPE_SAMPLER_ID:    T = Context.OCLSamplerTy;       break;
     case PREDEF_TYPE_EVENT_ID:      T = Context.OCLEventTy;         break;
+    // HLSL Change Begin
+    case PREDEF_TYPE_MIN12INT_ID:   T = Context.Min12IntTy;         break;
+    case PREDEF_TYPE_MIN10FLOAT_ID: T = Context.Min10FloatTy;       break;
+    case PREDEF_TYPE_LITINT_ID:     T = Context.LitIntTy;           break;
+    case PREDEF_TYPE_LITFLOAT_ID:   T = Context.LitFloatTy;         break;
+    case PREDEF_TYPE_HALFFLOAT_ID:  T = Context.HalfFloatTy;        break;
+    case PREDEF_TYPE_MIN16FLOAT_ID: T = Context.Min16FloatTy;       break;
+    case PREDEF_TYPE_MIN16INT_ID:   T = Context.Min16IntTy;         break;
+    case PREDEF_TYPE_MIN16UINT_ID:  T = Context.Min16UIntTy;        break;
+    case PREDEF_TYPE_INT8_4PACKED_ID:  T = Context.Int8_4PackedTy;  break;
+    case PREDEF_TYPE_UINT8_4PACKED_ID: T = Context.UInt8_4PackedTy; break;
+    // HLSL Change End
     case PREDEF_TYPE_AUTO_DEDUCT:   T = Context.getAutoDeductType(); break;
         
     case PREDEF_TYPE_AUTO_RREF_DEDUCT: 
@@ -6787,7 +6839,9 @@ void ASTReader::getMemoryBufferSizes(MemoryBufferSizes &sizes) const {
 
 void ASTReader::InitializeSema(Sema &S) {
   SemaObj = &S;
-  S.addExternalSource(this);
+  // HLSL Change - the HLSL external source multiplexes the reader itself.
+  if (!S.getLangOpts().HLSL)
+    S.addExternalSource(this);
 
   // Makes sure any declarations that were deserialized "too early"
   // still get added to the identifier's declaration chains.
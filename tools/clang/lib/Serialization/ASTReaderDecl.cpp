@@ -22,6 +22,7 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/DeclVisitor.h"
 #include "clang/AST/Expr.h"
+#include "clang/AST/HlslTypes.h" // HLSL Change
 #include "clang/Sema/IdentifierResolver.h"
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/SemaDiagnostic.h"
@@ -333,6 +334,7 @@ namespace clang {
     void VisitBlockDecl(BlockDecl *BD);
     void VisitCapturedDecl(CapturedDecl *CD);
     void VisitEmptyDecl(EmptyDecl *D);
+    void VisitHLSLBufferDecl(HLSLBufferDecl *D); // HLSL Change
 
     std::pair<uint64_t, uint64_t> VisitDeclContext(DeclContext *DC);
 
@@ -564,6 +566,63 @@ void ASTDeclReader::VisitNamedDecl(NamedDecl *ND) {
   VisitDecl(ND);
   ND->setDeclName(Reader.ReadDeclarationName(F, Record, Idx));
   AnonymousDeclNumber = Record[Idx++];
+  // HLSL Change Begin - semantics, register assignments and packing.
+  if (unsigned NumAnnotations = Record[Idx++]) {
+    ASTContext &C = Reader.getContext();
+    auto CopyString = [&C](const std::string &S) {
+      char *Buf = new (C) char[S.size()];
+      memcpy(Buf, S.data(), S.size());
+      return StringRef(Buf, S.size());
+    };
+    hlsl::UnusualAnnotation **Annotations =
+        new (C) hlsl::UnusualAnnotation *[NumAnnotations];
+    for (unsigned I = 0; I != NumAnnotations; ++I) {
+      unsigned Kind = Record[Idx++];
+      SourceLocation Loc = ReadSourceLocation(Record, Idx);
+      hlsl::UnusualAnnotation *UA = nullptr;
+      switch (Kind) {
+      case hlsl::UnusualAnnotation::UA_RegisterAssignment: {
+        hlsl::RegisterAssignment *RA = new (C) hlsl::RegisterAssignment();
+        RA->ShaderProfile = CopyString(ASTReader::ReadString(Record, Idx));
+        RA->IsValid = Record[Idx++];
+        RA->RegisterType = Record[Idx++];
+        RA->RegisterNumber = Record[Idx++];
+        if (Record[Idx++])
+          RA->RegisterSpace = (uint32_t)Record[Idx++];
+        RA->RegisterOffset = Record[Idx++];
+        UA = RA;
+        break;
+      }
+      case hlsl::UnusualAnnotation::UA_ConstantPacking: {
+        hlsl::ConstantPacking *CP = new (C) hlsl::ConstantPacking();
+        CP->Subcomponent = Record[Idx++];
+        CP->ComponentOffset = Record[Idx++];
+        CP->IsValid = Record[Idx++];
+        UA = CP;
+        break;
+      }
+      case hlsl::UnusualAnnotation::UA_SemanticDecl:
+        UA = new (C) hlsl::SemanticDecl(
+            CopyString(ASTReader::ReadString(Record, Idx)));
+        break;
+      default: {
+        assert(Kind == hlsl::UnusualAnnotation::UA_PayloadAccessQualifier);
+        hlsl::PayloadAccessAnnotation *PA =
+            new (C) hlsl::PayloadAccessAnnotation();
+        PA->qualifier = (hlsl::DXIL::PayloadAccessQualifier)Record[Idx++];
+        for (unsigned N = Record[Idx++]; N; --N)
+          PA->ShaderStages.push_back(
+              (hlsl::DXIL::PayloadAccessShaderStage)Record[Idx++]);
+        UA = PA;
+        break;
+      }
+      }
+      UA->Loc = Loc;
+      Annotations[I] = UA;
+    }
+    ND->setUnusualAnnotations(llvm::makeArrayRef(Annotations, NumAnnotations));
+  }
+  // HLSL Change End
 }
 
 void ASTDeclReader::VisitTypeDecl(TypeDecl *TD) {
@@ -1248,6 +1307,7 @@ void ASTDeclReader::VisitParmVarDecl(ParmVarDecl *PD) {
     PD->setScopeInfo(scopeDepth, scopeIndex);
   }
   PD->ParmVarDeclBits.IsKNRPromoted = Record[Idx++];
+  PD->ParmVarDeclBits.IsModifierOut = Record[Idx++]; // HLSL Change
   PD->ParmVarDeclBits.HasInheritedDefaultArg = Record[Idx++];
   if (Record[Idx++]) // hasUninstantiatedDefaultArg.
     PD->setUninstantiatedDefaultArg(Reader.ReadExpr(F));
@@ -1314,6 +1374,17 @@ void ASTDeclReader::VisitLinkageSpecDecl(LinkageSpecDecl *D) {
   D->setRBraceLoc(ReadSourceLocation(Record, Idx));
 }
 
+// HLSL Change Begin
+void ASTDeclReader::VisitHLSLBufferDecl(HLSLBufferDecl *D) {
+  VisitNamedDecl(D);
+  D->LBraceLoc = ReadSourceLocation(Record, Idx);
+  D->RBraceLoc = ReadSourceLocation(Record, Idx);
+  D->KwLoc = ReadSourceLocation(Record, Idx);
+  D->IsCBuffer = Record[Idx++];
+  D->IsConstantBufferView = Record[Idx++];
+}
+// HLSL Change End
+
 void ASTDeclReader::VisitLabelDecl(LabelDecl *D) {
   VisitNamedDecl(D);
   D->setLocStart(ReadSourceLocation(Record, Idx));
@@ -2413,11 +2484,15 @@ static bool isConsumerInterestedIn(Decl *D, bool HasBody) {
       isa<ObjCProtocolDecl>(D) || 
       isa<ObjCImplDecl>(D) ||
       isa<ImportDecl>(D) ||
-      isa<OMPThreadPrivateDecl>(D))
+      isa<OMPThreadPrivateDecl>(D) ||
+      isa<HLSLBufferDecl>(D)) // HLSL Change
     return true;
+  if (isa<HLSLBufferDecl>(D->getDeclContext())) // HLSL Change
+    return false;
   if (VarDecl *Var = dyn_cast<VarDecl>(D))
     return Var->isFileVarDecl() &&
-           Var->isThisDeclarationADefinition() == VarDecl::Definition;
+           (Var->isThisDeclarationADefinition() == VarDecl::Definition ||
+            Var->getASTContext().getLangOpts().HLSL); // HLSL Change
   if (FunctionDecl *Func = dyn_cast<FunctionDecl>(D))
     return Func->doesThisDeclarationHaveABody() || HasBody;
   
@@ -3306,6 +3381,11 @@ Decl *ASTReader::ReadDeclRecord(DeclID ID) {
   case DECL_OBJC_TYPE_PARAM:
     D = ObjCTypeParamDecl::CreateDeserialized(Context, ID);
     break;
+  // HLSL Change Begin
+  case DECL_HLSL_BUFFER:
+    D = HLSLBufferDecl::CreateDeserialized(Context, ID);
+    break;
+  // HLSL Change End
   }
 
   assert(D && "Unknown declaration reading AST file");
@@ -723,12 +723,27 @@ void ASTStmtReader::VisitExtMatrixElementExpr(ExtMatrixElementExpr *E) {
   E->setBase(Reader.ReadSubExpr());
   E->setAccessor(Reader.GetIdentifierInfo(F, Record, Idx));
   E->setAccessorLoc(ReadSourceLocation(Record, Idx));
+  hlsl::MatrixMemberAccessPositions Positions = {};
+  Positions.IsValid = Record[Idx++];
+  Positions.Count = Record[Idx++];
+  for (uint32_t i = 0; i < Positions.Count; ++i) {
+    uint32_t row = Record[Idx++];
+    uint32_t col = Record[Idx++];
+    Positions.SetPosition(i, row, col);
+  }
+  E->setEncodedElementAccess(Positions);
 }
 void ASTStmtReader::VisitHLSLVectorElementExpr(HLSLVectorElementExpr *E) {
   VisitExpr(E);
   E->setBase(Reader.ReadSubExpr());
   E->setAccessor(Reader.GetIdentifierInfo(F, Record, Idx));
   E->setAccessorLoc(ReadSourceLocation(Record, Idx));
+  hlsl::VectorMemberAccessPositions Positions = {};
+  Positions.IsValid = Record[Idx++];
+  Positions.Count = Record[Idx++];
+  for (uint32_t i = 0; i < Positions.Count; ++i)
+    Positions.SetPosition(i, Record[Idx++]);
+  E->setEncodedElementAccess(Positions);
 }
 // HLSL Change Ends
 
@@ -2379,6 +2394,12 @@ Stmt *ASTReader::ReadStmtFromStream(ModuleFile &F) {
       S = new (Context) NullStmt(Empty);
       break;
 
+    // HLSL Change Starts
+    case STMT_DISCARD:
+      S = new (Context) DiscardStmt(Empty);
+      break;
+    // HLSL Change Ends
+
     case STMT_COMPOUND:
       S = new (Context) CompoundStmt(Empty);
       break;
@@ -2608,11 +2629,13 @@ Stmt *ASTReader::ReadStmtFromStream(ModuleFile &F) {
       break;
 
     // HLSL Change Starts
-    // Note that we do not support serialization of matrix elements, as it's a breaking
-    // change for the format. We might when we get scenarios for this.
-    //case EXPR_EXT_MATRIX_ELEMENT:
-    //  S = new (Context)ExtMatrixElementExpr(Empty);
-    //  break;
+    case EXPR_EXT_MATRIX_ELEMENT:
+      S = new (Context) ExtMatrixElementExpr(Empty);
+      break;
+
+    case EXPR_HLSL_VECTOR_ELEMENT:
+      S = new (Context) HLSLVectorElementExpr(Empty);
+      break;
     // HLSL Change Ends
 
     case EXPR_INIT_LIST:
@@ -230,8 +230,10 @@ void ASTTypeWriter::VisitFunctionProtoType(const FunctionProtoType *T) {
   addExceptionSpec(Writer, T, Record);
 
   Record.push_back(T->getNumParams());
-  for (unsigned I = 0, N = T->getNumParams(); I != N; ++I)
+  for (unsigned I = 0, N = T->getNumParams(); I != N; ++I) {
     Writer.AddTypeRef(T->getParamType(I), Record);
+    Record.push_back(T->getParamMods()[I].getAsUnsigned()); // HLSL Change
+  }
 
   if (T->isVariadic() || T->hasTrailingReturn() || T->getTypeQuals() ||
       T->getRefQualifier() || T->getExceptionSpecType() != EST_None)
@@ -350,8 +352,13 @@ ASTTypeWriter::VisitDependentSizedArrayType(const DependentSizedArrayType *T) {
 void
 ASTTypeWriter::VisitDependentSizedExtVectorType(
                                         const DependentSizedExtVectorType *T) {
-  // FIXME: Serialize this type (C++ only)
-  llvm_unreachable("Cannot serialize dependent sized extended vector types");
+  // HLSL Change Begin - the vector template declares its element storage with
+  // one of these.
+  Writer.AddTypeRef(T->getElementType(), Record);
+  Writer.AddStmt(T->getSizeExpr());
+  Writer.AddSourceLocation(T->getAttributeLoc(), Record);
+  Code = TYPE_DEPENDENT_SIZED_EXT_VECTOR;
+  // HLSL Change End
 }
 
 void
@@ -700,7 +707,7 @@ void ASTWriter::WriteTypeAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(EST_None));                  // ExceptionSpec
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));   // NumParams
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-  Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));   // Params
+  Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));   // Params and modifiers
   TypeFunctionProtoAbbrev = Stream.EmitAbbrev(Abv);
 }
 
@@ -998,6 +1005,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(TYPE_ATOMIC);
   RECORD(TYPE_DECAYED);
   RECORD(TYPE_ADJUSTED);
+  RECORD(TYPE_DEPENDENT_SIZED_EXT_VECTOR); // HLSL Change
   RECORD(DECL_TYPEDEF);
   RECORD(DECL_TYPEALIAS);
   RECORD(DECL_ENUM);
@@ -1032,6 +1040,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(DECL_UNRESOLVED_USING_VALUE);
   RECORD(DECL_UNRESOLVED_USING_TYPENAME);
   RECORD(DECL_LINKAGE_SPEC);
+  RECORD(DECL_HLSL_BUFFER); // HLSL Change
   RECORD(DECL_CXX_RECORD);
   RECORD(DECL_CXX_METHOD);
   RECORD(DECL_CXX_CONSTRUCTOR);
@@ -1293,6 +1302,14 @@ void ASTWriter::WriteControlBlock(Preprocessor &PP, ASTContext &Context,
   }
   Record.push_back(LangOpts.CommentOpts.ParseAllComments);
 
+  // HLSL Change Begin - options that change how declarations are understood.
+  Record.push_back(LangOpts.HLSLVersion);
+  Record.push_back(LangOpts.UseMinPrecision);
+  Record.push_back(LangOpts.EnableDX9CompatMode);
+  Record.push_back(LangOpts.EnableFXCCompatMode);
+  Record.push_back(LangOpts.EnablePayloadAccessQualifiers);
+  // HLSL Change End
+
   Stream.EmitRecord(LANGUAGE_OPTIONS, Record);
 
   // Target options.
@@ -1488,6 +1505,9 @@ void ASTWriter::WriteInputFiles(SourceManager &SourceMgr,
     Entry.File = Cache->OrigEntry;
     Entry.IsSystemFile = Cache->IsSystemFile;
     Entry.BufferOverridden = Cache->BufferOverridden;
+    // HLSL Change - embed every input file, so that the AST file does not
+    // depend on the include handler that served the headers it was built from.
+    Entry.BufferOverridden |= Context->getLangOpts().HLSL;
     if (Cache->IsSystemFile)
       SortedFiles.push_back(Entry);
     else
@@ -1871,7 +1891,8 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
         
         Stream.EmitRecordWithAbbrev(SLocFileAbbrv, Record);
         
-        if (Content->BufferOverridden) {
+        if (Content->BufferOverridden ||
+            PP.getLangOpts().HLSL) { // HLSL Change - see WriteInputFiles
           Record.clear();
           Record.push_back(SM_SLOC_BUFFER_BLOB);
           const llvm::MemoryBuffer *Buffer
@@ -4459,6 +4480,28 @@ void ASTWriter::WriteASTCore(Sema &SemaRef,
 
   Stream.EmitRecord(SPECIAL_TYPES, SpecialTypes);
 
+  // HLSL Change Begin - code generation numbers resources and lays out
+  // constants in the order it sees them, so keep that the source order
+  // rather than the order in which declarations happened to be written.
+  if (Context.getLangOpts().HLSL && !EagerlyDeserializedDecls.empty()) {
+    SourceManager &SM = Context.getSourceManager();
+    SmallVector<unsigned, 16> Order(EagerlyDeserializedDecls.size());
+    for (unsigned I = 0, E = Order.size(); I != E; ++I)
+      Order[I] = I;
+    std::stable_sort(Order.begin(), Order.end(), [&](unsigned L, unsigned R) {
+      SourceLocation LLoc = EagerlyDeserializedDeclPtrs[L]->getLocation();
+      SourceLocation RLoc = EagerlyDeserializedDeclPtrs[R]->getLocation();
+      if (LLoc.isInvalid() || RLoc.isInvalid())
+        return LLoc.isInvalid() && RLoc.isValid();
+      return SM.isBeforeInTranslationUnit(LLoc, RLoc);
+    });
+    SmallVector<uint64_t, 16> Sorted;
+    for (unsigned I : Order)
+      Sorted.push_back(EagerlyDeserializedDecls[I]);
+    EagerlyDeserializedDecls.swap(Sorted);
+  }
+  // HLSL Change End
+
   // Write the record containing external, unnamed definitions.
   if (!EagerlyDeserializedDecls.empty())
     Stream.EmitRecord(EAGERLY_DESERIALIZED_DECLS, EagerlyDeserializedDecls);
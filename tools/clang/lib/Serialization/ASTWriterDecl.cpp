@@ -18,6 +18,7 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/DeclVisitor.h"
 #include "clang/AST/Expr.h"
+#include "clang/AST/HlslTypes.h" // HLSL Change
 #include "clang/Basic/SourceManager.h"
 #include "clang/Serialization/ASTReader.h"
 #include "llvm/ADT/Twine.h"
@@ -109,6 +110,7 @@ namespace clang {
     void VisitBlockDecl(BlockDecl *D);
     void VisitCapturedDecl(CapturedDecl *D);
     void VisitEmptyDecl(EmptyDecl *D);
+    void VisitHLSLBufferDecl(HLSLBufferDecl *D); // HLSL Change
 
     void VisitDeclContext(DeclContext *DC, uint64_t LexicalOffset,
                           uint64_t VisibleOffset);
@@ -215,6 +217,12 @@ namespace clang {
 void ASTDeclWriter::Visit(Decl *D) {
   DeclVisitor<ASTDeclWriter>::Visit(D);
 
+  // HLSL Change Begin - the abbreviations assume no annotations.
+  if (NamedDecl *ND = dyn_cast<NamedDecl>(D))
+    if (!ND->getUnusualAnnotations().empty())
+      AbbrevToUse = 0;
+  // HLSL Change End
+
   // Source locations require array (variable-length) abbreviations.  The
   // abbreviation infrastructure requires that arrays are encoded last, so
   // we handle it here in the case of those classes derived from DeclaratorDecl
@@ -279,6 +287,47 @@ void ASTDeclWriter::VisitNamedDecl(NamedDecl *D) {
   Record.push_back(needsAnonymousDeclarationNumber(D)
                        ? Writer.getAnonymousDeclarationNumber(D)
                        : 0);
+  // HLSL Change Begin - semantics, register assignments and packing.
+  ArrayRef<hlsl::UnusualAnnotation *> Annotations = D->getUnusualAnnotations();
+  Record.push_back(Annotations.size());
+  for (const hlsl::UnusualAnnotation *UA : Annotations) {
+    Record.push_back(UA->getKind());
+    Writer.AddSourceLocation(UA->Loc, Record);
+    switch (UA->getKind()) {
+    case hlsl::UnusualAnnotation::UA_RegisterAssignment: {
+      const hlsl::RegisterAssignment *RA = cast<hlsl::RegisterAssignment>(UA);
+      Writer.AddString(RA->ShaderProfile, Record);
+      Record.push_back(RA->IsValid);
+      Record.push_back(RA->RegisterType);
+      Record.push_back(RA->RegisterNumber);
+      Record.push_back(RA->RegisterSpace.hasValue());
+      if (RA->RegisterSpace.hasValue())
+        Record.push_back(RA->RegisterSpace.getValue());
+      Record.push_back(RA->RegisterOffset);
+      break;
+    }
+    case hlsl::UnusualAnnotation::UA_ConstantPacking: {
+      const hlsl::ConstantPacking *CP = cast<hlsl::ConstantPacking>(UA);
+      Record.push_back(CP->Subcomponent);
+      Record.push_back(CP->ComponentOffset);
+      Record.push_back(CP->IsValid);
+      break;
+    }
+    case hlsl::UnusualAnnotation::UA_SemanticDecl:
+      Writer.AddString(cast<hlsl::SemanticDecl>(UA)->SemanticName, Record);
+      break;
+    case hlsl::UnusualAnnotation::UA_PayloadAccessQualifier: {
+      const hlsl::PayloadAccessAnnotation *PA =
+          cast<hlsl::PayloadAccessAnnotation>(UA);
+      Record.push_back((unsigned)PA->qualifier);
+      Record.push_back(PA->ShaderStages.size());
+      for (hlsl::DXIL::PayloadAccessShaderStage Stage : PA->ShaderStages)
+        Record.push_back((unsigned)Stage);
+      break;
+    }
+    }
+  }
+  // HLSL Change End
 }
 
 void ASTDeclWriter::VisitTypeDecl(TypeDecl *D) {
@@ -891,6 +940,7 @@ void ASTDeclWriter::VisitParmVarDecl(ParmVarDecl *D) {
   Record.push_back(D->getFunctionScopeIndex());
   Record.push_back(D->getObjCDeclQualifier()); // FIXME: stable encoding
   Record.push_back(D->isKNRPromoted());
+  Record.push_back(D->isModifierOut()); // HLSL Change
   Record.push_back(D->hasInheritedDefaultArg());
   Record.push_back(D->hasUninstantiatedDefaultArg());
   if (D->hasUninstantiatedDefaultArg())
@@ -915,6 +965,7 @@ void ASTDeclWriter::VisitParmVarDecl(ParmVarDecl *D) {
       D->getFunctionScopeDepth() == 0 &&
       D->getObjCDeclQualifier() == 0 &&
       !D->isKNRPromoted() &&
+      !D->isModifierOut() && // HLSL Change
       !D->hasInheritedDefaultArg() &&
       D->getInit() == nullptr &&
       !D->hasUninstantiatedDefaultArg())  // No default expr.
@@ -989,6 +1040,18 @@ void ASTDeclWriter::VisitLinkageSpecDecl(LinkageSpecDecl *D) {
   Code = serialization::DECL_LINKAGE_SPEC;
 }
 
+// HLSL Change Begin
+void ASTDeclWriter::VisitHLSLBufferDecl(HLSLBufferDecl *D) {
+  VisitNamedDecl(D);
+  Writer.AddSourceLocation(D->LBraceLoc, Record);
+  Writer.AddSourceLocation(D->RBraceLoc, Record);
+  Writer.AddSourceLocation(D->KwLoc, Record);
+  Record.push_back(D->IsCBuffer);
+  Record.push_back(D->IsConstantBufferView);
+  Code = serialization::DECL_HLSL_BUFFER;
+}
+// HLSL Change End
+
 void ASTDeclWriter::VisitLabelDecl(LabelDecl *D) {
   VisitNamedDecl(D);
   Writer.AddSourceLocation(D->getLocStart(), Record);
@@ -1572,6 +1635,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // ValueDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type
   // DeclaratorDecl
@@ -1605,6 +1669,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // ValueDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type
   // DeclaratorDecl
@@ -1643,6 +1708,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // TypeDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Source Location
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type Ref
@@ -1691,6 +1757,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // TypeDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Source Location
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type Ref
@@ -1734,6 +1801,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // ValueDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type
   // DeclaratorDecl
@@ -1752,6 +1820,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // ScopeIndex
   Abv->Add(BitCodeAbbrevOp(0));                       // ObjCDeclQualifier
   Abv->Add(BitCodeAbbrevOp(0));                       // KNRPromoted
+  Abv->Add(BitCodeAbbrevOp(0));                  // ModifierOut - HLSL Change
   Abv->Add(BitCodeAbbrevOp(0));                       // HasInheritedDefaultArg
   Abv->Add(BitCodeAbbrevOp(0));                   // HasUninstantiatedDefaultArg
   // Type Source Info
@@ -1781,6 +1850,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // TypeDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Source Location
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type Ref
@@ -1810,6 +1880,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(0));                       // NameKind = Identifier
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Name
   Abv->Add(BitCodeAbbrevOp(0));                       // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                // UnusualAnnotations - HLSL Change
   // ValueDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Type
   // DeclaratorDecl
@@ -1856,6 +1927,7 @@ void ASTWriter::WriteDeclAbbrevs() {
   Abv->Add(BitCodeAbbrevOp(DeclarationName::Identifier)); // NameKind
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));   // Identifier
   Abv->Add(BitCodeAbbrevOp(0));                         // AnonDeclNumber
+  Abv->Add(BitCodeAbbrevOp(0));                  // UnusualAnnotations - HLSL Change
   // ValueDecl
   Abv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));   // Type
   // DeclaratorDecl
@@ -2004,6 +2076,19 @@ static bool isRequiredDecl(const Decl *D, ASTContext &Context) {
   if (isa<FileScopeAsmDecl>(D) || isa<ObjCImplDecl>(D) || isa<ImportDecl>(D))
     return true;
 
+  // HLSL Change - constant buffers are laid out by code generation, which
+  // visits their members through the buffer rather than on their own.
+  if (isa<HLSLBufferDecl>(D))
+    return true;
+  if (isa<HLSLBufferDecl>(D->getDeclContext()))
+    return false;
+  // HLSL Change - every global registers its resource or constant with code
+  // generation, whether or not it must be emitted.
+  if (Context.getLangOpts().HLSL)
+    if (const VarDecl *VD = dyn_cast<VarDecl>(D))
+      if (VD->isFileVarDecl())
+        return true;
+
   return Context.DeclMustBeEmitted(D);
 }
 
@@ -2090,8 +2175,10 @@ void ASTWriter::WriteDecl(ASTContext &Context, Decl *D) {
 
   // Note declarations that should be deserialized eagerly so that we can add
   // them to a record in the AST file later.
-  if (isRequiredDecl(D, Context))
+  if (isRequiredDecl(D, Context)) {
     EagerlyDeserializedDecls.push_back(ID);
+    EagerlyDeserializedDeclPtrs.push_back(D); // HLSL Change
+  }
 }
 
 void ASTWriter::AddFunctionDefinition(const FunctionDecl *FD,
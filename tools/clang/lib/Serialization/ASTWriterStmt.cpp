@@ -682,14 +682,35 @@ void ASTStmtWriter::VisitExtVectorElementExpr(ExtVectorElementExpr *E) {
 
 // HLSL Change Starts
 void ASTStmtWriter::VisitExtMatrixElementExpr(ExtMatrixElementExpr *E) {
-  // This requires a new serialization code that will break compatibility.
-  // Until there is a scenario for serializing these AST tress this is left unimplemented.
-  assert(false && "ASTStmtWriter::VisitExtMatrixElementExpr is unimplemented");
+  VisitExpr(E);
+  Writer.AddStmt(E->getBase());
+  Writer.AddIdentifierRef(&E->getAccessor(), Record);
+  Writer.AddSourceLocation(E->getAccessorLoc(), Record);
+  hlsl::MatrixMemberAccessPositions Positions = E->getEncodedElementAccess();
+  Record.push_back(Positions.IsValid);
+  Record.push_back(Positions.Count);
+  for (uint32_t i = 0; i < Positions.Count; ++i) {
+    uint32_t row, col;
+    Positions.GetPosition(i, &row, &col);
+    Record.push_back(row);
+    Record.push_back(col);
+  }
+  Code = serialization::EXPR_EXT_MATRIX_ELEMENT;
 }
 void ASTStmtWriter::VisitHLSLVectorElementExpr(HLSLVectorElementExpr *E) {
-  // This requires a new serialization code that will break compatibility.
-  // Until there is a scenario for serializing these AST tress this is left unimplemented.
-  assert(false && "ASTStmtWriter::VisitHLSLVectorElementExpr is unimplemented");
+  VisitExpr(E);
+  Writer.AddStmt(E->getBase());
+  Writer.AddIdentifierRef(&E->getAccessor(), Record);
+  Writer.AddSourceLocation(E->getAccessorLoc(), Record);
+  hlsl::VectorMemberAccessPositions Positions = E->getEncodedElementAccess();
+  Record.push_back(Positions.IsValid);
+  Record.push_back(Positions.Count);
+  for (uint32_t i = 0; i < Positions.Count; ++i) {
+    uint32_t col;
+    Positions.GetPosition(i, &col);
+    Record.push_back(col);
+  }
+  Code = serialization::EXPR_HLSL_VECTOR_ELEMENT;
 }
 // HLSL Change Ends
 
@@ -0,0 +1,29 @@
+// Run: %dxc -T ps_6_0 -E main -Zi
+
+// -Zi compiles the original source in a single pass. OpSource must hold the
+// text as written, with macro definitions and comments, and OpLine must count
+// lines of the original file.
+
+// CHECK:      [[file:%\d+]] = OpString
+// CHECK-SAME: spirv.debug.source.single-pass.hlsl
+// CHECK-NEXT: OpSource HLSL 600 [[file]] "// Run: %dxc -T ps_6_0 -E main -Zi
+// CHECK:      {{^}}#define SCALE(x) ((x) * 2)
+// CHECK:      {{^}}// A comment the preprocessor would have dropped.
+
+#define SCALE(x) ((x) * 2)
+
+// A comment the preprocessor would have dropped.
+
+float4 main(float4 color : COLOR, uint val : A) : SV_Target {
+  // CHECK:      OpLine [[file]] 20 {{\d+}}
+  // CHECK-NEXT: OpLoad %uint %val
+  uint a = SCALE(val);
+
+  // Blank lines and comments between statements must not shift the lines
+  // reported for the code after them.
+
+  // CHECK:      OpLine [[file]] 27 {{\d+}}
+  // CHECK-NEXT: OpLoad %v4float %color
+  float4 c = color * a;
+  return c;
+}
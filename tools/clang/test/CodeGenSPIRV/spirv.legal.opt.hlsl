@@ -0,0 +1,38 @@
+// Run: %dxc -T ps_6_0 -E main -O3
+
+// Legalization and optimization run in one optimizer. The struct of resources
+// must be legalized away, and the performance passes must still have run:
+// the branch on k is turned into an OpSelect by if-conversion.
+
+// CHECK-NOT: OpVariable %_ptr_Function_Bundle
+// CHECK-NOT: OpFunctionCall
+// CHECK-DAG: OpSelect %float {{%\d+}} %float_1 %float_2
+// CHECK-DAG: OpImageSampleImplicitLod %v4float
+// CHECK-NOT: OpFunctionCall
+// CHECK-NOT: OpBranchConditional
+
+Texture2D    gTex;
+SamplerState gSampler;
+
+struct Bundle {
+  Texture2D    tex;
+  SamplerState samp;
+};
+
+float4 SampleBundle(Bundle b, float2 uv) {
+  return b.tex.Sample(b.samp, uv);
+}
+
+float4 main(float2 uv : TEXCOORD, float k : K) : SV_Target {
+  Bundle b;
+  b.tex = gTex;
+  b.samp = gSampler;
+
+  float s;
+  if (k > 0)
+    s = 1;
+  else
+    s = 2;
+
+  return SampleBundle(b, uv) * s;
+}
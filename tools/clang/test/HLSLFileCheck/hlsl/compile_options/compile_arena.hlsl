@@ -0,0 +1,14 @@
+// RUN: %dxc -E main -T ps_6_0 -fcompile-arena -ftime-report %s | FileCheck %s
+// UNSUPPORTED: system-windows
+
+// The arena is installed when dxc links dxcompiler, and the time report says
+// how much it served.
+// CHECK: Compile arena: {{[1-9][0-9]*}} KB requested, {{[1-9][0-9]*}} KB in chunks
+
+Texture2D<float4> tex;
+SamplerState samp;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target
+{
+	return tex.Sample(samp, uv);
+}
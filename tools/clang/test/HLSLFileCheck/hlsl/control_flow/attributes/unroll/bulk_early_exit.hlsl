@@ -0,0 +1,44 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+// CHECK: @main
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 1,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 2,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 4,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 8,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 16,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 32,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 64,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 128,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 256,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 512,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 1024,
+// CHECK: br i1
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 2048,
+// CHECK-NOT: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 4096,
+
+// Confirm that when the trip count of the latch is known, the loop is still
+// unrolled with the other exits of every iteration intact.
+
+RWBuffer<float> buf : register(u0);
+
+[numthreads(1,1,1)]
+void main() {
+  float x = 0;
+  [unroll]
+  for (uint i = 1; i < 4096; i *= 2) {
+    float v = buf[i];
+    if (v < 0)
+      break;
+    x += v;
+  }
+  buf[0] = x;
+}
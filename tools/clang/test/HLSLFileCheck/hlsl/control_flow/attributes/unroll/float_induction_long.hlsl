@@ -0,0 +1,23 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+// CHECK: @main
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 2,
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 100,
+// CHECK: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 199,
+// CHECK-NOT: @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %{{[0-9]+}}, i32 200,
+// CHECK-NOT: br {{label|i1}}
+
+// Confirm that a loop with a floating point induction variable, which SCEV
+// can't count, is unrolled in one go once the trip count is found by
+// evaluating the exit condition, including past SCEV's 100 iteration limit.
+
+RWBuffer<float> buf : register(u0);
+
+[numthreads(1,1,1)]
+void main() {
+  float x = 0;
+  [unroll]
+  for (float f = 0; f < 200; f += 1) {
+    x = x * buf[(uint)f] + f;
+  }
+  buf[0] = x;
+}
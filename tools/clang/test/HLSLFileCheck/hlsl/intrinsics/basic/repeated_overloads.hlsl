@@ -0,0 +1,28 @@
+// RUN: %dxc -T ps_6_0 -E main %s | %FileCheck %s
+
+// Calls to the same intrinsic with other argument types resolve to their own
+// overload, even after a call with the same types has been resolved before.
+// Literal arguments are resolved from their value each time.
+
+// CHECK-DAG: call float @dx.op.unary.f32(i32 6,
+// CHECK-DAG: call i32 @dx.op.binary.i32(i32 37,
+// CHECK-DAG: call void @dx.op.storeOutput.i32(i32 5, i32 2, i32 0, i8 0, i32 3)
+// CHECK-DAG: call void @dx.op.storeOutput.i32(i32 5, i32 3, i32 0, i8 0, i32 5)
+
+struct PSOut {
+  float f : SV_Target0;
+  int i : SV_Target1;
+  int l : SV_Target2;
+  int m : SV_Target3;
+};
+
+PSOut main(float f : A, float g : B, int i : C, int j : D) {
+  PSOut o;
+  o.f = abs(f);
+  o.i = abs(i);
+  o.f += abs(g);
+  o.i += abs(j);
+  o.l = abs(-3);
+  o.m = abs(-5);
+  return o;
+}
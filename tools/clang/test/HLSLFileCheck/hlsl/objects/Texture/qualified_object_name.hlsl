@@ -0,0 +1,13 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Make sure built-in object types and the sampler typedef are found by
+// qualified lookup before any unqualified use.
+// CHECK: @dx.op.sample.f32
+
+::Texture2D<float4> tex;
+::sampler samp;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target
+{
+	return tex.Sample(samp, uv);
+}
@@ -0,0 +1,24 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// The structured buffer element has a bool and a matrix, so the library gets
+// a host layout copy of the buffer. Every handle must be recreated from it.
+
+// CHECK: %[[LD:[0-9]+]] = load %"hostlayout.class.StructuredBuffer<Vertex>", %"hostlayout.class.StructuredBuffer<Vertex>"* @"\01?vertices@@3V?$StructuredBuffer@UVertex@@@@A_legacy"
+// CHECK: call %dx.types.Handle @"dx.op.createHandleForLib.hostlayout.class.StructuredBuffer<Vertex>"(i32 160, %"hostlayout.class.StructuredBuffer<Vertex>" %[[LD]])
+
+struct Vertex {
+  float3 position;
+  bool visible;
+  float2x2 rot;
+};
+
+StructuredBuffer<Vertex> vertices : register(t0);
+RWTexture2D<float4> output : register(u0);
+
+[shader("raygeneration")]
+void RayGen() {
+  uint2 idx = DispatchRaysIndex().xy;
+  Vertex v = vertices[idx.x];
+  if (v.visible)
+    output[idx] = float4(mul(v.rot, v.position.xy), v.position.z, 1);
+}
@@ -0,0 +1,252 @@
+// Large compute shader: tiled light culling, shading, a groupshared bitonic
+// sort and a luminance histogram in one dispatch.
+
+#define TILE_SIZE 16
+#define THREADS (TILE_SIZE * TILE_SIZE)
+#define MAX_LIGHTS_PER_TILE 256
+#define HISTOGRAM_BINS 64
+
+struct Light {
+  float3 position;
+  float radius;
+  float3 color;
+  float intensity;
+  float3 direction;
+  float spotAngle;
+  uint type;
+  uint shadowIndex;
+  uint2 pad;
+};
+
+cbuffer FrameConstants : register(b0) {
+  row_major float4x4 viewProj;
+  row_major float4x4 invViewProj;
+  row_major float4x4 view;
+  float4 cameraPosition;
+  float4 screenSize;
+  uint lightCount;
+  float exposure;
+  float minLogLuminance;
+  float logLuminanceRange;
+};
+
+StructuredBuffer<Light> lights : register(t0);
+Texture2D<float> depthTexture : register(t1);
+Texture2D<float4> albedoTexture : register(t2);
+Texture2D<float4> normalTexture : register(t3);
+Texture2D<float4> materialTexture : register(t4);
+Texture2DArray<float> shadowMaps : register(t5);
+StructuredBuffer<float4x4> shadowMatrices : register(t6);
+SamplerComparisonState shadowSampler : register(s0);
+
+RWTexture2D<float4> outputTexture : register(u0);
+RWStructuredBuffer<uint> histogram : register(u1);
+RWStructuredBuffer<uint> tileLightCounts : register(u2);
+
+groupshared uint gsMinDepth;
+groupshared uint gsMaxDepth;
+groupshared uint gsLightCount;
+groupshared uint gsLightIndices[MAX_LIGHTS_PER_TILE];
+groupshared float gsSortKeys[THREADS];
+groupshared uint gsHistogram[HISTOGRAM_BINS];
+
+float3 ReconstructPosition(float2 uv, float depth) {
+  float4 clip = float4(uv * float2(2, -2) + float2(-1, 1), depth, 1);
+  float4 world = mul(clip, invViewProj);
+  return world.xyz / world.w;
+}
+
+float4 PlaneFromPoints(float3 a, float3 b, float3 c) {
+  float3 n = normalize(cross(b - a, c - a));
+  return float4(n, -dot(n, a));
+}
+
+bool SphereInsideFrustum(float3 center, float radius, float4 planes[6]) {
+  bool inside = true;
+  [unroll]
+  for (uint i = 0; i < 6; ++i)
+    inside = inside && (dot(planes[i].xyz, center) + planes[i].w > -radius);
+  return inside;
+}
+
+float DistributionGGX(float NdotH, float roughness) {
+  float a = roughness * roughness;
+  float a2 = a * a;
+  float d = NdotH * NdotH * (a2 - 1) + 1;
+  return a2 / (3.14159265 * d * d);
+}
+
+float GeometrySmith(float NdotV, float NdotL, float roughness) {
+  float k = (roughness + 1) * (roughness + 1) / 8;
+  float gv = NdotV / (NdotV * (1 - k) + k);
+  float gl = NdotL / (NdotL * (1 - k) + k);
+  return gv * gl;
+}
+
+float3 FresnelSchlick(float cosTheta, float3 f0) {
+  return f0 + (1 - f0) * pow(saturate(1 - cosTheta), 5);
+}
+
+float SampleShadow(uint index, float3 worldPos) {
+  float4 shadowPos = mul(float4(worldPos, 1), shadowMatrices[index]);
+  shadowPos.xyz /= shadowPos.w;
+  float2 uv = shadowPos.xy * float2(0.5, -0.5) + 0.5;
+  float sum = 0;
+  [unroll]
+  for (int y = -2; y <= 2; ++y) {
+    [unroll]
+    for (int x = -2; x <= 2; ++x) {
+      float2 offset = float2(x, y) * screenSize.zw;
+      sum += shadowMaps.SampleCmpLevelZero(shadowSampler,
+                                           float3(uv + offset, index),
+                                           shadowPos.z);
+    }
+  }
+  return sum / 25;
+}
+
+float3 ShadeLight(Light light, float3 worldPos, float3 N, float3 V,
+                  float3 albedo, float metallic, float roughness) {
+  float3 L;
+  float attenuation = 1;
+  if (light.type == 0) {
+    L = -light.direction;
+  } else {
+    float3 toLight = light.position - worldPos;
+    float dist = length(toLight);
+    L = toLight / dist;
+    float falloff = saturate(1 - pow(dist / light.radius, 4));
+    attenuation = falloff * falloff / (dist * dist + 1);
+    if (light.type == 2) {
+      float cosAngle = dot(-L, light.direction);
+      attenuation *= smoothstep(cos(light.spotAngle), 1, cosAngle);
+    }
+  }
+  if (light.shadowIndex != 0xffffffff)
+    attenuation *= SampleShadow(light.shadowIndex, worldPos);
+
+  float3 H = normalize(V + L);
+  float NdotL = saturate(dot(N, L));
+  float NdotV = saturate(dot(N, V)) + 1e-4;
+  float NdotH = saturate(dot(N, H));
+  float3 f0 = lerp(0.04, albedo, metallic);
+  float3 F = FresnelSchlick(saturate(dot(H, V)), f0);
+  float D = DistributionGGX(NdotH, roughness);
+  float G = GeometrySmith(NdotV, NdotL, roughness);
+  float3 specular = D * G * F / (4 * NdotV * NdotL + 1e-4);
+  float3 kd = (1 - F) * (1 - metallic);
+  return (kd * albedo / 3.14159265 + specular) * light.color *
+         light.intensity * NdotL * attenuation;
+}
+
+void BitonicSort(uint index) {
+  for (uint k = 2; k <= THREADS; k <<= 1) {
+    for (uint j = k >> 1; j > 0; j >>= 1) {
+      uint partner = index ^ j;
+      if (partner > index) {
+        float a = gsSortKeys[index];
+        float b = gsSortKeys[partner];
+        bool ascending = (index & k) == 0;
+        if ((a > b) == ascending) {
+          gsSortKeys[index] = b;
+          gsSortKeys[partner] = a;
+        }
+      }
+      GroupMemoryBarrierWithGroupSync();
+    }
+  }
+}
+
+uint LuminanceBin(float3 color) {
+  float lum = dot(color, float3(0.2126, 0.7152, 0.0722));
+  if (lum < 1e-5)
+    return 0;
+  float logLum = saturate((log2(lum) - minLogLuminance) / logLuminanceRange);
+  return (uint)(logLum * (HISTOGRAM_BINS - 2) + 1);
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 dtid : SV_DispatchThreadID,
+          uint groupIndex : SV_GroupIndex) {
+  if (groupIndex == 0) {
+    gsMinDepth = 0x7f7fffff;
+    gsMaxDepth = 0;
+    gsLightCount = 0;
+  }
+  if (groupIndex < HISTOGRAM_BINS)
+    gsHistogram[groupIndex] = 0;
+  GroupMemoryBarrierWithGroupSync();
+
+  float depth = depthTexture[dtid.xy];
+  InterlockedMin(gsMinDepth, asuint(depth));
+  InterlockedMax(gsMaxDepth, asuint(depth));
+  GroupMemoryBarrierWithGroupSync();
+
+  float minDepth = asfloat(gsMinDepth);
+  float maxDepth = asfloat(gsMaxDepth);
+  float2 tileMin = groupId.xy * TILE_SIZE * screenSize.zw;
+  float2 tileMax = (groupId.xy + 1) * TILE_SIZE * screenSize.zw;
+
+  float3 corners[8];
+  corners[0] = ReconstructPosition(float2(tileMin.x, tileMin.y), minDepth);
+  corners[1] = ReconstructPosition(float2(tileMax.x, tileMin.y), minDepth);
+  corners[2] = ReconstructPosition(float2(tileMax.x, tileMax.y), minDepth);
+  corners[3] = ReconstructPosition(float2(tileMin.x, tileMax.y), minDepth);
+  corners[4] = ReconstructPosition(float2(tileMin.x, tileMin.y), maxDepth);
+  corners[5] = ReconstructPosition(float2(tileMax.x, tileMin.y), maxDepth);
+  corners[6] = ReconstructPosition(float2(tileMax.x, tileMax.y), maxDepth);
+  corners[7] = ReconstructPosition(float2(tileMin.x, tileMax.y), maxDepth);
+
+  float4 planes[6];
+  planes[0] = PlaneFromPoints(corners[0], corners[4], corners[7]);
+  planes[1] = PlaneFromPoints(corners[2], corners[6], corners[5]);
+  planes[2] = PlaneFromPoints(corners[1], corners[5], corners[4]);
+  planes[3] = PlaneFromPoints(corners[3], corners[7], corners[6]);
+  planes[4] = PlaneFromPoints(corners[0], corners[3], corners[2]);
+  planes[5] = PlaneFromPoints(corners[4], corners[5], corners[6]);
+
+  for (uint i = groupIndex; i < lightCount; i += THREADS) {
+    Light light = lights[i];
+    if (light.type == 0 ||
+        SphereInsideFrustum(light.position, light.radius, planes)) {
+      uint slot;
+      InterlockedAdd(gsLightCount, 1, slot);
+      if (slot < MAX_LIGHTS_PER_TILE)
+        gsLightIndices[slot] = i;
+    }
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  uint tileLights = min(gsLightCount, MAX_LIGHTS_PER_TILE);
+  float2 uv = (dtid.xy + 0.5) * screenSize.zw;
+  float3 worldPos = ReconstructPosition(uv, depth);
+  float3 N = normalize(normalTexture[dtid.xy].xyz * 2 - 1);
+  float3 V = normalize(cameraPosition.xyz - worldPos);
+  float4 albedo = albedoTexture[dtid.xy];
+  float4 material = materialTexture[dtid.xy];
+
+  float3 color = 0;
+  for (uint l = 0; l < tileLights; ++l) {
+    Light light = lights[gsLightIndices[l]];
+    color += ShadeLight(light, worldPos, N, V, albedo.rgb, material.r,
+                        max(material.g, 0.05));
+  }
+  color += albedo.rgb * material.b * 0.03;
+  color *= exposure;
+
+  gsSortKeys[groupIndex] = dot(color, 1);
+  GroupMemoryBarrierWithGroupSync();
+  BitonicSort(groupIndex);
+  float median = gsSortKeys[THREADS / 2];
+  color = lerp(color, median, saturate(material.a - 0.5));
+
+  InterlockedAdd(gsHistogram[LuminanceBin(color)], 1);
+  GroupMemoryBarrierWithGroupSync();
+  if (groupIndex < HISTOGRAM_BINS)
+    InterlockedAdd(histogram[groupIndex], gsHistogram[groupIndex]);
+  if (groupIndex == 0)
+    tileLightCounts[groupId.y * (uint)(screenSize.x / TILE_SIZE) + groupId.x] =
+        tileLights;
+
+  outputTexture[dtid.xy] = float4(color, 1);
+}
@@ -0,0 +1,160 @@
+// Generic utility code instantiated for every scalar and vector type. HLSL
+// 2018 has no templates, so this is the macro-expanded form shaders use in
+// their place: many overloads, structs with methods and deep call chains.
+
+#define DEFINE_MATH(T)                                                        \
+  T Remap(T v, T inMin, T inMax, T outMin, T outMax) {                        \
+    return outMin + (v - inMin) * (outMax - outMin) / (inMax - inMin);        \
+  }                                                                           \
+  T SmoothMin(T a, T b, T k) {                                                \
+    T h = saturate(0.5 + 0.5 * (b - a) / k);                                  \
+    return lerp(b, a, h) - k * h * (1 - h);                                   \
+  }                                                                           \
+  T SmoothMax(T a, T b, T k) { return -SmoothMin(-a, -b, k); }                \
+  T Bias(T v, T b) { return v / ((1 / b - 2) * (1 - v) + 1); }                \
+  T Gain(T v, T g) {                                                          \
+    return v < 0.5 ? Bias(v * 2, g) / 2 : Bias(v * 2 - 1, 1 - g) / 2 + 0.5;   \
+  }                                                                           \
+  T Hermite(T a, T b, T ta, T tb, T t) {                                      \
+    T t2 = t * t, t3 = t2 * t;                                                \
+    return (2 * t3 - 3 * t2 + 1) * a + (t3 - 2 * t2 + t) * ta +               \
+           (-2 * t3 + 3 * t2) * b + (t3 - t2) * tb;                           \
+  }                                                                           \
+  T CatmullRom(T p0, T p1, T p2, T p3, T t) {                                 \
+    return Hermite(p1, p2, (p2 - p0) * 0.5, (p3 - p1) * 0.5, t);              \
+  }                                                                           \
+  void Sort3(inout T a, inout T b, inout T c) {                               \
+    T lo = min(a, b), hi = max(a, b);                                         \
+    a = min(lo, c);                                                           \
+    c = max(hi, c);                                                           \
+    b = lo + hi + min(max(lo, c), hi) - a - c + (c - max(hi, c));             \
+  }                                                                           \
+  T Median3(T a, T b, T c) {                                                  \
+    Sort3(a, b, c);                                                           \
+    return b;                                                                 \
+  }
+
+#define DEFINE_CONTAINERS(T, Name)                                            \
+  struct Stack##Name {                                                        \
+    T items[8];                                                               \
+    uint count;                                                               \
+    void Init() { count = 0; }                                                \
+    void Push(T v) {                                                          \
+      if (count < 8) {                                                        \
+        items[count] = v;                                                     \
+        ++count;                                                              \
+      }                                                                       \
+    }                                                                         \
+    T Pop() {                                                                 \
+      if (count > 0)                                                          \
+        --count;                                                              \
+      return items[count];                                                    \
+    }                                                                         \
+    T Sum() {                                                                 \
+      T s = 0;                                                                \
+      for (uint i = 0; i < count; ++i)                                        \
+        s += items[i];                                                        \
+      return s;                                                               \
+    }                                                                         \
+  };                                                                          \
+  struct Range##Name {                                                        \
+    T lo;                                                                     \
+    T hi;                                                                     \
+    void Init(T a, T b) {                                                     \
+      lo = min(a, b);                                                         \
+      hi = max(a, b);                                                         \
+    }                                                                         \
+    void Extend(T v) {                                                        \
+      lo = min(lo, v);                                                        \
+      hi = max(hi, v);                                                        \
+    }                                                                         \
+    T Clamp(T v) { return clamp(v, lo, hi); }                                 \
+    T Normalize(T v) { return Remap(v, lo, hi, (T)0, (T)1); }                 \
+  };                                                                          \
+  T Reduce##Name(Stack##Name s, Range##Name r) {                              \
+    T acc = 0;                                                                \
+    for (uint i = 0; i < s.count; ++i)                                        \
+      acc = SmoothMax(acc, r.Normalize(s.items[i]), (T)0.1);                  \
+    return Gain(saturate(acc), (T)0.3);                                       \
+  }
+
+#define DEFINE_ALL(T, Name)                                                   \
+  DEFINE_MATH(T)                                                              \
+  DEFINE_CONTAINERS(T, Name)
+
+DEFINE_ALL(float, F1)
+DEFINE_ALL(float2, F2)
+DEFINE_ALL(float3, F3)
+DEFINE_ALL(float4, F4)
+DEFINE_ALL(min16float, H1)
+DEFINE_ALL(min16float2, H2)
+DEFINE_ALL(min16float3, H3)
+DEFINE_ALL(min16float4, H4)
+
+#define DEFINE_MATRIX(N)                                                      \
+  float##N##x##N Identity##N() {                                              \
+    float##N##x##N m = (float##N##x##N)0;                                     \
+    [unroll] for (uint i = 0; i < N; ++i) m[i][i] = 1;                        \
+    return m;                                                                 \
+  }                                                                           \
+  float##N##x##N Power##N(float##N##x##N m, uint e) {                         \
+    float##N##x##N r = Identity##N();                                         \
+    [unroll] for (uint i = 0; i < 8; ++i) {                                   \
+      if (e & (1u << i))                                                      \
+        r = mul(r, m);                                                        \
+      m = mul(m, m);                                                          \
+    }                                                                         \
+    return r;                                                                 \
+  }                                                                           \
+  float Trace##N(float##N##x##N m) {                                          \
+    float t = 0;                                                              \
+    [unroll] for (uint i = 0; i < N; ++i) t += m[i][i];                       \
+    return t;                                                                 \
+  }
+
+DEFINE_MATRIX(2)
+DEFINE_MATRIX(3)
+DEFINE_MATRIX(4)
+
+cbuffer Params : register(b0) {
+  float4 inputs[16];
+  row_major float4x4 transform;
+  uint power;
+  uint itemCount;
+};
+
+Texture2D<float4> source : register(t0);
+SamplerState pointSampler : register(s0);
+
+#define EXERCISE(T, Name, swz)                                                \
+  {                                                                           \
+    Stack##Name s;                                                            \
+    s.Init();                                                                 \
+    Range##Name r;                                                            \
+    r.Init((T)inputs[0].swz, (T)inputs[1].swz);                               \
+    for (uint i = 0; i < itemCount && i < 8; ++i) {                           \
+      T v = (T)source.Sample(pointSampler, uv + inputs[i].xy).swz;            \
+      T a = v, b = (T)inputs[i].swz, c = (T)inputs[i + 8].swz;                \
+      Sort3(a, b, c);                                                         \
+      r.Extend(v);                                                            \
+      s.Push(CatmullRom(a, b, c, Median3(a, b, c), (T)uv.x));                 \
+    }                                                                         \
+    T red = Reduce##Name(s, r) + r.Clamp(s.Sum()) + s.Pop();                  \
+    result.swz += SmoothMin(red, (T)0.5, (T)0.2);                             \
+  }
+
+float4 main(float2 uv : TEXCOORD0) : SV_Target {
+  float4 result = 0;
+  EXERCISE(float, F1, x)
+  EXERCISE(float2, F2, xy)
+  EXERCISE(float3, F3, xyz)
+  EXERCISE(float4, F4, xyzw)
+  EXERCISE(min16float, H1, x)
+  EXERCISE(min16float2, H2, xy)
+  EXERCISE(min16float3, H3, xyz)
+  EXERCISE(min16float4, H4, xyzw)
+  result.x += Trace2(Power2((float2x2)transform, power));
+  result.y += Trace3(Power3((float3x3)transform, power));
+  result.z += Trace4(Power4(transform, power));
+  return result;
+}
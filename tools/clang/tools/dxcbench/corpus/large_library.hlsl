@@ -0,0 +1,67 @@
+// Large library: a shading-function library with many exported functions of
+// similar size. Library validation checks every function on its own, so this
+// entry is where serial and per-function parallel validation differ the most.
+
+Texture2D<float4> Textures[16] : register(t0);
+SamplerState LinearSampler : register(s0);
+RWStructuredBuffer<float4> Output : register(u0);
+
+cbuffer LibraryConstants : register(b0) {
+  float4 lightDirection;
+  float4 lightColor;
+  float4 ambient;
+  uint sampleCount;
+};
+
+float3 Fresnel(float3 f0, float cosTheta) {
+  return f0 + (1 - f0) * pow(1 - saturate(cosTheta), 5);
+}
+
+float Distribution(float nDotH, float roughness) {
+  float a2 = roughness * roughness * roughness * roughness;
+  float d = nDotH * nDotH * (a2 - 1) + 1;
+  return a2 / max(3.14159265 * d * d, 1e-4);
+}
+
+// Each exported function samples its own texture and runs a loop whose shape
+// depends on its index, so no two functions are identical after optimization.
+#define LIB_FUNCTION(N)                                                       \
+  export float4 Shade##N(float2 uv, float3 normal, float3 view,              \
+                         float roughness) {                                   \
+    float4 base = Textures[N % 16].SampleLevel(LinearSampler, uv, 0);         \
+    float3 h = normalize(view - lightDirection.xyz);                          \
+    float nDotL = saturate(dot(normal, -lightDirection.xyz));                 \
+    float3 color = ambient.rgb * base.rgb;                                    \
+    for (uint i = 0; i < sampleCount + N % 7; ++i) {                          \
+      float2 offset = float2(i * 0.01 * N, i * 0.02);                         \
+      float4 texel = Textures[(N + i) % 16].SampleLevel(LinearSampler,        \
+                                                        uv + offset, 0);      \
+      color += texel.rgb * Distribution(saturate(dot(normal, h)),             \
+                                        roughness + i * 0.001);               \
+    }                                                                         \
+    color *= Fresnel(base.rgb, dot(normal, view)) * lightColor.rgb * nDotL;   \
+    Output[N] = float4(color, base.a);                                        \
+    return float4(color, base.a);                                             \
+  }
+
+#define LIB_FUNCTIONS_8(P)                                                    \
+  LIB_FUNCTION(P##0) LIB_FUNCTION(P##1) LIB_FUNCTION(P##2)                    \
+  LIB_FUNCTION(P##3) LIB_FUNCTION(P##4) LIB_FUNCTION(P##5)                    \
+  LIB_FUNCTION(P##6) LIB_FUNCTION(P##7)
+
+LIB_FUNCTIONS_8(10)
+LIB_FUNCTIONS_8(11)
+LIB_FUNCTIONS_8(12)
+LIB_FUNCTIONS_8(13)
+LIB_FUNCTIONS_8(14)
+LIB_FUNCTIONS_8(15)
+LIB_FUNCTIONS_8(16)
+LIB_FUNCTIONS_8(17)
+LIB_FUNCTIONS_8(20)
+LIB_FUNCTIONS_8(21)
+LIB_FUNCTIONS_8(22)
+LIB_FUNCTIONS_8(23)
+LIB_FUNCTIONS_8(24)
+LIB_FUNCTIONS_8(25)
+LIB_FUNCTIONS_8(26)
+LIB_FUNCTIONS_8(27)
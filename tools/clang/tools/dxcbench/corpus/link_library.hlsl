@@ -0,0 +1,73 @@
+// Library of exported functions linked into vertex and pixel shader entry
+// points.
+
+struct VSIn {
+  float3 position : POSITION;
+  float3 normal : NORMAL;
+  float2 uv : TEXCOORD0;
+  uint instance : SV_InstanceID;
+};
+
+struct VSOut {
+  float4 position : SV_Position;
+  float3 normal : NORMAL;
+  float2 uv : TEXCOORD0;
+  float3 worldPos : POSITION1;
+};
+
+cbuffer Camera : register(b0) {
+  row_major float4x4 viewProj;
+  float3 cameraPosition;
+  float time;
+};
+
+StructuredBuffer<row_major float4x4> instanceTransforms : register(t0);
+Texture2D<float4> albedo : register(t1);
+Texture2D<float4> detail : register(t2);
+SamplerState linearSampler : register(s0);
+
+export float3 Wind(float3 position, float strength) {
+  float phase = dot(position, float3(0.7, 0.0, 0.3)) + time;
+  float sway = sin(phase) * 0.6 + sin(phase * 2.3) * 0.3 + sin(phase * 5.1) * 0.1;
+  return position + float3(sway, 0, sway * 0.5) * strength * saturate(position.y);
+}
+
+export float3 TriplanarWeights(float3 normal) {
+  float3 w = pow(abs(normal), 4);
+  return w / (w.x + w.y + w.z);
+}
+
+export float4 SampleTriplanar(float3 worldPos, float3 normal) {
+  float3 w = TriplanarWeights(normal);
+  float4 x = detail.Sample(linearSampler, worldPos.zy);
+  float4 y = detail.Sample(linearSampler, worldPos.xz);
+  float4 z = detail.Sample(linearSampler, worldPos.xy);
+  return x * w.x + y * w.y + z * w.z;
+}
+
+export float3 Tonemap(float3 color) {
+  const float a = 2.51, b = 0.03, c = 2.43, d = 0.59, e = 0.14;
+  return saturate((color * (a * color + b)) / (color * (c * color + d) + e));
+}
+
+[shader("vertex")]
+VSOut VSMain(VSIn input) {
+  float4x4 world = instanceTransforms[input.instance];
+  float3 position = Wind(input.position, 0.2);
+  float4 worldPos = mul(float4(position, 1), world);
+  VSOut output;
+  output.position = mul(worldPos, viewProj);
+  output.worldPos = worldPos.xyz;
+  output.normal = normalize(mul(float4(input.normal, 0), world).xyz);
+  output.uv = input.uv;
+  return output;
+}
+
+[shader("pixel")]
+float4 PSMain(VSOut input) : SV_Target {
+  float4 base = albedo.Sample(linearSampler, input.uv);
+  float4 detailColor = SampleTriplanar(input.worldPos, input.normal);
+  float3 lit = base.rgb * detailColor.rgb * 2 *
+               saturate(dot(input.normal, normalize(cameraPosition - input.worldPos)));
+  return float4(Tonemap(lit), base.a);
+}
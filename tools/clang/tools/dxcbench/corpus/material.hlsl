@@ -0,0 +1,105 @@
+// Uber material pixel shader. Every feature switch is compiled both ways, so
+// the corpus covers the permutation explosion of a typical material system.
+
+#include "material_common.hlsli"
+
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 1
+#endif
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+#ifndef FOG
+#define FOG 1
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 0
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 1
+#endif
+
+Surface GetSurface(SurfaceInput input) {
+  Surface s;
+  float4 base = baseColorMap.Sample(materialSampler, input.uv) * baseColorFactor;
+  s.albedo = base.rgb;
+  s.alpha = base.a;
+#if ALPHA_TEST
+  clip(s.alpha - alphaCutoff);
+#endif
+
+  float3 N = normalize(input.normal);
+#if NORMAL_MAP
+  float3 T = normalize(input.tangent.xyz - N * dot(N, input.tangent.xyz));
+  float3 B = cross(N, T) * input.tangent.w;
+  float3 tn = normalMap.Sample(materialSampler, input.uv).xyz * 2 - 1;
+  tn.xy *= normalScale;
+  N = normalize(tn.x * T + tn.y * B + tn.z * N);
+#endif
+  s.normal = N;
+
+  float4 mr = metallicRoughnessMap.Sample(materialSampler, input.uv);
+  s.metallic = mr.b * metallicFactor;
+  s.roughness = clamp(mr.g * roughnessFactor, 0.04, 1);
+  s.occlusion = occlusionMap.Sample(materialSampler, input.uv).r;
+  s.emissive = emissiveMap.Sample(materialSampler, input.uv).rgb * emissiveFactor;
+  return s;
+}
+
+float ShadowFactor(float4 shadowCoord) {
+#if SHADOWS
+  float3 coord = shadowCoord.xyz / shadowCoord.w;
+  float2 uv = coord.xy * float2(0.5, -0.5) + 0.5;
+  float sum = 0;
+  [unroll]
+  for (int y = -1; y <= 1; ++y) {
+    [unroll]
+    for (int x = -1; x <= 1; ++x)
+      sum += shadowMap.SampleCmpLevelZero(shadowSampler, uv,
+                                          coord.z - shadowBias, int2(x, y));
+  }
+  return sum / 9;
+#else
+  return 1;
+#endif
+}
+
+float3 ApplyFog(float3 color, float3 worldPos) {
+#if FOG
+  float3 toCamera = worldPos - cameraPosition;
+  float dist = length(toCamera);
+  float heightTerm = exp(-fogHeightFalloff * worldPos.y);
+  float fog = 1 - exp(-fogDensity * dist * heightTerm);
+  return lerp(color, fogColor, saturate(fog));
+#else
+  return color;
+#endif
+}
+
+float4 PSMain(SurfaceInput input) : SV_Target {
+  Surface s = GetSurface(input);
+  float3 V = normalize(cameraPosition - input.worldPos);
+
+  float3 color = EvaluateBRDF(s, -sunDirection, V, sunColor * sunIntensity) *
+                 ShadowFactor(input.shadowCoord);
+
+#if POINT_LIGHTS
+  for (uint i = 0; i < pointLightCount; ++i) {
+    PointLight light = pointLights[i];
+    float3 toLight = light.position - input.worldPos;
+    float dist = length(toLight);
+    float falloff = saturate(1 - pow(dist / light.radius, 4));
+    float attenuation = falloff * falloff / (dist * dist + 1);
+    color += EvaluateBRDF(s, toLight / dist, V,
+                          light.color * light.intensity * attenuation);
+  }
+#endif
+
+  float3 R = reflect(-V, s.normal);
+  float3 env = environmentMap.SampleLevel(materialSampler, R, s.roughness * 8).rgb;
+  float3 f0 = lerp(0.04, s.albedo, s.metallic);
+  color += env * FresnelSchlick(saturate(dot(s.normal, V)), f0) * specularFactor;
+  color += ambientColor * s.albedo * s.occlusion;
+  color += s.emissive;
+  return float4(ApplyFog(color, input.worldPos), s.alpha);
+}
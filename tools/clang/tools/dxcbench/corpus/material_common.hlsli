@@ -0,0 +1,98 @@
+// Shared declarations for the material permutations.
+
+#ifndef MATERIAL_COMMON_HLSLI
+#define MATERIAL_COMMON_HLSLI
+
+#define PI 3.14159265
+
+struct SurfaceInput {
+  float4 position : SV_Position;
+  float3 worldPos : POSITION1;
+  float3 normal : NORMAL;
+  float4 tangent : TANGENT;
+  float2 uv : TEXCOORD0;
+  float4 shadowCoord : TEXCOORD1;
+};
+
+struct Surface {
+  float3 albedo;
+  float alpha;
+  float3 normal;
+  float metallic;
+  float roughness;
+  float occlusion;
+  float3 emissive;
+};
+
+cbuffer MaterialConstants : register(b1) {
+  float4 baseColorFactor;
+  float3 emissiveFactor;
+  float metallicFactor;
+  float roughnessFactor;
+  float normalScale;
+  float alphaCutoff;
+  float specularFactor;
+};
+
+cbuffer ViewConstants : register(b0) {
+  float3 cameraPosition;
+  float fogDensity;
+  float3 sunDirection;
+  float sunIntensity;
+  float3 sunColor;
+  float fogHeightFalloff;
+  float3 fogColor;
+  float shadowBias;
+  float3 ambientColor;
+  uint pointLightCount;
+};
+
+struct PointLight {
+  float3 position;
+  float radius;
+  float3 color;
+  float intensity;
+};
+
+Texture2D<float4> baseColorMap : register(t0);
+Texture2D<float4> normalMap : register(t1);
+Texture2D<float4> metallicRoughnessMap : register(t2);
+Texture2D<float4> occlusionMap : register(t3);
+Texture2D<float4> emissiveMap : register(t4);
+Texture2D<float> shadowMap : register(t5);
+TextureCube<float4> environmentMap : register(t6);
+StructuredBuffer<PointLight> pointLights : register(t7);
+SamplerState materialSampler : register(s0);
+SamplerComparisonState shadowSampler : register(s1);
+
+float3 FresnelSchlick(float cosTheta, float3 f0) {
+  return f0 + (1 - f0) * pow(saturate(1 - cosTheta), 5);
+}
+
+float DistributionGGX(float NdotH, float roughness) {
+  float a2 = roughness * roughness * roughness * roughness;
+  float d = NdotH * NdotH * (a2 - 1) + 1;
+  return a2 / (PI * d * d);
+}
+
+float VisibilitySmithGGX(float NdotV, float NdotL, float roughness) {
+  float a2 = roughness * roughness * roughness * roughness;
+  float gv = NdotL * sqrt(NdotV * NdotV * (1 - a2) + a2);
+  float gl = NdotV * sqrt(NdotL * NdotL * (1 - a2) + a2);
+  return 0.5 / max(gv + gl, 1e-5);
+}
+
+float3 EvaluateBRDF(Surface s, float3 L, float3 V, float3 radiance) {
+  float3 H = normalize(L + V);
+  float NdotL = saturate(dot(s.normal, L));
+  float NdotV = saturate(dot(s.normal, V)) + 1e-4;
+  float NdotH = saturate(dot(s.normal, H));
+  float3 f0 = lerp(0.04, s.albedo, s.metallic);
+  float3 F = FresnelSchlick(saturate(dot(H, V)), f0);
+  float3 specular = DistributionGGX(NdotH, s.roughness) *
+                    VisibilitySmithGGX(NdotV, NdotL, s.roughness) * F;
+  float3 diffuse = (1 - F) * (1 - s.metallic) * s.albedo / PI;
+  return (diffuse + specular) * radiance * NdotL;
+}
+
+#endif // MATERIAL_COMMON_HLSLI
@@ -0,0 +1,137 @@
+// Meshlet pipeline: an amplification shader culling meshlets against the
+// view frustum and a normal cone, and the mesh shader that expands them.
+
+#define AS_GROUP_SIZE 32
+#define MAX_VERTS 64
+#define MAX_PRIMS 126
+
+struct Meshlet {
+  uint vertexCount;
+  uint vertexOffset;
+  uint primitiveCount;
+  uint primitiveOffset;
+};
+
+struct CullData {
+  float4 boundingSphere;
+  uint normalCone;
+  float apexOffset;
+};
+
+struct Payload {
+  uint meshletIndices[AS_GROUP_SIZE];
+};
+
+struct VertexOut {
+  float4 position : SV_Position;
+  float3 normal : NORMAL;
+  float2 uv : TEXCOORD0;
+  float3 worldPos : POSITION1;
+};
+
+struct PrimitiveOut {
+  uint meshletIndex : MESHLET_INDEX;
+  bool culled : SV_CullPrimitive;
+};
+
+cbuffer Constants : register(b0) {
+  row_major float4x4 world;
+  row_major float4x4 viewProj;
+  float4 planes[6];
+  float3 viewPosition;
+  uint meshletCount;
+  float scale;
+};
+
+StructuredBuffer<float3> positions : register(t0);
+StructuredBuffer<float3> normals : register(t1);
+StructuredBuffer<float2> uvs : register(t2);
+StructuredBuffer<Meshlet> meshlets : register(t3);
+ByteAddressBuffer uniqueVertexIndices : register(t4);
+StructuredBuffer<uint> primitiveIndices : register(t5);
+StructuredBuffer<CullData> cullData : register(t6);
+
+groupshared Payload gsPayload;
+
+float4 UnpackCone(uint packed) {
+  float4 v;
+  v.x = float((packed >> 0) & 0xff);
+  v.y = float((packed >> 8) & 0xff);
+  v.z = float((packed >> 16) & 0xff);
+  v.w = float((packed >> 24) & 0xff);
+  v = v / 255.0;
+  v.xyz = v.xyz * 2.0 - 1.0;
+  return v;
+}
+
+bool IsVisible(CullData c) {
+  float4 center = mul(float4(c.boundingSphere.xyz, 1), world);
+  float radius = c.boundingSphere.w * scale;
+  [unroll]
+  for (int i = 0; i < 6; ++i) {
+    if (dot(center, planes[i]) < -radius)
+      return false;
+  }
+  float4 cone = UnpackCone(c.normalCone);
+  if (cone.w >= 1)
+    return true;
+  float3 axis = normalize(mul(float4(cone.xyz, 0), world).xyz);
+  float3 apex = center.xyz - axis * c.apexOffset * scale;
+  float3 view = normalize(viewPosition - apex);
+  return dot(view, -axis) <= cone.w;
+}
+
+uint3 UnpackPrimitive(uint primitive) {
+  return uint3(primitive & 0x3ff, (primitive >> 10) & 0x3ff,
+               (primitive >> 20) & 0x3ff);
+}
+
+[numthreads(AS_GROUP_SIZE, 1, 1)]
+void ASMain(uint gtid : SV_GroupThreadID, uint dtid : SV_DispatchThreadID,
+            uint gid : SV_GroupID) {
+  bool visible = false;
+  if (dtid < meshletCount)
+    visible = IsVisible(cullData[dtid]);
+  if (visible) {
+    uint index = WavePrefixCountBits(visible);
+    gsPayload.meshletIndices[index] = dtid;
+  }
+  uint visibleCount = WaveActiveCountBits(visible);
+  DispatchMesh(visibleCount, 1, 1, gsPayload);
+}
+
+[numthreads(128, 1, 1)]
+[outputtopology("triangle")]
+void MSMain(uint gtid : SV_GroupThreadID, uint gid : SV_GroupID,
+            in payload Payload payload,
+            out indices uint3 tris[MAX_PRIMS],
+            out vertices VertexOut verts[MAX_VERTS],
+            out primitives PrimitiveOut prims[MAX_PRIMS]) {
+  uint meshletIndex = payload.meshletIndices[gid];
+  Meshlet m = meshlets[meshletIndex];
+  SetMeshOutputCounts(m.vertexCount, m.primitiveCount);
+
+  if (gtid < m.primitiveCount) {
+    uint3 tri = UnpackPrimitive(primitiveIndices[m.primitiveOffset + gtid]);
+    tris[gtid] = tri;
+    PrimitiveOut p;
+    p.meshletIndex = meshletIndex;
+    float3 a = positions[uniqueVertexIndices.Load((m.vertexOffset + tri.x) * 4)];
+    float3 b = positions[uniqueVertexIndices.Load((m.vertexOffset + tri.y) * 4)];
+    float3 c = positions[uniqueVertexIndices.Load((m.vertexOffset + tri.z) * 4)];
+    float3 faceNormal = cross(b - a, c - a);
+    p.culled = dot(faceNormal, viewPosition - a) < 0;
+    prims[gtid] = p;
+  }
+
+  if (gtid < m.vertexCount) {
+    uint vertexIndex = uniqueVertexIndices.Load((m.vertexOffset + gtid) * 4);
+    float4 worldPos = mul(float4(positions[vertexIndex], 1), world);
+    VertexOut v;
+    v.position = mul(worldPos, viewProj);
+    v.worldPos = worldPos.xyz;
+    v.normal = normalize(mul(float4(normals[vertexIndex], 0), world).xyz);
+    v.uv = uvs[vertexIndex];
+    verts[gtid] = v;
+  }
+}
@@ -0,0 +1,259 @@
+// Raytracing library: ray generation, miss, closest hit, any hit,
+// intersection and callable shaders sharing helper code.
+
+struct Vertex {
+  float3 position;
+  float3 normal;
+  float4 tangent;
+  float2 uv;
+};
+
+struct Material {
+  float4 baseColor;
+  float metallic;
+  float roughness;
+  float alphaCutoff;
+  uint textureIndex;
+};
+
+struct RadiancePayload {
+  float3 radiance;
+  float3 throughput;
+  uint depth;
+  uint seed;
+};
+
+struct ShadowPayload {
+  bool hit;
+};
+
+struct SphereAttributes {
+  float3 normal;
+};
+
+struct CallableData {
+  float3 value;
+  float2 uv;
+};
+
+cbuffer SceneConstants : register(b0) {
+  row_major float4x4 invView;
+  row_major float4x4 invProj;
+  float3 sunDirection;
+  float sunIntensity;
+  float3 skyColor;
+  uint frameIndex;
+  uint maxDepth;
+  uint samplesPerPixel;
+};
+
+RaytracingAccelerationStructure scene : register(t0);
+StructuredBuffer<Vertex> vertices : register(t1);
+StructuredBuffer<uint> indices : register(t2);
+StructuredBuffer<Material> materials : register(t3);
+StructuredBuffer<uint> instanceMaterials : register(t4);
+StructuredBuffer<float4> spheres : register(t5);
+Texture2D<float4> textures[] : register(t0, space1);
+SamplerState linearSampler : register(s0);
+RWTexture2D<float4> output : register(u0);
+RWTexture2D<float4> accumulation : register(u1);
+
+uint WangHash(uint seed) {
+  seed = (seed ^ 61) ^ (seed >> 16);
+  seed *= 9;
+  seed = seed ^ (seed >> 4);
+  seed *= 0x27d4eb2d;
+  seed = seed ^ (seed >> 15);
+  return seed;
+}
+
+float NextRandom(inout uint seed) {
+  seed = 1664525 * seed + 1013904223;
+  return (seed & 0x00ffffff) / float(0x01000000);
+}
+
+float3 CosineSampleHemisphere(float3 n, inout uint seed) {
+  float r1 = NextRandom(seed);
+  float r2 = NextRandom(seed);
+  float phi = 2 * 3.14159265 * r1;
+  float r = sqrt(r2);
+  float3 up = abs(n.z) < 0.999 ? float3(0, 0, 1) : float3(1, 0, 0);
+  float3 t = normalize(cross(up, n));
+  float3 b = cross(n, t);
+  return normalize(t * (r * cos(phi)) + b * (r * sin(phi)) + n * sqrt(1 - r2));
+}
+
+Vertex InterpolateVertex(uint primitive, float2 barycentrics) {
+  uint i0 = indices[primitive * 3 + 0];
+  uint i1 = indices[primitive * 3 + 1];
+  uint i2 = indices[primitive * 3 + 2];
+  float3 w = float3(1 - barycentrics.x - barycentrics.y, barycentrics);
+  Vertex v0 = vertices[i0], v1 = vertices[i1], v2 = vertices[i2];
+  Vertex v;
+  v.position = v0.position * w.x + v1.position * w.y + v2.position * w.z;
+  v.normal = normalize(v0.normal * w.x + v1.normal * w.y + v2.normal * w.z);
+  v.tangent = v0.tangent * w.x + v1.tangent * w.y + v2.tangent * w.z;
+  v.uv = v0.uv * w.x + v1.uv * w.y + v2.uv * w.z;
+  return v;
+}
+
+float4 SampleMaterial(Material m, float2 uv) {
+  float4 color = m.baseColor;
+  if (m.textureIndex != 0xffffffff)
+    color *= textures[NonUniformResourceIndex(m.textureIndex)]
+                 .SampleLevel(linearSampler, uv, 0);
+  return color;
+}
+
+bool TraceShadow(float3 origin, float3 direction, float tMax) {
+  RayDesc ray;
+  ray.Origin = origin;
+  ray.Direction = direction;
+  ray.TMin = 1e-3;
+  ray.TMax = tMax;
+  ShadowPayload payload;
+  payload.hit = true;
+  TraceRay(scene,
+           RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH |
+               RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+           0xff, 1, 2, 1, ray, payload);
+  return payload.hit;
+}
+
+[shader("raygeneration")]
+void RayGen() {
+  uint2 pixel = DispatchRaysIndex().xy;
+  uint2 size = DispatchRaysDimensions().xy;
+  uint seed = WangHash(pixel.x + pixel.y * size.x + frameIndex * size.x * size.y);
+  float3 total = 0;
+  for (uint s = 0; s < samplesPerPixel; ++s) {
+    float2 jitter = float2(NextRandom(seed), NextRandom(seed));
+    float2 ndc = (pixel + jitter) / size * float2(2, -2) + float2(-1, 1);
+    float4 target = mul(float4(ndc, 1, 1), invProj);
+    RayDesc ray;
+    ray.Origin = mul(float4(0, 0, 0, 1), invView).xyz;
+    ray.Direction = normalize(mul(float4(target.xyz, 0), invView).xyz);
+    ray.TMin = 0;
+    ray.TMax = 1e27;
+    RadiancePayload payload;
+    payload.radiance = 0;
+    payload.throughput = 1;
+    payload.depth = 0;
+    payload.seed = seed;
+    TraceRay(scene, RAY_FLAG_NONE, 0xff, 0, 2, 0, ray, payload);
+    seed = payload.seed;
+    total += payload.radiance;
+  }
+  float3 color = total / max(samplesPerPixel, 1);
+  float4 previous = accumulation[pixel];
+  float weight = 1.0 / (previous.w + 1);
+  float4 accumulated = float4(lerp(previous.rgb, color, weight), previous.w + 1);
+  accumulation[pixel] = accumulated;
+  output[pixel] = float4(accumulated.rgb / (1 + accumulated.rgb), 1);
+}
+
+[shader("miss")]
+void Miss(inout RadiancePayload payload) {
+  float t = saturate(WorldRayDirection().y * 0.5 + 0.5);
+  float3 sky = lerp(float3(1, 1, 1), skyColor, t);
+  float sun = pow(saturate(dot(WorldRayDirection(), -sunDirection)), 512);
+  payload.radiance += payload.throughput * (sky + sun * sunIntensity);
+}
+
+[shader("miss")]
+void ShadowMiss(inout ShadowPayload payload) {
+  payload.hit = false;
+}
+
+[shader("closesthit")]
+void ClosestHit(inout RadiancePayload payload,
+                BuiltInTriangleIntersectionAttributes attr) {
+  Vertex v = InterpolateVertex(PrimitiveIndex(), attr.barycentrics);
+  Material m = materials[instanceMaterials[InstanceID()]];
+  float3 N = normalize(mul(v.normal, (float3x3)ObjectToWorld3x4()));
+  float3 P = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
+  float4 albedo = SampleMaterial(m, v.uv);
+
+  CallableData emissive;
+  emissive.value = 0;
+  emissive.uv = v.uv;
+  if (m.textureIndex != 0xffffffff)
+    CallShader(0, emissive);
+
+  float3 direct = 0;
+  if (!TraceShadow(P + N * 1e-3, -sunDirection, 1e27))
+    direct = albedo.rgb * saturate(dot(N, -sunDirection)) * sunIntensity;
+  payload.radiance += payload.throughput * (direct + emissive.value);
+
+  if (payload.depth + 1 < maxDepth) {
+    payload.throughput *= albedo.rgb * (1 - m.metallic);
+    float3 bounce = CosineSampleHemisphere(N, payload.seed);
+    if (m.roughness < 0.3)
+      bounce = normalize(lerp(reflect(WorldRayDirection(), N), bounce, m.roughness));
+    RayDesc ray;
+    ray.Origin = P + N * 1e-3;
+    ray.Direction = bounce;
+    ray.TMin = 0;
+    ray.TMax = 1e27;
+    payload.depth += 1;
+    TraceRay(scene, RAY_FLAG_NONE, 0xff, 0, 2, 0, ray, payload);
+  }
+}
+
+[shader("anyhit")]
+void AnyHitAlphaTest(inout RadiancePayload payload,
+                     BuiltInTriangleIntersectionAttributes attr) {
+  Vertex v = InterpolateVertex(PrimitiveIndex(), attr.barycentrics);
+  Material m = materials[instanceMaterials[InstanceID()]];
+  if (SampleMaterial(m, v.uv).a < m.alphaCutoff)
+    IgnoreHit();
+}
+
+[shader("anyhit")]
+void ShadowAnyHit(inout ShadowPayload payload,
+                  BuiltInTriangleIntersectionAttributes attr) {
+  Vertex v = InterpolateVertex(PrimitiveIndex(), attr.barycentrics);
+  Material m = materials[instanceMaterials[InstanceID()]];
+  if (SampleMaterial(m, v.uv).a < m.alphaCutoff)
+    IgnoreHit();
+  else
+    AcceptHitAndEndSearch();
+}
+
+[shader("intersection")]
+void SphereIntersection() {
+  float4 sphere = spheres[PrimitiveIndex()];
+  float3 oc = ObjectRayOrigin() - sphere.xyz;
+  float3 d = ObjectRayDirection();
+  float a = dot(d, d);
+  float b = dot(oc, d);
+  float c = dot(oc, oc) - sphere.w * sphere.w;
+  float disc = b * b - a * c;
+  if (disc < 0)
+    return;
+  float sq = sqrt(disc);
+  float t = (-b - sq) / a;
+  if (t < RayTMin())
+    t = (-b + sq) / a;
+  if (t >= RayTMin() && t <= RayTCurrent()) {
+    SphereAttributes attr;
+    attr.normal = normalize(oc + t * d);
+    ReportHit(t, 0, attr);
+  }
+}
+
+[shader("closesthit")]
+void SphereClosestHit(inout RadiancePayload payload, SphereAttributes attr) {
+  float3 N = normalize(mul(attr.normal, (float3x3)ObjectToWorld3x4()));
+  float3 P = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
+  float lit = TraceShadow(P + N * 1e-3, -sunDirection, 1e27) ? 0 : 1;
+  payload.radiance += payload.throughput * saturate(dot(N, -sunDirection)) *
+                      sunIntensity * lit * 0.8;
+}
+
+[shader("callable")]
+void EmissiveCallable(inout CallableData data) {
+  float2 cell = floor(data.uv * 8);
+  float checker = fmod(cell.x + cell.y, 2);
+  data.value = float3(1, 0.6, 0.2) * checker * 4;
+}
@@ -0,0 +1,90 @@
+// Heavily unrolled code: a large convolution kernel, nested fixed-count
+// loops, a long float-induction loop and a multiplicative-step loop.
+
+#define KERNEL_RADIUS 7
+#define KERNEL_SIZE (2 * KERNEL_RADIUS + 1)
+
+cbuffer Params : register(b0) {
+  float4 weights[KERNEL_SIZE];
+  float2 texelSize;
+  float sharpness;
+  uint mode;
+};
+
+Texture2D<float4> input : register(t0);
+Buffer<float> coefficients : register(t1);
+SamplerState linearSampler : register(s0);
+RWTexture2D<float4> output : register(u0);
+RWBuffer<float> series : register(u1);
+
+groupshared float4 gsTile[16 + 2 * KERNEL_RADIUS][16 + 2 * KERNEL_RADIUS];
+
+float4 Convolve(float2 uv) {
+  float4 sum = 0;
+  [unroll]
+  for (int y = -KERNEL_RADIUS; y <= KERNEL_RADIUS; ++y) {
+    [unroll]
+    for (int x = -KERNEL_RADIUS; x <= KERNEL_RADIUS; ++x) {
+      float w = weights[x + KERNEL_RADIUS].x * weights[y + KERNEL_RADIUS].y;
+      sum += w * input.SampleLevel(linearSampler, uv + float2(x, y) * texelSize, 0);
+    }
+  }
+  return sum;
+}
+
+float4 BilateralFromTile(uint2 local) {
+  float4 center = gsTile[local.y + KERNEL_RADIUS][local.x + KERNEL_RADIUS];
+  float4 sum = 0;
+  float total = 0;
+  [unroll]
+  for (uint y = 0; y < KERNEL_SIZE; ++y) {
+    [unroll]
+    for (uint x = 0; x < KERNEL_SIZE; ++x) {
+      float4 s = gsTile[local.y + y][local.x + x];
+      float d = dot(s - center, s - center);
+      float w = exp(-d * sharpness) * weights[x].z * weights[y].z;
+      sum += s * w;
+      total += w;
+    }
+  }
+  return sum / max(total, 1e-5);
+}
+
+float Series(float x) {
+  float acc = 0;
+  [unroll]
+  for (float f = 0; f < 200; f += 1)
+    acc = acc * x + coefficients[(uint)f] + f;
+  return acc;
+}
+
+float Octaves(float2 p) {
+  float v = 0;
+  [unroll]
+  for (uint i = 1; i < 4096; i *= 2) {
+    float c = coefficients[i];
+    if (c < 0)
+      break;
+    v += c * sin(dot(p, float2(i, i + 1)));
+  }
+  return v;
+}
+
+[numthreads(16, 16, 1)]
+void main(uint3 dtid : SV_DispatchThreadID, uint3 gtid : SV_GroupThreadID,
+          uint gi : SV_GroupIndex) {
+  for (uint i = gi; i < (16 + 2 * KERNEL_RADIUS) * (16 + 2 * KERNEL_RADIUS);
+       i += 256) {
+    uint2 t = uint2(i % (16 + 2 * KERNEL_RADIUS), i / (16 + 2 * KERNEL_RADIUS));
+    int2 src = int2(dtid.xy - gtid.xy + t) - KERNEL_RADIUS;
+    gsTile[t.y][t.x] = input.Load(int3(src, 0));
+  }
+  GroupMemoryBarrierWithGroupSync();
+
+  float2 uv = (dtid.xy + 0.5) * texelSize;
+  float4 color = mode == 0 ? Convolve(uv) : BilateralFromTile(gtid.xy);
+  color.a = Octaves(uv);
+  output[dtid.xy] = color;
+  if (gi == 0)
+    series[dtid.x / 16 + dtid.y] = Series(color.r);
+}
@@ -0,0 +1,101 @@
+# Copyright (C) Microsoft Corporation. All rights reserved.
+# This file is distributed under the University of Illinois Open Source License. See LICENSE.TXT for details.
+"""Compares two dxcbench JSON results and flags regressions.
+
+Usage: dxcbench-compare.py baseline.json candidate.json [options]
+
+Exits with 1 when a phase of the candidate is slower or allocates more than
+the thresholds allow, so it can gate a change in automation.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    if data.get("format") != "dxcbench-1":
+        sys.exit("%s: not a dxcbench-1 result" % path)
+    return data
+
+
+def describe(data):
+    c = data["compiler"]
+    return "%s %s (%s)" % (c["library"], c["version"], c["commit_hash"] or "unknown commit")
+
+
+def change(old, new):
+    return (new - old) * 100.0 / old if old else 0.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two dxcbench results.")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--time-threshold", type=float, default=5.0,
+                        help="median wall time increase in percent that counts as a regression")
+    parser.add_argument("--min-ms", type=float, default=1.0,
+                        help="ignore time changes smaller than this many milliseconds")
+    parser.add_argument("--alloc-threshold", type=float, default=2.0,
+                        help="allocated bytes increase in percent that counts as a regression")
+    parser.add_argument("--breakdown", type=int, default=0, metavar="N",
+                        help="also show the N compile phases that changed the most per entry")
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    cand = load(args.candidate)
+    print("baseline:  " + describe(base))
+    print("candidate: " + describe(cand))
+    print("%-24s %-17s %10s %10s %8s %12s %12s %8s" %
+          ("entry", "phase", "base ms", "new ms", "time", "base bytes", "new bytes", "bytes"))
+
+    base_entries = dict((e["name"], e) for e in base["entries"])
+    regressions = []
+    for entry in cand["entries"]:
+        old_entry = base_entries.get(entry["name"])
+        if old_entry is None:
+            print("%-24s (not in baseline)" % entry["name"])
+            continue
+        for phase_name, phase in entry["phases"].items():
+            old = old_entry["phases"].get(phase_name)
+            if old is None or old["status"] != "ok" or phase["status"] != "ok":
+                status = "%s -> %s" % (old["status"] if old else "missing", phase["status"])
+                print("%-24s %-17s %s" % (entry["name"], phase_name, status))
+                if old and old["status"] == "ok" and phase["status"] == "failed":
+                    regressions.append("%s/%s now fails" % (entry["name"], phase_name))
+                continue
+
+            old_ms, new_ms = old["wall_ms"]["median"], phase["wall_ms"]["median"]
+            old_bytes, new_bytes = old["allocated_bytes"], phase["allocated_bytes"]
+            time_change = change(old_ms, new_ms)
+            alloc_change = change(old_bytes, new_bytes)
+            print("%-24s %-17s %10.2f %10.2f %+7.1f%% %12d %12d %+7.1f%%" %
+                  (entry["name"], phase_name, old_ms, new_ms, time_change,
+                   old_bytes, new_bytes, alloc_change))
+            if time_change > args.time_threshold and new_ms - old_ms > args.min_ms:
+                regressions.append("%s/%s time %+.1f%%" % (entry["name"], phase_name, time_change))
+            if alloc_change > args.alloc_threshold:
+                regressions.append("%s/%s allocations %+.1f%%" % (entry["name"], phase_name, alloc_change))
+
+            if args.breakdown and "breakdown_ms" in phase:
+                old_rows = old.get("breakdown_ms", {})
+                rows = [(name, old_rows.get(name, 0.0), ms)
+                        for name, ms in phase["breakdown_ms"].items()]
+                rows += [(name, ms, 0.0) for name, ms in old_rows.items()
+                         if name not in phase["breakdown_ms"]]
+                rows.sort(key=lambda r: abs(r[2] - r[1]), reverse=True)
+                for name, old_row, new_row in rows[:args.breakdown]:
+                    print("    %-48s %10.2f %10.2f %+9.2f" % (name, old_row, new_row, new_row - old_row))
+
+    print("peak RSS: %d KB -> %d KB" % (base["peak_rss_kb"], cand["peak_rss_kb"]))
+    if regressions:
+        print("\nregressions:")
+        for r in regressions:
+            print("  " + r)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
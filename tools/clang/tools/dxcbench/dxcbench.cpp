@@ -0,0 +1,987 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbench.cpp                                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxcbench console program.                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// dxcbench measures compile throughput. It runs every entry of a corpus
+// manifest through the compiler, linker, validator, container reflection and
+// SPIR-V paths of the API, and reports wall time, allocations and memory for
+// each phase. The JSON it writes is meant to be compared across commits with
+// dxcbench-compare.py.
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <d3d12shader.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+#endif
+
+#ifndef STDOUT_FILENO
+#define STDOUT_FILENO 1
+#endif
+
+using namespace llvm;
+using namespace dxc;
+
+static cl::opt<bool> Help("help", cl::desc("Print help"));
+static cl::alias Help_h("h", cl::aliasopt(Help));
+static cl::alias Help_q("?", cl::aliasopt(Help));
+
+static cl::opt<std::string> CorpusFilename(cl::Positional,
+                                           cl::desc("<corpus manifest>"));
+
+static cl::opt<std::string> OutputFilename("o",
+                                           cl::desc("Write JSON results to file ('-' for stdout)"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<unsigned> Repetitions("n",
+                                     cl::desc("Measured repetitions per entry"),
+                                     cl::init(5));
+
+static cl::opt<unsigned> Warmup("warmup",
+                                cl::desc("Unmeasured repetitions per entry"),
+                                cl::init(1));
+
+static cl::opt<std::string> Filter("filter",
+                                   cl::desc("Only run entries whose name contains this string"));
+
+static cl::opt<std::string> DllPath("dll",
+                                    cl::desc("Compiler library to measure instead of the default one"),
+                                    cl::value_desc("path"));
+
+static cl::list<std::string> ExtraArgs("arg",
+                                       cl::desc("Extra compiler argument for every entry"),
+                                       cl::value_desc("argument"));
+
+//===----------------------------------------------------------------------===//
+// Allocation accounting.
+//
+// On Windows everything the compiler allocates goes through the IMalloc it was
+// created with. Elsewhere only blobs and streams do, and the rest comes from
+// operator new, so this program replaces operator new for the whole process.
+// That also keeps the -fcompile-arena allocator from being installed here.
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct AllocCounters {
+  std::atomic<uint64_t> Count;
+  std::atomic<uint64_t> Bytes;
+  std::atomic<int64_t> Live;
+  std::atomic<int64_t> Peak;
+};
+
+struct AllocSnapshot {
+  uint64_t Count;
+  uint64_t Bytes;
+  int64_t Live;
+};
+}
+
+static AllocCounters g_Allocs;
+
+static size_t AllocatedSize(void *ptr) {
+#ifdef _WIN32
+  return _msize(ptr);
+#elif defined(__APPLE__)
+  return malloc_size(ptr);
+#else
+  return malloc_usable_size(ptr);
+#endif
+}
+
+static void CountAlloc(void *ptr) {
+  if (ptr == nullptr)
+    return;
+  size_t size = AllocatedSize(ptr);
+  g_Allocs.Count.fetch_add(1, std::memory_order_relaxed);
+  g_Allocs.Bytes.fetch_add(size, std::memory_order_relaxed);
+  int64_t live = g_Allocs.Live.fetch_add(size, std::memory_order_relaxed) + size;
+  int64_t peak = g_Allocs.Peak.load(std::memory_order_relaxed);
+  while (live > peak &&
+         !g_Allocs.Peak.compare_exchange_weak(peak, live,
+                                              std::memory_order_relaxed))
+    ;
+}
+
+static void CountFree(void *ptr) {
+  if (ptr != nullptr)
+    g_Allocs.Live.fetch_sub(AllocatedSize(ptr), std::memory_order_relaxed);
+}
+
+static AllocSnapshot TakeAllocSnapshot() {
+  AllocSnapshot S;
+  S.Count = g_Allocs.Count.load(std::memory_order_relaxed);
+  S.Bytes = g_Allocs.Bytes.load(std::memory_order_relaxed);
+  S.Live = g_Allocs.Live.load(std::memory_order_relaxed);
+  // Peak live memory is measured from here on.
+  g_Allocs.Peak.store(S.Live, std::memory_order_relaxed);
+  return S;
+}
+
+#ifndef _WIN32
+void *operator new(std::size_t size) {
+  void *ptr = malloc(size ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  CountAlloc(ptr);
+  return ptr;
+}
+void *operator new(std::size_t size, const std::nothrow_t &) throw() {
+  void *ptr = malloc(size ? size : 1);
+  CountAlloc(ptr);
+  return ptr;
+}
+void operator delete(void *ptr) throw() {
+  CountFree(ptr);
+  free(ptr);
+}
+void operator delete(void *ptr, const std::nothrow_t &) throw() {
+  CountFree(ptr);
+  free(ptr);
+}
+#endif
+
+class CountingMalloc : public IMalloc {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  void *STDMETHODCALLTYPE Alloc(SIZE_T size) override {
+    void *ptr = malloc(size ? size : 1);
+    CountAlloc(ptr);
+    return ptr;
+  }
+  void *STDMETHODCALLTYPE Realloc(void *ptr, SIZE_T size) override {
+    CountFree(ptr);
+    void *newPtr = realloc(ptr, size);
+    // realloc leaves the old block alone when it fails.
+    CountAlloc(newPtr ? newPtr : (size ? ptr : nullptr));
+    return newPtr;
+  }
+  void STDMETHODCALLTYPE Free(void *ptr) override {
+    CountFree(ptr);
+    free(ptr);
+  }
+#ifdef _WIN32
+  SIZE_T STDMETHODCALLTYPE GetSize(void *ptr) override {
+    return ptr ? AllocatedSize(ptr) : (SIZE_T)-1;
+  }
+  int STDMETHODCALLTYPE DidAlloc(void *) override { return -1; }
+  void STDMETHODCALLTYPE HeapMinimize() override {}
+#endif
+};
+
+static uint64_t GetPeakRSSKB() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize >> 10;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (uint64_t)usage.ru_maxrss >> 10; // Bytes on macOS.
+#else
+  return (uint64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Corpus manifest.
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct LinkTarget {
+  std::string Target;
+  std::string Entry;
+};
+
+struct CorpusEntry {
+  std::string Name;
+  std::string File;   // As written in the manifest.
+  std::string Path;   // Resolved against the manifest directory.
+  std::string Target;
+  std::string Entry = "main";
+  std::vector<std::string> Args;
+  std::vector<std::string> Permute;
+  std::vector<LinkTarget> Links;
+  bool SpirV = false;
+
+  bool IsLibrary() const { return StringRef(Target).startswith("lib_"); }
+  unsigned VariantCount() const { return 1u << Permute.size(); }
+};
+}
+
+static void SplitList(StringRef list, std::vector<std::string> &items) {
+  SmallVector<StringRef, 8> parts;
+  list.split(parts, ",", -1, false);
+  for (StringRef part : parts)
+    items.push_back(part.trim().str());
+}
+
+static std::vector<CorpusEntry> ReadCorpus(const std::string &manifest) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> input = MemoryBuffer::getFile(manifest);
+  if (!input)
+    throw hlsl::Exception(E_FAIL, "cannot open corpus manifest " + manifest +
+                                      ": " + input.getError().message());
+
+  SmallString<128> dir(manifest);
+  sys::path::remove_filename(dir);
+
+  std::vector<CorpusEntry> entries;
+  SmallVector<StringRef, 32> lines;
+  (*input)->getBuffer().split(lines, "\n");
+  for (unsigned lineNumber = 1; lineNumber <= lines.size(); ++lineNumber) {
+    StringRef text = lines[lineNumber - 1].split('#').first.trim();
+    if (text.empty())
+      continue;
+    SmallVector<StringRef, 8> fields;
+    text.split(fields, " ", -1, false);
+    auto fail = [&](const Twine &msg) {
+      throw hlsl::Exception(E_INVALIDARG, (manifest + ":" + Twine(lineNumber) +
+                                           ": " + msg).str());
+    };
+    if (fields.size() < 3)
+      fail("expected <name> <file> <target>");
+
+    CorpusEntry E;
+    E.Name = fields[0].str();
+    E.File = fields[1].str();
+    E.Target = fields[2].str();
+    SmallString<128> path(dir);
+    sys::path::append(path, E.File);
+    E.Path = path.str();
+    for (StringRef field : makeArrayRef(fields).slice(3)) {
+      std::pair<StringRef, StringRef> kv = field.split('=');
+      if (kv.first == "entry")
+        E.Entry = kv.second.str();
+      else if (kv.first == "arg")
+        E.Args.push_back(kv.second.str());
+      else if (kv.first == "permute")
+        SplitList(kv.second, E.Permute);
+      else if (kv.first == "spirv" && kv.second.empty())
+        E.SpirV = true;
+      else if (kv.first == "link") {
+        std::vector<std::string> links;
+        SplitList(kv.second, links);
+        for (const std::string &link : links) {
+          std::pair<StringRef, StringRef> te = StringRef(link).split(':');
+          if (te.first.empty() || te.second.empty())
+            fail("expected link=<target>:<entry>,...");
+          E.Links.push_back({ te.first.str(), te.second.str() });
+        }
+      }
+      else
+        fail("unknown key '" + kv.first + "'");
+    }
+    if (E.Permute.size() > 10)
+      fail("too many permutation switches");
+    if (!E.Links.empty() && !E.IsLibrary())
+      fail("only lib_* targets can be linked");
+    entries.push_back(std::move(E));
+  }
+  return entries;
+}
+
+//===----------------------------------------------------------------------===//
+// Measurement.
+//===----------------------------------------------------------------------===//
+
+namespace {
+enum class PhaseStatus { NotRun, Ok, Failed, Unavailable };
+
+struct PhaseResult {
+  PhaseStatus Status = PhaseStatus::NotRun;
+  std::string Message;
+  std::vector<double> WallMs;         // One total per measured repetition.
+  uint64_t Allocations = 0;           // Per repetition.
+  uint64_t AllocatedBytes = 0;        // Per repetition.
+  uint64_t PeakLiveBytes = 0;         // Most held by a single operation.
+  uint64_t OutputBytes = 0;           // Per repetition.
+  std::map<std::string, double> BreakdownMs; // Fastest repetition per row.
+
+  // Totals of the repetition in progress.
+  double RepWallMs = 0;
+  uint64_t RepAllocations = 0;
+  uint64_t RepAllocatedBytes = 0;
+  uint64_t RepOutputBytes = 0;
+  std::map<std::string, double> RepBreakdownMs;
+
+  void Fail(PhaseStatus status, const std::string &msg) {
+    Status = status;
+    Message = msg;
+  }
+  void EndRepetition() {
+    if (Status != PhaseStatus::Ok)
+      return;
+    WallMs.push_back(RepWallMs);
+    Allocations = RepAllocations;
+    AllocatedBytes = RepAllocatedBytes;
+    OutputBytes = RepOutputBytes;
+    for (const auto &row : RepBreakdownMs) {
+      auto it = BreakdownMs.find(row.first);
+      if (it == BreakdownMs.end() || row.second < it->second)
+        BreakdownMs[row.first] = row.second;
+    }
+    RepWallMs = 0;
+    RepAllocations = RepAllocatedBytes = RepOutputBytes = 0;
+    RepBreakdownMs.clear();
+  }
+};
+
+// Measures one operation and adds it to the phase totals.
+class PhaseTimer {
+  PhaseResult &m_phase;
+  AllocSnapshot m_start;
+  std::chrono::steady_clock::time_point m_startTime;
+
+public:
+  PhaseTimer(PhaseResult &phase)
+      : m_phase(phase), m_start(TakeAllocSnapshot()),
+        m_startTime(std::chrono::steady_clock::now()) {}
+  ~PhaseTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - m_startTime;
+    m_phase.RepWallMs +=
+        std::chrono::duration<double, std::milli>(elapsed).count();
+    m_phase.RepAllocations +=
+        g_Allocs.Count.load(std::memory_order_relaxed) - m_start.Count;
+    m_phase.RepAllocatedBytes +=
+        g_Allocs.Bytes.load(std::memory_order_relaxed) - m_start.Bytes;
+    int64_t peak = g_Allocs.Peak.load(std::memory_order_relaxed) - m_start.Live;
+    m_phase.PeakLiveBytes =
+        std::max<uint64_t>(m_phase.PeakLiveBytes, peak > 0 ? peak : 0);
+  }
+};
+
+struct EntryResult {
+  const CorpusEntry *Entry;
+  // All phases are added before the first repetition, so that references to
+  // them stay valid while it runs.
+  std::vector<std::pair<const char *, PhaseResult>> Phases;
+
+  PhaseResult *Find(const char *name) {
+    for (auto &phase : Phases)
+      if (strcmp(phase.first, name) == 0)
+        return &phase.second;
+    return nullptr;
+  }
+  bool Failed() const {
+    for (const auto &phase : Phases)
+      if (phase.second.Status == PhaseStatus::Failed)
+        return true;
+    return false;
+  }
+};
+}
+
+static std::string FirstLine(StringRef text) {
+  return text.trim().split('\n').first.rtrim().str();
+}
+
+static std::string GetErrorText(IDxcOperationResult *pResult) {
+  CComPtr<IDxcBlobEncoding> pErrors;
+  if (FAILED(pResult->GetErrorBuffer(&pErrors)) || !pErrors)
+    return std::string();
+  // The buffer may include the string terminator.
+  return StringRef((const char *)pErrors->GetBufferPointer(),
+                   pErrors->GetBufferSize()).rtrim(StringRef("\0", 1)).str();
+}
+
+static bool Succeeded(IDxcOperationResult *pResult, std::string &errors) {
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (SUCCEEDED(status))
+    return true;
+  errors = GetErrorText(pResult);
+  if (errors.empty())
+    errors = "failed with no diagnostics";
+  return false;
+}
+
+// Adds the rows of a -ftime-report to the breakdown of the repetition.
+static void AddTimeReport(IDxcResult *pResult, PhaseResult &phase) {
+  CComPtr<IDxcBlobUtf8> pReport;
+  if (FAILED(pResult->GetOutput(DXC_OUT_TIME_REPORT, __uuidof(IDxcBlobUtf8),
+                                (void **)&pReport, nullptr)) || !pReport)
+    return;
+  SmallVector<StringRef, 64> lines;
+  StringRef(pReport->GetStringPointer(), pReport->GetStringLength())
+      .split(lines, "\n", -1, false);
+  for (StringRef line : lines) {
+    std::string row = line.str();
+    double seconds, percent;
+    unsigned count;
+    int nameOffset = 0;
+    if (sscanf(row.c_str(), " %lf (%lf%%) %u %n", &seconds, &percent, &count,
+               &nameOffset) != 3 || nameOffset == 0)
+      continue;
+    phase.RepBreakdownMs[StringRef(row).substr(nameOffset).rtrim().str()] +=
+        seconds * 1000.0;
+  }
+}
+
+namespace {
+class Benchmark {
+  DxcDllSupport &m_dxcSupport;
+  CComPtr<IMalloc> m_pMalloc;
+  CComPtr<IDxcUtils> m_pUtils;
+  CComPtr<IDxcCompiler3> m_pCompiler;
+
+  HRESULT Create(REFCLSID clsid, REFIID riid, IUnknown **ppResult) {
+    if (m_dxcSupport.HasCreateWithMalloc())
+      return m_dxcSupport.CreateInstance2(m_pMalloc, clsid, riid, ppResult);
+    return m_dxcSupport.CreateInstance(clsid, riid, ppResult);
+  }
+  template <typename TInterface>
+  HRESULT Create(REFCLSID clsid, TInterface **ppResult) {
+    return Create(clsid, __uuidof(TInterface), (IUnknown **)ppResult);
+  }
+
+  void Compile(const CorpusEntry &E, IDxcBlobEncoding *pSource,
+               const std::vector<std::wstring> &defines, bool spirv,
+               PhaseResult &phase, IDxcBlob **ppObject);
+  void Link(const CorpusEntry &E, IDxcBlob *pLibrary, PhaseResult &phase);
+  void Validate(IDxcBlob *pObject, UINT32 flags, PhaseResult &phase);
+  void Reflect(const CorpusEntry &E, IDxcBlob *pObject, PhaseResult &phase);
+
+public:
+  Benchmark(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {
+    m_pMalloc = new CountingMalloc();
+    IFT(Create(CLSID_DxcUtils, &m_pUtils));
+    IFT(Create(CLSID_DxcCompiler, &m_pCompiler));
+  }
+
+  IDxcCompiler3 *GetCompiler() { return m_pCompiler; }
+  void Run(const CorpusEntry &E, EntryResult &result);
+};
+}
+
+void Benchmark::Compile(const CorpusEntry &E, IDxcBlobEncoding *pSource,
+                        const std::vector<std::wstring> &defines, bool spirv,
+                        PhaseResult &phase, IDxcBlob **ppObject) {
+  std::vector<std::wstring> args;
+  args.push_back(Unicode::UTF8ToUTF16StringOrThrow(E.Path.c_str()));
+  args.push_back(L"-T");
+  args.push_back(Unicode::UTF8ToUTF16StringOrThrow(E.Target.c_str()));
+  if (!E.IsLibrary()) {
+    args.push_back(L"-E");
+    args.push_back(Unicode::UTF8ToUTF16StringOrThrow(E.Entry.c_str()));
+  }
+  for (const std::string &arg : E.Args)
+    args.push_back(Unicode::UTF8ToUTF16StringOrThrow(arg.c_str()));
+  for (const std::string &arg : ExtraArgs)
+    args.push_back(Unicode::UTF8ToUTF16StringOrThrow(arg.c_str()));
+  args.insert(args.end(), defines.begin(), defines.end());
+  if (spirv)
+    args.push_back(L"-spirv");
+  else
+    args.push_back(L"-ftime-report");
+  std::vector<LPCWSTR> argPtrs;
+  for (const std::wstring &arg : args)
+    argPtrs.push_back(arg.c_str());
+
+  CComPtr<IDxcResult> pResult;
+  {
+    PhaseTimer timer(phase);
+    // The include handler reads files, which is part of the compile.
+    CComPtr<IDxcIncludeHandler> pIncludeHandler;
+    IFT(m_pUtils->CreateDefaultIncludeHandler(&pIncludeHandler));
+    DxcBuffer source = { pSource->GetBufferPointer(),
+                         pSource->GetBufferSize(), DXC_CP_UTF8 };
+    IFT(m_pCompiler->Compile(&source, argPtrs.data(), (UINT32)argPtrs.size(),
+                             pIncludeHandler, __uuidof(IDxcResult),
+                             (void **)&pResult));
+  }
+
+  std::string errors;
+  if (!Succeeded(pResult, errors)) {
+    if (spirv && errors.find("SPIR-V CodeGen not available") != std::string::npos)
+      phase.Fail(PhaseStatus::Unavailable, FirstLine(errors));
+    else
+      phase.Fail(PhaseStatus::Failed, FirstLine(errors));
+    return;
+  }
+  CComPtr<IDxcBlob> pObject;
+  IFT(pResult->GetOutput(DXC_OUT_OBJECT, __uuidof(IDxcBlob), (void **)&pObject,
+                         nullptr));
+  phase.Status = PhaseStatus::Ok;
+  phase.RepOutputBytes += pObject ? pObject->GetBufferSize() : 0;
+  AddTimeReport(pResult, phase);
+  if (ppObject)
+    *ppObject = pObject.Detach();
+}
+
+void Benchmark::Link(const CorpusEntry &E, IDxcBlob *pLibrary,
+                     PhaseResult &phase) {
+  std::vector<CComPtr<IDxcOperationResult>> results;
+  {
+    PhaseTimer timer(phase);
+    CComPtr<IDxcLinker> pLinker;
+    HRESULT hr = Create(CLSID_DxcLinker, &pLinker);
+    if (hr == REGDB_E_CLASSNOTREG) {
+      phase.Fail(PhaseStatus::Unavailable, "linker not available");
+      return;
+    }
+    IFT(hr);
+    LPCWSTR libName = L"library";
+    IFT(pLinker->RegisterLibrary(libName, pLibrary));
+    for (const LinkTarget &link : E.Links) {
+      std::wstring entry = Unicode::UTF8ToUTF16StringOrThrow(link.Entry.c_str());
+      std::wstring target = Unicode::UTF8ToUTF16StringOrThrow(link.Target.c_str());
+      CComPtr<IDxcOperationResult> pResult;
+      IFT(pLinker->Link(entry.c_str(), target.c_str(), &libName, 1, nullptr, 0,
+                        &pResult));
+      results.push_back(pResult);
+    }
+  }
+
+  for (IDxcOperationResult *pResult : results) {
+    std::string errors;
+    if (!Succeeded(pResult, errors)) {
+      phase.Fail(PhaseStatus::Failed, FirstLine(errors));
+      return;
+    }
+    CComPtr<IDxcBlob> pObject;
+    IFT(pResult->GetResult(&pObject));
+    phase.RepOutputBytes += pObject ? pObject->GetBufferSize() : 0;
+  }
+  phase.Status = PhaseStatus::Ok;
+}
+
+void Benchmark::Validate(IDxcBlob *pObject, UINT32 flags,
+                         PhaseResult &phase) {
+  CComPtr<IDxcOperationResult> pResult;
+  {
+    PhaseTimer timer(phase);
+    CComPtr<IDxcValidator> pValidator;
+    HRESULT hr = Create(CLSID_DxcValidator, &pValidator);
+    if (hr == REGDB_E_CLASSNOTREG) {
+      phase.Fail(PhaseStatus::Unavailable, "validator not available");
+      return;
+    }
+    IFT(hr);
+    IFT(pValidator->Validate(pObject, flags, &pResult));
+  }
+  std::string errors;
+  if (!Succeeded(pResult, errors)) {
+    phase.Fail(PhaseStatus::Failed, FirstLine(errors));
+    return;
+  }
+  phase.Status = PhaseStatus::Ok;
+}
+
+void Benchmark::Reflect(const CorpusEntry &E, IDxcBlob *pObject,
+                        PhaseResult &phase) {
+  PhaseTimer timer(phase);
+  CComPtr<IDxcContainerReflection> pReflection;
+  HRESULT hr = Create(CLSID_DxcContainerReflection, &pReflection);
+  if (hr == REGDB_E_CLASSNOTREG) {
+    phase.Fail(PhaseStatus::Unavailable, "container reflection not available");
+    return;
+  }
+  IFT(hr);
+  IFT(pReflection->Load(pObject));
+  UINT32 partIndex;
+  IFT(pReflection->FindFirstPartKind(hlsl::DFCC_DXIL, &partIndex));
+#ifdef _WIN32
+  // Walk the descriptions, so that lazily built reflection data is counted.
+  if (E.IsLibrary()) {
+    CComPtr<ID3D12LibraryReflection> pLibrary;
+    IFT(pReflection->GetPartReflection(partIndex,
+                                       __uuidof(ID3D12LibraryReflection),
+                                       (void **)&pLibrary));
+    D3D12_LIBRARY_DESC libraryDesc;
+    IFT(pLibrary->GetDesc(&libraryDesc));
+    for (UINT i = 0; i < libraryDesc.FunctionCount; ++i) {
+      D3D12_FUNCTION_DESC functionDesc;
+      IFT(pLibrary->GetFunctionByIndex(i)->GetDesc(&functionDesc));
+    }
+  } else {
+    CComPtr<ID3D12ShaderReflection> pShader;
+    IFT(pReflection->GetPartReflection(partIndex,
+                                       __uuidof(ID3D12ShaderReflection),
+                                       (void **)&pShader));
+    D3D12_SHADER_DESC shaderDesc;
+    IFT(pShader->GetDesc(&shaderDesc));
+    for (UINT i = 0; i < shaderDesc.BoundResources; ++i) {
+      D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+      IFT(pShader->GetResourceBindingDesc(i, &bindDesc));
+    }
+  }
+#else
+  (void)E;
+#endif
+  phase.Status = PhaseStatus::Ok;
+}
+
+void Benchmark::Run(const CorpusEntry &E, EntryResult &result) {
+  result.Entry = &E;
+  result.Phases.emplace_back("compile", PhaseResult());
+  if (!E.Links.empty())
+    result.Phases.emplace_back("link", PhaseResult());
+  result.Phases.emplace_back("validate", PhaseResult());
+  // Libraries are validated a second time with one thread per function, so
+  // the gain from DxcValidatorFlags_ParallelFunctions shows next to the
+  // serial time.
+  if (E.IsLibrary())
+    result.Phases.emplace_back("validate-parallel", PhaseResult());
+  result.Phases.emplace_back("reflect", PhaseResult());
+  if (E.SpirV)
+    result.Phases.emplace_back("spirv", PhaseResult());
+  PhaseResult &compile = *result.Find("compile");
+  PhaseResult *link = result.Find("link");
+  PhaseResult &validate = *result.Find("validate");
+  PhaseResult *validateParallel = result.Find("validate-parallel");
+  PhaseResult &reflect = *result.Find("reflect");
+  PhaseResult *spirv = result.Find("spirv");
+
+  CComPtr<IDxcBlobEncoding> pSource;
+  std::wstring path = Unicode::UTF8ToUTF16StringOrThrow(E.Path.c_str());
+  if (FAILED(m_pUtils->LoadFile(path.c_str(), nullptr, &pSource))) {
+    compile.Fail(PhaseStatus::Failed, "cannot read " + E.Path);
+    return;
+  }
+
+  // Each permutation switch doubles the variants; bit i of the variant index
+  // is the value of switch i.
+  std::vector<std::vector<std::wstring>> variants(E.VariantCount());
+  for (unsigned v = 0; v < variants.size(); ++v)
+    for (unsigned i = 0; i < E.Permute.size(); ++i)
+      variants[v].push_back(Unicode::UTF8ToUTF16StringOrThrow(
+          ("-D" + E.Permute[i] + ((v >> i) & 1 ? "=1" : "=0")).c_str()));
+
+  for (unsigned rep = 0; rep < Warmup + Repetitions; ++rep) {
+    for (const std::vector<std::wstring> &defines : variants) {
+      CComPtr<IDxcBlob> pObject;
+      Compile(E, pSource, defines, false, compile, &pObject);
+      if (compile.Status != PhaseStatus::Ok)
+        return;
+      if (link && link->Status != PhaseStatus::Unavailable)
+        Link(E, pObject, *link);
+      if (validate.Status != PhaseStatus::Unavailable)
+        Validate(pObject, DxcValidatorFlags_Default, validate);
+      if (validateParallel &&
+          validateParallel->Status != PhaseStatus::Unavailable)
+        Validate(pObject, DxcValidatorFlags_ParallelFunctions,
+                 *validateParallel);
+      if (reflect.Status != PhaseStatus::Unavailable)
+        Reflect(E, pObject, reflect);
+      if (spirv && spirv->Status != PhaseStatus::Unavailable)
+        Compile(E, pSource, defines, true, *spirv, nullptr);
+      if (result.Failed())
+        return;
+    }
+
+    for (auto &phase : result.Phases) {
+      if (rep < Warmup) {
+        // Only the status of a warmup repetition is kept.
+        PhaseStatus status = phase.second.Status;
+        std::string message = phase.second.Message;
+        phase.second = PhaseResult();
+        phase.second.Status = status;
+        phase.second.Message = message;
+      } else {
+        phase.second.EndRepetition();
+      }
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Reporting.
+//===----------------------------------------------------------------------===//
+
+static const char *StatusName(PhaseStatus status) {
+  switch (status) {
+  case PhaseStatus::Ok:          return "ok";
+  case PhaseStatus::Failed:      return "failed";
+  case PhaseStatus::Unavailable: return "unavailable";
+  default:                       return "not run";
+  }
+}
+
+static void WriteJSONString(raw_ostream &OS, StringRef str) {
+  OS << '"';
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if (c < 0x20)
+        OS << format("\\u%04x", c);
+      else
+        OS << c;
+    }
+  }
+  OS << '"';
+}
+
+namespace {
+struct WallStats {
+  double Min = 0, Median = 0, Max = 0;
+  WallStats(std::vector<double> samples) {
+    if (samples.empty())
+      return;
+    std::sort(samples.begin(), samples.end());
+    Min = samples.front();
+    Max = samples.back();
+    size_t mid = samples.size() / 2;
+    Median = samples.size() % 2 ? samples[mid]
+                                : (samples[mid - 1] + samples[mid]) / 2;
+  }
+};
+
+struct CompilerInfo {
+  std::string Library;
+  std::string Version;
+  std::string CommitHash;
+  UINT32 CommitCount = 0;
+};
+}
+
+static CompilerInfo GetCompilerInfo(IDxcCompiler3 *pCompiler) {
+  CompilerInfo info;
+  info.Library = DllPath.empty() ? std::string("default") : DllPath;
+  CComPtr<IDxcVersionInfo> pVersion;
+  if (SUCCEEDED(pCompiler->QueryInterface(&pVersion))) {
+    UINT32 major = 0, minor = 0;
+    if (SUCCEEDED(pVersion->GetVersion(&major, &minor)))
+      info.Version = (Twine(major) + "." + Twine(minor)).str();
+  }
+  CComPtr<IDxcVersionInfo2> pVersion2;
+  if (SUCCEEDED(pCompiler->QueryInterface(&pVersion2))) {
+    char *pHash = nullptr;
+    if (SUCCEEDED(pVersion2->GetCommitInfo(&info.CommitCount, &pHash)) && pHash) {
+      info.CommitHash = pHash;
+      CoTaskMemFree(pHash);
+    }
+  }
+  return info;
+}
+
+static void WriteJSON(raw_ostream &OS, const CompilerInfo &info,
+                      const std::vector<EntryResult> &results) {
+  OS << "{\n  \"format\": \"dxcbench-1\",\n  \"compiler\": {\n"
+     << "    \"library\": ";
+  WriteJSONString(OS, info.Library);
+  OS << ",\n    \"version\": ";
+  WriteJSONString(OS, info.Version);
+  OS << ",\n    \"commit_count\": " << info.CommitCount
+     << ",\n    \"commit_hash\": ";
+  WriteJSONString(OS, info.CommitHash);
+  OS << "\n  },\n  \"corpus\": ";
+  WriteJSONString(OS, CorpusFilename);
+  OS << ",\n  \"repetitions\": " << Repetitions.getValue()
+     << ",\n  \"warmup\": " << Warmup.getValue()
+     << ",\n  \"peak_rss_kb\": " << GetPeakRSSKB()
+     << ",\n  \"entries\": [";
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const EntryResult &result = results[i];
+    const CorpusEntry &E = *result.Entry;
+    OS << (i ? ",\n" : "\n") << "    {\n      \"name\": ";
+    WriteJSONString(OS, E.Name);
+    OS << ",\n      \"file\": ";
+    WriteJSONString(OS, E.File);
+    OS << ",\n      \"target\": ";
+    WriteJSONString(OS, E.Target);
+    OS << ",\n      \"variants\": " << E.VariantCount()
+       << ",\n      \"phases\": {";
+    for (size_t p = 0; p < result.Phases.size(); ++p) {
+      const PhaseResult &phase = result.Phases[p].second;
+      OS << (p ? ",\n" : "\n") << "        ";
+      WriteJSONString(OS, result.Phases[p].first);
+      OS << ": {\n          \"status\": ";
+      WriteJSONString(OS, StatusName(phase.Status));
+      if (!phase.Message.empty()) {
+        OS << ",\n          \"message\": ";
+        WriteJSONString(OS, phase.Message);
+      }
+      if (phase.Status == PhaseStatus::Ok) {
+        WallStats wall(phase.WallMs);
+        OS << format(",\n          \"wall_ms\": { \"min\": %.3f, \"median\": "
+                     "%.3f, \"max\": %.3f }",
+                     wall.Min, wall.Median, wall.Max)
+           << ",\n          \"allocations\": " << phase.Allocations
+           << ",\n          \"allocated_bytes\": " << phase.AllocatedBytes
+           << ",\n          \"peak_live_bytes\": " << phase.PeakLiveBytes
+           << ",\n          \"output_bytes\": " << phase.OutputBytes;
+        if (!phase.BreakdownMs.empty()) {
+          OS << ",\n          \"breakdown_ms\": {";
+          bool first = true;
+          for (const auto &row : phase.BreakdownMs) {
+            OS << (first ? "\n" : ",\n") << "            ";
+            first = false;
+            WriteJSONString(OS, row.first);
+            OS << format(": %.3f", row.second);
+          }
+          OS << "\n          }";
+        }
+      }
+      OS << "\n        }";
+    }
+    OS << "\n      }\n    }";
+  }
+  OS << "\n  ]\n}\n";
+}
+
+static void WriteSummary(raw_ostream &OS,
+                         const std::vector<EntryResult> &results) {
+  OS << "entry                    phase               median ms      min ms"
+        "      allocs    alloc MB     peak MB\n";
+  for (const EntryResult &result : results) {
+    for (const auto &phase : result.Phases) {
+      const PhaseResult &P = phase.second;
+      OS << format("%-24s %-17s ", result.Entry->Name.c_str(), phase.first);
+      if (P.Status != PhaseStatus::Ok) {
+        OS << StatusName(P.Status);
+        if (!P.Message.empty())
+          OS << ": " << P.Message;
+        OS << "\n";
+        continue;
+      }
+      WallStats wall(P.WallMs);
+      OS << format("%11.2f %11.2f %11llu %11.2f %11.2f\n", wall.Median,
+                   wall.Min, (unsigned long long)P.Allocations,
+                   P.AllocatedBytes / 1048576.0, P.PeakLiveBytes / 1048576.0);
+    }
+  }
+  OS << format("peak RSS: %llu KB\n", (unsigned long long)GetPeakRSSKB());
+}
+
+int __cdecl main(int argc, const char **argv) {
+  if (llvm::sys::fs::SetupPerThreadFileSystem())
+    return 1;
+  llvm::sys::fs::AutoCleanupPerThreadFileSystem auto_cleanup_fs;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocToDefault();
+
+  const char *pStage = "Operation";
+  try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    pStage = "Argument processing";
+    cl::ParseCommandLineOptions(argc, argv, "dxc compile throughput benchmark\n");
+#ifdef DXCBENCH_DEFAULT_CORPUS
+    if (CorpusFilename.empty())
+      CorpusFilename = DXCBENCH_DEFAULT_CORPUS;
+#endif
+    if (CorpusFilename.empty() || Help || Repetitions == 0) {
+      cl::PrintHelpMessage();
+      return 2;
+    }
+
+    pStage = "Reading corpus";
+    std::vector<CorpusEntry> entries = ReadCorpus(CorpusFilename);
+
+    pStage = "Loading compiler";
+    DxcDllSupport dxcSupport;
+    if (DllPath.empty()) {
+      IFT(dxcSupport.Initialize());
+    } else {
+      std::wstring dll = Unicode::UTF8ToUTF16StringOrThrow(DllPath.c_str());
+      IFT(dxcSupport.InitializeForDll(dll.c_str(), "DxcCreateInstance"));
+    }
+
+    pStage = "Benchmarking";
+    std::vector<EntryResult> results;
+    bool failed = false;
+    {
+      Benchmark bench(dxcSupport);
+      // Unlike outs(), this does not close stdout at exit, after the
+      // per-thread file system it writes through is gone.
+      raw_fd_ostream stdoutStream(STDOUT_FILENO, /*shouldClose*/ false);
+      raw_ostream &progress = OutputFilename == "-" ? errs() : stdoutStream;
+      for (const CorpusEntry &E : entries) {
+        if (!Filter.empty() && E.Name.find(Filter) == std::string::npos)
+          continue;
+        progress << "running " << E.Name << "\n";
+        progress.flush();
+        results.push_back(EntryResult());
+        bench.Run(E, results.back());
+        failed |= results.back().Failed();
+      }
+
+      pStage = "Reporting";
+      CompilerInfo info = GetCompilerInfo(bench.GetCompiler());
+      WriteSummary(progress, results);
+      if (OutputFilename == "-") {
+        WriteJSON(stdoutStream, info, results);
+      } else if (!OutputFilename.empty()) {
+        std::error_code EC;
+        raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_Text);
+        if (EC)
+          throw hlsl::Exception(E_FAIL, "cannot write " + OutputFilename +
+                                            ": " + EC.message());
+        WriteJSON(OS, info, results);
+      }
+    }
+    return failed ? 1 : 0;
+  } catch (const ::hlsl::Exception &hlslException) {
+    const char *msg = hlslException.what();
+    if (msg == nullptr || *msg == '\0')
+      printf("%s failed - error code 0x%08x.\n", pStage,
+             (unsigned)hlslException.hr);
+    else
+      printf("%s failed - %s\n", pStage, msg);
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+}
@@ -59,13 +59,17 @@
 #include "llvm/Option/OptTable.h"
 #include "llvm/Option/ArgList.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/StringSaver.h"
 #ifdef _WIN32
 #include <dia2.h>
 #include <comdef.h>
 #endif
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <unordered_map>
 
 #ifdef _WIN32
@@ -124,6 +128,7 @@ class DxcContext {
 private:
   DxcOpts &m_Opts;
   DxcDllSupport &m_dxcSupport;
+  IDxcCompiler *m_pCompiler; // Shared compiler instance, if any.
 
   int ActOnBlob(IDxcBlob *pBlob);
   int ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName);
@@ -148,9 +153,19 @@ private:
   return m_dxcSupport.CreateInstance(clsid, pResult);
   }
 
+  HRESULT CreateCompiler(_Outptr_ IDxcCompiler **ppCompiler) {
+    if (m_pCompiler != nullptr) {
+      m_pCompiler->AddRef();
+      *ppCompiler = m_pCompiler;
+      return S_OK;
+    }
+    return CreateInstance(CLSID_DxcCompiler, ppCompiler);
+  }
+
 public:
-  DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
-      : m_Opts(Opts), m_dxcSupport(dxcSupport) {
+  DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport,
+             IDxcCompiler *pCompiler = nullptr)
+      : m_Opts(Opts), m_dxcSupport(dxcSupport), m_pCompiler(pCompiler) {
   }
 
   int  Compile();
@@ -206,6 +221,21 @@ static void WriteDxcOutputToFile(DXC_OUT_KIND kind, IDxcResult *pResult, UINT32
   }
 }
 
+// Timing outputs go to the file named by the option, or to the console.
+static void WriteDxcTimingOutputs(IDxcResult *pResult, UINT32 textCodePage) {
+  for (DXC_OUT_KIND kind : { DXC_OUT_TIME_REPORT, DXC_OUT_TIME_TRACE }) {
+    if (!pResult->HasOutput(kind))
+      continue;
+    CComPtr<IDxcBlob> pData;
+    CComPtr<IDxcBlobUtf16> pName;
+    IFT(pResult->GetOutput(kind, IID_PPV_ARGS(&pData), &pName));
+    if (pName && pName->GetStringLength() > 0)
+      WriteBlobToFile(pData, pName->GetStringPointer(), textCodePage);
+    else
+      WriteBlobToConsole(pData);
+  }
+}
+
 static bool StringBlobEqualUtf16(IDxcBlobUtf16 *pBlob, const WCHAR *pStr) {
   size_t uSize = wcslen(pStr);
   if (pBlob && pBlob->GetStringLength() == uSize) {
@@ -355,7 +385,7 @@ int DxcContext::ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugB
       IFT(pLibrary->CreateBlobWithEncodingOnHeapCopy((LPBYTE)&Message[0], Message.size(), CP_ACP, &pDisassembleResult));
   } else {
       CComPtr<IDxcCompiler> pCompiler;
-      IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
+      IFT(CreateCompiler(&pCompiler));
       IFT(pCompiler->Disassemble(pBlob, &pDisassembleResult));
   }
   
@@ -750,7 +780,7 @@ int DxcContext::Compile() {
 
     CComPtr<IDxcLibrary> pLibrary;
     IFT(CreateInstance(CLSID_DxcLibrary, &pLibrary));
-    IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    IFT(CreateCompiler(&pCompiler));
     ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
     IFTARG(pSource->GetBufferSize() >= 4);
 
@@ -812,6 +842,13 @@ int DxcContext::Compile() {
     WriteOperationErrorsToConsole(pCompileResult, m_Opts.OutputWarnings);
   }
 
+  // Timing is reported whether or not the compile succeeded.
+  {
+    CComPtr<IDxcResult> pResult;
+    if (SUCCEEDED(pCompileResult->QueryInterface(&pResult)))
+      WriteDxcTimingOutputs(pResult, m_Opts.DefaultTextCodePage);
+  }
+
   HRESULT status;
   IFT(pCompileResult->GetStatus(&status));
   if (SUCCEEDED(status) || m_Opts.AstDump || m_Opts.OptDump) {
@@ -919,7 +956,7 @@ void DxcContext::Preprocess() {
   }
 
   ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
-  IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  IFT(CreateCompiler(&pCompiler));
   IFT(pCompiler->Preprocess(pSource, StringRefUtf16(m_Opts.InputFile), args.data(), args.size(), m_Opts.Defines.data(), m_Opts.Defines.size(), pIncludeHandler, &pPreprocessResult));
   WriteOperationErrorsToConsole(pPreprocessResult, m_Opts.OutputWarnings);
 
@@ -1217,6 +1254,192 @@ void DxcContext::GetCompilerVersionInfo(llvm::raw_string_ostream &OS) {
 #define VERSION_STRING_SUFFIX ""
 #endif
 
+// Returns the message of an exception, or a description of its error code
+// written to printBuffer if it has none.
+static const char *GetHlslExceptionMessage(const ::hlsl::Exception &hlslException,
+                                           Unicode::acp_char *printBuffer,
+                                           size_t printBufferSize) {
+  const char *msg = hlslException.what();
+  if (msg == nullptr || *msg == '\0') {
+    switch (hlslException.hr) {
+    case DXC_E_DUPLICATE_PART:
+      sprintf_s(
+          printBuffer, printBufferSize,
+          "dxc failed : DXIL container already contains the given part.");
+      break;
+    case DXC_E_MISSING_PART:
+      sprintf_s(
+          printBuffer, printBufferSize,
+          "dxc failed : DXIL container does not contain the given part.");
+      break;
+    case DXC_E_CONTAINER_INVALID:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Invalid DXIL container.");
+      break;
+    case DXC_E_CONTAINER_MISSING_DXIL:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : DXIL container is missing DXIL part.");
+      break;
+    case DXC_E_CONTAINER_MISSING_DEBUG:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : DXIL container is missing Debug Info part.");
+      break;
+    case DXC_E_LLVM_FATAL_ERROR:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Internal Compiler Error - LLVM Fatal Error!");
+      break;
+    case DXC_E_LLVM_UNREACHABLE:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Internal Compiler Error - UNREACHABLE executed!");
+      break;
+    case DXC_E_LLVM_CAST_ERROR:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Internal Compiler Error - Cast of incompatible type!");
+      break;
+    case E_OUTOFMEMORY:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Out of Memory.");
+      break;
+    case E_INVALIDARG:
+      sprintf_s(printBuffer, printBufferSize,
+                "dxc failed : Invalid argument.");
+      break;
+    default:
+      sprintf_s(printBuffer, printBufferSize,
+        "dxc failed : error code 0x%08x.\n", hlslException.hr);
+    }
+    msg = printBuffer;
+  }
+  return msg;
+}
+
+// Runs one command line from a -batch file with the given compiler, and
+// returns its exit code. Failures that stop the job are described in errors.
+static int RunBatchJob(llvm::StringRef command, DxcDllSupport &dxcSupport,
+                       IDxcCompiler *pCompiler, std::string &errors) {
+  llvm::BumpPtrAllocator alloc;
+  llvm::BumpPtrStringSaver saver(alloc);
+  llvm::SmallVector<const char *, 16> argPtrs;
+#ifdef _WIN32
+  llvm::cl::TokenizeWindowsCommandLine(command, saver, argPtrs);
+#else
+  llvm::cl::TokenizeGNUCommandLine(command, saver, argPtrs);
+#endif
+  llvm::SmallVector<llvm::StringRef, 16> argRefs;
+  for (const char *arg : argPtrs) {
+    if (arg != nullptr)
+      argRefs.push_back(arg);
+  }
+
+  llvm::raw_string_ostream errorStream(errors);
+  MainArgs argStrings(argRefs);
+  DxcOpts dxcOpts;
+  int retVal = ReadDxcOpts(getHlslOptTable(), DxcFlags, argStrings, dxcOpts,
+                           errorStream);
+  if (retVal != 0)
+    return retVal;
+  if (!dxcOpts.BatchFile.empty()) {
+    errorStream << "-batch cannot be used in a batch file.";
+    return 1;
+  }
+  if (dxcOpts.EntryPoint.empty() && !dxcOpts.RecompileFromBinary) {
+    dxcOpts.EntryPoint = "main";
+  }
+
+  try {
+    DxcContext context(dxcOpts, dxcSupport, pCompiler);
+    if (!dxcOpts.Preprocess.empty())
+      context.Preprocess();
+    else if (dxcOpts.DumpBin)
+      retVal = context.DumpBinary();
+    else if (dxcOpts.Link)
+      retVal = context.Link();
+    else
+      retVal = context.Compile();
+  } catch (const ::hlsl::Exception &hlslException) {
+    Unicode::acp_char printBuffer[128];
+    errorStream << GetHlslExceptionMessage(hlslException, printBuffer,
+                                           _countof(printBuffer));
+    retVal = 1;
+  } catch (std::bad_alloc &) {
+    errorStream << "out of memory.";
+    retVal = 1;
+  } catch (...) {
+    errorStream << "unknown error.";
+    retVal = 1;
+  }
+  return retVal;
+}
+
+// Runs every command line in the -batch file on a pool of threads that each
+// keep one compiler instance, so the process and compiler setup costs are
+// paid once. Blank lines and lines starting with // are skipped. Returns
+// nonzero if any job failed.
+static int RunBatch(const DxcOpts &batchOpts, DxcDllSupport &dxcSupport) {
+  CComPtr<IDxcBlobEncoding> pBatchFile;
+  ReadFileIntoBlob(dxcSupport, StringRefUtf16(batchOpts.BatchFile), &pBatchFile);
+  llvm::StringRef batchText((const char *)pBatchFile->GetBufferPointer(),
+                            pBatchFile->GetBufferSize());
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  batchText.split(lines, "\n", /*MaxSplit*/ -1, /*KeepEmpty*/ false);
+  std::vector<llvm::StringRef> commands;
+  for (llvm::StringRef line : lines) {
+    line = line.trim();
+    if (!line.empty() && !line.startswith("//"))
+      commands.push_back(line);
+  }
+  if (commands.empty())
+    return 0;
+
+  unsigned threadCount = batchOpts.BatchThreads;
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  threadCount = std::min<unsigned>(threadCount, commands.size());
+
+  std::atomic<size_t> nextCommand(0);
+  std::atomic<unsigned> failedCount(0);
+  auto worker = [&]() {
+    DxcSetThreadMallocToDefault();
+    CComPtr<IDxcCompiler> pCompiler;
+    HRESULT hr = dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler);
+    for (size_t i = nextCommand++; i < commands.size(); i = nextCommand++) {
+      std::string errors;
+      int retVal = 1;
+      if (FAILED(hr))
+        errors = "unable to create a compiler instance.";
+      else
+        retVal = RunBatchJob(commands[i], dxcSupport, pCompiler, errors);
+      if (retVal != 0)
+        ++failedCount;
+      if (!errors.empty()) {
+        std::string message = "dxc failed : " + commands[i].str() + "\n" +
+                              errors + "\n";
+        WriteUtf8ToConsoleSizeT(message.data(), message.size(),
+                                STD_ERROR_HANDLE);
+      }
+    }
+    pCompiler.Release();
+    DxcClearThreadMalloc();
+  };
+
+  if (threadCount == 1) {
+    worker();
+  } else {
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; ++i)
+      threads.emplace_back(worker);
+    for (std::thread &thread : threads)
+      thread.join();
+  }
+
+  if (failedCount != 0) {
+    fprintf(stderr, "dxc failed : %u of %u batch jobs failed.\n",
+            (unsigned)failedCount, (unsigned)commands.size());
+    return 1;
+  }
+  return 0;
+}
+
 #ifdef _WIN32
 // Unhandled exception filter called when an unhandled exception occurs
 // to at least print an generic error message instead of crashing silently.
@@ -1365,7 +1588,11 @@ int dxc::main(int argc, const char **argv_) {
     }
 
     // TODO: implement all other actions.
-    if (!dxcOpts.Preprocess.empty()) {
+    if (!dxcOpts.BatchFile.empty()) {
+      pStage = "Batch compilation";
+      retVal = RunBatch(dxcOpts, dxcSupport);
+    }
+    else if (!dxcOpts.Preprocess.empty()) {
       pStage = "Preprocessing";
       context.Preprocess();
     }
@@ -1383,59 +1610,10 @@ int dxc::main(int argc, const char **argv_) {
     }
   } catch (const ::hlsl::Exception &hlslException) {
     try {
-      const char *msg = hlslException.what();
       Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
                                           // UTF-8 because we use ASCII only errors
-      if (msg == nullptr || *msg == '\0') {
-        switch (hlslException.hr) {
-        case DXC_E_DUPLICATE_PART:
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container already contains the given part.");
-          break;
-        case DXC_E_MISSING_PART:
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container does not contain the given part.");
-          break;
-        case DXC_E_CONTAINER_INVALID:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid DXIL container.");
-          break;
-        case DXC_E_CONTAINER_MISSING_DXIL:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing DXIL part.");
-          break;
-        case DXC_E_CONTAINER_MISSING_DEBUG:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing Debug Info part.");
-          break;
-        case DXC_E_LLVM_FATAL_ERROR:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Internal Compiler Error - LLVM Fatal Error!");
-          break;
-        case DXC_E_LLVM_UNREACHABLE:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Internal Compiler Error - UNREACHABLE executed!");
-          break;
-        case DXC_E_LLVM_CAST_ERROR:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Internal Compiler Error - Cast of incompatible type!");
-          break;
-        case E_OUTOFMEMORY:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Out of Memory.");
-          break;
-        case E_INVALIDARG:
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid argument.");
-          break;
-        default:
-          sprintf_s(printBuffer, _countof(printBuffer),
-            "dxc failed : error code 0x%08x.\n", hlslException.hr);
-        }
-        msg = printBuffer;
-      }
+      const char *msg = GetHlslExceptionMessage(hlslException, printBuffer,
+                                                _countof(printBuffer));
 
       WriteUtf8ToConsoleSizeT(msg, strlen(msg), STD_ERROR_HANDLE);
       printf("\n");
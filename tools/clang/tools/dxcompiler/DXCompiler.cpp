@@ -45,6 +45,31 @@ void  __CRTDECL operator delete (void* ptr) throw() {
 void  __CRTDECL operator delete (void* ptr, const std::nothrow_t& nothrow_constant) throw() {
   DxcGetThreadMallocNoRef()->Free(ptr);
 }
+#else
+// operator new and friends. These replace the process-wide ones only when
+// dxcompiler is linked in; they serve a DxcThreadArena if one is installed on
+// the thread and go to the heap otherwise.
+void *operator new(std::size_t size) {
+  void * ptr = DxcArenaAlloc(size);
+  if (ptr == nullptr)
+    ptr = malloc(size ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+void *operator new(std::size_t size,
+  const std::nothrow_t &nothrow_value) throw() {
+  void * ptr = DxcArenaAlloc(size);
+  return ptr ? ptr : malloc(size ? size : 1);
+}
+void operator delete (void* ptr) throw() {
+  if (!DxcArenaFree(ptr))
+    free(ptr);
+}
+void operator delete (void* ptr, const std::nothrow_t& nothrow_constant) throw() {
+  if (!DxcArenaFree(ptr))
+    free(ptr);
+}
 #endif
 
 static HRESULT InitMaybeFail() throw() {
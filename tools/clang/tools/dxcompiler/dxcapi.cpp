@@ -32,6 +32,7 @@ HRESULT CreateDxcDiaDataSource(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcIntelliSense(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcCompilerArgs(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcUtils(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcRewriter(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcAssembler(_In_ REFIID riid, _Out_ LPVOID *ppv);
@@ -89,6 +90,9 @@ static HRESULT ThreadMallocDxcCreateInstance(
   else if (IsEqualCLSID(rclsid, CLSID_DxcUtils)) {
     hr = CreateDxcUtils(riid, ppv);
   }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcIncludeCache)) {
+    hr = CreateDxcIncludeCache(riid, ppv);
+  }
   else if (IsEqualCLSID(rclsid, CLSID_DxcValidator)) {
     if (DxilLibIsEnabled()) {
       hr = DxilLibCreateInstance(rclsid, riid, (IUnknown**)ppv);
@@ -0,0 +1,525 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides an on-disk cache of compile results for dxcompiler.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/dxcfilesystem.h"
+#include "dxccompilecache.h"
+#include "dxcutil.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Option/Arg.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+// Bump when the entry layout or the key derivation changes.
+static const uint32_t kCacheEntryMagic = 0x43435844; // 'DXCC'
+static const uint32_t kCacheEntryVersion = 1;
+// Temporary files younger than this may belong to a store in progress in
+// another process, so trimming leaves them alone.
+static const uint64_t kTempFileGraceSeconds = 10 * 60;
+// File in the cache directory holding the running size of the cache and the
+// number of stores left until the size is measured again.
+static const char kSizeFileName[] = "size";
+// Concurrent stores may overwrite each other's update of the running size,
+// so it is measured again after as many stores as there were files, and at
+// least this many. Each store then pays for a constant share of a scan.
+static const uint64_t kMinStoresPerSizeCheck = 256;
+
+typedef MD5::MD5Result ContentDigest;
+
+void ComputeContentDigest(StringRef Data, ContentDigest &Digest) {
+  MD5 Hash;
+  Hash.update(Data);
+  Hash.final(Digest);
+}
+
+// Runs llvm::sys::fs calls against the disk rather than the compile's
+// in-memory file system for the lifetime of the scope.
+class DiskFileSystemScope {
+  std::unique_ptr<sys::fs::MSFileSystem> m_pFileSystem;
+  std::unique_ptr<sys::fs::AutoPerThreadSystem> m_pScope;
+
+public:
+  HRESULT Init() {
+    sys::fs::MSFileSystem *pFileSystem;
+    IFR(CreateMSFileSystemForDisk(&pFileSystem));
+    m_pFileSystem.reset(pFileSystem);
+    m_pScope.reset(new sys::fs::AutoPerThreadSystem(pFileSystem));
+    if (m_pScope->error_code())
+      return E_FAIL;
+    return S_OK;
+  }
+};
+
+class EntryWriter {
+  raw_string_ostream &m_OS;
+
+public:
+  EntryWriter(raw_string_ostream &OS) : m_OS(OS) {}
+  void WriteU32(uint32_t Value) {
+    m_OS.write((const char *)&Value, sizeof(Value));
+  }
+  void WriteString(StringRef Str) {
+    WriteU32((uint32_t)Str.size());
+    m_OS << Str;
+  }
+  void WriteDigest(const ContentDigest &Digest) {
+    m_OS.write((const char *)Digest, sizeof(ContentDigest));
+  }
+};
+
+// Reads an entry back; any truncation or inconsistency makes the whole
+// entry a miss.
+class EntryReader {
+  StringRef m_Data;
+
+public:
+  EntryReader(StringRef Data) : m_Data(Data) {}
+  bool ReadU32(uint32_t &Value) {
+    if (m_Data.size() < sizeof(Value))
+      return false;
+    memcpy(&Value, m_Data.data(), sizeof(Value));
+    m_Data = m_Data.drop_front(sizeof(Value));
+    return true;
+  }
+  bool ReadString(StringRef &Str) {
+    uint32_t Size;
+    if (!ReadU32(Size) || m_Data.size() < Size)
+      return false;
+    Str = m_Data.substr(0, Size);
+    m_Data = m_Data.drop_front(Size);
+    return true;
+  }
+  bool ReadDigest(const uint8_t *&pDigest) {
+    if (m_Data.size() < sizeof(ContentDigest))
+      return false;
+    pDigest = (const uint8_t *)m_Data.data();
+    m_Data = m_Data.drop_front(sizeof(ContentDigest));
+    return true;
+  }
+  bool AtEnd() const { return m_Data.empty(); }
+};
+
+} // namespace
+
+namespace dxcutil {
+
+void DxcCompileCache::ComputeKey(IDxcVersionInfo *pVersionInfo,
+                                 const hlsl::options::DxcOpts &opts,
+                                 IDxcBlobUtf8 *pSource) {
+  MD5 Hash;
+  auto updateU32 = [&Hash](uint32_t Value) {
+    Hash.update(ArrayRef<uint8_t>((const uint8_t *)&Value, sizeof(Value)));
+  };
+  auto updateString = [&](StringRef Str) {
+    updateU32((uint32_t)Str.size());
+    Hash.update(Str);
+  };
+
+  updateU32(kCacheEntryVersion);
+
+  // Compiler version, including the commit so that development builds
+  // never share entries.
+  UINT32 Major = 0, Minor = 0, Flags = 0;
+  IFT(pVersionInfo->GetVersion(&Major, &Minor));
+  IFT(pVersionInfo->GetFlags(&Flags));
+  updateU32(Major);
+  updateU32(Minor);
+  updateU32(Flags);
+  CComPtr<IDxcVersionInfo2> pVersionInfo2;
+  if (SUCCEEDED(pVersionInfo->QueryInterface(&pVersionInfo2))) {
+    UINT32 CommitCount = 0;
+    CComHeapPtr<char> CommitSha;
+    IFT(pVersionInfo2->GetCommitInfo(&CommitCount, &CommitSha));
+    updateU32(CommitCount);
+    updateString(CommitSha.m_pData);
+  }
+  CComPtr<IDxcVersionInfo3> pVersionInfo3;
+  if (SUCCEEDED(pVersionInfo->QueryInterface(&pVersionInfo3))) {
+    CComHeapPtr<char> CustomString;
+    IFT(pVersionInfo3->GetCustomVersionString(&CustomString));
+    updateString(CustomString.m_pData);
+  }
+
+  // The validator may come from dxil.dll, which is versioned separately.
+  unsigned ValMajor = 0, ValMinor = 0;
+  GetValidatorVersion(&ValMajor, &ValMinor);
+  updateU32(ValMajor);
+  updateU32(ValMinor);
+
+  // Arguments as parsed, so that spelling differences such as '/E main'
+  // and '-Emain' map to the same entry. The cache options themselves do not
+  // affect the output.
+  for (const llvm::opt::Arg *A : opts.Args) {
+    unsigned ID = A->getOption().getID();
+    if (ID == hlsl::options::OPT_cache_dir ||
+        ID == hlsl::options::OPT_cache_size_limit)
+      continue;
+    updateU32(ID);
+    updateU32(A->getNumValues());
+    for (const char *Value : A->getValues())
+      updateString(Value);
+  }
+
+  updateString(StringRef(pSource->GetStringPointer(),
+                         pSource->GetStringLength()));
+
+  ContentDigest Digest;
+  Hash.final(Digest);
+  SmallString<32> KeyStr;
+  MD5::stringifyResult(Digest, KeyStr);
+  m_Key = KeyStr.str();
+}
+
+std::string DxcCompileCache::GetEntryDir() const {
+  SmallString<128> Path(m_Dir);
+  sys::path::append(Path, m_Key.substr(0, 2));
+  return Path.str();
+}
+
+std::string DxcCompileCache::GetEntryPath() const {
+  SmallString<128> Path(GetEntryDir());
+  sys::path::append(Path, m_Key);
+  return Path.str();
+}
+
+std::string DxcCompileCache::GetSizeFilePath() const {
+  SmallString<128> Path(m_Dir);
+  sys::path::append(Path, kSizeFileName);
+  return Path.str();
+}
+
+bool DxcCompileCache::ReadSizeFile(uint64_t &Size,
+                                   uint64_t &StoresUntilCheck) const {
+  auto BufferOrErr = MemoryBuffer::getFile(GetSizeFilePath());
+  if (!BufferOrErr)
+    return false;
+  std::pair<StringRef, StringRef> Fields =
+      BufferOrErr.get()->getBuffer().trim().split(' ');
+  return !Fields.first.getAsInteger(10, Size) &&
+         !Fields.second.getAsInteger(10, StoresUntilCheck);
+}
+
+// Replaces the size file through a rename, like an entry, so that readers
+// never see a partial write.
+void DxcCompileCache::WriteSizeFile(uint64_t Size,
+                                    uint64_t StoresUntilCheck) const {
+  int FD;
+  SmallString<128> TempPath;
+  if (sys::fs::createUniqueFile(GetSizeFilePath() + "-%%%%%%%%.tmp", FD,
+                                TempPath))
+    return;
+  bool WriteFailed;
+  {
+    raw_fd_ostream TempOS(FD, /*shouldClose*/ true);
+    TempOS << Size << ' ' << StoresUntilCheck << '\n';
+    TempOS.close();
+    WriteFailed = TempOS.has_error();
+    TempOS.clear_error();
+  }
+  if (WriteFailed || sys::fs::rename(TempPath, GetSizeFilePath()))
+    sys::fs::remove(TempPath);
+}
+
+// Adds a stored entry to the running size, and trims the cache only when
+// the total crosses the limit. The directory is measured instead when the
+// size file is missing or unreadable, and when its store countdown runs out.
+void DxcCompileCache::UpdateSize(StringRef StoredPath, uint64_t StoredSize,
+                                 uint64_t ReplacedSize) {
+  uint64_t Size, StoresUntilCheck;
+  if (ReadSizeFile(Size, StoresUntilCheck) && StoresUntilCheck > 0) {
+    Size = Size + StoredSize - std::min(Size + StoredSize, ReplacedSize);
+    if (Size <= m_SizeLimit) {
+      WriteSizeFile(Size, StoresUntilCheck - 1);
+      return;
+    }
+  }
+  uint64_t FileCount;
+  Size = Trim(StoredPath, FileCount);
+  WriteSizeFile(Size, std::max(kMinStoresPerSizeCheck, FileCount));
+}
+
+HRESULT DxcCompileCache::Lookup(IDxcIncludeHandler *pIncludeHandler,
+                                UINT32 textEncoding,
+                                IDxcResult **ppResult) {
+  DXASSERT(!m_Key.empty(), "otherwise ComputeKey was not called");
+  *ppResult = nullptr;
+
+  std::unique_ptr<MemoryBuffer> pEntry;
+  {
+    DiskFileSystemScope diskScope;
+    IFR(diskScope.Init());
+    std::string EntryPath = GetEntryPath();
+    int FD;
+    if (sys::fs::openFileForRead(EntryPath, FD))
+      return S_FALSE;
+    sys::fs::file_status Status;
+    if (!sys::fs::status(FD, Status)) {
+      auto BufferOrErr = MemoryBuffer::getOpenFile(
+          FD, EntryPath, Status.getSize(), /*RequiresNullTerminator*/ false,
+          /*IsVolatileSize*/ true);
+      if (BufferOrErr)
+        pEntry = std::move(BufferOrErr.get());
+      // Refresh the modification time so that trimming evicts the least
+      // recently used entries first. Failure only affects eviction order.
+      if (pEntry)
+        sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+    }
+    sys::fs::msf_close(FD);
+    if (!pEntry)
+      return S_FALSE;
+  }
+
+  EntryReader Reader(pEntry->getBuffer());
+  uint32_t Magic, Version, IncludeCount;
+  if (!Reader.ReadU32(Magic) || Magic != kCacheEntryMagic ||
+      !Reader.ReadU32(Version) || Version != kCacheEntryVersion ||
+      !Reader.ReadU32(IncludeCount))
+    return S_FALSE;
+
+  // Every include must still resolve to the same contents, and every name
+  // that could not be found before must still be missing, since either
+  // could change which file a later #include picks up.
+  for (uint32_t i = 0; i < IncludeCount; ++i) {
+    StringRef Name;
+    uint32_t Found;
+    if (!Reader.ReadString(Name) || !Reader.ReadU32(Found))
+      return S_FALSE;
+    const uint8_t *pStoredDigest = nullptr;
+    if (Found && !Reader.ReadDigest(pStoredDigest))
+      return S_FALSE;
+    if (!pIncludeHandler)
+      return S_FALSE;
+
+    std::wstring NameW;
+    if (!Unicode::UTF8ToUTF16String(Name.data(), Name.size(), &NameW))
+      return S_FALSE;
+    CComPtr<IDxcBlob> pBlob;
+    HRESULT hr = pIncludeHandler->LoadSource(NameW.c_str(), &pBlob);
+    bool Loaded = SUCCEEDED(hr) && pBlob != nullptr;
+    if (Loaded != (Found != 0))
+      return S_FALSE;
+    if (!Loaded)
+      continue;
+    CComPtr<IDxcBlobUtf8> pBlobUtf8;
+    if (FAILED(hlsl::DxcGetBlobAsUtf8(pBlob, DxcGetThreadMallocNoRef(),
+                                      &pBlobUtf8)))
+      return S_FALSE;
+    ContentDigest Digest;
+    ComputeContentDigest(StringRef(pBlobUtf8->GetStringPointer(),
+                                   pBlobUtf8->GetStringLength()),
+                         Digest);
+    if (memcmp(Digest, pStoredDigest, sizeof(ContentDigest)) != 0)
+      return S_FALSE;
+  }
+
+  uint32_t OutputCount;
+  if (!Reader.ReadU32(OutputCount))
+    return S_FALSE;
+  CComPtr<DxcResult> pResult = DxcResult::Alloc(DxcGetThreadMallocNoRef());
+  IFROOM(pResult.p);
+  IFR(pResult->SetEncoding(textEncoding));
+  for (uint32_t i = 0; i < OutputCount; ++i) {
+    uint32_t Kind;
+    StringRef Name, Data;
+    if (!Reader.ReadU32(Kind) || !Reader.ReadString(Name) ||
+        !Reader.ReadString(Data))
+      return S_FALSE;
+    if (Kind <= DXC_OUT_NONE || Kind > kNumDxcOutputTypes)
+      return S_FALSE;
+    DXC_OUT_KIND OutKind = (DXC_OUT_KIND)Kind;
+    if (DxcGetOutputType(OutKind) == DxcOutputType_Text) {
+      IFR(pResult->SetOutputString(OutKind, Data.data(), Data.size()));
+    } else {
+      CComPtr<IDxcBlob> pBlob;
+      IFR(hlsl::DxcCreateBlobOnHeapCopy(Data.data(), (UINT32)Data.size(),
+                                        &pBlob));
+      IFR(pResult->SetOutputObject(OutKind, pBlob));
+    }
+    if (!Name.empty())
+      IFR(pResult->SetOutputName(OutKind, Name.str().c_str()));
+  }
+  if (!Reader.AtEnd())
+    return S_FALSE;
+
+  IFR(pResult->SetStatusAndPrimaryResult(S_OK, DXC_OUT_OBJECT));
+  *ppResult = pResult.Detach();
+  return S_OK;
+}
+
+HRESULT DxcCompileCache::Store(DxcArgsFileSystem *pFileSystem,
+                               IDxcResult *pResult) {
+  DXASSERT(!m_Key.empty(), "otherwise ComputeKey was not called");
+
+  std::string EntryData;
+  raw_string_ostream OS(EntryData);
+  EntryWriter Writer(OS);
+  Writer.WriteU32(kCacheEntryMagic);
+  Writer.WriteU32(kCacheEntryVersion);
+
+  std::vector<DxcIncludeRecord> Includes;
+  pFileSystem->GetIncludeRecords(Includes);
+  Writer.WriteU32((uint32_t)Includes.size());
+  for (const DxcIncludeRecord &Include : Includes) {
+    std::string Name;
+    IFRBOOL(Unicode::UTF16ToUTF8String(Include.Name.c_str(), &Name),
+            E_INVALIDARG);
+    Writer.WriteString(Name);
+    Writer.WriteU32(Include.Blob != nullptr);
+    if (Include.Blob) {
+      ContentDigest Digest;
+      ComputeContentDigest(StringRef(Include.Blob->GetStringPointer(),
+                                     Include.Blob->GetStringLength()),
+                           Digest);
+      Writer.WriteDigest(Digest);
+    }
+  }
+
+  uint32_t OutputCount = pResult->GetNumOutputs();
+  Writer.WriteU32(OutputCount);
+  for (uint32_t i = 0; i < OutputCount; ++i) {
+    DXC_OUT_KIND Kind = pResult->GetOutputByIndex(i);
+    CComPtr<IDxcBlob> pBlob;
+    CComPtr<IDxcBlobUtf16> pName;
+    // Outputs that are not blobs cannot be stored; skip the entry.
+    IFR(pResult->GetOutput(Kind, IID_PPV_ARGS(&pBlob), &pName));
+    std::string Name;
+    if (pName)
+      IFRBOOL(Unicode::UTF16ToUTF8String(pName->GetStringPointer(), &Name),
+              E_INVALIDARG);
+    StringRef Data((const char *)pBlob->GetBufferPointer(),
+                   pBlob->GetBufferSize());
+    // Text is stored as UTF-8 and converted to the requested encoding when
+    // the entry is loaded.
+    CComPtr<IDxcBlobUtf8> pText;
+    if (DxcGetOutputType(Kind) == DxcOutputType_Text) {
+      IFR(hlsl::DxcGetBlobAsUtf8(pBlob, DxcGetThreadMallocNoRef(), &pText));
+      Data = StringRef(pText->GetStringPointer(), pText->GetStringLength());
+    }
+    Writer.WriteU32(Kind);
+    Writer.WriteString(Name);
+    Writer.WriteString(Data);
+  }
+  OS.flush();
+
+  DiskFileSystemScope diskScope;
+  IFR(diskScope.Init());
+  std::string EntryDir = GetEntryDir();
+  if (sys::fs::create_directories(EntryDir))
+    return E_FAIL;
+
+  // Write to a unique temporary and rename it into place, so that readers
+  // in other processes only ever see complete entries.
+  int FD;
+  SmallString<128> TempPath;
+  if (sys::fs::createUniqueFile(GetEntryPath() + "-%%%%%%%%.tmp", FD,
+                                TempPath))
+    return E_FAIL;
+  bool WriteFailed;
+  {
+    raw_fd_ostream TempOS(FD, /*shouldClose*/ true);
+    TempOS << EntryData;
+    TempOS.close();
+    WriteFailed = TempOS.has_error();
+    TempOS.clear_error();
+  }
+  // An entry stored again by another process is replaced, not added.
+  sys::fs::file_status ReplacedStatus;
+  uint64_t ReplacedSize = 0;
+  if (!sys::fs::status(GetEntryPath(), ReplacedStatus) &&
+      sys::fs::is_regular_file(ReplacedStatus))
+    ReplacedSize = ReplacedStatus.getSize();
+  if (WriteFailed || sys::fs::rename(TempPath, GetEntryPath())) {
+    sys::fs::remove(TempPath);
+    return E_FAIL;
+  }
+
+  UpdateSize(GetEntryPath(), EntryData.size(), ReplacedSize);
+  return S_OK;
+}
+
+// Removes the least recently used files in the cache until it fits in the
+// size limit, and returns the size and number of files left. The entry just
+// stored is kept even if it alone exceeds the limit, and recent temporary
+// files are skipped since another process may still be writing them.
+uint64_t DxcCompileCache::Trim(StringRef StoredPath, uint64_t &FileCount) {
+  struct CachedFile {
+    std::string Path;
+    uint64_t Size;
+    sys::TimeValue ModTime;
+  };
+  std::vector<CachedFile> Files;
+  uint64_t TotalSize = 0;
+  sys::TimeValue TempCutoff =
+      sys::TimeValue::now() - sys::TimeValue((int64_t)kTempFileGraceSeconds);
+  std::error_code EC;
+  // Entries live one level down, in a subdirectory named after the first two
+  // characters of their key.
+  for (sys::fs::directory_iterator DirIt(m_Dir, EC), End; DirIt != End && !EC;
+       DirIt.increment(EC)) {
+    std::error_code FileEC;
+    for (sys::fs::directory_iterator It(DirIt->path(), FileEC);
+         It != End && !FileEC; It.increment(FileEC)) {
+      sys::fs::file_status Status;
+      if (It->status(Status) || !sys::fs::is_regular_file(Status))
+        continue;
+      if (It->path() == StoredPath)
+        continue;
+      if (sys::path::extension(It->path()) == ".tmp" &&
+          Status.getLastModificationTime() > TempCutoff)
+        continue;
+      Files.push_back({It->path(), Status.getSize(),
+                       Status.getLastModificationTime()});
+      TotalSize += Status.getSize();
+    }
+  }
+
+  sys::fs::file_status StoredStatus;
+  FileCount = Files.size();
+  if (!sys::fs::status(StoredPath, StoredStatus)) {
+    TotalSize += StoredStatus.getSize();
+    ++FileCount;
+  }
+
+  if (TotalSize <= m_SizeLimit)
+    return TotalSize;
+  std::sort(Files.begin(), Files.end(),
+            [](const CachedFile &A, const CachedFile &B) {
+              return A.ModTime < B.ModTime;
+            });
+  for (const CachedFile &File : Files) {
+    if (TotalSize <= m_SizeLimit)
+      break;
+    if (!sys::fs::remove(File.Path)) {
+      TotalSize -= File.Size;
+      --FileCount;
+    }
+  }
+  return TotalSize;
+}
+
+} // namespace dxcutil
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides an on-disk cache of compile results for dxcompiler.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace hlsl {
+namespace options {
+class DxcOpts;
+} // namespace options
+} // namespace hlsl
+
+namespace dxcutil {
+
+class DxcArgsFileSystem;
+
+// Content-addressed store of compile results.
+//
+// Entries are keyed on the source text, the parsed arguments and the
+// compiler and validator versions. Each entry also records every name the
+// include handler was asked for along with a digest of what it returned, so
+// a lookup only hits when the includes still resolve to the same contents.
+// Entries are written to a temporary file and renamed into place, and the
+// directory is trimmed back under its size limit oldest entry first. A
+// running total of the cache size is kept beside the entries, so the
+// directory is only scanned when that total crosses the limit, or after as
+// many stores as it holds files to correct updates lost to concurrent
+// processes.
+class DxcCompileCache {
+public:
+  DxcCompileCache(llvm::StringRef Dir, uint64_t SizeLimitInBytes)
+      : m_Dir(Dir), m_SizeLimit(SizeLimitInBytes) {}
+
+  // Computes the entry key; must be called before Lookup or Store.
+  void ComputeKey(_In_ IDxcVersionInfo *pVersionInfo,
+                  const hlsl::options::DxcOpts &opts,
+                  _In_ IDxcBlobUtf8 *pSource);
+
+  // Returns S_OK and the stored result if a matching entry exists, or
+  // S_FALSE if the compile needs to run.
+  HRESULT Lookup(_In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                 UINT32 textEncoding, _COM_Outptr_ IDxcResult **ppResult);
+
+  // Stores the outputs of a successful compile along with the includes
+  // that pFileSystem resolved for it.
+  HRESULT Store(_In_ DxcArgsFileSystem *pFileSystem,
+                _In_ IDxcResult *pResult);
+
+private:
+  std::string GetEntryDir() const;
+  std::string GetEntryPath() const;
+  std::string GetSizeFilePath() const;
+  bool ReadSizeFile(uint64_t &Size, uint64_t &StoresUntilCheck) const;
+  void WriteSizeFile(uint64_t Size, uint64_t StoresUntilCheck) const;
+  void UpdateSize(llvm::StringRef StoredPath, uint64_t StoredSize,
+                  uint64_t ReplacedSize);
+  uint64_t Trim(llvm::StringRef StoredPath, uint64_t &FileCount);
+
+  std::string m_Dir;
+  uint64_t m_SizeLimit;
+  std::string m_Key;
+};
+
+} // namespace dxcutil
@@ -21,6 +21,8 @@
 #include "dxc/Support/Unicode.h"
 #include "clang/Frontend/CompilerInstance.h"
 
+#include <unordered_map>
+
 #ifndef _WIN32
 #include <sys/stat.h>
 #include <unistd.h>
@@ -82,10 +84,10 @@ enum class SpecialValue {
   Output = 4
 };
 
-// We use 10 bits for Offset to support MaxIncludedFiles include files,
+// We use 12 bits for Offset to support MaxIncludedFiles include files,
 // and we use 16 bits for Length to support nearly arbitrary path length.
 struct HandleBits {
-  unsigned Offset : 10;
+  unsigned Offset : 12;
   unsigned Length : 16;
   unsigned Kind : 4;
 };
@@ -145,9 +147,9 @@ const DxcArgsHandle StdErrHandle(SpecialValue::StdErr);
 const DxcArgsHandle OutputHandle(SpecialValue::Output);
 
 /// Max number of included files (1:1 to their directories) or search directories.
-/// If programs include more than a handful, DxcArgsFileSystem will need to do better than linear scans.
+/// Bounded by the number of bits available for Offset in HandleBits.
 /// If this is fired, ERROR_OUT_OF_STRUCTURES will be returned by an attempt to open a file.
-static const size_t MaxIncludedFiles = 1000;
+static const size_t MaxIncludedFiles = 4000;
 
 bool IsAbsoluteOrCurDirRelativeW(LPCWSTR Path) {
   if (!Path || !Path[0]) return FALSE;
@@ -244,6 +246,27 @@ private:
       : Blob(pBlob), BlobStream(pStream), Name(name) { }
   };
   llvm::SmallVector<IncludedFile, 4> m_includedFiles;
+  // Index of m_includedFiles by name.
+  std::unordered_map<std::wstring, unsigned> m_includedFileIndex;
+  // Directory prefixes of included file names (with and without the trailing
+  // separator) mapped to the first file found under them.
+  std::unordered_map<std::wstring, unsigned> m_includedDirIndex;
+  // Names the include handler could not provide, with the error returned.
+  std::unordered_map<std::wstring, DWORD> m_missingFiles;
+
+  static bool IsPathSeparator(wchar_t ch) { return ch == L'\\' || ch == L'/'; }
+
+  void AddIncludedFile(std::wstring &&name, IDxcBlobUtf8 *pBlob, IStream *pStream) {
+    unsigned index = (unsigned)m_includedFiles.size();
+    for (size_t i = 0; i + 1 < name.size(); ++i) {
+      if (IsPathSeparator(name[i])) {
+        m_includedDirIndex.emplace(name.substr(0, i), index);
+        m_includedDirIndex.emplace(name.substr(0, i + 1), index);
+      }
+    }
+    m_includedFileIndex.emplace(name, index);
+    m_includedFiles.emplace_back(std::move(name), pBlob, pStream);
+  }
 
   static bool IsDirOf(LPCWSTR lpDir, size_t dirLen, const std::wstring &fileName) {
     if (fileName.size() <= dirLen) return false;
@@ -266,11 +289,9 @@ private:
 
   HANDLE TryFindDirHandle(LPCWSTR lpDir) const {
     size_t dirLen = wcslen(lpDir);
-    for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-      const std::wstring &fileName = m_includedFiles[i].Name;
-      if (IsDirOf(lpDir, dirLen, fileName)) {
-        return DxcArgsHandle(HandleKind::FileDir, i, dirLen).Handle;
-      }
+    auto it = m_includedDirIndex.find(std::wstring(lpDir, dirLen));
+    if (it != m_includedDirIndex.end()) {
+      return DxcArgsHandle(HandleKind::FileDir, it->second, dirLen).Handle;
     }
     for (size_t i = 0; i < m_searchEntries.size(); ++i) {
       if (IsDirPrefixOrSame(lpDir, dirLen, m_searchEntries[i])) {
@@ -279,12 +300,24 @@ private:
     }
     return INVALID_HANDLE_VALUE;
   }
+  static bool IsPrecompiledHeader(IDxcBlob *pBlob) {
+    return pBlob->GetBufferSize() >= 4 &&
+           0 == memcmp(pBlob->GetBufferPointer(), "CPCH", 4);
+  }
+
   DWORD TryFindOrOpen(LPCWSTR lpFileName, size_t &index) {
-    for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-      if (0 == wcscmp(lpFileName, m_includedFiles[i].Name.data())) {
-        index = i;
-        return ERROR_SUCCESS;
-      }
+    std::wstring fileName(lpFileName);
+    auto it = m_includedFileIndex.find(fileName);
+    if (it != m_includedFileIndex.end()) {
+      index = it->second;
+      return ERROR_SUCCESS;
+    }
+
+    // Header search probes the same candidates repeatedly; only ask the
+    // include handler once per name.
+    auto missing = m_missingFiles.find(fileName);
+    if (missing != m_missingFiles.end()) {
+      return missing->second;
     }
 
     if (m_includeLoader.p != nullptr) {
@@ -295,18 +328,29 @@ private:
       CComPtr<::IDxcBlob> fileBlob;
       HRESULT hr = m_includeLoader->LoadSource(lpFileName, &fileBlob);
       if (FAILED(hr)) {
+        m_missingFiles[std::move(fileName)] = ERROR_UNHANDLED_EXCEPTION;
         return ERROR_UNHANDLED_EXCEPTION;
       }
       if (fileBlob.p != nullptr) {
         CComPtr<IDxcBlobUtf8> fileBlobUtf8;
-        if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, DxcGetThreadMallocNoRef(), &fileBlobUtf8))) {
+        if (IsPrecompiledHeader(fileBlob)) {
+          // Precompiled headers are binary; serve their bytes unconverted.
+          CComPtr<IDxcBlobEncoding> fileBlobRaw;
+          if (FAILED(hlsl::DxcCreateBlobEncodingFromBlob(
+                  fileBlob, 0, 0, true, CP_UTF8, DxcGetThreadMallocNoRef(),
+                  &fileBlobRaw)) ||
+              FAILED(hlsl::DxcGetBlobAsUtf8(fileBlobRaw, DxcGetThreadMallocNoRef(), &fileBlobUtf8))) {
+            return ERROR_UNHANDLED_EXCEPTION;
+          }
+        }
+        else if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, DxcGetThreadMallocNoRef(), &fileBlobUtf8))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
         CComPtr<IStream> fileStream;
         if (FAILED(hlsl::CreateReadOnlyBlobStream(fileBlobUtf8, &fileStream))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
-        m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobUtf8, fileStream);
+        AddIncludedFile(std::move(fileName), fileBlobUtf8, fileStream);
         index = m_includedFiles.size() - 1;
 
         if (m_bDisplayIncludeProcess) {
@@ -322,6 +366,7 @@ private:
         }
         return ERROR_SUCCESS;
       }
+      m_missingFiles[std::move(fileName)] = ERROR_NOT_FOUND;
     }
     return ERROR_NOT_FOUND;
   }
@@ -343,7 +388,7 @@ public:
         m_includeLoader(pHandler), m_bDisplayIncludeProcess(false) {
     MakeAbsoluteOrCurDirRelativeW(m_pSourceName, m_pAbsSourceName);
     IFT(CreateReadOnlyBlobStream(m_pSource, &m_pSourceStream));
-    m_includedFiles.push_back(IncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream));
+    AddIncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream);
   }
   void EnableDisplayIncludeProcess() override {
     m_bDisplayIncludeProcess = true;
@@ -416,6 +461,14 @@ public:
     MakeAbsoluteOrCurDirRelativeW(m_pOutputStreamName, m_pAbsOutputStreamName);
     return S_OK;
   }
+  void GetIncludeRecords(std::vector<DxcIncludeRecord> &records) override {
+    // The main source is always the first entry and was not included.
+    records.clear();
+    for (size_t i = 1; i < m_includedFiles.size(); ++i)
+      records.push_back({ m_includedFiles[i].Name, m_includedFiles[i].Blob.p });
+    for (const auto &missing : m_missingFiles)
+      records.push_back({ missing.first, nullptr });
+  }
 
   ~DxcArgsFileSystemImpl() override { };
   BOOL FindNextFileW(
@@ -782,8 +835,11 @@ public:
     HANDLE H = CreateFileW(CA2W(lpFileName, CP_UTF8), GENERIC_READ | GENERIC_WRITE,
                            FILE_SHARE_READ | FILE_SHARE_WRITE,
                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL);
-    if (H == INVALID_HANDLE_VALUE)
+    if (H == INVALID_HANDLE_VALUE) {
+      // Callers retry on EINTR, so never leave a stale errno behind.
+      errno = GetLastError() == ERROR_NOT_FOUND ? ENOENT : EIO;
       return -1;
+    }
     int FD = open_osfhandle(intptr_t(H), 0);
     if (FD == -1)
       CloseHandle(H);
@@ -22,6 +22,11 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DXIL/DxilPDB.h"
 
+#include "llvm/ADT/Hashing.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -63,6 +68,133 @@ public:
   }
 };
 
+class DxcIncludeCache : public IDxcIncludeCache {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  struct CachedFile {
+    std::once_flag Loaded;       // Set once the load below has completed.
+    HRESULT hr = S_OK;           // Result of the original load.
+    CComPtr<IDxcBlobUtf8> Blob;  // nullptr if the file was not found.
+  };
+  // Guards the maps and the handler pointer, never held across a load.
+  std::mutex m_lock;
+  // Serializes calls into a handler set by the caller.
+  std::mutex m_handlerLock;
+  CComPtr<IDxcIncludeHandler> m_pHandler;
+  bool m_bDefaultHandler = false;
+  std::unordered_map<std::wstring, std::shared_ptr<CachedFile>> m_files;
+  // Decoded contents keyed by a hash of their UTF-8 text.
+  std::unordered_multimap<size_t, CComPtr<IDxcBlobUtf8>> m_contents;
+
+  static StringRef GetContents(IDxcBlobUtf8 *pBlob) {
+    return StringRef(pBlob->GetStringPointer(), pBlob->GetStringLength());
+  }
+
+  // Returns the cached blob with the same contents as pUtf8, adding pUtf8 if
+  // those contents have not been seen before. Called with m_lock held.
+  IDxcBlobUtf8 *FindOrAddContents(IDxcBlobUtf8 *pUtf8) {
+    StringRef contents = GetContents(pUtf8);
+    size_t hash = llvm::hash_value(contents);
+    auto range = m_contents.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (GetContents(it->second) == contents)
+        return it->second;
+    }
+    m_contents.emplace(hash, pUtf8);
+    return pUtf8;
+  }
+
+  void LoadFile(IDxcIncludeHandler *pHandler, bool bSerialize,
+                LPCWSTR pFilename, CachedFile &file) {
+    CComPtr<IDxcBlob> pRaw;
+    {
+      std::unique_lock<std::mutex> handlerLock(m_handlerLock, std::defer_lock);
+      if (bSerialize)
+        handlerLock.lock();
+      file.hr = pHandler->LoadSource(pFilename, &pRaw);
+    }
+    if (SUCCEEDED(file.hr) && pRaw != nullptr) {
+      // Precompiled headers are binary; keep their bytes unconverted.
+      if (pRaw->GetBufferSize() >= 4 &&
+          0 == memcmp(pRaw->GetBufferPointer(), "CPCH", 4)) {
+        CComPtr<IDxcBlobEncoding> pRawEncoding;
+        IFT(hlsl::DxcCreateBlobEncodingFromBlob(pRaw, 0, 0, true, CP_UTF8,
+                                                m_pMalloc, &pRawEncoding));
+        pRaw = pRawEncoding;
+      }
+      CComPtr<IDxcBlobUtf8> pUtf8;
+      IFT(hlsl::DxcGetBlobAsUtf8(pRaw, m_pMalloc, &pUtf8));
+      std::lock_guard<std::mutex> lock(m_lock);
+      file.Blob = FindOrAddContents(pUtf8);
+    }
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcIncludeCache)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeCache, IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE SetIncludeHandler(
+    _In_opt_ IDxcIncludeHandler *pHandler) override {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_pHandler = pHandler;
+    m_bDefaultHandler = false;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Clear() override {
+    DxcThreadMalloc TM(m_pMalloc);
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_files.clear();
+    m_contents.clear();
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ LPCWSTR pFilename,                                   // Candidate filename.
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource  // Resultant source object for included file, nullptr if not found.
+    ) override {
+    if (ppIncludeSource == nullptr)
+      return E_POINTER;
+    *ppIncludeSource = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::shared_ptr<CachedFile> file;
+      CComPtr<IDxcIncludeHandler> pHandler;
+      bool bSerialize;
+      {
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::shared_ptr<CachedFile> &entry = m_files[pFilename];
+        if (entry == nullptr)
+          entry = std::make_shared<CachedFile>();
+        file = entry;
+        if (m_pHandler == nullptr) {
+          m_pHandler = DxcIncludeHandlerForFS::Alloc(m_pMalloc);
+          IFROOM(m_pHandler.p);
+          m_bDefaultHandler = true;
+        }
+        pHandler = m_pHandler;
+        bSerialize = !m_bDefaultHandler;
+      }
+      // Each name is loaded once. Requests for a name that is being loaded
+      // wait for it; other names load and convert in parallel. The file
+      // system handler is thread-safe, so only a caller's handler is
+      // serialized.
+      std::call_once(file->Loaded, [&]() {
+        LoadFile(pHandler, bSerialize, pFilename, *file);
+      });
+      *ppIncludeSource = file->Blob.p;
+      if (*ppIncludeSource)
+        (*ppIncludeSource)->AddRef();
+      return file->hr;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
 class DxcCompilerArgs : public IDxcCompilerArgs {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
@@ -585,6 +717,16 @@ HRESULT CreateDxcCompilerArgs(_In_ REFIID riid, _Out_ LPVOID* ppv) {
   return result.p->QueryInterface(riid, ppv);
 }
 
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID* ppv) {
+  CComPtr<DxcIncludeCache> result = DxcIncludeCache::Alloc(DxcGetThreadMallocNoRef());
+  if (result == nullptr) {
+    *ppv = nullptr;
+    return E_OUTOFMEMORY;
+  }
+
+  return result.p->QueryInterface(riid, ppv);
+}
+
 HRESULT CreateDxcUtils(_In_ REFIID riid, _Out_ LPVOID* ppv) {
   CComPtr<DxcUtils> result = DxcUtils::Alloc(DxcGetThreadMallocNoRef());
   if (result == nullptr) {
@@ -20,7 +20,11 @@
 #include "dxillib.h"
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
 
 #include "dxc/HLSL/DxilLinker.h"
 #include "dxc/HLSL/DxilValidation.h"
@@ -43,7 +47,8 @@ using namespace llvm;
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcLinker : public IDxcLinker, public IDxcContainerEvent {
+class DxcLinker : public IDxcLinker, public IDxcLinkerBatch,
+                  public IDxcContainerEvent {
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcLinker)
@@ -69,6 +74,20 @@ public:
           *ppResult // Linker output status, buffer, and errors
   ) override;
 
+  // Links one shader per target on a pool of threads.
+  HRESULT STDMETHODCALLTYPE LinkBatch(
+      _In_count_(targetCount) const DxcLinkTarget *pTargets, // Shaders to link
+      _In_ UINT32 targetCount,                               // Number of targets
+      _In_count_(libCount)
+          const LPCWSTR *pLibNames,                          // Array of library names to link
+      _In_ UINT32 libCount,                                  // Number of libraries to link
+      _In_opt_count_(sharedArgCount)
+          const LPCWSTR *pSharedArguments,                   // Arguments common to every target
+      _In_ UINT32 sharedArgCount,                            // Number of shared arguments
+      _In_ UINT32 numThreads,                                // Worker threads; 0 uses one per hardware thread
+      _In_ IDxcLinkerBatchCallback *pCallback                // Receives each target's result
+  ) override;
+
   HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(
       IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) override {
     DxcThreadMalloc TM(m_pMalloc);
@@ -88,7 +107,8 @@ public:
   }
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcLinker>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcLinker, IDxcLinkerBatch>(this, riid,
+                                                              ppvObject);
   }
 
   void Initialize() {
@@ -107,23 +127,21 @@ private:
   LLVMContext m_Ctx;
   std::unique_ptr<DxilLinker> m_pLinker;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
-  std::vector<CComPtr<IDxcBlob>> m_blobs; // Keep blobs live for lazy load.
+  // Keep blobs live for lazy load; batch links load them again by name.
+  llvm::StringMap<CComPtr<IDxcBlob>> m_blobs;
+
+  static HRESULT RegisterLibraryWith(DxilLinker &linker, LLVMContext &Ctx,
+                                     llvm::StringRef libName, IDxcBlob *pBlob);
+  HRESULT LinkWith(DxilLinker &linker, LLVMContext &Ctx, LPCWSTR pEntryName,
+                   LPCWSTR pTargetProfile, const LPCWSTR *pLibNames,
+                   UINT32 libCount, const LPCWSTR *pArguments, UINT32 argCount,
+                   IDxcOperationResult **ppResult);
 };
 
-HRESULT
-DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
-                           _In_ IDxcBlob *pBlob       // Library to add.
-) {
-  if (!pLibName || !pBlob)
-    return E_INVALIDARG;
-  DXASSERT(m_pLinker.get(), "else Initialize() not called or failed silently");
-  DxcThreadMalloc TM(m_pMalloc);
-  // Prepare UTF8-encoded versions of API values.
-  CW2A pUtf8LibName(pLibName, CP_UTF8);
-  // Already exist lib with same name.
-  if (m_pLinker->HasLibNameRegistered(pUtf8LibName.m_psz))
-    return E_INVALIDARG;
-
+// Loads a library lazily into Ctx and registers it with linker.
+HRESULT DxcLinker::RegisterLibraryWith(DxilLinker &linker, LLVMContext &Ctx,
+                                       llvm::StringRef libName,
+                                       IDxcBlob *pBlob) {
   try {
     std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -137,11 +155,10 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
 
     IFR(ValidateLoadModuleFromContainerLazy(
         pBlob->GetBufferPointer(), pBlob->GetBufferSize(), pModule,
-        pDebugModule, m_Ctx, m_Ctx, DiagStream));
+        pDebugModule, Ctx, Ctx, DiagStream));
 
-    if (m_pLinker->RegisterLib(pUtf8LibName.m_psz, std::move(pModule),
-                               std::move(pDebugModule))) {
-      m_blobs.emplace_back(pBlob);
+    if (linker.RegisterLib(libName, std::move(pModule),
+                           std::move(pDebugModule))) {
       return S_OK;
     } else {
       return E_INVALIDARG;
@@ -151,6 +168,31 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
   }
 }
 
+HRESULT
+DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
+                           _In_ IDxcBlob *pBlob       // Library to add.
+) {
+  if (!pLibName || !pBlob)
+    return E_INVALIDARG;
+  DXASSERT(m_pLinker.get(), "else Initialize() not called or failed silently");
+  DxcThreadMalloc TM(m_pMalloc);
+  // Prepare UTF8-encoded versions of API values.
+  CW2A pUtf8LibName(pLibName, CP_UTF8);
+  // Already exist lib with same name.
+  if (m_pLinker->HasLibNameRegistered(pUtf8LibName.m_psz))
+    return E_INVALIDARG;
+
+  HRESULT hr = RegisterLibraryWith(*m_pLinker, m_Ctx, pUtf8LibName.m_psz, pBlob);
+  if (SUCCEEDED(hr)) {
+    try {
+      m_blobs[pUtf8LibName.m_psz] = pBlob;
+    } catch (std::bad_alloc &) {
+      return E_OUTOFMEMORY;
+    }
+  }
+  return hr;
+}
+
 // Links the shader and produces a shader blob that the Direct3D runtime can
 // use.
 HRESULT STDMETHODCALLTYPE DxcLinker::Link(
@@ -168,6 +210,16 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
   if (!pTargetProfile || !pLibNames || libCount == 0 || !ppResult)
     return E_INVALIDARG;
   DxcThreadMalloc TM(m_pMalloc);
+  return LinkWith(*m_pLinker, m_Ctx, pEntryName, pTargetProfile, pLibNames,
+                  libCount, pArguments, argCount, ppResult);
+}
+
+// Links one shader with linker, whose libraries are loaded into Ctx.
+HRESULT DxcLinker::LinkWith(DxilLinker &linker, LLVMContext &Ctx,
+                            LPCWSTR pEntryName, LPCWSTR pTargetProfile,
+                            const LPCWSTR *pLibNames, UINT32 libCount,
+                            const LPCWSTR *pArguments, UINT32 argCount,
+                            IDxcOperationResult **ppResult) {
   // Prepare UTF8-encoded versions of API values.
   CW2A pUtf8TargetProfile(pTargetProfile, CP_UTF8);
   CW2A pUtf8EntryPoint(pEntryName, CP_UTF8);
@@ -175,7 +227,7 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
   CComPtr<AbstractMemoryStream> pOutputStream;
 
   // Detach previous libraries.
-  m_pLinker->DetachAll();
+  linker.DetachAll();
 
   HRESULT hr = S_OK;
   try {
@@ -210,11 +262,11 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     raw_stream_ostream DiagStream(pDiagStream);
     llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
     PrintDiagnosticContext DiagContext(DiagPrinter);
-    m_Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
+    Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
                                &DiagContext, true);
 
     if (opts.ValVerMajor != UINT32_MAX) {
-      m_pLinker->SetValidatorVersion(opts.ValVerMajor, opts.ValVerMinor);
+      linker.SetValidatorVersion(opts.ValVerMajor, opts.ValVerMinor);
     }
 
     bool needsValidation = !opts.DisableValidation;
@@ -230,7 +282,7 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     bool bSuccess = true;
     for (unsigned i = 0; i < libCount; i++) {
       CW2A pUtf8LibName(pLibNames[i], CP_UTF8);
-      bSuccess &= m_pLinker->AttachLib(pUtf8LibName.m_psz);
+      bSuccess &= linker.AttachLib(pUtf8LibName.m_psz);
     }
 
     dxilutil::ExportMap exportMap;
@@ -241,7 +293,7 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
     bool hasErrorOccurred = !bSuccess;
     if (bSuccess) {
-      std::unique_ptr<Module> pM = m_pLinker->Link(
+      std::unique_ptr<Module> pM = linker.Link(
           opts.EntryPoint, pUtf8TargetProfile.m_psz, exportMap);
       if (pM) {
         const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
@@ -308,6 +360,108 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
   return hr;
 }
 
+// Links one shader per target on a pool of threads.
+HRESULT STDMETHODCALLTYPE DxcLinker::LinkBatch(
+    _In_count_(targetCount) const DxcLinkTarget *pTargets, // Shaders to link
+    _In_ UINT32 targetCount,                               // Number of targets
+    _In_count_(libCount)
+        const LPCWSTR *pLibNames,                          // Array of library names to link
+    _In_ UINT32 libCount,                                  // Number of libraries to link
+    _In_opt_count_(sharedArgCount)
+        const LPCWSTR *pSharedArguments,                   // Arguments common to every target
+    _In_ UINT32 sharedArgCount,                            // Number of shared arguments
+    _In_ UINT32 numThreads,                                // Worker threads; 0 uses one per hardware thread
+    _In_ IDxcLinkerBatchCallback *pCallback                // Receives each target's result
+) {
+  if ((targetCount > 0 && !pTargets) || !pLibNames || libCount == 0 ||
+      (sharedArgCount > 0 && !pSharedArguments) || !pCallback)
+    return E_INVALIDARG;
+  for (UINT32 i = 0; i < targetCount; ++i) {
+    if (!pTargets[i].pTargetProfile ||
+        (pTargets[i].argCount > 0 && !pTargets[i].pArguments))
+      return E_INVALIDARG;
+  }
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    // Every library must already be registered; each thread loads its own
+    // copy of them from the registered blobs.
+    std::vector<std::pair<std::string, IDxcBlob *>> libs;
+    for (UINT32 i = 0; i < libCount; ++i) {
+      CW2A pUtf8LibName(pLibNames[i], CP_UTF8);
+      auto it = m_blobs.find(pUtf8LibName.m_psz);
+      if (it == m_blobs.end())
+        return E_INVALIDARG;
+      libs.emplace_back(it->getKey().str(), it->getValue().p);
+    }
+
+    UINT32 valMajor, valMinor;
+    dxcutil::GetValidatorVersion(&valMajor, &valMinor);
+
+    if (numThreads == 0)
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, targetCount);
+
+    std::atomic<UINT32> nextTarget(0);
+    std::atomic<HRESULT> batchHR(S_OK);
+    auto linkTargets = [&]() {
+      DxcThreadMalloc TM(m_pMalloc);
+      HRESULT hr = S_OK;
+      try {
+        // Make sure the linker is released before its LLVMContext.
+        LLVMContext Ctx;
+        std::unique_ptr<DxilLinker> pLinker(
+            DxilLinker::CreateLinker(Ctx, valMajor, valMinor));
+        for (auto &lib : libs) {
+          hr = RegisterLibraryWith(*pLinker, Ctx, lib.first, lib.second);
+          if (FAILED(hr))
+            break;
+        }
+
+        std::vector<LPCWSTR> args;
+        for (UINT32 i = nextTarget++;
+             SUCCEEDED(hr) && i < targetCount && SUCCEEDED(batchHR);
+             i = nextTarget++) {
+          const DxcLinkTarget &target = pTargets[i];
+          args.assign(pSharedArguments, pSharedArguments + sharedArgCount);
+          args.insert(args.end(), target.pArguments,
+                      target.pArguments + target.argCount);
+          CComPtr<IDxcOperationResult> pResult;
+          hr = LinkWith(*pLinker, Ctx, target.pEntryName,
+                        target.pTargetProfile, pLibNames, libCount,
+                        args.data(), (UINT32)args.size(), &pResult);
+          if (SUCCEEDED(hr))
+            hr = pCallback->OnResult(i, pResult);
+        }
+      } catch (std::bad_alloc &) {
+        hr = E_OUTOFMEMORY;
+      }
+      if (FAILED(hr)) {
+        HRESULT expected = S_OK;
+        batchHR.compare_exchange_strong(expected, hr);
+      }
+    };
+
+    if (numThreads <= 1) {
+      linkTargets();
+    } else {
+      std::vector<std::thread> workers;
+      workers.reserve(numThreads - 1);
+      try {
+        for (UINT32 i = 1; i < numThreads; ++i)
+          workers.emplace_back(linkTargets);
+      } catch (std::system_error &) {
+        // Continue with the threads that did start.
+      }
+      linkTargets();
+      for (std::thread &worker : workers)
+        worker.join();
+    }
+    return batchHR;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv) {
   *ppv = nullptr;
   try {
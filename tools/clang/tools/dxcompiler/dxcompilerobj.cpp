@@ -20,11 +20,14 @@
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Sema/SemaHLSL.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
@@ -51,10 +54,14 @@
 #endif
 #include "dxillib.h"
 #include "dxcshadersourceinfo.h"
+#include "dxccompilecache.h"
 #include "dxcompileradapter.h"
 #include "dxcversion.inc"
 #include <algorithm>
+#include <atomic>
 #include <cfloat>
+#include <system_error>
+#include <thread>
 
 // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
@@ -173,20 +180,10 @@ struct CompilerVersionPartWriter {
   }
 };
 
-static HRESULT CreateContainerForPDB(IMalloc *pMalloc,
-  IDxcBlob *pOldContainer,
-  IDxcBlob *pDebugBlob, IDxcVersionInfo *pVersionInfo,
-  const hlsl::DxilSourceInfo *pSourceInfo,
-  AbstractMemoryStream *pReflectionStream,
-  IDxcBlob **ppNewContaner)
-{
-  // If the pContainer is not a valid container, give up.
-  if (!hlsl::IsValidDxilContainer((hlsl::DxilContainerHeader *)pOldContainer->GetBufferPointer(), pOldContainer->GetBufferSize()))
-    return E_FAIL;
-
-  hlsl::DxilContainerHeader *DxilHeader = (hlsl::DxilContainerHeader *)pOldContainer->GetBufferPointer();
-  hlsl::DxilProgramHeader *ProgramHeader = nullptr;
-
+// Lays out the container stored in the PDB without materializing it, so that
+// it can be written straight into the PDB data stream. The blobs passed to
+// Init must outlive the writer.
+class PdbContainerWriter {
   struct Part {
     typedef std::function<HRESULT(IStream *)> WriteProc;
     UINT32 uFourCC = 0;
@@ -200,9 +197,37 @@ static HRESULT CreateContainerForPDB(IMalloc *pMalloc,
     {}
   };
 
+  hlsl::DxilContainerHeader m_Header = {};
+  SmallVector<UINT32, 4> m_OffsetTable;
+  SmallVector<Part, 4> m_PartWriters;
+  CompilerVersionPartWriter m_VersionWriter;
+
+public:
+  HRESULT Init(IDxcBlob *pOldContainer,
+    IDxcBlob *pDebugBlob, IDxcVersionInfo *pVersionInfo,
+    const hlsl::DxilSourceInfo *pSourceInfo,
+    AbstractMemoryStream *pReflectionStream);
+
+  UINT32 GetSize() const { return m_Header.ContainerSizeInBytes; }
+
+  HRESULT Write(IStream *pStream) const;
+};
+
+HRESULT PdbContainerWriter::Init(IDxcBlob *pOldContainer,
+  IDxcBlob *pDebugBlob, IDxcVersionInfo *pVersionInfo,
+  const hlsl::DxilSourceInfo *pSourceInfo,
+  AbstractMemoryStream *pReflectionStream)
+{
+  // If the pContainer is not a valid container, give up.
+  if (!hlsl::IsValidDxilContainer((hlsl::DxilContainerHeader *)pOldContainer->GetBufferPointer(), pOldContainer->GetBufferSize()))
+    return E_FAIL;
+
+  hlsl::DxilContainerHeader *DxilHeader = (hlsl::DxilContainerHeader *)pOldContainer->GetBufferPointer();
+  hlsl::DxilProgramHeader *ProgramHeader = nullptr;
+
   // Compute offset table.
-  SmallVector<UINT32, 4> OffsetTable;
-  SmallVector<Part, 4> PartWriters;
+  SmallVector<UINT32, 4> &OffsetTable = m_OffsetTable;
+  SmallVector<Part, 4> &PartWriters = m_PartWriters;
   UINT32 uTotalPartsSize = 0;
 
   auto AddPart = [&PartWriters, &OffsetTable, &uTotalPartsSize](Part NewPart, UINT32 uSize) {
@@ -270,7 +295,7 @@ static HRESULT CreateContainerForPDB(IMalloc *pMalloc,
     AddPart(NewPart, pReflectionPartHeader->PartSize);
   }
 
-  CompilerVersionPartWriter versionWriter;
+  CompilerVersionPartWriter &versionWriter = m_VersionWriter;
   if (pVersionInfo) {
     versionWriter.Init(pVersionInfo);
 
@@ -324,33 +349,32 @@ static HRESULT CreateContainerForPDB(IMalloc *pMalloc,
     OffsetTable[i] += sizeof(hlsl::DxilContainerHeader) + OffsetTable.size() * sizeof(UINT32);
 
   // Create the new header
-  hlsl::DxilContainerHeader NewDxilHeader = *DxilHeader;
-  NewDxilHeader.PartCount = OffsetTable.size();
-  NewDxilHeader.ContainerSizeInBytes =
-    sizeof(NewDxilHeader) +
+  m_Header = *DxilHeader;
+  m_Header.PartCount = OffsetTable.size();
+  m_Header.ContainerSizeInBytes =
+    sizeof(m_Header) +
     OffsetTable.size() * sizeof(UINT32) +
     uTotalPartsSize;
 
-  // Write it to the result stream
+  return S_OK;
+}
+
+HRESULT PdbContainerWriter::Write(IStream *pStream) const {
   ULONG uSizeWritten = 0;
-  CComPtr<hlsl::AbstractMemoryStream> pStrippedContainerStream;
-  IFR(hlsl::CreateMemoryStream(pMalloc, &pStrippedContainerStream));
-  IFR(pStrippedContainerStream->Write(&NewDxilHeader, sizeof(NewDxilHeader), &uSizeWritten));
+  IFR(pStream->Write(&m_Header, sizeof(m_Header), &uSizeWritten));
 
   // Write offset table
-  IFR(pStrippedContainerStream->Write(OffsetTable.data(), OffsetTable.size() * sizeof(OffsetTable.data()[0]), &uSizeWritten));
+  IFR(pStream->Write(m_OffsetTable.data(), m_OffsetTable.size() * sizeof(m_OffsetTable.data()[0]), &uSizeWritten));
 
-  for (unsigned i = 0; i < PartWriters.size(); i++) {
-    auto &Writer = PartWriters[i];
+  for (unsigned i = 0; i < m_PartWriters.size(); i++) {
+    auto &Writer = m_PartWriters[i];
     hlsl::DxilPartHeader PartHeader = {};
     PartHeader.PartFourCC = Writer.uFourCC;
     PartHeader.PartSize = Writer.uSize;
-    IFR(pStrippedContainerStream->Write(&PartHeader, sizeof(PartHeader), &uSizeWritten));
-    IFR(Writer.Writer(pStrippedContainerStream));
+    IFR(pStream->Write(&PartHeader, sizeof(PartHeader), &uSizeWritten));
+    IFR(Writer.Writer(pStream));
   }
 
-  IFR(pStrippedContainerStream.QueryInterface(ppNewContaner));
-
   return S_OK;
 }
 
@@ -555,7 +579,158 @@ static HRESULT ErrorWithString(const std::string &error, REFIID riid, void **ppR
   return S_OK;
 }
 
+// Owns the current thread's time trace profiler for a compile that asked for
+// -ftime-report or -ftime-trace, unless a caller up the stack already did.
+class TimeTraceProfilerOwner {
+  bool m_owned = false;
+
+public:
+  ~TimeTraceProfilerOwner() {
+    if (m_owned)
+      llvm::timeTraceProfilerCleanup();
+  }
+  void Enable(llvm::TimeTraceClock::time_point startTime) {
+    if (!llvm::timeTraceProfilerEnabled()) {
+      llvm::timeTraceProfilerInitialize(startTime);
+      m_owned = true;
+    }
+  }
+  bool IsOwned() const { return m_owned; }
+};
+
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID *ppv);
+
+// Returns the length of the leading lines of a batch source that only hold
+// comments and #include, #define and #undef directives. These lines can be
+// compiled once into a precompiled header shared by every variant. Returns
+// 0 when they include no file, as there is then little to share.
+static size_t GetSharedPrefixLength(StringRef source) {
+  size_t prefixEnd = 0;
+  bool hasInclude = false;
+  size_t pos = 0;
+  while (pos < source.size()) {
+    char c = source[pos];
+    if (c == '\n') {
+      prefixEnd = ++pos;
+      continue;
+    }
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+      ++pos;
+      continue;
+    }
+    StringRef rest = source.substr(pos);
+    if (rest.startswith("//")) {
+      pos = std::min(source.find('\n', pos), source.size());
+      continue;
+    }
+    if (rest.startswith("/*")) {
+      size_t close = source.find("*/", pos + 2);
+      if (close == StringRef::npos)
+        break;
+      pos = close + 2;
+      continue;
+    }
+    if (c != '#')
+      break;
+    rest = rest.drop_front().ltrim();
+    StringRef directive = rest.substr(
+        0, rest.find_first_not_of("abcdefghijklmnopqrstuvwxyz"));
+    if (directive != "include" && directive != "define" &&
+        directive != "undef")
+      break;
+    // The directive ends at the first newline not escaped by a backslash.
+    size_t eol = source.find('\n', pos);
+    while (eol != StringRef::npos &&
+           source.substr(0, eol).rtrim("\r").endswith("\\"))
+      eol = source.find('\n', eol + 1);
+    if (eol == StringRef::npos)
+      break;
+    hasInclude |= directive == "include";
+    pos = eol;
+  }
+  return hasInclude ? prefixEnd : 0;
+}
+
+// Returns true if text holds one of names as an identifier. Comments and
+// strings are not skipped, so this may find names that are never expanded.
+static bool ReferencesAnyName(StringRef text, const StringSet<> &names) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    if (!isalpha(text[pos]) && text[pos] != '_') {
+      ++pos;
+      continue;
+    }
+    size_t start = pos;
+    while (pos < text.size() && (isalnum(text[pos]) || text[pos] == '_'))
+      ++pos;
+    if (names.count(text.substr(start, pos - start)))
+      return true;
+  }
+  return false;
+}
+
+// Reserved name under which a batch serves its precompiled header.
+static const char BatchPCHName[] = "dxc-batch.pch";
+static const wchar_t BatchPCHNameW[] = L"dxc-batch.pch";
+
+// Include handler of a batch whose variants share a precompiled header. It
+// serves the header under a reserved name and forwards every other name to
+// the batch include handler. Until the header is set, it keeps the files it
+// loads, which are the files the header was built from; afterwards it is
+// read-only, so the variants may use it concurrently.
+class DxcBatchIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pHandler;
+  CComPtr<IDxcBlob> m_pPCH;
+  std::vector<CComPtr<IDxcBlob>> m_LoadedFiles;
+
+  static bool IsPCHName(LPCWSTR pFilename) {
+    std::string path = Unicode::UTF16ToUTF8StringOrThrow(pFilename);
+    StringRef name(path);
+    return name.substr(name.find_last_of("/\\") + 1) == BatchPCHName;
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcBatchIncludeHandler)
+
+  DxcBatchIncludeHandler(IMalloc *pMalloc, IDxcIncludeHandler *pHandler)
+      : m_dwRef(0), m_pMalloc(pMalloc), m_pHandler(pHandler) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void SetPCH(IDxcBlob *pPCH) { m_pPCH = pPCH; }
+  const std::vector<CComPtr<IDxcBlob>> &GetLoadedFiles() const {
+    return m_LoadedFiles;
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ LPCWSTR pFilename,                                   // Candidate filename.
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource  // Resultant source object for included file, nullptr if not found.
+    ) override {
+    if (ppIncludeSource == nullptr)
+      return E_POINTER;
+    *ppIncludeSource = nullptr;
+    try {
+      if (m_pPCH != nullptr && IsPCHName(pFilename)) {
+        *ppIncludeSource = m_pPCH;
+        (*ppIncludeSource)->AddRef();
+        return S_OK;
+      }
+      HRESULT hr = m_pHandler->LoadSource(pFilename, ppIncludeSource);
+      if (SUCCEEDED(hr) && *ppIncludeSource != nullptr && m_pPCH == nullptr)
+        m_LoadedFiles.emplace_back(*ppIncludeSource);
+      return hr;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
 class DxcCompiler : public IDxcCompiler3,
+                    public IDxcCompilerBatch,
                     public IDxcLangExtensions3,
                     public IDxcContainerEvent,
                     public IDxcVersionInfo3,
@@ -590,6 +765,7 @@ public:
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
     HRESULT hr = DoBasicQueryInterface<
       IDxcCompiler3,
+      IDxcCompilerBatch,
       IDxcLangExtensions,
       IDxcLangExtensions2,
       IDxcLangExtensions3,
@@ -635,6 +811,9 @@ public:
 
     try {
       DefaultFPEnvScope fpEnvScope;
+      TimeTraceProfilerOwner timeTraceOwner;
+      llvm::TimeTraceClock::time_point compileStartTime =
+          llvm::TimeTraceClock::now();
 
       IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
 
@@ -660,6 +839,15 @@ public:
         }
       }
 
+      if (opts.TimeReport || !opts.TimeTrace.empty()) {
+        timeTraceOwner.Enable(compileStartTime);
+        llvm::timeTraceProfilerAddRegion("ParseOptions", "", compileStartTime);
+      }
+
+      // From here on, what operator new hands out on this thread comes from
+      // an arena whose chunks are freed together once the compile is done.
+      DxcThreadArena arena(opts.CompileArena);
+
       bool isPreprocessing = !opts.Preprocess.empty();
       if (isPreprocessing) {
         DxcEtw_DXCompilerPreprocess_Start();
@@ -694,32 +882,33 @@ public:
         true, false, pSource->Encoding != 0, pSource->Encoding,
         nullptr, &pSourceEncoding));
 
- #ifdef ENABLE_SPIRV_CODEGEN
-      // We want to embed the preprocessed source code in the final SPIR-V if
-      // debug information is enabled. Therefore, we invoke Preprocess() here
-      // first for such case. Then we invoke the compilation process over the
-      // preprocessed source code, so that line numbers are consistent with the
-      // embedded source code.
-      if (!isPreprocessing && opts.GenSPIRV && opts.DebugInfo) {
-        CComPtr<IDxcResult> pSrcCodeResult;
-        std::vector<LPCWSTR> PreprocessArgs;
-        PreprocessArgs.reserve(argCount + 1);
-        PreprocessArgs.assign(pArguments, pArguments + argCount);
-        PreprocessArgs.push_back(L"-P");
-        PreprocessArgs.push_back(L"preprocessed.hlsl");
-        IFT(Compile(pSource, PreprocessArgs.data(), PreprocessArgs.size(), pIncludeHandler, IID_PPV_ARGS(&pSrcCodeResult)));
-        HRESULT status;
-        IFT(pSrcCodeResult->GetStatus(&status));
-        if (SUCCEEDED(status)) {
-          pSourceEncoding.Release();
-          IFT(pSrcCodeResult->GetOutput(DXC_OUT_HLSL, IID_PPV_ARGS(&pSourceEncoding), nullptr));
-        }
-      }
-#endif // ENABLE_SPIRV_CODEGEN
-
       // Convert source code encoding
       IFC(hlsl::DxcGetBlobAsUtf8(pSourceEncoding, m_pMalloc, &utf8Source));
 
+      // Only full compiles whose inputs all come through the include handler
+      // can be served from the cache. Registered language extensions change
+      // the output in ways the key can't capture.
+      std::unique_ptr<dxcutil::DxcCompileCache> pCompileCache;
+      if (!opts.CacheDir.empty() && !isPreprocessing && !opts.AstDump &&
+          !m_langExtensionsHelper.HasRegisteredExtensions() &&
+          !opts.OptDump && !opts.CodeGenHighLevel && !opts.EmitPCH &&
+          opts.IncludePCH.empty() &&
+          !opts.DisplayIncludeProcess && opts.ImportBindingTable.empty() &&
+          !opts.TimeReport && opts.TimeTrace.empty() &&
+          m_pDxcContainerEventsHandler == nullptr) {
+        pCompileCache.reset(new dxcutil::DxcCompileCache(
+            opts.CacheDir, (uint64_t)opts.CacheSizeLimit << 20));
+        pCompileCache->ComputeKey(static_cast<IDxcVersionInfo *>(this), opts,
+                                  utf8Source);
+        CComPtr<IDxcResult> pCachedResult;
+        if (pCompileCache->Lookup(pIncludeHandler, opts.DefaultTextCodePage,
+                                  &pCachedResult) == S_OK) {
+          IFT(pCachedResult->QueryInterface(riid, ppResult));
+          hr = S_OK;
+          goto Cleanup;
+        }
+      }
+
       CComPtr<IDxcBlob> pOutputBlob;
       dxcutil::DxcArgsFileSystem *msfPtr =
         dxcutil::CreateDxcArgsFileSystem(utf8Source, pUtf16SourceName.m_psz, pIncludeHandler);
@@ -798,6 +987,7 @@ public:
         PPOutOpts.ShowMacros = 0;         // Print macro definitions.
         PPOutOpts.RewriteIncludes = 0;    // Preprocess include directives only.
 
+        llvm::TimeTraceScope preprocessScope("Preprocess");
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
         clang::PrintPreprocessedAction action;
         if (action.BeginSourceFile(compiler, file)) {
@@ -856,7 +1046,7 @@ public:
 
         // NOTE: this calls the validation component from dxil.dll; the built-in
         // validator can be used as a fallback.
-        produceFullContainer = !opts.CodeGenHighLevel && !opts.AstDump && !opts.OptDump && rootSigMajor == 0;
+        produceFullContainer = !opts.CodeGenHighLevel && !opts.AstDump && !opts.OptDump && !opts.EmitPCH && rootSigMajor == 0;
         needsValidation = produceFullContainer && !opts.DisableValidation;
 
         if (compiler.getCodeGenOpts().HLSLProfile == "lib_6_x") {
@@ -891,6 +1081,18 @@ public:
         dumpAction.EndSourceFile();
         outStream.flush();
       }
+      else if (opts.EmitPCH) {
+        // The PCH is written to the default output, as a compile writes its
+        // object.
+        clang::GeneratePCHAction action;
+        FrontendInputFile file(pUtf8SourceName, IK_HLSL);
+        llvm::TimeTraceScope frontendScope("Frontend");
+        if (action.BeginSourceFile(compiler, file)) {
+          action.Execute();
+          action.EndSourceFile();
+        }
+        outStream.flush();
+      }
       else if (opts.OptDump) {
         EmitOptDumpAction action(&llvmContext);
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
@@ -957,13 +1159,16 @@ public:
         EmitBCAction action(&llvmContext);
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
         bool compileOK;
-        if (action.BeginSourceFile(compiler, file)) {
-          action.Execute();
-          action.EndSourceFile();
-          compileOK = !compiler.getDiagnostics().hasErrorOccurred();
-        }
-        else {
-          compileOK = false;
+        {
+          llvm::TimeTraceScope frontendScope("Frontend");
+          if (action.BeginSourceFile(compiler, file)) {
+            action.Execute();
+            action.EndSourceFile();
+            compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+          }
+          else {
+            compileOK = false;
+          }
         }
         outStream.flush();
 
@@ -1015,6 +1220,8 @@ public:
                 pOutputStream,
                 opts.GetPDBName(), &compiler.getDiagnostics(),
                 &ShaderHashContent, pReflectionStream, pRootSigStream);
+          // Share the PDB snapshot with the validator rather than cloning again.
+          inputs.pDebugModule = debugModule.get();
 
           if (needsValidation) {
             valHR = dxcutil::ValidateAndAssembleToContainer(inputs);
@@ -1089,73 +1296,115 @@ public:
       // SPIRV change ends
 
       if (!hasErrorOccurred && writePDB) {
-        CComPtr<IDxcBlob> pStrippedContainer;
-        {
-          // Create the shader source information for PDB
-          hlsl::SourceInfoWriter debugSourceInfoWriter;
-          const hlsl::DxilSourceInfo *pSourceInfo = nullptr;
-          if (!opts.SourceInDebugModule) { // If we are using old PDB format where sources are in debug module, do not generate source info at all
-            debugSourceInfoWriter.Write(opts.TargetProfile, opts.EntryPoint, compiler.getCodeGenOpts(), compiler.getSourceManager());
-            pSourceInfo = debugSourceInfoWriter.GetPart();
-          }
+        llvm::TimeTraceScope pdbScope("WritePDB");
+        // Create the shader source information for PDB
+        hlsl::SourceInfoWriter debugSourceInfoWriter;
+        const hlsl::DxilSourceInfo *pSourceInfo = nullptr;
+        if (!opts.SourceInDebugModule) { // If we are using old PDB format where sources are in debug module, do not generate source info at all
+          debugSourceInfoWriter.Write(opts.TargetProfile, opts.EntryPoint, compiler.getCodeGenOpts(), compiler.getSourceManager());
+          pSourceInfo = debugSourceInfoWriter.GetPart();
+        }
 
-          CComPtr<IDxcBlob> pDebugProgramBlob;
-          CComPtr<AbstractMemoryStream> pReflectionInPdb;
-          // Don't include the debug part if using source only PDB
-          if (opts.SourceOnlyDebug) {
-            assert(pSourceInfo);
-            pReflectionInPdb = pReflectionStream;
-          }
-          else {
-            if (!opts.SourceInDebugModule) {
-              // Strip out the source related metadata
-              debugModule->GetOrCreateDxilModule()
-                .StripShaderSourcesAndCompileOptions(/* bReplaceWithDummyData */ true);
-            }
-            CComPtr<AbstractMemoryStream> pDebugBlobStorage;
-            IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pDebugBlobStorage));
-            raw_stream_ostream outStream(pDebugBlobStorage.p);
-            WriteBitcodeToFile(debugModule.get(), outStream, true);
-            outStream.flush();
-            IFT(pDebugBlobStorage.QueryInterface(&pDebugProgramBlob));
+        CComPtr<IDxcBlob> pDebugProgramBlob;
+        CComPtr<AbstractMemoryStream> pReflectionInPdb;
+        // Don't include the debug part if using source only PDB
+        if (opts.SourceOnlyDebug) {
+          assert(pSourceInfo);
+          pReflectionInPdb = pReflectionStream;
+        }
+        else {
+          if (!opts.SourceInDebugModule) {
+            // Strip out the source related metadata
+            debugModule->GetOrCreateDxilModule()
+              .StripShaderSourcesAndCompileOptions(/* bReplaceWithDummyData */ true);
           }
-
-          IFT(CreateContainerForPDB(
-            m_pMalloc,
-            pOutputBlob, pDebugProgramBlob,
-            static_cast<IDxcVersionInfo *>(this), pSourceInfo,
-            pReflectionInPdb,
-            &pStrippedContainer));
+          CComPtr<AbstractMemoryStream> pDebugBlobStorage;
+          IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pDebugBlobStorage));
+          raw_stream_ostream outStream(pDebugBlobStorage.p);
+          WriteBitcodeToFile(debugModule.get(), outStream, true);
+          outStream.flush();
+          IFT(pDebugBlobStorage.QueryInterface(&pDebugProgramBlob));
         }
 
-        // Create the final PDB Blob
-        CComPtr<IDxcBlob> pPdbBlob;
-        IFT(hlsl::pdb::WriteDxilPDB(m_pMalloc, pStrippedContainer, ShaderHashContent.Digest, &pPdbBlob));
-        IFT(pResult->SetOutputObject(DXC_OUT_PDB, pPdbBlob));
+        // The container for the PDB is only laid out here. It is written
+        // straight into the PDB data stream, which in turn is written straight
+        // into its final blob, so the debug bitcode is copied exactly once.
+        PdbContainerWriter pdbContainer;
+        IFT(pdbContainer.Init(
+          pOutputBlob, pDebugProgramBlob,
+          static_cast<IDxcVersionInfo *>(this), pSourceInfo,
+          pReflectionInPdb));
+        const UINT32 uPdbSize = hlsl::pdb::GetDxilPDBSize(pdbContainer.GetSize());
+        auto WritePdb = [&pdbContainer, &ShaderHashContent](AbstractMemoryStream *pStream) {
+          return hlsl::pdb::WriteDxilPDB(
+            pStream, pdbContainer.GetSize(),
+            [&pdbContainer](IStream *pContainerStream) {
+              return pdbContainer.Write(pContainerStream);
+            },
+            ShaderHashContent.Digest);
+        };
 
-        // If option Qpdb_in_private given, add the PDB to the DXC_OUT_OBJECT container output as a
-        // DFCC_PrivateData part.
+        CComPtr<IDxcBlob> pPdbBlob;
         if (opts.PdbInPrivate) {
-          CComPtr<IDxcBlobEncoding> pContainerBlob;
-          hlsl::DxcCreateBlobWithEncodingFromPinned(pOutputBlob->GetBufferPointer(), pOutputBlob->GetBufferSize(), CP_ACP, &pContainerBlob);
-
-          CComPtr<IDxcContainerBuilder> pContainerBuilder;
-          DxcCreateInstance2(this->m_pMalloc, CLSID_DxcContainerBuilder, IID_PPV_ARGS(&pContainerBuilder));
-          IFT(pContainerBuilder->Load(pOutputBlob));
-          IFT(pContainerBuilder->AddPart(hlsl::DFCC_PrivateData, pPdbBlob));
-
-          CComPtr<IDxcOperationResult> pReserializeResult;
-          IFT(pContainerBuilder->SerializeContainer(&pReserializeResult));
-
+          // If option Qpdb_in_private given, write the PDB into a
+          // DFCC_PrivateData part appended to the DXC_OUT_OBJECT container,
+          // and output a view of that part as the PDB.
           CComPtr<IDxcBlob> pNewOutput;
-          IFT(pReserializeResult->GetResult(&pNewOutput));
+          UINT32 uPartOffset = 0;
+          IFT(AppendPartToContainer(m_pMalloc, pOutputBlob,
+            hlsl::DFCC_PrivateData, uPdbSize, WritePdb,
+            &pNewOutput, &uPartOffset));
+          IFT(hlsl::DxcCreateBlobFromBlob(
+            pNewOutput, uPartOffset + sizeof(hlsl::DxilPartHeader), uPdbSize,
+            &pPdbBlob));
           pOutputBlob = pNewOutput;
-        } // PDB in private
+        }
+        else {
+          // Create the final PDB Blob
+          CComPtr<AbstractMemoryStream> pPdbStream;
+          IFT(CreateMemoryStream(m_pMalloc, &pPdbStream));
+          IFT(pPdbStream->Reserve(uPdbSize));
+          IFT(WritePdb(pPdbStream));
+          IFT(pPdbStream.QueryInterface(&pPdbBlob));
+        }
+        IFT(pResult->SetOutputObject(DXC_OUT_PDB, pPdbBlob));
       } // Write PDB
 
       IFT(primaryOutput.SetObject(pOutputBlob, opts.DefaultTextCodePage));
       IFT(pResult->SetOutput(primaryOutput));
       IFT(pResult->SetStatusAndPrimaryResult(hasErrorOccurred ? E_FAIL : S_OK, primaryOutput.kind));
+
+      // A failure to store only costs the next compile a cache hit.
+      if (pCompileCache && !hasErrorOccurred && pOutputBlob)
+        pCompileCache->Store(msfPtr, pResult);
+
+      if (timeTraceOwner.IsOwned()) {
+        if (opts.TimeReport) {
+          std::string timeReport;
+          raw_string_ostream OS(timeReport);
+          llvm::timeTraceProfilerWriteReport(OS);
+          if (opts.CompileArena) {
+            DxcArenaStats arenaStats = arena.GetStats();
+            if (arena.IsInstalled())
+              OS << format("\n  Compile arena: %llu KB requested, %llu KB in chunks\n",
+                           (unsigned long long)arenaStats.TotalBytes >> 10,
+                           (unsigned long long)arenaStats.ChunkBytes >> 10);
+            else
+              OS << "\n  Compile arena: not available in this process\n";
+          }
+          OS.flush();
+          IFT(pResult->SetOutputString(DXC_OUT_TIME_REPORT, timeReport.c_str(), timeReport.size()));
+        }
+        if (!opts.TimeTrace.empty()) {
+          std::string timeTrace;
+          raw_string_ostream OS(timeTrace);
+          llvm::timeTraceProfilerWrite(OS);
+          OS.flush();
+          IFT(pResult->SetOutputString(DXC_OUT_TIME_TRACE, timeTrace.c_str(), timeTrace.size()));
+          if (opts.TimeTrace != "-")
+            IFT(pResult->SetOutputName(DXC_OUT_TIME_TRACE, llvm::StringRef(opts.TimeTrace)));
+        }
+      }
       IFT(pResult->QueryInterface(riid, ppResult));
 
       hr = S_OK;
@@ -1187,6 +1436,234 @@ public:
     return hr;
   }
 
+private:
+  // Builds the precompiled header shared by the variants of a batch. It
+  // holds the leading includes and defines of the source, compiled with the
+  // shared arguments, so the defines they set are the only ones it depends
+  // on. It is only used when the output of every variant stays the same:
+  // - each variant adds nothing but -D defines, and neither the header lines
+  //   nor the files they include mention the names of those defines;
+  // - there is no debug information or source hash, which carry the main
+  //   file text, and no compile cache, which does not serve PCH compiles;
+  // - building the header reported nothing, as each variant would otherwise
+  //   miss those warnings.
+  // On success, returns the include handler that serves the header, and the
+  // source with the header lines left blank, so line numbers do not change.
+  bool PrepareBatchPCH(StringRef source, LPCWSTR *pSharedArguments,
+                       UINT32 sharedArgCount,
+                       IDxcCompilerArgs **ppVariantArguments,
+                       UINT32 variantCount,
+                       IDxcIncludeHandler *pIncludeHandler,
+                       DxcBatchIncludeHandler **ppPCHIncludeHandler,
+                       std::string &variantSource) {
+    size_t prefixLength = GetSharedPrefixLength(source);
+    if (variantCount < 2 || prefixLength == 0)
+      return false;
+
+    const llvm::opt::OptTable *table = hlsl::options::getHlslOptTable();
+    int argCountInt;
+    IFT(UIntToInt(sharedArgCount, &argCountInt));
+    hlsl::options::MainArgs sharedArgs(argCountInt, pSharedArguments, 0);
+    hlsl::options::DxcOpts sharedOpts;
+    std::string optionErrors;
+    raw_string_ostream optionErrorStream(optionErrors);
+    if (0 != hlsl::options::ReadDxcOpts(table, hlsl::options::CompilerFlags,
+                                        sharedArgs, sharedOpts,
+                                        optionErrorStream))
+      return false;
+    if (!sharedOpts.IncludePCH.empty() || sharedOpts.EmitPCH ||
+        !sharedOpts.Preprocess.empty() || sharedOpts.AstDump ||
+        sharedOpts.OptDump || sharedOpts.CodeGenHighLevel ||
+        sharedOpts.DisplayIncludeProcess || sharedOpts.GeneratePDB() ||
+        sharedOpts.DebugNameForSource || !sharedOpts.CacheDir.empty() ||
+        sharedOpts.RecompileFromBinary || sharedOpts.DumpBin)
+      return false;
+#ifdef ENABLE_SPIRV_CODEGEN
+    if (sharedOpts.GenSPIRV)
+      return false;
+#endif
+
+    StringSet<> variantDefines;
+    for (UINT32 i = 0; i < variantCount; ++i) {
+      IDxcCompilerArgs *pVariantArgs = ppVariantArguments[i];
+      IFT(UIntToInt(pVariantArgs->GetCount(), &argCountInt));
+      hlsl::options::MainArgs variantArgs(argCountInt,
+                                          pVariantArgs->GetArguments(), 0);
+      unsigned missingArgIndex = 0, missingArgCount = 0;
+      llvm::opt::InputArgList args = table->ParseArgs(
+          variantArgs.getArrayRef(), missingArgIndex, missingArgCount,
+          hlsl::options::CompilerFlags);
+      if (missingArgCount != 0)
+        return false;
+      for (const llvm::opt::Arg *A : args) {
+        if (!A->getOption().matches(hlsl::options::OPT_D))
+          return false;
+        variantDefines.insert(StringRef(A->getValue()).split('=').first);
+      }
+    }
+    std::string prefix = source.substr(0, prefixLength);
+    if (ReferencesAnyName(prefix, variantDefines))
+      return false;
+
+    CComPtr<DxcBatchIncludeHandler> pPCHIncludeHandler =
+        DxcBatchIncludeHandler::Alloc(m_pMalloc, pIncludeHandler);
+    IFTOOM(pPCHIncludeHandler.p);
+    std::vector<LPCWSTR> args(pSharedArguments,
+                              pSharedArguments + sharedArgCount);
+    args.push_back(L"-emit-pch");
+    DxcBuffer prefixBuffer;
+    prefixBuffer.Ptr = prefix.c_str();
+    prefixBuffer.Size = prefix.size() + 1;
+    prefixBuffer.Encoding = CP_UTF8;
+    CComPtr<IDxcResult> pResult;
+    HRESULT status;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    CComPtr<IDxcBlob> pPCH;
+    if (FAILED(Compile(&prefixBuffer, args.data(), (UINT32)args.size(),
+                       pPCHIncludeHandler, IID_PPV_ARGS(&pResult))) ||
+        FAILED(pResult->GetStatus(&status)) || FAILED(status) ||
+        FAILED(pResult->GetErrorBuffer(&pErrors)) ||
+        (pErrors != nullptr && pErrors->GetBufferSize() > 0) ||
+        FAILED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pPCH),
+                                  nullptr)) ||
+        pPCH == nullptr)
+      return false;
+    for (IDxcBlob *pFile : pPCHIncludeHandler->GetLoadedFiles()) {
+      CComPtr<IDxcBlobUtf8> pUtf8File;
+      IFT(hlsl::DxcGetBlobAsUtf8(pFile, m_pMalloc, &pUtf8File));
+      if (ReferencesAnyName(StringRef(pUtf8File->GetStringPointer(),
+                                      pUtf8File->GetStringLength()),
+                            variantDefines))
+        return false;
+    }
+
+    pPCHIncludeHandler->SetPCH(pPCH);
+    variantSource.assign(std::count(prefix.begin(), prefix.end(), '\n'),
+                         '\n');
+    variantSource.append(source.substr(prefixLength));
+    *ppPCHIncludeHandler = pPCHIncludeHandler.Detach();
+    return true;
+  }
+
+public:
+  // Compile one source once per argument set on a pool of threads.
+  HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_ const DxcBuffer *pSource,                      // Source text to compile
+    _In_opt_count_(sharedArgCount) LPCWSTR *pSharedArguments, // Arguments common to every variant, placed first
+    _In_ UINT32 sharedArgCount,                         // Number of shared arguments
+    _In_count_(variantCount) IDxcCompilerArgs **ppVariantArguments, // Arguments specific to each variant
+    _In_ UINT32 variantCount,                           // Number of variants
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,       // user-provided interface to handle #include directives (optional)
+    _In_ UINT32 numThreads,                             // Worker threads; 0 uses one per hardware thread
+    _In_ IDxcCompilerBatchCallback *pCallback           // Receives each variant's IDxcResult
+  ) override {
+    if (pSource == nullptr || pCallback == nullptr ||
+        (sharedArgCount > 0 && pSharedArguments == nullptr) ||
+        (variantCount > 0 && ppVariantArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < variantCount; ++i) {
+      if (ppVariantArguments[i] == nullptr)
+        return E_INVALIDARG;
+    }
+
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // Decode the source once; every variant then references the same
+      // null-terminated UTF-8 text without copying it.
+      CComPtr<IDxcBlobEncoding> pSourceEncoding;
+      CComPtr<IDxcBlobUtf8> pUtf8Source;
+      IFT(hlsl::DxcCreateBlob(pSource->Ptr, pSource->Size,
+        true, false, pSource->Encoding != 0, pSource->Encoding,
+        nullptr, &pSourceEncoding));
+      IFT(hlsl::DxcGetBlobAsUtf8(pSourceEncoding, m_pMalloc, &pUtf8Source));
+      DxcBuffer utf8Buffer;
+      utf8Buffer.Ptr = pUtf8Source->GetStringPointer();
+      utf8Buffer.Size = pUtf8Source->GetStringLength() + 1;
+      utf8Buffer.Encoding = CP_UTF8;
+
+      // Share loaded and decoded includes across all variants.
+      CComPtr<IDxcIncludeHandler> pBatchIncludeHandler;
+      CComPtr<IDxcIncludeCache> pIncludeCache;
+      if (pIncludeHandler != nullptr &&
+          FAILED(pIncludeHandler->QueryInterface(&pIncludeCache))) {
+        IFT(CreateDxcIncludeCache(__uuidof(IDxcIncludeCache), (void **)&pIncludeCache));
+        IFT(pIncludeCache->SetIncludeHandler(pIncludeHandler));
+      }
+      pBatchIncludeHandler = pIncludeCache;
+
+      // Variants that differ only in defines not used by the leading
+      // includes of the source load those includes from a shared
+      // precompiled header instead of parsing them again.
+      CComPtr<DxcBatchIncludeHandler> pPCHIncludeHandler;
+      std::string variantSource;
+      if (pBatchIncludeHandler != nullptr &&
+          PrepareBatchPCH(StringRef(pUtf8Source->GetStringPointer(),
+                                    pUtf8Source->GetStringLength()),
+                          pSharedArguments, sharedArgCount,
+                          ppVariantArguments, variantCount,
+                          pBatchIncludeHandler, &pPCHIncludeHandler,
+                          variantSource)) {
+        pBatchIncludeHandler = pPCHIncludeHandler;
+        utf8Buffer.Ptr = variantSource.c_str();
+        utf8Buffer.Size = variantSource.size() + 1;
+      }
+
+      if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+      numThreads = std::min(numThreads, variantCount);
+
+      std::atomic<UINT32> nextVariant(0);
+      std::atomic<HRESULT> batchHR(S_OK);
+      auto compileVariants = [&]() {
+        DxcThreadMalloc TM(m_pMalloc);
+        std::vector<LPCWSTR> args;
+        for (UINT32 i = nextVariant++; i < variantCount && SUCCEEDED(batchHR);
+             i = nextVariant++) {
+          IDxcCompilerArgs *pVariantArgs = ppVariantArguments[i];
+          HRESULT hr = S_OK;
+          try {
+            args.assign(pSharedArguments, pSharedArguments + sharedArgCount);
+            args.insert(args.end(), pVariantArgs->GetArguments(),
+                        pVariantArgs->GetArguments() + pVariantArgs->GetCount());
+            if (pPCHIncludeHandler != nullptr) {
+              args.push_back(L"-include-pch");
+              args.push_back(BatchPCHNameW);
+            }
+            CComPtr<IDxcResult> pResult;
+            hr = Compile(&utf8Buffer, args.data(), (UINT32)args.size(),
+                         pBatchIncludeHandler, IID_PPV_ARGS(&pResult));
+            if (SUCCEEDED(hr))
+              hr = pCallback->OnResult(i, pResult);
+          } catch (std::bad_alloc &) {
+            hr = E_OUTOFMEMORY;
+          }
+          if (FAILED(hr)) {
+            HRESULT expected = S_OK;
+            batchHR.compare_exchange_strong(expected, hr);
+          }
+        }
+      };
+
+      if (numThreads <= 1) {
+        compileVariants();
+      } else {
+        std::vector<std::thread> workers;
+        workers.reserve(numThreads - 1);
+        try {
+          for (UINT32 i = 1; i < numThreads; ++i)
+            workers.emplace_back(compileVariants);
+        } catch (std::system_error &) {
+          // Continue with the threads that did start.
+        }
+        compileVariants();
+        for (std::thread &worker : workers)
+          worker.join();
+      }
+      return batchHR;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
   // Disassemble a program.
   virtual HRESULT STDMETHODCALLTYPE Disassemble(
     _In_ const DxcBuffer *pObject,                // Program to disassemble: dxil container or bitcode.
@@ -1305,6 +1782,7 @@ public:
     }
 
     PPOpts.IgnoreLineDirectives = Opts.IgnoreLineDirectives;
+    PPOpts.ImplicitPCHInclude = Opts.IncludePCH;
     // fxc compatibility: pre-expand operands before performing token-pasting
     PPOpts.ExpandTokPastingArg = Opts.LegacyMacroExpansion;
 
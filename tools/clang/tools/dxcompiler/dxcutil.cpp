@@ -24,6 +24,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "dxc/Support/dxcapi.impl.h"
@@ -106,6 +107,7 @@ void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor) {
 }
 
 void AssembleToContainer(AssembleInputs &inputs) {
+  llvm::TimeTraceScope AssembleScope("AssembleContainer");
   CComPtr<AbstractMemoryStream> pContainerStream;
   IFT(CreateMemoryStream(inputs.pMalloc, &pContainerStream));
   SerializeDxilContainerForModule(&inputs.pM->GetOrCreateDxilModule(),
@@ -170,11 +172,16 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
     // IDxcValidator2, we'll use the modules directly. In this case, we'll want
     // to make a clone to avoid SerializeDxilContainerForModule stripping all
     // the debug info. The debug info will be stripped from the orginal module,
-    // but preserved in the cloned module.
-    if (llvm::getDebugMetadataVersionFromModule(*inputs.pM) != 0) {
+    // but preserved in the cloned module. Callers that already keep such a
+    // snapshot pass it in pDebugModule, and it is borrowed instead.
+    if (!inputs.pDebugModule &&
+        llvm::getDebugMetadataVersionFromModule(*inputs.pM) != 0) {
       llvmModuleWithDebugInfo.reset(llvm::CloneModule(inputs.pM.get()));
     }
   }
+  llvm::Module *pDebugModule = inputs.pDebugModule
+                                   ? inputs.pDebugModule
+                                   : llvmModuleWithDebugInfo.get();
 
   // Verify validator version can validate this module
   CComPtr<IDxcVersionInfo> pValidatorVersion;
@@ -198,34 +205,39 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
 
   AssembleToContainer(inputs);
 
+  llvm::TimeTraceScope ValidationScope("Validation");
   CComPtr<IDxcOperationResult> pValResult;
   // Important: in-place edit is required so the blob is reused and thus
   // dxil.dll can be released.
   if (bInternalValidator) {
     IFT(RunInternalValidator(pValidator, inputs.pM.get(),
-                             llvmModuleWithDebugInfo.get(), inputs.pOutputContainerBlob,
+                             pDebugModule, inputs.pOutputContainerBlob,
                              DxcValidatorFlags_InPlaceEdit, &pValResult));
   } else {
-    if (pValidator2 && llvmModuleWithDebugInfo) {
-
-      // If metadata was stripped, re-serialize the input module.
+    // The debug module only improves the messages for a module that fails
+    // validation, and an external validator has to load it from bitcode
+    // before it can validate anything. Validate without it first, and only
+    // serialize it to re-validate with line information on failure. A
+    // failing compile with debug info is therefore validated twice; that
+    // only costs time when there is an error to report anyway.
+    IFT(pValidator->Validate(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
+                             &pValResult));
+    IFT(pValResult->GetStatus(&valHR));
+    if (FAILED(valHR) && pValidator2 && pDebugModule) {
       CComPtr<AbstractMemoryStream> pDebugModuleStream;
       IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pDebugModuleStream));
       raw_stream_ostream outStream(pDebugModuleStream.p);
-      WriteBitcodeToFile(llvmModuleWithDebugInfo.get(), outStream, true);
+      WriteBitcodeToFile(pDebugModule, outStream, true);
       outStream.flush();
 
       DxcBuffer debugModule = {};
       debugModule.Ptr = pDebugModuleStream->GetPtr();
       debugModule.Size = pDebugModuleStream->GetPtrSize();
 
+      pValResult.Release();
       IFT(pValidator2->ValidateWithDebug(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
                                          &debugModule, &pValResult));
     }
-    else {
-      IFT(pValidator->Validate(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
-                               &pValResult));
-    }
   }
   IFT(pValResult->GetStatus(&valHR));
   if (inputs.pDiag) {
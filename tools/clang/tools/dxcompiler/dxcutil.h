@@ -60,6 +60,9 @@ struct AssembleInputs {
   hlsl::DxilShaderHash *pShaderHashOut = nullptr;
   hlsl::AbstractMemoryStream *pReflectionOut = nullptr;
   hlsl::AbstractMemoryStream *pRootSigOut = nullptr;
+  // Optional snapshot of pM taken before debug info is stripped. When set,
+  // validation reads debug locations from it instead of cloning pM again.
+  llvm::Module *pDebugModule = nullptr;
 };
 HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs);
 HRESULT ValidateRootSignatureInContainer(
@@ -25,6 +25,7 @@
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
+#include <thread>
 
 #ifdef _WIN32
 #include "dxcetw.h"
@@ -69,6 +70,7 @@ private:
     _In_ UINT32 Flags,                            // Validation flags.
     _In_opt_ llvm::Module *pModule,               // Module to validate, if available.
     _In_opt_ llvm::Module *pDebugModule,          // Debug module to validate, if available
+    _In_opt_ DxcBuffer *pOptDebugBitcode,         // Debug module bitcode, if no module is available
     _In_ AbstractMemoryStream *pDiagStream);
 
   HRESULT RunRootSignatureValidation(
@@ -89,6 +91,7 @@ public:
     _In_ UINT32 Flags,                            // Validation flags.
     _In_opt_ llvm::Module *pModule,               // Module to validate, if available.
     _In_opt_ llvm::Module *pDebugModule,          // Debug module to validate, if available
+    _In_opt_ DxcBuffer *pOptDebugBitcode,         // Debug module bitcode, if no module is available
     _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
   );
 
@@ -131,7 +134,7 @@ HRESULT STDMETHODCALLTYPE DxcValidator::Validate(
     return E_INVALIDARG;
   if ((Flags & DxcValidatorFlags_ModuleOnly) && (Flags & (DxcValidatorFlags_InPlaceEdit | DxcValidatorFlags_RootSignatureOnly)))
     return E_INVALIDARG;
-  return ValidateWithOptModules(pShader, Flags, nullptr, nullptr, ppResult);
+  return ValidateWithOptModules(pShader, Flags, nullptr, nullptr, nullptr, ppResult);
 }
 
 HRESULT STDMETHODCALLTYPE DxcValidator::ValidateWithDebug(
@@ -152,27 +155,11 @@ HRESULT STDMETHODCALLTYPE DxcValidator::ValidateWithDebug(
                            pOptDebugBitcode->Size >= UINT32_MAX))
     return E_INVALIDARG;
 
-  HRESULT hr = S_OK;
+  // The debug bitcode is only parsed if the container has no debug part of
+  // its own, when the container is validated.
   DxcThreadMalloc TM(m_pMalloc);
-  try {
-    LLVMContext Ctx;
-    CComPtr<AbstractMemoryStream> pDiagStream;
-    IFT(CreateMemoryStream(m_pMalloc, &pDiagStream));
-    raw_stream_ostream DiagStream(pDiagStream);
-    llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
-    PrintDiagnosticContext DiagContext(DiagPrinter);
-    Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
-                             &DiagContext, true);
-    std::unique_ptr<llvm::Module> pDebugModule;
-    if (pOptDebugBitcode) {
-      IFT(ValidateLoadModule((const char *)pOptDebugBitcode->Ptr,
-                             (uint32_t)pOptDebugBitcode->Size, pDebugModule,
-                             Ctx, DiagStream, /*bLazyLoad*/ false));
-    }
-    return ValidateWithOptModules(pShader, Flags, nullptr, pDebugModule.get(), ppResult);
-  }
-  CATCH_CPP_ASSIGN_HRESULT();
-  return hr;
+  return ValidateWithOptModules(pShader, Flags, nullptr, nullptr,
+                                pOptDebugBitcode, ppResult);
 }
 
 HRESULT DxcValidator::ValidateWithOptModules(
@@ -180,6 +167,7 @@ HRESULT DxcValidator::ValidateWithOptModules(
   _In_ UINT32 Flags,                            // Validation flags.
   _In_opt_ llvm::Module *pModule,               // Module to validate, if available.
   _In_opt_ llvm::Module *pDebugModule,          // Debug module to validate, if available
+  _In_opt_ DxcBuffer *pOptDebugBitcode,         // Debug module bitcode, if no module is available
   _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
 ) {
   *ppResult = nullptr;
@@ -196,7 +184,8 @@ HRESULT DxcValidator::ValidateWithOptModules(
     if (Flags & DxcValidatorFlags_RootSignatureOnly) {
       validationStatus = RunRootSignatureValidation(pShader, pDiagStream);
     } else {
-      validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream);
+      validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule,
+                                       pOptDebugBitcode, pDiagStream);
     }
     if (FAILED(validationStatus)) {
       std::string msg("Validation failed.\n");
@@ -259,6 +248,7 @@ HRESULT DxcValidator::RunValidation(
   _In_ UINT32 Flags,                            // Validation flags.
   _In_opt_ llvm::Module *pModule,               // Module to validate, if available.
   _In_opt_ llvm::Module *pDebugModule,          // Debug module to validate, if available
+  _In_opt_ DxcBuffer *pOptDebugBitcode,         // Debug module bitcode, if no module is available
   _In_ AbstractMemoryStream *pDiagStream) {
 
   // Run validation may throw, but that indicates an inability to validate,
@@ -267,6 +257,10 @@ HRESULT DxcValidator::RunValidation(
 
   raw_stream_ostream DiagStream(pDiagStream);
 
+  unsigned NumThreads = 0;
+  if (Flags & DxcValidatorFlags_ParallelFunctions)
+    NumThreads = std::thread::hardware_concurrency();
+
   if (Flags & DxcValidatorFlags_ModuleOnly) {
     IFRBOOL(!IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()), E_INVALIDARG);
   } else {
@@ -276,9 +270,13 @@ HRESULT DxcValidator::RunValidation(
   if (!pModule) {
     DXASSERT_NOMSG(pDebugModule == nullptr);
     if (Flags & DxcValidatorFlags_ModuleOnly) {
-      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream, NumThreads);
+    } else if (pOptDebugBitcode) {
+      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(),
+                                   pOptDebugBitcode->Ptr, (uint32_t)pOptDebugBitcode->Size,
+                                   DiagStream, NumThreads);
     } else {
-      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream, NumThreads);
     }
   }
 
@@ -286,7 +284,7 @@ HRESULT DxcValidator::RunValidation(
   PrintDiagnosticContext DiagContext(DiagPrinter);
   DiagRestore DR(pModule->getContext(), &DiagContext);
 
-  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule));
+  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule, NumThreads));
   if (!(Flags & DxcValidatorFlags_ModuleOnly)) {
     IFR(ValidateDxilContainerParts(pModule, pDebugModule,
                       IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()),
@@ -355,7 +353,8 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
 
   DxcValidator *pInternalValidator = (DxcValidator *)pValidator;
   return pInternalValidator->ValidateWithOptModules(pShader, Flags, pModule,
-                                                    pDebugModule, ppResult);
+                                                    pDebugModule, nullptr,
+                                                    ppResult);
 }
 
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID* ppv) {
@@ -39,6 +39,9 @@ static cl::opt<std::string> OutputFilename("o",
                                            cl::desc("Override output filename for signed container"),
                                            cl::value_desc("filename"));
 
+static cl::opt<bool> ParallelFunctions("parallel-functions",
+                                       cl::desc("Validate library functions on multiple threads"));
+
 class DxvContext {
 private:
   DxcDllSupport &m_dxcSupport;
@@ -92,7 +95,10 @@ void DxvContext::Validate() {
     CComPtr<IDxcOperationResult> pResult;
 
     IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
-    IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+    UINT32 Flags = DxcValidatorFlags_InPlaceEdit;
+    if (ParallelFunctions)
+      Flags |= DxcValidatorFlags_ParallelFunctions;
+    IFT(pValidator->Validate(pContainerBlob, Flags, &pResult));
 
     HRESULT status;
     IFT(pResult->GetStatus(&status));
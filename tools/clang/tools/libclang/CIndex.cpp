@@ -3343,6 +3343,7 @@ struct ReparseTranslationUnitInfo {
   ArrayRef<CXUnsavedFile> unsaved_files;
   unsigned options;
   CXErrorCode &result;
+  ::llvm::sys::fs::MSFileSystemRef fsr; // HLSL Change
 };
 
 static void clang_reparseTranslationUnit_Impl(void *UserData) {
@@ -3352,6 +3353,13 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
   unsigned options = RTUI->options;
   (void) options;
 
+  // HLSL Change Starts
+  if (RTUI->fsr) {
+    // Reparsing runs on its own thread; see clang_parseTranslationUnit_Impl.
+    ::llvm::sys::fs::SetCurrentThreadFileSystem(RTUI->fsr);
+  }
+  // HLSL Change Ends
+
   // Check arguments.
   if (isNotUsableTU(TU)) {
     LOG_BAD_TU(TU);
@@ -3404,7 +3412,7 @@ int clang_reparseTranslationUnit(CXTranslationUnit TU,
   CXErrorCode result = CXError_Failure;
   ReparseTranslationUnitInfo RTUI = {
       TU, llvm::makeArrayRef(unsaved_files, num_unsaved_files), options,
-      result};
+      result, nullptr};
 
   if (getenv("LIBCLANG_NOTHREADS")) {
     clang_reparseTranslationUnit_Impl(&RTUI);
@@ -3413,6 +3421,7 @@ int clang_reparseTranslationUnit(CXTranslationUnit TU,
 
   llvm::CrashRecoveryContext CRC;
 
+  RTUI.fsr = ::llvm::sys::fs::GetCurrentThreadFileSystem(); // HLSL Change
   if (!RunSafely(CRC, clang_reparseTranslationUnit_Impl, &RTUI)) {
     fprintf(stderr, "libclang: crash detected during reparsing\n");
     cxtu::getASTUnit(TU)->setUnsafeToFree(true);
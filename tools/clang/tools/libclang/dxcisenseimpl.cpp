@@ -1623,6 +1623,16 @@ HRESULT DxcTranslationUnit::Reparse(
   DxcThreadMalloc TM(m_pMalloc);
   hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
   if (FAILED(hr)) return hr;
+  // Reparsing checks the included files again, so it needs the same file
+  // access as the initial parse.
+  ::llvm::sys::fs::MSFileSystem* msfPtr;
+  hr = CreateMSFileSystemForDisk(&msfPtr);
+  if (FAILED(hr)) {
+    CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
+    return hr;
+  }
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
   int reparseResult = clang_reparseTranslationUnit(
     m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
   CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
@@ -1813,6 +1823,15 @@ HRESULT DxcTranslationUnit::CodeCompleteAt(
   if (FAILED(hr))
     return hr;
 
+  ::llvm::sys::fs::MSFileSystem* msfPtr;
+  hr = CreateMSFileSystemForDisk(&msfPtr);
+  if (FAILED(hr)) {
+    CleanupUnsavedFiles(files, numUnsavedFiles);
+    return hr;
+  }
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+
   CXCodeCompleteResults *results = clang_codeCompleteAt(
       m_tu, fileName, line, column, files, numUnsavedFiles, options);
 
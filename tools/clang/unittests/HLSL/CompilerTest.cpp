@@ -17,6 +17,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <mutex>
 #include <set>
 #include <cassert>
 #include <sstream>
@@ -106,6 +107,27 @@ public:
   }
 };
 
+class TestBatchCallback : public IDxcCompilerBatchCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::mutex m_lock;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestBatchCallback(UINT32 variantCount) : m_dwRef(0), Results(variantCount) { }
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompilerBatchCallback>(this, iid, ppvObject);
+  }
+
+  std::vector<CComPtr<IDxcResult>> Results;
+
+  HRESULT STDMETHODCALLTYPE OnResult(UINT32 uIndex, IDxcResult *pResult) override {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (uIndex >= Results.size() || Results[uIndex] != nullptr)
+      return E_UNEXPECTED;
+    Results[uIndex] = pResult;
+    return S_OK;
+  }
+};
+
 #ifdef _WIN32
 class CompilerTest {
 #else
@@ -153,6 +175,12 @@ public:
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
   TEST_METHOD(CompileWhenIncludeHasPathThenOK)
   TEST_METHOD(CompileWhenIncludeEmptyThenOK)
+  TEST_METHOD(CompileWhenIncludeCacheThenLoadOnce)
+  TEST_METHOD(CompileBatchWhenVariantsThenResultPerVariant)
+  TEST_METHOD(CompileWhenCacheDirThenReuseUntilIncludeChanges)
+  TEST_METHOD(CompileWhenTimeReportThenHasTimingOutputs)
+  TEST_METHOD(CompileWhenCompileArenaThenSameObject)
+  TEST_METHOD(CompileWhenIncludePCHThenSameObject)
 
   TEST_METHOD(CompileWhenODumpThenPassConfig)
   TEST_METHOD(CompileWhenODumpThenOptimizerMatch)
@@ -2340,6 +2368,337 @@ TEST_F(CompilerTest, CompileWhenIncludeThenLoadUsed) {
   VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
 }
 
+TEST_F(CompilerTest, CompileWhenIncludeCacheThenLoadOnce) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+  CComPtr<IDxcIncludeCache> pCache;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "#include \"missing.h\"\r\n"
+    "float4 main() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcIncludeCache, &pCache));
+  VERIFY_SUCCEEDED(pCache->SetIncludeHandler(pInclude));
+
+  // Both compiles fail on missing.h, but neither file is requested twice.
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", nullptr, 0, nullptr, 0, pCache, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_FAILED(status);
+  }
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;./missing.h;", pInclude->GetAllFileNames().c_str());
+
+  VERIFY_SUCCEEDED(pCache->Clear());
+  CComPtr<IDxcBlob> pBlob;
+  VERIFY_FAILED(pCache->LoadSource(L"./missing.h", &pBlob));
+  VERIFY_IS_NULL(pBlob.p);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;./missing.h;./missing.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileBatchWhenVariantsThenResultPerVariant) {
+  const UINT32 VariantCount = 8;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcUtils> pUtils;
+  CComPtr<TestIncludeHandler> pInclude;
+  CComPtr<TestBatchCallback> pCallback;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pBatch));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcUtils, &pUtils));
+
+  std::string source =
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE + ZERO; }";
+  DxcBuffer sourceBuf = { source.c_str(), source.size(), CP_UTF8 };
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+
+  // Variant 3 leaves VALUE undefined and must fail on its own.
+  std::vector<CComPtr<IDxcCompilerArgs>> variantArgs(VariantCount);
+  std::vector<IDxcCompilerArgs *> ppVariantArgs;
+  for (UINT32 i = 0; i < VariantCount; ++i) {
+    std::wstring value = std::to_wstring(i);
+    DxcDefine define = { L"VALUE", value.c_str() };
+    VERIFY_SUCCEEDED(pUtils->BuildArguments(L"source.hlsl", L"main", L"ps_6_0",
+      nullptr, 0, &define, i == 3 ? 0 : 1, &variantArgs[i]));
+    ppVariantArgs.push_back(variantArgs[i]);
+  }
+  LPCWSTR sharedArgs[] = { L"-O3" };
+
+  pCallback = new TestBatchCallback(VariantCount);
+  VERIFY_SUCCEEDED(pBatch->CompileBatch(&sourceBuf, sharedArgs, _countof(sharedArgs),
+    ppVariantArgs.data(), VariantCount, pInclude, 4, pCallback));
+
+  for (UINT32 i = 0; i < VariantCount; ++i) {
+    VERIFY_IS_NOT_NULL(pCallback->Results[i].p);
+    HRESULT status;
+    VERIFY_SUCCEEDED(pCallback->Results[i]->GetStatus(&status));
+    if (i == 3) {
+      VERIFY_FAILED(status);
+    } else {
+      VERIFY_SUCCEEDED(status);
+    }
+  }
+  // Includes are loaded once for the whole batch.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+// Calls fn with the path of every file one level below the cache directory,
+// where the entries are stored.
+template <typename TFn>
+static void ForEachCacheFile(const std::wstring &cacheDir, TFn fn) {
+  WIN32_FIND_DATAW shardData;
+  HANDLE hShards = FindFirstFileW((cacheDir + L"\\*").c_str(), &shardData);
+  if (hShards == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    if (!(shardData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        wcscmp(shardData.cFileName, L".") == 0 ||
+        wcscmp(shardData.cFileName, L"..") == 0)
+      continue;
+    std::wstring shardDir = cacheDir + L"\\" + shardData.cFileName;
+    WIN32_FIND_DATAW fileData;
+    HANDLE hFiles = FindFirstFileW((shardDir + L"\\*").c_str(), &fileData);
+    if (hFiles == INVALID_HANDLE_VALUE)
+      continue;
+    do {
+      if (!(fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        fn(shardDir + L"\\" + fileData.cFileName);
+    } while (FindNextFileW(hFiles, &fileData));
+    FindClose(hFiles);
+  } while (FindNextFileW(hShards, &shardData));
+  FindClose(hShards);
+}
+
+static void RemoveCacheDirectory(const std::wstring &cacheDir) {
+  ForEachCacheFile(cacheDir, [](const std::wstring &path) {
+    DeleteFileW(path.c_str());
+  });
+  WIN32_FIND_DATAW shardData;
+  HANDLE hShards = FindFirstFileW((cacheDir + L"\\*").c_str(), &shardData);
+  if (hShards != INVALID_HANDLE_VALUE) {
+    do {
+      if (shardData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        RemoveDirectoryW((cacheDir + L"\\" + shardData.cFileName).c_str());
+    } while (FindNextFileW(hShards, &shardData));
+    FindClose(hShards);
+  }
+  RemoveDirectoryW(cacheDir.c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenCacheDirThenReuseUntilIncludeChanges) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  CComPtr<TestIncludeHandler> pInclude;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source =
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }";
+  DxcBuffer sourceBuf = { source.c_str(), source.size(), CP_UTF8 };
+
+  // Start from an empty directory so entries from earlier runs cannot hit.
+  wchar_t tempPath[MAX_PATH];
+  VERIFY_ARE_NOT_EQUAL(0u, GetTempPathW(MAX_PATH, tempPath));
+  std::wstring cacheDir = std::wstring(tempPath) + L"dxc-cache-" +
+                          std::to_wstring(GetTickCount64());
+  LPCWSTR args[] = { L"-E", L"main", L"-T", L"ps_6_0",
+                     L"-cache-dir", cacheDir.c_str() };
+
+  // The second compile is served from the cache and only reloads helper.h to
+  // check it; the third sees a different helper.h and compiles again.
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define VALUE 1");
+  pInclude->CallResults.emplace_back("#define VALUE 1");
+  pInclude->CallResults.emplace_back("#define VALUE 2");
+  pInclude->CallResults.emplace_back("#define VALUE 2");
+
+  CComPtr<IDxcBlob> pObjects[3];
+  for (unsigned i = 0; i < 3; ++i) {
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(&sourceBuf, args, _countof(args),
+      pInclude, IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObjects[i]), nullptr));
+    VERIFY_IS_TRUE(pResult->HasOutput(DXC_OUT_SHADER_HASH));
+  }
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;./helper.h;./helper.h;./helper.h;",
+                        pInclude->GetAllFileNames().c_str());
+
+  VERIFY_ARE_EQUAL(pObjects[0]->GetBufferSize(), pObjects[1]->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(pObjects[0]->GetBufferPointer(),
+                             pObjects[1]->GetBufferPointer(),
+                             pObjects[0]->GetBufferSize()));
+  VERIFY_IS_FALSE(pObjects[0]->GetBufferSize() == pObjects[2]->GetBufferSize() &&
+                  0 == memcmp(pObjects[0]->GetBufferPointer(),
+                              pObjects[2]->GetBufferPointer(),
+                              pObjects[0]->GetBufferSize()));
+
+  // The size limit applies to the whole directory, and the entry just stored
+  // is kept even when it alone is over the limit.
+  std::string otherSource = "float4 main() : SV_Target { return 3; }";
+  DxcBuffer otherSourceBuf = { otherSource.c_str(), otherSource.size(), CP_UTF8 };
+  LPCWSTR limitArgs[] = { L"-E", L"main", L"-T", L"ps_6_0",
+                          L"-cache-dir", cacheDir.c_str(),
+                          L"-cache-size-limit", L"0" };
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&otherSourceBuf, limitArgs,
+    _countof(limitArgs), nullptr, IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  unsigned fileCount = 0;
+  ForEachCacheFile(cacheDir, [&fileCount](const std::wstring &) { ++fileCount; });
+  VERIFY_ARE_EQUAL(1u, fileCount);
+
+  RemoveCacheDirectory(cacheDir);
+}
+
+TEST_F(CompilerTest, CompileWhenTimeReportThenHasTimingOutputs) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source = "float4 main() : SV_Target { return 0; }";
+  DxcBuffer sourceBuf = { source.c_str(), source.size(), CP_UTF8 };
+  LPCWSTR args[] = { L"-E", L"main", L"-T", L"ps_6_0",
+                     L"-ftime-report", L"-ftime-trace" };
+
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&sourceBuf, args, _countof(args),
+    nullptr, IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+
+  CComPtr<IDxcBlobUtf8> pReport;
+  CComPtr<IDxcBlobUtf8> pTrace;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_TIME_REPORT, IID_PPV_ARGS(&pReport), nullptr));
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_TIME_TRACE, IID_PPV_ARGS(&pTrace), nullptr));
+  std::string report(pReport->GetStringPointer(), pReport->GetStringLength());
+  std::string trace(pTrace->GetStringPointer(), pTrace->GetStringLength());
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, report.find("Frontend"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, report.find("RunPass: "));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, trace.find("\"traceEvents\""));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, trace.find("\"Validation\""));
+
+  // Without the options, no timing outputs are produced.
+  pResult.Release();
+  VERIFY_SUCCEEDED(pCompiler->Compile(&sourceBuf, args, _countof(args) - 2,
+    nullptr, IID_PPV_ARGS(&pResult)));
+  VERIFY_IS_FALSE(pResult->HasOutput(DXC_OUT_TIME_REPORT));
+  VERIFY_IS_FALSE(pResult->HasOutput(DXC_OUT_TIME_TRACE));
+}
+
+TEST_F(CompilerTest, CompileWhenCompileArenaThenSameObject) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source = "float4 main(float4 a : A) : SV_Target { return a * 2; }";
+  DxcBuffer sourceBuf = { source.c_str(), source.size(), CP_UTF8 };
+  LPCWSTR args[] = { L"-E", L"main", L"-T", L"ps_6_0",
+                     L"-ftime-report", L"-fcompile-arena" };
+
+  // The arena results are kept alive past the compiles that produced them.
+  CComPtr<IDxcResult> pResults[3];
+  CComPtr<IDxcBlob> pObjects[3];
+  for (unsigned i = 0; i < _countof(pResults); ++i) {
+    UINT32 argCount = i == 0 ? _countof(args) - 1 : _countof(args);
+    VERIFY_SUCCEEDED(pCompiler->Compile(&sourceBuf, args, argCount,
+      nullptr, IID_PPV_ARGS(&pResults[i])));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResults[i]->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    VERIFY_SUCCEEDED(pResults[i]->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObjects[i]), nullptr));
+  }
+  for (unsigned i = 1; i < _countof(pObjects); ++i) {
+    VERIFY_ARE_EQUAL(pObjects[0]->GetBufferSize(), pObjects[i]->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pObjects[0]->GetBufferPointer(),
+                               pObjects[i]->GetBufferPointer(),
+                               pObjects[0]->GetBufferSize()));
+  }
+
+  // The arena is not installed when dxcompiler is loaded at run time, but
+  // the report still says so.
+  CComPtr<IDxcBlobUtf8> pReport;
+  VERIFY_SUCCEEDED(pResults[2]->GetOutput(DXC_OUT_TIME_REPORT, IID_PPV_ARGS(&pReport), nullptr));
+  std::string report(pReport->GetStringPointer(), pReport->GetStringLength());
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, report.find("Compile arena: "));
+}
+
+TEST_F(CompilerTest, CompileWhenIncludePCHThenSameObject) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  const char header[] =
+    "Texture2D<float4> tex : register(t0);\r\n"
+    "SamplerState samp : register(s0);\r\n"
+    "cbuffer Globals : register(b0) { float4 tint; float2 scale; }\r\n"
+    "struct Light { float3 dir; float3 Apply(float3 n) { return saturate(dot(n, -dir)); } };\r\n"
+    "float4 Shade(float2 uv) { return tex.Sample(samp, uv * scale) * tint; }\r\n"
+    // Swizzles and matrix element accesses carry their decoded positions.
+    "float3 Swizzle(float4 v) { return v.wzy + v.x; }\r\n"
+    "float MatrixElements(float3x3 m) { return m._12 + m._m20 + m._11_22.y; }\r\n";
+  std::string includeSource = "#include \"helper.h\"\r\n";
+  std::string body =
+    "float4 main(float2 uv : UV, float3 n : N, float3x3 m : M) : SV_Target {\r\n"
+    "  Light l = (Light)0;\r\n"
+    "  return Shade(uv) * l.Apply(n).x * float4(Swizzle(tint), MatrixElements(m)); }";
+
+  // Build the precompiled header from helper.h.
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(header);
+  DxcBuffer headerBuf = { includeSource.c_str(), includeSource.size(), CP_UTF8 };
+  LPCWSTR pchArgs[] = { L"-T", L"ps_6_0", L"-emit-pch" };
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&headerBuf, pchArgs, _countof(pchArgs),
+    pInclude, IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  CComPtr<IDxcBlob> pPCH;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pPCH), nullptr));
+  VERIFY_IS_TRUE(pPCH->GetBufferSize() > 4);
+
+  // Compiling the body against it matches compiling header and body together.
+  CComPtr<IDxcBlob> pObjects[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    std::string source = i == 0 ? includeSource + body : body;
+    DxcBuffer sourceBuf = { source.c_str(), source.size(), CP_UTF8 };
+    std::vector<LPCWSTR> args = { L"-E", L"main", L"-T", L"ps_6_0",
+                                  L"-Qstrip_reflect" };
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    if (i == 0) {
+      pInclude->CallResults.emplace_back(header);
+    } else {
+      args.push_back(L"-include-pch");
+      args.push_back(L"helper.pch");
+      pInclude->CallResults.emplace_back();
+      pInclude->CallResults.back().hr = S_OK;
+      pInclude->CallResults.back().source.assign(
+          (const char *)pPCH->GetBufferPointer(), pPCH->GetBufferSize());
+    }
+    pResult.Release();
+    VERIFY_SUCCEEDED(pCompiler->Compile(&sourceBuf, args.data(), args.size(),
+      pInclude, IID_PPV_ARGS(&pResult)));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObjects[i]), nullptr));
+  }
+
+  VERIFY_ARE_EQUAL(pObjects[0]->GetBufferSize(), pObjects[1]->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(pObjects[0]->GetBufferPointer(),
+                             pObjects[1]->GetBufferPointer(),
+                             pObjects[0]->GetBufferSize()));
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeAbsoluteThenLoadAbsolute) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -109,6 +109,8 @@ protected:
   TEST_METHOD(InclusionWhenMissingThenError)
   TEST_METHOD(InclusionWhenValidThenAvailable)
 
+  TEST_METHOD(ReparseWhenPreambleThenHeaderChangesSeen)
+
   TEST_METHOD(TUWhenGetFileMissingThenFail)
   TEST_METHOD(TUWhenGetFilePresentThenOK)
   TEST_METHOD(TUWhenEmptyStructThenErrorIfISense)
@@ -124,6 +126,7 @@ protected:
   TEST_METHOD(TypeWhenICEThenEval)
 
   TEST_METHOD(CompletionWhenResultsAvailable)
+  TEST_METHOD(CompletionWhenBuiltinObjectUnusedThenAvailable)
 };
 
 bool DXIntellisenseTest::DXIntellisenseTestClassSetup() {
@@ -270,6 +273,40 @@ TEST_F(DXIntellisenseTest, InclusionWhenValidThenAvailable) {
   }
 }
 
+TEST_F(DXIntellisenseTest, ReparseWhenPreambleThenHeaderChangesSeen) {
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcUnsavedFile> unsaved[2];
+  CComPtr<IDxcTranslationUnit> TU;
+  const char main_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return FOO; }";
+  const char edited_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return FOO + 1; }";
+  const char unsaved_text[] = "#define FOO 1";
+  const char changed_text[] = "#define BAR 1";
+  unsigned diagCount;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", unsaved_text, strlen(unsaved_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_text, strlen(main_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+    (DxcTranslationUnitFlags)(DxcTranslationUnitFlags_PrecompiledPreamble | DxcTranslationUnitFlags_UseCallerThread), &TU));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0U, diagCount);
+
+  // The first reparse precompiles the preamble, the second one uses it.
+  unsaved[1].Release();
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", edited_text, strlen(edited_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0U, diagCount);
+
+  // A change to the included file invalidates the preamble.
+  unsaved[0].Release();
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", changed_text, strlen(changed_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(1U, diagCount);
+}
 
 TEST_F(DXIntellisenseTest, TUWhenGetFileMissingThenFail) {
   const char program[] = "int i;";
@@ -879,3 +916,40 @@ TEST_F(DXIntellisenseTest, CompletionWhenResultsAvailable)
   VERIFY_SUCCEEDED(completionString->GetCompletionChunkText(0, &completionChunkText));
   VERIFY_ARE_EQUAL_STR("MyStruct", completionChunkText);
 }
+
+TEST_F(DXIntellisenseTest, CompletionWhenBuiltinObjectUnusedThenAvailable)
+{
+  // Built-in object types are offered even if the shader doesn't use them.
+  char program[] =
+	"float4 main() : SV_Target { return 0; }\n"
+	"RWStructured";
+  CompilationResult result(CompilationResult::CreateForProgram(program, _countof(program)));
+  VERIFY_IS_FALSE(result.ParseSucceeded());
+  const char* fileName = "filename.hlsl";
+  CComPtr<IDxcUnsavedFile> unsavedFile;
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(fileName, program, &unsavedFile));
+  CComPtr<IDxcCodeCompleteResults> codeCompleteResults;
+  VERIFY_SUCCEEDED(result.TU->CodeCompleteAt(fileName, 2, 1, &unsavedFile.p, 1, DxcCodeCompleteFlags_None, &codeCompleteResults));
+  unsigned numResults;
+  VERIFY_SUCCEEDED(codeCompleteResults->GetNumResults(&numResults));
+  bool found = false;
+  for (unsigned i = 0; i < numResults && !found; i++) {
+    CComPtr<IDxcCompletionResult> completionResult;
+    VERIFY_SUCCEEDED(codeCompleteResults->GetResultAt(i, &completionResult));
+    CComPtr<IDxcCompletionString> completionString;
+    VERIFY_SUCCEEDED(completionResult->GetCompletionString(&completionString));
+    unsigned numCompletionChunks;
+    VERIFY_SUCCEEDED(completionString->GetNumCompletionChunks(&numCompletionChunks));
+    for (unsigned j = 0; j < numCompletionChunks; j++) {
+      DxcCompletionChunkKind completionChunkKind;
+      VERIFY_SUCCEEDED(completionString->GetCompletionChunkKind(j, &completionChunkKind));
+      if (completionChunkKind != DxcCompletionChunk_TypedText)
+        continue;
+      CComHeapPtr<char> completionChunkText;
+      VERIFY_SUCCEEDED(completionString->GetCompletionChunkText(j, &completionChunkText));
+      if (strcmp(completionChunkText, "RWStructuredBuffer") == 0)
+        found = true;
+    }
+  }
+  VERIFY_IS_TRUE(found);
+}
@@ -114,6 +114,9 @@ public:
   BEGIN_TEST_METHOD(ReflectionMatchesDXBC_Full)
     TEST_METHOD_PROPERTY(L"Priority", L"1")
   END_TEST_METHOD()
+  BEGIN_TEST_METHOD(ReflectionPerf_Samples)
+    TEST_METHOD_PROPERTY(L"Priority", L"2")
+  END_TEST_METHOD()
 
   dxc::DxcDllSupport m_dllSupport;
   VersionSupportInfo m_ver;
@@ -1867,6 +1870,40 @@ TEST_F(DxilContainerTest, ReflectionMatchesDXBC_Full) {
     }
   }
 }
+
+TEST_F(DxilContainerTest, ReflectionPerf_Samples) {
+  // Compile the samples once, then time only the creation of reflection
+  // objects from the resulting containers.
+  std::wstring codeGenPath = hlsl_test::GetPathToHlslDataFile(L"..\\CodeGenHLSL\\Samples");
+  std::vector<CComPtr<IDxcBlob>> containers;
+  for (auto &p: recursive_directory_iterator(path(codeGenPath))) {
+    if (!is_regular_file(p) || p.path().extension() != L".hlsl")
+      continue;
+    if (wcsstr(p.path().c_str(), L"_fail_") != nullptr)
+      continue;
+    CComPtr<IDxcBlob> pProgram;
+    if (SUCCEEDED(CompileFromFile(p.path().c_str(), false, 0, &pProgram)))
+      containers.emplace_back(pProgram);
+  }
+  VERIFY_IS_TRUE(containers.size() > 0);
+
+  const unsigned Iterations = 10;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < Iterations; ++i) {
+    for (IDxcBlob *pContainer : containers) {
+      CComPtr<ID3D12ShaderReflection> pReflection;
+      D3D12_SHADER_DESC desc;
+      CreateReflectionFromBlob(pContainer, &pReflection);
+      VERIFY_SUCCEEDED(pReflection->GetDesc(&desc));
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto dur = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  LogCommentFmt(L"Reflected %u containers %u times in %u ms (%u us each)",
+                (unsigned)containers.size(), Iterations,
+                (unsigned)(dur.count() / 1000),
+                (unsigned)(dur.count() / (containers.size() * Iterations)));
+}
 #endif // _WIN32 - Reflection unsupported
 
 TEST_F(DxilContainerTest, ValidateFromLL_Abs2) {
@@ -17,15 +17,24 @@
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerAssembler.h"
 #include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilPDB.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/HLSL/DxilValidation.h"
+#include "dxc/HLSL/ComputeViewIdState.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/MSFileSystem.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace hlsl;
 using namespace llvm;
@@ -71,6 +80,16 @@ public:
 
   TEST_METHOD(PayloadQualifier)
 
+  TEST_METHOD(ValidateParallelFunctionsMatchSerial)
+
+  TEST_METHOD(ViewIdStateWalkMatchesDataflow)
+  TEST_METHOD(ViewIdStateWalkMatchesDataflowOnFileCheckShaders)
+
+  TEST_METHOD(AppendPartToContainerRejectsDuplicatePart)
+  TEST_METHOD(StreamedPdbMatchesBufferedWriter)
+
+  void VerifyViewIdStateWalkMatchesDataflow(const char *source,
+                                            LPCWSTR shaderModel);
   void VerifyValidatorVersionFails(
     LPCWSTR shaderModel, const std::vector<LPCWSTR> &arguments,
     const std::vector<LPCSTR> &expectedErrors);
@@ -620,4 +639,355 @@ TEST_F(DxilModuleTest, PayloadQualifier) {
                            DXIL::PayloadAccessShaderStage::Anyhit));
     }
   }
-}
\ No newline at end of file
+}
+
+TEST_F(DxilModuleTest, ValidateParallelFunctionsMatchSerial) {
+  Compiler c(m_dllSupport);
+  if (c.SkipDxil_Test(1, 3)) return;
+
+  const unsigned NumFunctions = 16;
+  std::string source =
+      "RWByteAddressBuffer Buf : register(u0);\n"
+      "Texture2D<float4> Tex : register(t0);\n"
+      "SamplerState Samp : register(s0);\n";
+  for (unsigned i = 0; i < NumFunctions; ++i) {
+    std::string n = std::to_string(i);
+    source +=
+        "export uint Fn" + n + "(uint a, uint b, float2 uv) {\n"
+        "  uint r = a / b;\n"
+        "  [loop] for (uint j = 0; j < a; ++j) {\n"
+        "    r += Buf.Load(j * 4 + " + n + ");\n"
+        "    r += (uint)Tex.SampleLevel(Samp, uv * j, 0).x;\n"
+        "  }\n"
+        "  Buf.Store(" + n + " * 4, r);\n"
+        "  return r;\n"
+        "}\n";
+  }
+  c.Compile(source.c_str(), L"lib_6_3", {L"-Vd"}, {});
+  c.GetDxilModule();
+
+  // Make every function fail, so the order of merged diagnostics is checked.
+  unsigned NumDivisions = 0;
+  for (Function &F : *c.m_module) {
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+      if (I->getOpcode() == Instruction::UDiv) {
+        I->setOperand(1, ConstantInt::get(I->getType(), 0));
+        NumDivisions++;
+      }
+    }
+  }
+  VERIFY_ARE_EQUAL(NumFunctions, NumDivisions);
+  std::string bitcode;
+  {
+    raw_string_ostream OS(bitcode);
+    WriteBitcodeToFile(c.m_module.get(), OS);
+  }
+
+  // Pass the thread count explicitly, so the parallel path runs however many
+  // processors the machine has.
+  auto Validate = [&](unsigned NumThreads, std::string &errors) {
+    raw_string_ostream DiagStream(errors);
+    HRESULT hr = ValidateDxilBitcode(bitcode.data(), (uint32_t)bitcode.size(),
+                                     DiagStream, NumThreads);
+    DiagStream.flush();
+    return hr;
+  };
+  std::string serialErrors, parallelErrors;
+  HRESULT serialStatus = Validate(1, serialErrors);
+  HRESULT parallelStatus = Validate(4, parallelErrors);
+  VERIFY_IS_TRUE(FAILED(serialStatus));
+  VERIFY_ARE_EQUAL(serialStatus, parallelStatus);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos,
+                       serialErrors.find("No unsigned integer division by zero"));
+  VERIFY_ARE_EQUAL(serialErrors, parallelErrors);
+}
+
+TEST_F(DxilModuleTest, ViewIdStateWalkMatchesDataflow) {
+  struct Shader {
+    LPCWSTR profile;
+    const char *source;
+  };
+  // Loops, branches on inputs, arrays, calls and patch constants, so the
+  // dataflow merges cycles and control dependences the way the walk sees them.
+  const Shader Shaders[] = {
+    { L"vs_6_1",
+      "struct VSOut { float4 pos : SV_Position; float4 c : COLOR; uint id : ID; };\n"
+      "VSOut main(float4 pos : POSITION, float3 n : NORMAL, uint vid : SV_ViewID) {\n"
+      "  VSOut o;\n"
+      "  o.pos = pos * (vid + 1);\n"
+      "  o.c = float4(n, 1);\n"
+      "  if (n.x > 0) o.c.w = pos.y;\n"
+      "  o.id = vid;\n"
+      "  return o;\n"
+      "}\n" },
+    { L"ps_6_1",
+      "float Scale(float a, uint b) { return a * b; }\n"
+      "float4 main(float4 a : A, float4 b : B, nointerpolation uint n : N,\n"
+      "            uint vid : SV_ViewID) : SV_Target {\n"
+      "  float arr[4] = { a.x, a.y, b.z, b.w };\n"
+      "  float4 r = 0;\n"
+      "  [loop] for (uint i = 0; i < n; ++i) {\n"
+      "    r.x += arr[i % 4];\n"
+      "    if (r.x > a.w) r.y = Scale(r.x, vid);\n"
+      "    else r.z = r.y + b.x;\n"
+      "  }\n"
+      "  r.w = arr[vid % 4];\n"
+      "  return r;\n"
+      "}\n" },
+    { L"gs_6_1",
+      "struct VSOut { float4 pos : SV_Position; float4 a : A; float3 b : B; };\n"
+      "struct GSOut { float4 pos : SV_Position; float4 a : A; uint id : ID; };\n"
+      "[maxvertexcount(6)]\n"
+      "void main(triangle VSOut input[3], uint vid : SV_ViewID,\n"
+      "          inout TriangleStream<GSOut> s) {\n"
+      "  for (uint i = 0; i < 3; ++i) {\n"
+      "    GSOut o;\n"
+      "    o.pos = input[i].pos + vid;\n"
+      "    o.a = input[i].a * input[i].b.x;\n"
+      "    if (input[i].b.y > vid) o.a.y = 0;\n"
+      "    o.id = vid;\n"
+      "    s.Append(o);\n"
+      "  }\n"
+      "  s.RestartStrip();\n"
+      "}\n" },
+    { L"hs_6_1",
+      "struct CP { float3 pos : POSITION; float2 uv : TEXCOORD; };\n"
+      "struct PC { float edges[3] : SV_TessFactor; float inside : SV_InsideTessFactor;\n"
+      "            float3 c : CENTER; };\n"
+      "PC PatchFoo(InputPatch<CP, 3> ip, OutputPatch<CP, 3> op, uint vid : SV_ViewID) {\n"
+      "  PC p;\n"
+      "  for (uint i = 0; i < 3; ++i) p.edges[i] = ip[i].pos.x + op[i].uv.y;\n"
+      "  p.inside = ip[0].uv.x;\n"
+      "  p.c = (ip[0].pos + ip[1].pos + ip[2].pos) * vid;\n"
+      "  return p;\n"
+      "}\n"
+      "[domain(\"tri\")]\n"
+      "[partitioning(\"fractional_odd\")]\n"
+      "[outputtopology(\"triangle_cw\")]\n"
+      "[outputcontrolpoints(3)]\n"
+      "[patchconstantfunc(\"PatchFoo\")]\n"
+      "CP main(InputPatch<CP, 3> ip, uint i : SV_OutputControlPointID,\n"
+      "        uint vid : SV_ViewID) {\n"
+      "  CP o;\n"
+      "  o.pos = ip[i].pos * vid;\n"
+      "  o.uv = ip[(i + 1) % 3].uv;\n"
+      "  if (ip[i].uv.x > 0) o.uv.y = ip[i].pos.z;\n"
+      "  return o;\n"
+      "}\n" },
+    { L"ds_6_1",
+      "struct CP { float3 pos : POSITION; float2 uv : TEXCOORD; };\n"
+      "struct PC { float edges[3] : SV_TessFactor; float inside : SV_InsideTessFactor;\n"
+      "            float3 c : CENTER; };\n"
+      "struct DSOut { float4 pos : SV_Position; float2 uv : TEXCOORD; };\n"
+      "[domain(\"tri\")]\n"
+      "DSOut main(const OutputPatch<CP, 3> patch, PC pc, float3 bary : SV_DomainLocation,\n"
+      "           uint vid : SV_ViewID) {\n"
+      "  DSOut o;\n"
+      "  float3 p = 0;\n"
+      "  for (uint i = 0; i < 3; ++i) p += patch[i].pos * bary[i];\n"
+      "  o.pos = float4(p + pc.c, pc.inside);\n"
+      "  o.uv = patch[vid % 3].uv;\n"
+      "  return o;\n"
+      "}\n" },
+  };
+
+  if (m_ver.SkipDxilVersion(1, 1)) return;
+  for (const Shader &S : Shaders)
+    VerifyViewIdStateWalkMatchesDataflow(S.source, S.profile);
+}
+
+TEST_F(DxilModuleTest, ViewIdStateWalkMatchesDataflowOnFileCheckShaders) {
+  // The ViewID tests, plus mesh, domain, hull and multi-stream geometry
+  // shaders; each is compiled with the profile of its first RUN line.
+  std::vector<std::wstring> Files;
+  for (unsigned i = 1; i <= 19; ++i) {
+    wchar_t Name[64];
+    swprintf_s(Name, _countof(Name),
+               L"..\\HLSLFileCheck\\hlsl\\semantics\\sv_viewid\\viewid%02u.hlsl", i);
+    Files.push_back(Name);
+  }
+  Files.push_back(L"..\\HLSLFileCheck\\shader_targets\\mesh\\mesh.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\shader_targets\\mesh\\mesh-payload-matrix.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\shader_targets\\mesh\\mesh-shadingrate.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\shader_targets\\geometry\\multiStreamGS.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\shader_targets\\hull\\FloatMaxtessfactorHs.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\samples\\SimpleDs1.hlsl");
+  Files.push_back(L"..\\HLSLFileCheck\\samples\\d3d11\\SubD11_BezierEvalDS.hlsl");
+
+  for (const std::wstring &File : Files) {
+    std::wstring Path = hlsl_test::GetPathToHlslDataFile(File.c_str());
+#ifdef _WIN32
+    std::ifstream Stream(Path);
+#else
+    std::replace(Path.begin(), Path.end(), L'\\', L'/');
+    std::ifstream Stream((CW2A(Path.c_str())));
+#endif
+    std::string Source((std::istreambuf_iterator<char>(Stream)),
+                       std::istreambuf_iterator<char>());
+    VERIFY_IS_FALSE(Source.empty());
+
+    size_t ProfilePos = Source.find("-T ", Source.find("RUN:"));
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, ProfilePos);
+    std::string Profile = Source.substr(ProfilePos + 3, 6);
+    unsigned Minor = Profile[5] - '0';
+    if (m_ver.SkipDxilVersion(1, Minor))
+      continue;
+    VerifyViewIdStateWalkMatchesDataflow(Source.c_str(),
+                                         CA2W(Profile.c_str()));
+  }
+}
+
+// Computes the ViewID state of the shader with the dataflow and with the
+// walk over each output, and checks that both serialize the same.
+void DxilModuleTest::VerifyViewIdStateWalkMatchesDataflow(
+    const char *source, LPCWSTR shaderModel) {
+  // Each computation gets a module of its own, since the pass also updates
+  // the signatures it reads.
+  auto Compute = [&](bool bPerOutputWalk) {
+    Compiler c(m_dllSupport);
+    c.Compile(source, shaderModel);
+    DxilModule &DM = c.GetDxilModule();
+    legacy::PassManager PM;
+    PM.add(createComputeViewIdStatePass(bPerOutputWalk));
+    PM.run(*c.m_module);
+    return DM.GetSerializedViewIdState();
+  };
+  std::vector<unsigned> Dataflow = Compute(false);
+  std::vector<unsigned> Walk = Compute(true);
+  VERIFY_IS_FALSE(Dataflow.empty());
+  VERIFY_IS_TRUE(Dataflow == Walk);
+}
+
+// Returns a container with a single debug info part of PartSize bytes.
+static std::vector<uint8_t> CreateTestContainer(uint32_t PartSize) {
+  const uint32_t ContainerSize =
+      (uint32_t)GetDxilContainerSizeFromParts(1, PartSize);
+  std::vector<uint8_t> Container(ContainerSize);
+  DxilContainerHeader *pHeader = (DxilContainerHeader *)Container.data();
+  InitDxilContainer(pHeader, 1, ContainerSize);
+  uint32_t *pOffsets = (uint32_t *)(pHeader + 1);
+  pOffsets[0] = sizeof(DxilContainerHeader) + sizeof(uint32_t);
+  DxilPartHeader *pPart = (DxilPartHeader *)(Container.data() + pOffsets[0]);
+  pPart->PartFourCC = DFCC_ShaderDebugInfoDXIL;
+  pPart->PartSize = PartSize;
+  uint8_t *pPartData = (uint8_t *)(pPart + 1);
+  for (uint32_t i = 0; i < PartSize; ++i)
+    pPartData[i] = (uint8_t)(i * 7 + 3);
+  return Container;
+}
+
+static std::string GetMD5String(const void *pData, size_t Size) {
+  llvm::MD5 Hasher;
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)pData, Size));
+  llvm::MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Str;
+  llvm::MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+TEST_F(DxilModuleTest, AppendPartToContainerRejectsDuplicatePart) {
+  CComPtr<IMalloc> pMalloc;
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+  std::vector<uint8_t> Container = CreateTestContainer(64);
+  CComPtr<IDxcBlob> pContainer;
+  VERIFY_SUCCEEDED(DxcCreateBlobOnHeapCopy(Container.data(),
+                                           (UINT32)Container.size(),
+                                           &pContainer));
+
+  const uint32_t PartSize = 12;
+  auto WritePart = [&](AbstractMemoryStream *pStream) {
+    uint8_t Data[PartSize] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    ULONG cbWritten = 0;
+    return pStream->Write(Data, PartSize, &cbWritten);
+  };
+
+  CComPtr<IDxcBlob> pNewContainer;
+  uint32_t PartOffset = 0;
+  VERIFY_SUCCEEDED(AppendPartToContainer(pMalloc, pContainer, DFCC_PrivateData,
+                                         PartSize, WritePart, &pNewContainer,
+                                         &PartOffset));
+  const DxilContainerHeader *pHeader = IsDxilContainerLike(
+      pNewContainer->GetBufferPointer(), pNewContainer->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  VERIFY_IS_TRUE(IsValidDxilContainer(pHeader, pNewContainer->GetBufferSize()));
+  VERIFY_ARE_EQUAL(2U, pHeader->PartCount);
+  const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, 1);
+  VERIFY_ARE_EQUAL((const char *)pHeader + PartOffset, (const char *)pPart);
+  VERIFY_ARE_EQUAL((uint32_t)DFCC_PrivateData, pPart->PartFourCC);
+  VERIFY_ARE_EQUAL(PartSize, pPart->PartSize);
+  VERIFY_ARE_EQUAL(12, GetDxilPartData(pPart)[PartSize - 1]);
+
+  // Neither the original part nor the appended one can be added again.
+  CComPtr<IDxcBlob> pDuplicate;
+  VERIFY_ARE_EQUAL(DXC_E_DUPLICATE_PART,
+                   AppendPartToContainer(pMalloc, pNewContainer,
+                                         DFCC_PrivateData, PartSize, WritePart,
+                                         &pDuplicate, &PartOffset));
+  VERIFY_ARE_EQUAL(DXC_E_DUPLICATE_PART,
+                   AppendPartToContainer(pMalloc, pContainer,
+                                         DFCC_ShaderDebugInfoDXIL, PartSize,
+                                         WritePart, &pDuplicate, &PartOffset));
+  VERIFY_IS_NULL(pDuplicate.p);
+}
+
+TEST_F(DxilModuleTest, StreamedPdbMatchesBufferedWriter) {
+  // Digests of the PDBs written by the buffered MSF writer that the streamed
+  // one replaced, for containers of one, six and 144 blocks.
+  struct {
+    uint32_t PartSize;
+    uint32_t PdbSize;
+    const char *MD5;
+  } Cases[] = {
+    { 64,    3584,  "0a7742280fcc24820b6600ef673b0b46" },
+    { 3000,  6144,  "0ba587e508b83fe62c47a7a491c73b68" },
+    { 70000, 73728, "5c01f0382198ba4479af5f0759ebf44b" },
+  };
+  BYTE Hash[16];
+  for (unsigned i = 0; i < _countof(Hash); ++i)
+    Hash[i] = (BYTE)(0xA0 + i);
+
+  CComPtr<IMalloc> pMalloc;
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pMalloc));
+  for (const auto &Case : Cases) {
+    std::vector<uint8_t> Container = CreateTestContainer(Case.PartSize);
+    const uint32_t ContainerSize = (uint32_t)Container.size();
+    VERIFY_ARE_EQUAL(Case.PdbSize, pdb::GetDxilPDBSize(ContainerSize));
+
+    CComPtr<AbstractMemoryStream> pStream;
+    VERIFY_SUCCEEDED(CreateMemoryStream(pMalloc, &pStream));
+    VERIFY_SUCCEEDED(pdb::WriteDxilPDB(pStream, ContainerSize,
+      [&](IStream *pContainerStream) {
+        ULONG cbWritten = 0;
+        return pContainerStream->Write(Container.data(), ContainerSize,
+                                       &cbWritten);
+      },
+      Hash));
+    VERIFY_ARE_EQUAL(Case.PdbSize, (uint32_t)pStream->GetPosition());
+    VERIFY_ARE_EQUAL(Case.PdbSize, (uint32_t)pStream->GetPtrSize());
+    VERIFY_ARE_EQUAL(std::string(Case.MD5),
+                     GetMD5String(pStream->GetPtr(), pStream->GetPtrSize()));
+
+    // The blob form goes through the same writer.
+    CComPtr<IDxcBlob> pPdb;
+    VERIFY_SUCCEEDED(pdb::WriteDxilPDB(pMalloc, Container, Hash, &pPdb));
+    VERIFY_ARE_EQUAL(std::string(Case.MD5),
+                     GetMD5String(pPdb->GetBufferPointer(),
+                                  pPdb->GetBufferSize()));
+
+    // Reading it back gives the hash and the container, padded to whole
+    // blocks.
+    CComPtr<IStream> pPdbStream;
+    VERIFY_SUCCEEDED(CreateReadOnlyBlobStream(pPdb, &pPdbStream));
+    CComPtr<IDxcBlob> pReadHash, pReadContainer;
+    VERIFY_SUCCEEDED(pdb::LoadDataFromStream(pMalloc, pPdbStream, &pReadHash,
+                                             &pReadContainer));
+    VERIFY_ARE_EQUAL(sizeof(Hash), pReadHash->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(Hash, pReadHash->GetBufferPointer(),
+                               sizeof(Hash)));
+    VERIFY_IS_TRUE(ContainerSize <= pReadContainer->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(Container.data(),
+                               pReadContainer->GetBufferPointer(),
+                               ContainerSize));
+  }
+}
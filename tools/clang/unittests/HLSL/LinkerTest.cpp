@@ -9,6 +9,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include "llvm/ADT/ArrayRef.h"
@@ -23,11 +24,33 @@
 #include "dxc/Test/DxcTestUtils.h"
 #include "dxc/dxcapi.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/Support/microcom.h"
 
 using namespace std;
 using namespace hlsl;
 using namespace llvm;
 
+class TestLinkBatchCallback : public IDxcLinkerBatchCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::mutex m_lock;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestLinkBatchCallback(UINT32 targetCount) : m_dwRef(0), Results(targetCount) { }
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcLinkerBatchCallback>(this, iid, ppvObject);
+  }
+
+  std::vector<CComPtr<IDxcOperationResult>> Results;
+
+  HRESULT STDMETHODCALLTYPE OnResult(UINT32 uIndex, IDxcOperationResult *pResult) override {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (uIndex >= Results.size() || Results[uIndex] != nullptr)
+      return E_UNEXPECTED;
+    Results[uIndex] = pResult;
+    return S_OK;
+  }
+};
+
 // The test fixture.
 class LinkerTest
 {
@@ -42,6 +65,7 @@ public:
   TEST_METHOD(RunLinkResource);
   TEST_METHOD(RunLinkResourceWithBinding);
   TEST_METHOD(RunLinkAllProfiles);
+  TEST_METHOD(RunLinkBatch);
   TEST_METHOD(RunLinkFailNoDefine);
   TEST_METHOD(RunLinkFailReDefine);
   TEST_METHOD(RunLinkGlobalInit);
@@ -51,6 +75,7 @@ public:
   TEST_METHOD(RunLinkMatParamToLib);
   TEST_METHOD(RunLinkResRet);
   TEST_METHOD(RunLinkToLib);
+  TEST_METHOD(RunLinkToLibAfterShader);
   TEST_METHOD(RunLinkToLibExport);
   TEST_METHOD(RunLinkToLibExportShadersOnly);
   TEST_METHOD(RunLinkFailReDefineGlobal);
@@ -272,6 +297,55 @@ TEST_F(LinkerTest, RunLinkAllProfiles) {
   Link(L"cs_main", L"cs_6_0", pLinker, {libName, libResName}, {},{});
 }
 
+TEST_F(LinkerTest, RunLinkBatch) {
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+
+  LPCWSTR libName = L"entry";
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_entries2.hlsl", &pEntryLib);
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+
+  // Target 5 names an entry the library does not define and must fail on its
+  // own.
+  LPCWSTR psArgs[] = { L"-Od" };
+  DxcLinkTarget targets[] = {
+    { L"vs_main", L"vs_6_0", nullptr, 0 },
+    { L"hs_main", L"hs_6_0", nullptr, 0 },
+    { L"ds_main", L"ds_6_0", nullptr, 0 },
+    { L"gs_main", L"gs_6_0", nullptr, 0 },
+    { L"ps_main", L"ps_6_0", psArgs, _countof(psArgs) },
+    { L"no_main", L"ps_6_0", nullptr, 0 },
+  };
+  const UINT32 TargetCount = _countof(targets);
+  LPCWSTR libNames[] = { libName };
+  LPCWSTR sharedArgs[] = { L"-Qstrip_reflect" };
+
+  CComPtr<IDxcLinkerBatch> pBatch;
+  VERIFY_SUCCEEDED(pLinker.QueryInterface(&pBatch));
+  CComPtr<TestLinkBatchCallback> pCallback = new TestLinkBatchCallback(TargetCount);
+  VERIFY_SUCCEEDED(pBatch->LinkBatch(targets, TargetCount, libNames,
+                                     _countof(libNames), sharedArgs,
+                                     _countof(sharedArgs), 4, pCallback));
+
+  for (UINT32 i = 0; i < TargetCount; ++i) {
+    VERIFY_IS_NOT_NULL(pCallback->Results[i].p);
+    HRESULT status;
+    VERIFY_SUCCEEDED(pCallback->Results[i]->GetStatus(&status));
+    if (i == 5) {
+      VERIFY_FAILED(status);
+    } else {
+      VERIFY_SUCCEEDED(status);
+    }
+  }
+
+  // Libraries must be registered before they can be linked in a batch.
+  LPCWSTR missingNames[] = { L"missing" };
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pBatch->LinkBatch(targets, TargetCount, missingNames, 1,
+                                     nullptr, 0, 4, pCallback));
+}
+
 TEST_F(LinkerTest, RunLinkFailNoDefine) {
   CComPtr<IDxcBlob> pEntryLib;
   CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
@@ -483,6 +557,35 @@ TEST_F(LinkerTest, RunLinkToLib) {
   Link(L"", L"lib_6_3", pLinker, {libName, libName2}, {"!llvm.dbg.cu"}, {}, option);
 }
 
+TEST_F(LinkerTest, RunLinkToLibAfterShader) {
+  LPCWSTR option[] = {L"-Zi", L"-Qembed_debug"};
+
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_mat_entry2.hlsl",
+             &pEntryLib, option);
+  CComPtr<IDxcBlob> pLib;
+  CompileLib(
+      L"..\\CodeGenHLSL\\linker\\lib_mat_cast2.hlsl",
+      &pLib, option);
+
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+
+  LPCWSTR libName = L"ps_main";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+
+  LPCWSTR libName2 = L"test";
+  RegisterDxcModule(libName2, pLib, pLinker);
+
+  // Shaders link from prepared copies of the library functions; linking the
+  // library afterwards must still see the original functions.
+  Link(L"main", L"ps_6_0", pLinker, {libName, libName2}, {"define void @main()"}, {}, option);
+  Link(L"main", L"ps_6_0", pLinker, {libName, libName2}, {"define void @main()"}, {}, option);
+  Link(L"", L"lib_6_3", pLinker, {libName, libName2},
+       {"define .*mat_test", "!DISubprogram\\(name: \"mat_test\"[^)]*function: "},
+       {"prepared"}, option, /*bRegEx*/ true);
+}
+
 TEST_F(LinkerTest, RunLinkToLibExport) {
   CComPtr<IDxcBlob> pEntryLib;
   CompileLib(L"..\\CodeGenHLSL\\linker\\lib_mat_entry2.hlsl",
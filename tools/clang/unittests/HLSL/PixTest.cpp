@@ -25,6 +25,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cfloat>
+#include <chrono>
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
@@ -190,6 +191,9 @@ public:
   TEST_METHOD(DiaLoadRelocatedBitcode)
   TEST_METHOD(DiaLoadBitcodePlusExtraData)
   TEST_METHOD(DiaCompileArgs)
+  BEGIN_TEST_METHOD(DiaLoadLargeThenQueryPerf)
+    TEST_METHOD_PROPERTY(L"Priority", L"2")
+  END_TEST_METHOD()
   TEST_METHOD(PixDebugCompileInfo)
 
   TEST_METHOD(CheckSATPassFor66_NoDynamicAccess)
@@ -1544,6 +1548,71 @@ TEST_F(PixTest, DiaTableIndexThenOK) {
   VERIFY_FAILED(pEnumTables->Item(vtIndex, &pTable));
 }
 
+TEST_F(PixTest, DiaLoadLargeThenQueryPerf) {
+  // Synthesize a long shader, then time opening the session separately from
+  // the first line lookups (which build the session indices) and later ones.
+  const unsigned StatementCount = 10000;
+  std::string hlsl = "float4 main(float4 pos : SV_Position) : SV_Target {\n"
+                     "  float4 r = pos;\n";
+  for (unsigned i = 0; i < StatementCount; ++i)
+    hlsl += "  r = r * 1.0001 + pos.yzwx;\n";
+  hlsl += "  return r;\n}\n";
+
+  CComPtr<IDiaDataSource> pDiaSource;
+  VERIFY_SUCCEEDED(CreateDiaSourceForCompile(hlsl.c_str(), &pDiaSource));
+
+  using Clock = std::chrono::steady_clock;
+  auto MicrosecondsSince = [](Clock::time_point start) {
+    return (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+               Clock::now() - start).count();
+  };
+
+  CComPtr<IDiaSession> pSession;
+  auto start = Clock::now();
+  VERIFY_SUCCEEDED(pDiaSource->openSession(&pSession));
+  unsigned openUs = MicrosecondsSince(start);
+
+  CComPtr<IDiaEnumTables> pEnumTables;
+  VERIFY_SUCCEEDED(pSession->getEnumTables(&pEnumTables));
+
+  const DWORD Queries = 1000;
+  CComPtr<IDiaEnumLineNumbers> pLines;
+  start = Clock::now();
+  VERIFY_SUCCEEDED(pSession->findLinesByRVA(0, 1, &pLines));
+  unsigned firstRvaUs = MicrosecondsSince(start);
+  start = Clock::now();
+  for (DWORD rva = 0; rva < Queries; ++rva) {
+    pLines.Release();
+    VERIFY_SUCCEEDED(pSession->findLinesByRVA(rva, 1, &pLines));
+  }
+  unsigned rvaUs = MicrosecondsSince(start);
+
+  CComPtr<IDiaEnumSourceFiles> pFiles;
+  CComPtr<IDiaSourceFile> pFile;
+  ULONG fetched;
+  VERIFY_SUCCEEDED(pSession->findFile(nullptr, L"source.hlsl", nsNone, &pFiles));
+  VERIFY_SUCCEEDED(pFiles->Next(1, &pFile, &fetched));
+  VERIFY_ARE_EQUAL(1u, fetched);
+
+  // Statements start on line 3.
+  pLines.Release();
+  start = Clock::now();
+  VERIFY_ARE_EQUAL(S_OK, pSession->findLinesByLinenum(nullptr, pFile, 3, 0, &pLines));
+  unsigned firstLineUs = MicrosecondsSince(start);
+  start = Clock::now();
+  for (DWORD line = 3; line < Queries + 3; ++line) {
+    pLines.Release();
+    VERIFY_ARE_EQUAL(S_OK, pSession->findLinesByLinenum(nullptr, pFile, line, 0, &pLines));
+  }
+  unsigned lineUs = MicrosecondsSince(start);
+
+  LogCommentFmt(L"Opened session over %u statements in %u us", StatementCount, openUs);
+  LogCommentFmt(L"findLinesByRVA: first %u us, then %u ns each",
+                firstRvaUs, (unsigned)(rvaUs * 1000ull / Queries));
+  LogCommentFmt(L"findLinesByLinenum: first %u us, then %u ns each",
+                firstLineUs, (unsigned)(lineUs * 1000ull / Queries));
+}
+
 TEST_F(PixTest, PixDebugCompileInfo) {
   static const char source[] = R"(
     SamplerState  samp0 : register(s0);
@@ -1687,6 +1687,9 @@ TEST_F(FileTest, SpirvLegalizationStructuredBufferInStruct) {
   setBeforeHLSLLegalization();
   runFileTest("spirv.legal.sbuffer.struct.hlsl");
 }
+TEST_F(FileTest, SpirvLegalizationAndOptimization) {
+  runFileTest("spirv.legal.opt.hlsl");
+}
 TEST_F(FileTest, SpirvLegalizationConstantBuffer) {
   runFileTest("spirv.legal.cbuffer.hlsl");
 }
@@ -1702,6 +1705,9 @@ TEST_F(FileTest, SpirvDebugOpSource) {
 TEST_F(FileTest, SpirvDebugOpSourceNonExistingFile) {
   runFileTest("spirv.debug.source.non.existing.file.hlsl");
 }
+TEST_F(FileTest, SpirvDebugSourceSinglePass) {
+  runFileTest("spirv.debug.source.single-pass.hlsl");
+}
 
 TEST_F(FileTest, SpirvDebugOpLine) { runFileTest("spirv.debug.opline.hlsl"); }
 TEST_F(FileTest, SpirvDebugOpLineBranch) {
@@ -175,4 +175,28 @@ TEST(ValueTest, printSlots) {
 #undef CHECK_PRINT_AS_OPERAND
 }
 
+// HLSL Change Begin
+TEST(ValueTest, DxilOpNameFollowsRenames) {
+  LLVMContext C;
+  std::unique_ptr<Module> M(new Module("M", C));
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(C), false);
+
+  Function *Op = Function::Create(FTy, GlobalValue::ExternalLinkage,
+                                  "dx.op.barrier", M.get());
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, "f",
+                                 M.get());
+  EXPECT_TRUE(Op->hasDxilOpName());
+  EXPECT_FALSE(F->hasDxilOpName());
+
+  F->setName("dx.op.discard");
+  EXPECT_TRUE(F->hasDxilOpName());
+  F->setName("");
+  EXPECT_FALSE(F->hasDxilOpName());
+
+  F->takeName(Op);
+  EXPECT_TRUE(F->hasDxilOpName());
+  EXPECT_FALSE(Op->hasDxilOpName());
+}
+// HLSL Change End
+
 } // end anonymous namespace
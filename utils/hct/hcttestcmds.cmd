@@ -384,6 +384,20 @@ if %Failed% neq 0 goto :failed
 call :run dxc_batch.exe -multi-thread "%testfiles%\batch_cmds.txt"
 if %Failed% neq 0 goto :failed
 
+set testname=Smoke test for dxc -batch
+echo // one dxc command line per line> smoke.batch.txt
+echo /T ps_6_0 "%testfiles%\smoke.hlsl" /Fo smoke.batch1.cso>> smoke.batch.txt
+echo /T ps_6_0 "%testfiles%\smoke.hlsl" /DDX12 /Fc smoke.batch2.ll>> smoke.batch.txt
+call :run dxc.exe -batch smoke.batch.txt -batch-threads 2
+call :check_file smoke.batch1.cso del
+call :check_file smoke.batch2.ll find "define void @main()" del
+if %Failed% neq 0 goto :failed
+echo /T ps_6_0 "%testfiles%\smoke.hlsl" /E not_an_entry>> smoke.batch.txt
+call :run-fail dxc.exe -batch smoke.batch.txt
+call :check_file log find "1 of 3 batch jobs failed"
+call :check_file smoke.batch.txt del
+if %Failed% neq 0 goto :failed
+
 set testname=Smoke test for dxl command line
 call :run dxc.exe -T lib_6_x "%testfiles%\lib_entry4.hlsl" -Fo lib_entry4.dxbc
 call :check_file lib_entry4.dxbc